@@ -0,0 +1,182 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "psi/algorithm/ecdh/ecdh_flow_control.h"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
+#include "spdlog/spdlog.h"
+#include "yacl/base/exception.h"
+
+#include "psi/trace_categories.h"
+
+namespace psi::ecdh {
+
+namespace {
+
+// Weight of a new sample in the smoothed timings.
+constexpr double kSmoothFactor = 0.25;
+
+// Number of samples of both kinds to wait for after a change.
+constexpr size_t kSamplesPerChange = 2;
+
+double Smooth(double smoothed, double sample) {
+  return smoothed == 0 ? sample
+                       : smoothed + kSmoothFactor * (sample - smoothed);
+}
+
+}  // namespace
+
+EcdhFlowControlOptions MakeEcdhFlowControlOptions(
+    const v2::EcdhFlowControlConfig& config) {
+  EcdhFlowControlOptions options;
+  options.enable = config.enable();
+  if (config.min_batch_size() != 0) {
+    options.min_batch_size = config.min_batch_size();
+  }
+  if (config.max_batch_size() != 0) {
+    options.max_batch_size = config.max_batch_size();
+  }
+  if (config.max_in_flight_batches() != 0) {
+    options.max_in_flight = config.max_in_flight_batches();
+  }
+  return options;
+}
+
+EcdhFlowController::EcdhFlowController(const EcdhFlowControlOptions& options,
+                                       size_t initial_batch_size)
+    : options_(options) {
+  YACL_ENFORCE(options_.min_batch_size > 0 &&
+                   options_.min_batch_size <= options_.max_batch_size,
+               "invalid batch size bounds [{}, {}]", options_.min_batch_size,
+               options_.max_batch_size);
+  YACL_ENFORCE(options_.min_in_flight > 0 &&
+                   options_.min_in_flight <= options_.max_in_flight,
+               "invalid in-flight bounds [{}, {}]", options_.min_in_flight,
+               options_.max_in_flight);
+  batch_size_ = std::clamp(initial_batch_size, options_.min_batch_size,
+                           options_.max_batch_size);
+  in_flight_ = options_.max_in_flight;
+}
+
+size_t EcdhFlowController::batch_size() const {
+  std::unique_lock lock(mtx_);
+  return batch_size_;
+}
+
+size_t EcdhFlowController::in_flight() const {
+  std::unique_lock lock(mtx_);
+  return in_flight_;
+}
+
+void EcdhFlowController::OnBatchMasked(size_t item_cnt, double seconds) {
+  if (item_cnt == 0) {
+    return;
+  }
+  std::unique_lock lock(mtx_);
+  item_seconds_ = Smooth(item_seconds_, seconds / item_cnt);
+  mask_samples_++;
+  Adjust();
+}
+
+void EcdhFlowController::OnBatchAcked(double seconds) {
+  std::unique_lock lock(mtx_);
+  ack_seconds_ = Smooth(ack_seconds_, seconds);
+  ack_samples_++;
+  Adjust();
+}
+
+void EcdhFlowController::WaitToSend(size_t batch_idx) {
+  std::unique_lock lock(mtx_);
+  ack_cv_.wait(lock,
+               [&] { return closed_ || batch_idx < acked_cnt_ + in_flight_; });
+  if (!closed_) {
+    send_time_[batch_idx] = Clock::now();
+  }
+}
+
+void EcdhFlowController::Ack(size_t batch_idx) {
+  std::optional<double> seconds;
+  {
+    std::unique_lock lock(mtx_);
+    acked_cnt_ = std::max(acked_cnt_, batch_idx + 1);
+    auto iter = send_time_.find(batch_idx);
+    if (iter != send_time_.end()) {
+      seconds = std::chrono::duration<double>(Clock::now() - iter->second)
+                    .count();
+      send_time_.erase(iter);
+    }
+  }
+  ack_cv_.notify_all();
+  if (seconds.has_value()) {
+    OnBatchAcked(*seconds);
+  }
+}
+
+void EcdhFlowController::Close() {
+  {
+    std::unique_lock lock(mtx_);
+    closed_ = true;
+    send_time_.clear();
+  }
+  ack_cv_.notify_all();
+}
+
+void EcdhFlowController::Adjust() {
+  if (item_seconds_ == 0 || ack_seconds_ == 0 ||
+      mask_samples_ < kSamplesPerChange || ack_samples_ < kSamplesPerChange) {
+    return;
+  }
+
+  // Number of batches masked while one batch is being acknowledged.
+  auto acking_batches = [&](size_t batch_size) {
+    return ack_seconds_ / (item_seconds_ * batch_size);
+  };
+
+  size_t batch_size = batch_size_;
+  double acking = acking_batches(batch_size);
+  if (acking > options_.max_in_flight / 2.0) {
+    batch_size = std::min(batch_size * 2, options_.max_batch_size);
+  } else if (acking < 2) {
+    batch_size = std::max(batch_size / 2, options_.min_batch_size);
+  }
+  size_t in_flight = std::clamp(
+      static_cast<size_t>(std::ceil(acking_batches(batch_size))) + 1,
+      options_.min_in_flight, options_.max_in_flight);
+
+  if (batch_size != batch_size_ || in_flight != in_flight_) {
+    SPDLOG_INFO(
+        "ECDH flow control: batch_size {} -> {}, in_flight {} -> {}, "
+        "mask {:.3g}s/item, ack {:.3g}s",
+        batch_size_, batch_size, in_flight_, in_flight, item_seconds_,
+        ack_seconds_);
+    if (batch_size != batch_size_) {
+      // Acknowledgement time depends on the batch size, start over.
+      ack_seconds_ = 0;
+    }
+    batch_size_ = batch_size;
+    in_flight_ = in_flight;
+    mask_samples_ = 0;
+    ack_samples_ = 0;
+    TRACE_COUNTER("online", "EcdhPsi::BatchSize",
+                  static_cast<int64_t>(batch_size_));
+    TRACE_COUNTER("online", "EcdhPsi::InFlightBatches",
+                  static_cast<int64_t>(in_flight_));
+    ack_cv_.notify_all();
+  }
+}
+
+}  // namespace psi::ecdh
@@ -0,0 +1,109 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include "psi/proto/psi_v2.pb.h"
+
+namespace psi::ecdh {
+
+inline constexpr size_t kEcdhFlowControlMinBatchSize = 1024;
+inline constexpr size_t kEcdhFlowControlMaxBatchSize = 1 << 20;
+inline constexpr size_t kEcdhFlowControlMaxInFlight = 16;
+
+struct EcdhFlowControlOptions {
+  // If false, batches are sent as read from the batch provider and the number
+  // of batches in flight is not limited.
+  bool enable = false;
+
+  // Bounds of the batch size.
+  size_t min_batch_size = kEcdhFlowControlMinBatchSize;
+  size_t max_batch_size = kEcdhFlowControlMaxBatchSize;
+
+  // Bounds of the number of batches sent but not acknowledged by peer yet.
+  size_t min_in_flight = 1;
+  size_t max_in_flight = kEcdhFlowControlMaxInFlight;
+};
+
+// Options from config, unset fields keep the defaults.
+EcdhFlowControlOptions MakeEcdhFlowControlOptions(
+    const v2::EcdhFlowControlConfig& config);
+
+// Tunes the batch size and the number of in-flight batches of MaskSelf.
+//
+// A batch is acknowledged when its dual masked echo comes back from peer, or
+// when its send call returns if peer echoes nothing. The in-flight limit is
+// the number of batches produced during one acknowledgement, plus one, so
+// the link is kept busy without queueing more than needed at the slower side.
+// The batch size doubles when more than max_in_flight / 2 batches are masked
+// during one acknowledgement, i.e. latency dominates, and halves when less
+// than two are, to keep memory low. Timings are smoothed and a change waits
+// for fresh samples.
+class EcdhFlowController {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  EcdhFlowController(const EcdhFlowControlOptions& options,
+                     size_t initial_batch_size);
+
+  size_t batch_size() const;
+
+  size_t in_flight() const;
+
+  // Masking `item_cnt` items took `seconds`.
+  void OnBatchMasked(size_t item_cnt, double seconds);
+
+  // Peer acknowledged a batch `seconds` after it was sent.
+  void OnBatchAcked(double seconds);
+
+  // Blocks until batch `batch_idx` may be sent, then records its send time.
+  void WaitToSend(size_t batch_idx);
+
+  // Echo of batch `batch_idx` arrived.
+  void Ack(size_t batch_idx);
+
+  // No more echoes will arrive, stops limiting the batches in flight.
+  void Close();
+
+ private:
+  void Adjust();
+
+  const EcdhFlowControlOptions options_;
+
+  mutable std::mutex mtx_;
+  std::condition_variable ack_cv_;
+
+  size_t batch_size_;
+  size_t in_flight_;
+
+  // Smoothed seconds to mask one item, and to acknowledge a batch.
+  double item_seconds_ = 0;
+  double ack_seconds_ = 0;
+  // Samples taken since the last change.
+  size_t mask_samples_ = 0;
+  size_t ack_samples_ = 0;
+
+  size_t acked_cnt_ = 0;
+  bool closed_ = false;
+  std::unordered_map<size_t, Clock::time_point> send_time_;
+};
+
+}  // namespace psi::ecdh
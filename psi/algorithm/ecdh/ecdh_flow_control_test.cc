@@ -0,0 +1,117 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "psi/algorithm/ecdh/ecdh_flow_control.h"
+
+#include <future>
+
+#include "gtest/gtest.h"
+
+namespace psi::ecdh {
+
+namespace {
+
+// Feeds timings of a link where acknowledging a batch takes `latency`
+// seconds plus the time to mask it, until the controller settles.
+void Simulate(EcdhFlowController* controller, double item_seconds,
+              double latency) {
+  for (size_t i = 0; i < 100; ++i) {
+    size_t batch_size = controller->batch_size();
+    controller->OnBatchMasked(batch_size, item_seconds * batch_size);
+    controller->OnBatchAcked(latency + item_seconds * batch_size);
+  }
+}
+
+}  // namespace
+
+TEST(EcdhFlowControllerTest, GrowsBatchOnHighLatency) {
+  EcdhFlowControlOptions options;
+  options.enable = true;
+  EcdhFlowController controller(options, 4096);
+
+  // 1s latency, 10us per item.
+  Simulate(&controller, 1e-5, 1);
+
+  EXPECT_GT(controller.batch_size(), 4096);
+  EXPECT_LE(controller.in_flight(), options.max_in_flight / 2 + 1);
+  EXPECT_GE(controller.in_flight(), 2);
+}
+
+TEST(EcdhFlowControllerTest, ShrinksBatchOnLowLatency) {
+  EcdhFlowControlOptions options;
+  options.enable = true;
+  options.min_batch_size = 256;
+  EcdhFlowController controller(options, 1 << 16);
+
+  // 10us latency, 10us per item.
+  Simulate(&controller, 1e-5, 1e-5);
+
+  EXPECT_EQ(controller.batch_size(), 256);
+  EXPECT_LE(controller.in_flight(), 3);
+}
+
+TEST(EcdhFlowControllerTest, Bounds) {
+  EcdhFlowControlOptions options;
+  options.enable = true;
+  options.min_batch_size = 1000;
+  options.max_batch_size = 2000;
+  options.max_in_flight = 4;
+  EcdhFlowController controller(options, 1);
+  EXPECT_EQ(controller.batch_size(), 1000);
+
+  Simulate(&controller, 1e-6, 10);
+  EXPECT_EQ(controller.batch_size(), 2000);
+  EXPECT_EQ(controller.in_flight(), 4);
+}
+
+TEST(EcdhFlowControllerTest, WaitToSend) {
+  EcdhFlowControlOptions options;
+  options.enable = true;
+  options.max_in_flight = 2;
+  EcdhFlowController controller(options, 4096);
+
+  controller.WaitToSend(0);
+  controller.WaitToSend(1);
+  auto f = std::async(std::launch::async, [&] { controller.WaitToSend(2); });
+  EXPECT_EQ(f.wait_for(std::chrono::milliseconds(50)),
+            std::future_status::timeout);
+  controller.Ack(0);
+  f.get();
+
+  // Close releases every waiting sender.
+  f = std::async(std::launch::async, [&] { controller.WaitToSend(10); });
+  controller.Close();
+  f.get();
+}
+
+TEST(EcdhFlowControllerTest, OptionsFromConfig) {
+  v2::EcdhFlowControlConfig config;
+  auto options = MakeEcdhFlowControlOptions(config);
+  EXPECT_FALSE(options.enable);
+  EXPECT_EQ(options.min_batch_size, kEcdhFlowControlMinBatchSize);
+  EXPECT_EQ(options.max_batch_size, kEcdhFlowControlMaxBatchSize);
+  EXPECT_EQ(options.max_in_flight, kEcdhFlowControlMaxInFlight);
+
+  config.set_enable(true);
+  config.set_min_batch_size(10);
+  config.set_max_batch_size(100);
+  config.set_max_in_flight_batches(3);
+  options = MakeEcdhFlowControlOptions(config);
+  EXPECT_TRUE(options.enable);
+  EXPECT_EQ(options.min_batch_size, 10);
+  EXPECT_EQ(options.max_batch_size, 100);
+  EXPECT_EQ(options.max_in_flight, 3);
+}
+
+}  // namespace psi::ecdh
@@ -14,10 +14,21 @@
 
 #include "psi/algorithm/ecdh/ecdh_psi.h"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <cstring>
+#include <deque>
 #include <future>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 #include <utility>
 
@@ -25,6 +36,7 @@
 #include "yacl/base/exception.h"
 #include "yacl/crypto/hash/hash_utils.h"
 #include "yacl/utils/parallel.h"
+#include "yacl/utils/scope_guard.h"
 #include "yacl/utils/serialize.h"
 
 #include "psi/cryptor/cryptor_selector.h"
@@ -41,6 +53,11 @@ EcdhPsiContext::EcdhPsiContext(EcdhPsiOptions options)
 
   main_link_ctx_ = options_.link_ctx;
   dual_mask_link_ctx_ = options_.link_ctx->Spawn();
+
+  if (options_.flow_control.enable) {
+    flow_controller_ = std::make_unique<EcdhFlowController>(
+        options_.flow_control, options_.batch_size);
+  }
 }
 
 void EcdhPsiContext::CheckConfig() {
@@ -57,90 +74,281 @@ void EcdhPsiContext::CheckConfig() {
                peer_config.data<const char>());
 }
 
+namespace {
+
+// Fixed capacity FIFO handing batches from one MaskSelf stage to the next.
+// Close() wakes up both sides: Push then fails and Pop drains what is left.
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(size_t capacity)
+      : capacity_(std::max<size_t>(capacity, 1)) {}
+
+  bool Push(T item) {
+    std::unique_lock lock(mtx_);
+    not_full_cv_.wait(lock,
+                      [&] { return closed_ || queue_.size() < capacity_; });
+    if (closed_) {
+      return false;
+    }
+    queue_.push(std::move(item));
+    not_empty_cv_.notify_one();
+    return true;
+  }
+
+  std::optional<T> Pop() {
+    std::unique_lock lock(mtx_);
+    not_empty_cv_.wait(lock, [&] { return closed_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return std::nullopt;
+    }
+    T item = std::move(queue_.front());
+    queue_.pop();
+    not_full_cv_.notify_one();
+    return item;
+  }
+
+  void Close() {
+    std::unique_lock lock(mtx_);
+    closed_ = true;
+    not_full_cv_.notify_all();
+    not_empty_cv_.notify_all();
+  }
+
+ private:
+  const size_t capacity_;
+  std::mutex mtx_;
+  std::condition_variable not_full_cv_;
+  std::condition_variable not_empty_cv_;
+  std::queue<T> queue_;
+  bool closed_ = false;
+};
+
+struct SelfBatch {
+  std::vector<std::string> items;
+  std::unordered_map<uint32_t, uint32_t> duplicate_item_cnt;
+};
+
+struct MaskedSelfBatch {
+  size_t batch_idx = 0;
+  std::vector<std::string> masked_items;
+  std::unordered_map<uint32_t, uint32_t> duplicate_item_cnt;
+};
+
+// Re-slices batches read from the provider into batches of any size, keeping
+// duplicate counts attached to their items.
+class BatchRechunker {
+ public:
+  void Append(SelfBatch batch) {
+    uint64_t end_pos = begin_pos_ + items_.size();
+    for (auto [index, cnt] : batch.duplicate_item_cnt) {
+      duplicate_item_cnt_[end_pos + index] = cnt;
+    }
+    std::move(batch.items.begin(), batch.items.end(),
+              std::back_inserter(items_));
+  }
+
+  size_t size() const { return items_.size(); }
+
+  SelfBatch Take(size_t size) {
+    size = std::min(size, items_.size());
+    SelfBatch batch;
+    batch.items.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+      batch.items.push_back(std::move(items_.front()));
+      items_.pop_front();
+    }
+    auto iter = duplicate_item_cnt_.begin();
+    while (iter != duplicate_item_cnt_.end() &&
+           iter->first < begin_pos_ + size) {
+      batch.duplicate_item_cnt[iter->first - begin_pos_] = iter->second;
+      iter = duplicate_item_cnt_.erase(iter);
+    }
+    begin_pos_ += size;
+    return batch;
+  }
+
+ private:
+  std::deque<std::string> items_;
+  // Position of items_.front() in the stream.
+  uint64_t begin_pos_ = 0;
+  // Keyed by position in the stream.
+  std::map<uint64_t, uint32_t> duplicate_item_cnt_;
+};
+
+}  // namespace
+
+// MaskSelf runs as a three stage pipeline connected by bounded queues:
+//   reader: batch_provider -> read_queue
+//   masker: read_queue -> HashAndMask -> send_queue   (this thread)
+//   sender: send_queue -> peer
+// So the next batch is read while the current one is masked and the previous
+// one is on the wire.
+//
+// With flow control, the reader re-slices batches to the size picked by the
+// controller and the sender waits while too many batches are unacknowledged.
 void EcdhPsiContext::MaskSelf(
     const std::shared_ptr<IBasicBatchProvider>& batch_provider,
     uint64_t processed_item_cnt) {
-  size_t batch_count = 0;
-  size_t item_count = processed_item_cnt;
-  bool read_next_batch = true;
+  BoundedQueue<SelfBatch> read_queue(options_.pipeline_depth);
+  BoundedQueue<MaskedSelfBatch> send_queue(options_.pipeline_depth);
 
-  std::vector<std::string> batch_items;
-  std::unordered_map<uint32_t, uint32_t> duplicate_item_cnt;
-  while (processed_item_cnt > 0) {
-    auto [read_batch_items, item_cnt] =
-        batch_provider->ReadNextBatchWithDupCnt();
+  auto read_f = std::async(std::launch::async, [&]() {
+    ON_SCOPE_EXIT([&] { read_queue.Close(); });
 
-    if (read_batch_items.empty()) {
-      YACL_ENFORCE_EQ(processed_item_cnt, 0U);
-    }
+    BatchRechunker rechunker;
+    auto push = [&](SelfBatch batch) {
+      if (!flow_controller_) {
+        return read_queue.Push(std::move(batch));
+      }
+      bool is_last = batch.items.empty();
+      rechunker.Append(std::move(batch));
+      while (rechunker.size() > 0 &&
+             (is_last || rechunker.size() >= flow_controller_->batch_size())) {
+        if (!read_queue.Push(
+                rechunker.Take(flow_controller_->batch_size()))) {
+          return false;
+        }
+      }
+      return !is_last || read_queue.Push(SelfBatch());
+    };
 
-    if (read_batch_items.size() <= processed_item_cnt) {
-      processed_item_cnt -= read_batch_items.size();
-    } else {
-      read_next_batch = false;
-      batch_items = std::vector<std::string>(
-          read_batch_items.begin() + processed_item_cnt,
-          read_batch_items.end());
-      processed_item_cnt = 0;
+    // Skip items which have been processed before recovery.
+    uint64_t skip_cnt = processed_item_cnt;
+    while (skip_cnt > 0) {
+      auto [read_batch_items, item_cnt] =
+          batch_provider->ReadNextBatchWithDupCnt();
+
+      if (read_batch_items.empty()) {
+        YACL_ENFORCE_EQ(skip_cnt, 0U);
+      }
+
+      if (read_batch_items.size() <= skip_cnt) {
+        skip_cnt -= read_batch_items.size();
+        continue;
+      }
+
+      SelfBatch batch;
+      batch.items = std::vector<std::string>(
+          read_batch_items.begin() + skip_cnt, read_batch_items.end());
       for (auto [index, cnt] : item_cnt) {
-        if (index >= processed_item_cnt) {
-          duplicate_item_cnt[index - processed_item_cnt] = cnt;
+        if (index >= skip_cnt) {
+          batch.duplicate_item_cnt[index - skip_cnt] = cnt;
         }
       }
+      skip_cnt = 0;
+      if (!push(std::move(batch))) {
+        return;
+      }
     }
-  }
 
-  while (true) {
-    // NOTE: we still need to send one batch even there is no data.
-    // This dummy batch is used to notify peer the end of data stream.
-    if (read_next_batch) {
-      std::tie(batch_items, duplicate_item_cnt) =
+    while (true) {
+      SelfBatch batch;
+      std::tie(batch.items, batch.duplicate_item_cnt) =
           batch_provider->ReadNextBatchWithDupCnt();
-    } else {
-      read_next_batch = true;
+      bool is_last = batch.items.empty();
+      if (!push(std::move(batch)) || is_last) {
+        return;
+      }
     }
+  });
 
-    std::vector<std::string> masked_items;
-    std::vector<std::string> hashed_masked_items;
-    auto hashed_points = options_.ecc_cryptor->HashInputs(batch_items);
-    auto masked_points = options_.ecc_cryptor->EccMask(hashed_points);
-    masked_items = options_.ecc_cryptor->SerializeEcPoints(masked_points);
+  auto send_f = std::async(std::launch::async, [&]() {
+    ON_SCOPE_EXIT([&] { send_queue.Close(); });
 
-    // Send x^a.
-    const auto tag = fmt::format("ECDHPSI:X^A:{}", batch_count);
-    if (PeerCanTouchResults()) {
-      if (!duplicate_item_cnt.empty()) {
-        SPDLOG_INFO("send extra item cnt: {}", duplicate_item_cnt.size());
+    while (auto batch = send_queue.Pop()) {
+      if (flow_controller_) {
+        flow_controller_->WaitToSend(batch->batch_idx);
+      }
+      // Send x^a.
+      const auto tag = fmt::format("ECDHPSI:X^A:{}", batch->batch_idx);
+      if (PeerCanTouchResults()) {
+        if (!batch->duplicate_item_cnt.empty()) {
+          SPDLOG_INFO("send extra item cnt: {}",
+                      batch->duplicate_item_cnt.size());
+        }
+        SendBatch(batch->masked_items, batch->duplicate_item_cnt,
+                  batch->batch_idx, tag);
+      } else {
+        SendBatch(batch->masked_items, batch->batch_idx, tag);
+      }
+      if (flow_controller_ && !SelfCanTouchResults()) {
+        // Peer echoes nothing, a batch is acknowledged once it is sent.
+        flow_controller_->Ack(batch->batch_idx);
       }
-      SendBatch(masked_items, duplicate_item_cnt, batch_count, tag);
-    } else {
-      SendBatch(masked_items, batch_count, tag);
     }
+  });
 
-    if (batch_items.empty()) {
-      SPDLOG_INFO("MaskSelf:{} --finished, batch_count={}, self_item_count={}",
-                  Id(), batch_count, item_count);
-      if (options_.statistics) {
-        options_.statistics->self_item_count = item_count;
+  try {
+    size_t batch_count = 0;
+    size_t item_count = processed_item_cnt;
+    // NOTE: we still need to send one batch even there is no data.
+    // This dummy batch is used to notify peer the end of data stream.
+    while (auto batch = read_queue.Pop()) {
+      MaskedSelfBatch masked;
+      masked.batch_idx = batch_count;
+      masked.duplicate_item_cnt = std::move(batch->duplicate_item_cnt);
+
+      if (options_.ecdh_logger && !batch->items.empty()) {
+        // The logger needs the hashed points, so keep them around.
+        auto hashed_points = options_.ecc_cryptor->HashInputs(batch->items);
+        masked.masked_items = options_.ecc_cryptor->SerializeEcPoints(
+            options_.ecc_cryptor->EccMask(hashed_points));
+        options_.ecdh_logger->Log(
+            EcdhStage::MaskSelf, options_.ecc_cryptor->GetPrivateKey(),
+            item_count, options_.ecc_cryptor->SerializeEcPoints(hashed_points),
+            masked.masked_items);
+      } else {
+        auto start = std::chrono::steady_clock::now();
+        masked.masked_items = options_.ecc_cryptor->HashAndMask(batch->items);
+        if (flow_controller_) {
+          flow_controller_->OnBatchMasked(
+              batch->items.size(),
+              std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                            start)
+                  .count());
+        }
       }
-      break;
-    }
 
-    if (options_.ecdh_logger) {
-      hashed_masked_items =
-          options_.ecc_cryptor->SerializeEcPoints(hashed_points);
-      options_.ecdh_logger->Log(EcdhStage::MaskSelf,
-                                options_.ecc_cryptor->GetPrivateKey(),
-                                item_count, hashed_masked_items, masked_items);
-    }
-    item_count += batch_items.size();
-    ++batch_count;
+      if (!send_queue.Push(std::move(masked))) {
+        break;
+      }
 
-    if (batch_count % kLogBatchInterval == 0) {
-      SPDLOG_INFO("MaskSelf:{}, batch_count={}, self_item_count={}", Id(),
-                  batch_count, item_count);
+      if (batch->items.empty()) {
+        SPDLOG_INFO(
+            "MaskSelf:{} --finished, batch_count={}, self_item_count={}", Id(),
+            batch_count, item_count);
+        if (options_.statistics) {
+          options_.statistics->self_item_count = item_count;
+          if (flow_controller_) {
+            options_.statistics->batch_size = flow_controller_->batch_size();
+            options_.statistics->in_flight_batches =
+                flow_controller_->in_flight();
+          }
+        }
+        break;
+      }
+
+      item_count += batch->items.size();
+      ++batch_count;
+
+      if (batch_count % kLogBatchInterval == 0) {
+        SPDLOG_INFO("MaskSelf:{}, batch_count={}, self_item_count={}", Id(),
+                    batch_count, item_count);
+      }
     }
+  } catch (...) {
+    read_queue.Close();
+    send_queue.Close();
+    read_f.wait();
+    send_f.wait();
+    throw;
   }
+
+  read_queue.Close();
+  send_queue.Close();
+  read_f.get();
+  send_f.get();
 }
 
 void EcdhPsiContext::MaskPeer(
@@ -149,37 +357,46 @@ void EcdhPsiContext::MaskPeer(
   size_t item_count = 0;
   while (true) {
     // Fetch y^b.
-    std::vector<std::string> peer_items;
-    std::vector<std::string> dual_masked_peers;
-    std::unordered_map<uint32_t, uint32_t> duplicate_item_cnt;
     const auto tag = fmt::format("ECDHPSI:Y^B:{}", batch_count);
-    RecvBatch(&peer_items, &duplicate_item_cnt, batch_count, tag);
-    if (!duplicate_item_cnt.empty()) {
-      SPDLOG_INFO("recv extra item cnt: {}", duplicate_item_cnt.size());
+    auto peer_batch = RecvBatch(batch_count, tag);
+    if (!peer_batch.duplicate_item_cnt.empty()) {
+      SPDLOG_INFO("recv extra item cnt: {}",
+                  peer_batch.duplicate_item_cnt.size());
     }
+    auto peer_items = peer_batch.Items();
 
     auto peer_points = options_.ecc_cryptor->DeserializeEcPoints(peer_items);
 
     // Compute (y^b)^a.
+    // In the final comparison, we only send & compare `kFinalCompareBytes`
+    // number of bytes, all of them are packed in `dual_masked_bytes`.
+    std::string dual_masked_bytes;
+    std::vector<std::string_view> dual_masked_peers;
     if (!peer_items.empty()) {
-      // TODO: avoid mem copy
       const auto& masked_points = options_.ecc_cryptor->EccMask(peer_points);
-      for (uint32_t i = 0; i != peer_points.size(); ++i) {
-        const auto masked =
-            options_.ecc_cryptor->SerializeEcPoint(masked_points[i]);
-        // In the final comparison, we only send & compare `kFinalCompareBytes`
-        // number of bytes.
-        std::string cipher(
-            masked.data<char>() + masked.size() - options_.dual_mask_size,
+      dual_masked_bytes.resize(peer_points.size() * options_.dual_mask_size);
+      yacl::parallel_for(
+          0, peer_points.size(), [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; ++i) {
+              const auto masked =
+                  options_.ecc_cryptor->SerializeEcPoint(masked_points[i]);
+              std::memcpy(
+                  dual_masked_bytes.data() + i * options_.dual_mask_size,
+                  masked.data<char>() + masked.size() - options_.dual_mask_size,
+                  options_.dual_mask_size);
+            }
+          });
+      dual_masked_peers.reserve(peer_points.size());
+      for (size_t i = 0; i != peer_points.size(); ++i) {
+        dual_masked_peers.emplace_back(
+            dual_masked_bytes.data() + i * options_.dual_mask_size,
             options_.dual_mask_size);
-        if (SelfCanTouchResults()) {
-          // Store cipher of peer items for later intersection compute.
-          peer_ec_point_store->Save(cipher, duplicate_item_cnt[i]);
-        }
-        dual_masked_peers.emplace_back(std::move(cipher));
       }
 
       if (SelfCanTouchResults()) {
+        // Store cipher of peer items for later intersection compute.
+        peer_ec_point_store->Save(dual_masked_peers,
+                                  peer_batch.duplicate_item_cnt);
         if (options_.recovery_manager) {
           peer_ec_point_store->Flush();
           options_.recovery_manager->UpdateEcdhDualMaskedItemPeerCount(
@@ -221,9 +438,12 @@ void EcdhPsiContext::MaskPeer(
       break;
     }
     if (options_.ecdh_logger) {
-      options_.ecdh_logger->Log(EcdhStage::MaskPeer,
-                                options_.ecc_cryptor->GetPrivateKey(),
-                                item_count, peer_items, dual_masked_peers);
+      options_.ecdh_logger->Log(
+          EcdhStage::MaskPeer, options_.ecc_cryptor->GetPrivateKey(),
+          item_count,
+          std::vector<std::string>(peer_items.begin(), peer_items.end()),
+          std::vector<std::string>(dual_masked_peers.begin(),
+                                   dual_masked_peers.end()));
     }
     item_count += peer_items.size();
     batch_count++;
@@ -241,18 +461,28 @@ void EcdhPsiContext::RecvDualMaskedSelf(
     return;
   }
 
+  // Echoes stop here, either done or failed, let MaskSelf send freely.
+  ON_SCOPE_EXIT([&] {
+    if (flow_controller_) {
+      flow_controller_->Close();
+    }
+  });
+
   size_t item_count = 0;
   // Receive x^a^b.
   size_t batch_count = 0;
   while (true) {
-    // TODO: avoid mem copy
-    std::vector<std::string> masked_items;
     const auto tag = fmt::format("ECDHPSI:X^A^B:{}", batch_count);
-    RecvDualMaskedBatch(&masked_items, batch_count, tag);
+    auto masked_batch = RecvDualMaskedBatch(batch_count, tag);
+    if (flow_controller_) {
+      flow_controller_->Ack(batch_count);
+    }
+    auto masked_items = masked_batch.Items();
     if (options_.ecdh_logger) {
-      options_.ecdh_logger->Log(EcdhStage::RecvDualMaskedSelf,
-                                options_.ecc_cryptor->GetPrivateKey(),
-                                item_count, masked_items);
+      options_.ecdh_logger->Log(
+          EcdhStage::RecvDualMaskedSelf, options_.ecc_cryptor->GetPrivateKey(),
+          item_count,
+          std::vector<std::string>(masked_items.begin(), masked_items.end()));
     }
 
     self_ec_point_store->Save(masked_items);
@@ -348,41 +578,25 @@ void SendBatchNonBlockImpl(const std::vector<T>& batch_items,
                         link_ctx, type, batch_idx, tag);
 }
 
-void RecvBatchImpl(const std::shared_ptr<yacl::link::Context>& link_ctx,
-                   int32_t batch_idx, std::string_view tag,
-                   std::vector<std::string>* items) {
-  PsiDataBatch batch =
-      PsiDataBatch::Deserialize(link_ctx->Recv(link_ctx->NextRank(), tag));
+PsiDataBatchView RecvBatchImpl(
+    const std::shared_ptr<yacl::link::Context>& link_ctx, int32_t batch_idx,
+    std::string_view tag) {
+  auto batch =
+      PsiDataBatchView::Deserialize(link_ctx->Recv(link_ctx->NextRank(), tag));
 
   YACL_ENFORCE(batch.batch_index == batch_idx, "Expected batch {}, but got {} ",
                batch_idx, batch.batch_index);
 
-  if (batch.item_num > 0) {
-    auto item_size = batch.flatten_bytes.size() / batch.item_num;
-    for (size_t i = 0; i < batch.item_num; ++i) {
-      items->emplace_back(batch.flatten_bytes.substr(i * item_size, item_size));
-    }
-  }
+  return batch;
 }
 
 void RecvBatchImpl(const std::shared_ptr<yacl::link::Context>& link_ctx,
                    int32_t batch_idx, std::string_view tag,
-                   std::vector<std::string>& items,
-                   std::unordered_map<uint32_t, uint32_t>& duplicate_item_cnt) {
-  PsiDataBatch batch =
-      PsiDataBatch::Deserialize(link_ctx->Recv(link_ctx->NextRank(), tag));
-
-  YACL_ENFORCE(batch.batch_index == batch_idx, "Expected batch {}, but got {} ",
-               batch_idx, batch.batch_index);
-
-  if (batch.item_num > 0) {
-    auto item_size = batch.flatten_bytes.size() / batch.item_num;
-    for (size_t i = 0; i < batch.item_num; ++i) {
-      items.emplace_back(batch.flatten_bytes.substr(i * item_size, item_size));
-    }
-    for (const auto& [idx, cnt] : batch.duplicate_item_cnt) {
-      duplicate_item_cnt[idx] = cnt;
-    }
+                   std::vector<std::string>* items) {
+  auto batch = RecvBatchImpl(link_ctx, batch_idx, tag);
+  items->reserve(items->size() + batch.item_num);
+  for (size_t i = 0; i < batch.item_num; ++i) {
+    items->emplace_back(batch.item(i));
   }
 }
 
@@ -412,11 +626,9 @@ void EcdhPsiContext::SendBatch(const std::vector<std::string_view>& batch_items,
   SendBatchImpl(batch_items, main_link_ctx_, "enc", batch_idx, tag);
 }
 
-void EcdhPsiContext::RecvBatch(
-    std::vector<std::string>* items,
-    std::unordered_map<uint32_t, uint32_t>* duplicate_item_cnt,
-    int32_t batch_idx, std::string_view tag) {
-  RecvBatchImpl(main_link_ctx_, batch_idx, tag, *items, *duplicate_item_cnt);
+PsiDataBatchView EcdhPsiContext::RecvBatch(int32_t batch_idx,
+                                           std::string_view tag) {
+  return RecvBatchImpl(main_link_ctx_, batch_idx, tag);
 }
 void EcdhPsiContext::RecvBatch(std::vector<std::string>* items,
                                int32_t batch_idx, std::string_view tag) {
@@ -442,10 +654,16 @@ void EcdhPsiContext::SendDualMaskedBatchNonBlock(
                         tag);
 }
 
-void EcdhPsiContext::RecvDualMaskedBatch(std::vector<std::string>* items,
-                                         int32_t batch_idx,
-                                         std::string_view tag) {
-  RecvBatchImpl(dual_mask_link_ctx_, batch_idx, tag, items);
+void EcdhPsiContext::SendDualMaskedBatchNonBlock(
+    const std::vector<std::string_view>& batch_items, int32_t batch_idx,
+    std::string_view tag) {
+  SendBatchNonBlockImpl(batch_items, dual_mask_link_ctx_, "dual.enc", batch_idx,
+                        tag);
+}
+
+PsiDataBatchView EcdhPsiContext::RecvDualMaskedBatch(int32_t batch_idx,
+                                                     std::string_view tag) {
+  return RecvBatchImpl(dual_mask_link_ctx_, batch_idx, tag);
 }
 
 void RunEcdhPsi(const EcdhPsiOptions& options,
@@ -555,17 +773,13 @@ std::vector<std::string> RunEcdhPsi(
   // But tests show that when items_count > 10,000,000, the performance of
   // |std::unordered_set| or |absl::flat_hash_set| drops significantly.
   // Besides, these hashset containers require more memory.
-  // Here we choose the compact data structure and stable find costs.
+  // Here we choose a sort-merge join on compact fixed-width prefixes, which
+  // has predictable memory and spreads over all cores.
   std::vector<std::string> ret;
-  std::vector<std::string> peer_results(peer_ec_point_store->content());
-  std::sort(peer_results.begin(), peer_results.end());
-  const auto& self_results = self_ec_point_store->content();
-  for (uint32_t index = 0; index < self_results.size(); index++) {
-    if (std::binary_search(peer_results.begin(), peer_results.end(),
-                           self_results[index])) {
-      YACL_ENFORCE(index < items.size());
-      ret.push_back(items[index]);
-    }
+  for (uint64_t index :
+       ComputeIndices(*self_ec_point_store, *peer_ec_point_store)) {
+    YACL_ENFORCE(index < items.size());
+    ret.push_back(items[index]);
   }
   return ret;
 }
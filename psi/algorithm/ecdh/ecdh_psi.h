@@ -24,6 +24,7 @@
 
 #include "yacl/link/link.h"
 
+#include "psi/algorithm/ecdh/ecdh_flow_control.h"
 #include "psi/algorithm/ecdh/ecdh_logger.h"
 #include "psi/checkpoint/recovery.h"
 #include "psi/cryptor/ecc_cryptor.h"
@@ -37,9 +38,15 @@ namespace psi::ecdh {
 
 using FinishBatchHook = std::function<void(size_t)>;
 
+inline constexpr size_t kEcdhPsiPipelineDepth = 2;
+
 struct EcdhPsiStatistics {
   size_t self_item_count = 0;
   size_t peer_item_count = 0;
+  // Batch size and in-flight batch limit chosen by flow control at the end of
+  // MaskSelf, 0 if flow control is disabled.
+  size_t batch_size = 0;
+  size_t in_flight_batches = 0;
 };
 
 struct EcdhPsiOptions {
@@ -56,6 +63,15 @@ struct EcdhPsiOptions {
   //     batch send and read
   size_t batch_size = kEcdhPsiBatchSize;
 
+  // Capacity of the bounded queues between the read, mask and send stages of
+  // MaskSelf, i.e. how many batches may wait in front of each stage. Larger
+  // values smooth out jitter in reading and sending at the cost of memory.
+  size_t pipeline_depth = kEcdhPsiPipelineDepth;
+
+  // Adapts the size of batches sent by MaskSelf, starting from batch_size,
+  // and how many of them may wait for peer at the same time.
+  EcdhFlowControlOptions flow_control;
+
   // Points out which rank the psi results should be revealed.
   //
   // Allowed values:
@@ -131,9 +147,8 @@ class EcdhPsiContext {
 
   void RecvBatch(std::vector<std::string>* items, int32_t batch_idx,
                  std::string_view tag = "");
-  void RecvBatch(std::vector<std::string>* items,
-                 std::unordered_map<uint32_t, uint32_t>* duplicate_item_cnt,
-                 int32_t batch_idx, std::string_view tag);
+  // Items of the returned batch are views into the received buffer.
+  PsiDataBatchView RecvBatch(int32_t batch_idx, std::string_view tag);
 
   void SendDualMaskedBatch(const std::vector<std::string>& batch_items,
                            int32_t batch_idx, std::string_view tag = "");
@@ -145,11 +160,18 @@ class EcdhPsiContext {
                                    int32_t batch_idx,
                                    std::string_view tag = "");
 
-  void RecvDualMaskedBatch(std::vector<std::string>* items, int32_t batch_idx,
-                           std::string_view tag = "");
+  void SendDualMaskedBatchNonBlock(
+      const std::vector<std::string_view>& batch_items, int32_t batch_idx,
+      std::string_view tag = "");
+
+  PsiDataBatchView RecvDualMaskedBatch(int32_t batch_idx,
+                                       std::string_view tag = "");
 
   EcdhPsiOptions options_;
 
+  // Set if flow control is enabled.
+  std::unique_ptr<EcdhFlowController> flow_controller_;
+
   std::shared_ptr<yacl::link::Context> main_link_ctx_;
   std::shared_ptr<yacl::link::Context> dual_mask_link_ctx_;
   const std::string id_;
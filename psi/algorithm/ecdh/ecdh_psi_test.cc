@@ -22,6 +22,8 @@
 #include "yacl/base/exception.h"
 #include "yacl/link/test_util.h"
 
+#include "psi/cryptor/cryptor_selector.h"
+#include "psi/utils/batch_provider_impl.h"
 #include "psi/utils/test_utils.h"
 
 struct TestParams {
@@ -82,6 +84,60 @@ TEST(EcdhPsiTestFailed, CurveTypeMismatched) {
   ASSERT_THROW(fb.get(), ::yacl::EnforceNotMet);
 }
 
+TEST(EcdhPsiTest, FlowControl) {
+  auto items_a = test::CreateRangeItems(0, 40961);
+  auto items_b = test::CreateRangeItems(5, 40961);
+  auto ctxs = yacl::link::test::SetupWorld(2);
+
+  // Flow control is local to a party, only enable it on one side.
+  auto proc = [&](const std::shared_ptr<yacl::link::Context>& ctx,
+                  const std::vector<std::string>& items, size_t target_rank,
+                  bool flow_control, EcdhPsiStatistics* statistics) {
+    EcdhPsiOptions options;
+    options.ecc_cryptor = CreateEccCryptor(CurveType::CURVE_25519);
+    options.link_ctx = ctx;
+    options.target_rank = target_rank;
+    options.batch_size = 1000;
+    options.flow_control.enable = flow_control;
+    options.flow_control.min_batch_size = 100;
+    options.flow_control.max_in_flight = 4;
+    options.statistics = statistics;
+
+    auto self_store = std::make_shared<MemoryEcPointStore>();
+    auto peer_store = std::make_shared<MemoryEcPointStore>();
+    RunEcdhPsi(options, std::make_shared<MemoryBatchProvider>(items, 4096),
+               self_store, peer_store);
+    std::vector<std::string> ret;
+    for (uint64_t index : ComputeIndices(*self_store, *peer_store)) {
+      ret.push_back(items[index]);
+    }
+    return ret;
+  };
+
+  for (size_t target_rank : {yacl::link::kAllRank, size_t(0), size_t(1)}) {
+    EcdhPsiStatistics stats_a;
+    EcdhPsiStatistics stats_b;
+    auto fa = std::async(proc, ctxs[0], items_a, target_rank, true, &stats_a);
+    auto fb = std::async(proc, ctxs[1], items_b, target_rank, false, &stats_b);
+    auto results_a = fa.get();
+    auto results_b = fb.get();
+
+    auto intersection = test::GetIntersection(items_a, items_b);
+    if (target_rank != 1) {
+      EXPECT_EQ(results_a, intersection);
+    }
+    if (target_rank != 0) {
+      EXPECT_EQ(results_b, intersection);
+    }
+    EXPECT_EQ(stats_a.self_item_count, items_a.size());
+    EXPECT_EQ(stats_b.peer_item_count, items_a.size());
+    EXPECT_GE(stats_a.batch_size, 100);
+    EXPECT_GE(stats_a.in_flight_batches, 1);
+    EXPECT_LE(stats_a.in_flight_batches, 4);
+    EXPECT_EQ(stats_b.batch_size, 0);
+  }
+}
+
 class EcdhPsiTest : public testing::TestWithParam<TestParams> {};
 
 TEST_P(EcdhPsiTest, Works) {
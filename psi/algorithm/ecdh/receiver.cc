@@ -63,9 +63,14 @@ void EcdhPsiReceiver::PreProcess() {
   }
 
   psi_options_.ecc_cryptor =
-      CreateEccCryptor(config_.protocol_config().ecdh_config().curve());
+      CreateEccCryptor(config_.protocol_config().ecdh_config().curve(),
+                       config_.protocol_config().ecdh_config().backend());
   psi_options_.link_ctx = lctx_;
 
+  psi_options_.flow_control = MakeEcdhFlowControlOptions(
+      config_.protocol_config().ecdh_config().flow_control());
+  psi_options_.statistics = &psi_stats_;
+
   // NOTE(junfeng): Only difference between receiver and sender.
   psi_options_.target_rank = lctx_->Rank();
   if (config_.protocol_config().broadcast_result()) {
@@ -107,6 +112,8 @@ void EcdhPsiReceiver::Online() {
       RunEcdhPsi(psi_options_, batch_provider_, self_ec_point_store_,
                  peer_ec_point_store_);
     });
+    report_.set_ecdh_batch_size(psi_stats_.batch_size);
+    report_.set_ecdh_in_flight_batches(psi_stats_.in_flight_batches);
   }
 
   if (recovery_manager_) {
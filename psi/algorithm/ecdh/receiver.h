@@ -39,6 +39,8 @@ class EcdhPsiReceiver final : public AbstractPsiReceiver {
 
   EcdhPsiOptions psi_options_;
 
+  EcdhPsiStatistics psi_stats_;
+
   std::shared_ptr<HashBucketEcPointStore> self_ec_point_store_;
   std::shared_ptr<HashBucketEcPointStore> peer_ec_point_store_;
 };
@@ -60,21 +60,14 @@ std::string HashItem(absl::string_view item, absl::string_view masked_item,
 /**
  * @brief do ec ponit mul
  *
- * @param sk_bytes  private key data
+ * @param ec_group ec group
+ * @param bn_sk private key, reduced modulo the group order
  * @param point_bytes compressed ec point data
- * @param ec_group_nid ec group nid
  * @return std::string compressed ec point data
  */
-std::string EcPointMul(absl::string_view sk_bytes,
-                       absl::string_view point_bytes, int ec_group_nid) {
+std::string EcPointMul(const EcGroupSt &ec_group, const BigNumSt &bn_sk,
+                       absl::string_view point_bytes) {
   BnCtxPtr bn_ctx(yacl::CheckNotNull(BN_CTX_new()));
-  EcGroupSt ec_group(ec_group_nid);
-  BigNumSt bn_sk;
-
-  YACL_ENFORCE(sk_bytes.size() == kEccKeySize);
-  bn_sk.FromBytes(absl::string_view(static_cast<const char *>(sk_bytes.data()),
-                                    sk_bytes.length()),
-                  ec_group.bn_n);
 
   EcPointSt ec_point(ec_group);
   EC_POINT_oct2point(ec_group.get(), ec_point.get(),
@@ -91,25 +84,42 @@ std::string EcPointMul(absl::string_view sk_bytes,
   return masked_point_bytes;
 }
 
+BigNumSt PrivateKeyToBigNum(absl::string_view sk_bytes,
+                            const EcGroupSt &ec_group) {
+  BigNumSt bn_sk;
+
+  YACL_ENFORCE(sk_bytes.size() == kEccKeySize);
+  bn_sk.FromBytes(absl::string_view(static_cast<const char *>(sk_bytes.data()),
+                                    sk_bytes.length()),
+                  ec_group.bn_n);
+  return bn_sk;
+}
+
 /**
  * @brief do ec ponit mul
  *
  * @param sk_bytes  private key data
- * @param item_bytes input data, map to ec point internal
+ * @param point_bytes compressed ec point data
  * @param ec_group_nid ec group nid
  * @return std::string compressed ec point data
  */
-std::string ItemMul(absl::string_view sk_bytes, absl::string_view item_bytes,
-                    int ec_group_nid) {
-  BnCtxPtr bn_ctx(yacl::CheckNotNull(BN_CTX_new()));
+std::string EcPointMul(absl::string_view sk_bytes,
+                       absl::string_view point_bytes, int ec_group_nid) {
   EcGroupSt ec_group(ec_group_nid);
-  BigNumSt bn_sk;
-
-  YACL_ENFORCE(sk_bytes.size() == kEccKeySize);
-  bn_sk.FromBytes(absl::string_view(static_cast<const char *>(sk_bytes.data()),
-                                    sk_bytes.length()),
-                  ec_group.bn_n);
+  return EcPointMul(ec_group, PrivateKeyToBigNum(sk_bytes, ec_group),
+                    point_bytes);
+}
 
+/**
+ * @brief do ec ponit mul
+ *
+ * @param ec_group ec group
+ * @param bn_sk private key, reduced modulo the group order
+ * @param item_bytes input data, map to ec point internal
+ * @return std::string compressed ec point data
+ */
+std::string ItemMul(const EcGroupSt &ec_group, const BigNumSt &bn_sk,
+                    absl::string_view item_bytes) {
   EcPointSt ec_point =
       EcPointSt::CreateEcPointByHashToCurve(item_bytes, ec_group);
 
@@ -121,6 +131,21 @@ std::string ItemMul(absl::string_view sk_bytes, absl::string_view item_bytes,
   return point_bytes;
 }
 
+/**
+ * @brief do ec ponit mul
+ *
+ * @param sk_bytes  private key data
+ * @param item_bytes input data, map to ec point internal
+ * @param ec_group_nid ec group nid
+ * @return std::string compressed ec point data
+ */
+std::string ItemMul(absl::string_view sk_bytes, absl::string_view item_bytes,
+                    int ec_group_nid) {
+  EcGroupSt ec_group(ec_group_nid);
+  return ItemMul(ec_group, PrivateKeyToBigNum(sk_bytes, ec_group),
+                 item_bytes);
+}
+
 std::vector<uint8_t> EccPrivateKeyInv(int group_id,
                                       yacl::ByteContainerView private_key) {
   BnCtxPtr bn_ctx(yacl::CheckNotNull(BN_CTX_new()));
@@ -145,35 +170,58 @@ std::vector<uint8_t> EccPrivateKeyInv(int group_id,
 
 }  // namespace
 
-std::string BasicEcdhOprfServer::Evaluate(
-    absl::string_view blinded_element) const {
-  return EcPointMul(
+BasicEcdhOprfServer::BasicEcdhOprfServer(CurveType type)
+    : curve_type_(type), ec_group_nid_(Sm2Cryptor::GetEcGroupId(type)) {
+  (void)curve_type_;
+  PrecomputeKey();
+}
+
+BasicEcdhOprfServer::BasicEcdhOprfServer(yacl::ByteContainerView private_key,
+                                         CurveType type)
+    : IEcdhOprfServer(private_key),
+      curve_type_(type),
+      ec_group_nid_(Sm2Cryptor::GetEcGroupId(type)) {
+  PrecomputeKey();
+}
+
+void BasicEcdhOprfServer::SetPrivateKey(yacl::ByteContainerView private_key) {
+  IEcdhOprfServer::SetPrivateKey(private_key);
+  PrecomputeKey();
+}
+
+void BasicEcdhOprfServer::PrecomputeKey() {
+  if (ec_group_ == nullptr) {
+    ec_group_ = std::make_unique<EcGroupSt>(ec_group_nid_);
+  }
+  bn_sk_ = PrivateKeyToBigNum(
       absl::string_view(reinterpret_cast<const char *>(&private_key_[0]),
                         kEccKeySize),
-      blinded_element, ec_group_nid_);
+      *ec_group_);
+}
+
+std::string BasicEcdhOprfServer::Evaluate(
+    absl::string_view blinded_element) const {
+  YACL_ENFORCE(ec_group_ != nullptr, "curve type is not set");
+  return EcPointMul(*ec_group_, bn_sk_, blinded_element);
 }
 
 std::string BasicEcdhOprfServer::FullEvaluate(
     yacl::ByteContainerView input) const {
+  YACL_ENFORCE(ec_group_ != nullptr, "curve type is not set");
   absl::string_view input_sv = absl::string_view(
       reinterpret_cast<const char *>(input.data()), input.size());
-  std::string point_bytes = ItemMul(
-      absl::string_view(reinterpret_cast<const char *>(&private_key_[0]),
-                        kEccKeySize),
-      input_sv, ec_group_nid_);
+  std::string point_bytes = ItemMul(*ec_group_, bn_sk_, input_sv);
 
   return HashItem(input_sv, point_bytes, GetCompareLength(), hash_type_);
 }
 
 std::string BasicEcdhOprfServer::SimpleEvaluate(
     yacl::ByteContainerView input) const {
+  YACL_ENFORCE(ec_group_ != nullptr, "curve type is not set");
   absl::string_view input_sv = absl::string_view(
       reinterpret_cast<const char *>(input.data()), input.size());
 
-  std::string point_bytes = ItemMul(
-      absl::string_view(reinterpret_cast<const char *>(&private_key_[0]),
-                        kEccKeySize),
-      input_sv, ec_group_nid_);
+  std::string point_bytes = ItemMul(*ec_group_, bn_sk_, input_sv);
 
   return HashItem(absl::string_view(), point_bytes, GetCompareLength(),
                   hash_type_);
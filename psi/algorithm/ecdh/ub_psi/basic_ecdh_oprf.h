@@ -27,6 +27,7 @@
 #include "yacl/crypto/hash/hash_interface.h"
 
 #include "psi/algorithm/ecdh/ub_psi/ecdh_oprf.h"
+#include "psi/cryptor/ecc_utils.h"
 #include "psi/cryptor/ecc_cryptor.h"
 #include "psi/cryptor/sm2_cryptor.h"
 
@@ -52,17 +53,13 @@ class BasicEcdhOprfServer : public IEcdhOprfServer {
    *
    * @param type support CurveSecp256k1/Sm2/FourQ
    */
-  explicit BasicEcdhOprfServer(CurveType type)
-      : curve_type_(type), ec_group_nid_(Sm2Cryptor::GetEcGroupId(type)) {
-    (void)curve_type_;
-  }
+  explicit BasicEcdhOprfServer(CurveType type);
+
+  BasicEcdhOprfServer(yacl::ByteContainerView private_key, CurveType type);
 
-  BasicEcdhOprfServer(yacl::ByteContainerView private_key, CurveType type)
-      : IEcdhOprfServer(private_key),
-        curve_type_(type),
-        ec_group_nid_(Sm2Cryptor::GetEcGroupId(type)) {}
+  ~BasicEcdhOprfServer() override { BN_clear(bn_sk_.get()); }
 
-  ~BasicEcdhOprfServer() override = default;
+  void SetPrivateKey(yacl::ByteContainerView private_key) override;
 
   OprfType GetOprfType() const override { return OprfType::Basic; }
 
@@ -79,8 +76,14 @@ class BasicEcdhOprfServer : public IEcdhOprfServer {
   }
 
  private:
+  // Builds the ec group and the reduced private key once, every Evaluate call
+  // reuses them instead of parsing the key and creating the group per item.
+  void PrecomputeKey();
+
   CurveType curve_type_;
   int ec_group_nid_{};
+  std::unique_ptr<EcGroupSt> ec_group_;
+  BigNumSt bn_sk_;
   yacl::crypto::HashAlgorithm hash_type_ = yacl::crypto::HashAlgorithm::BLAKE3;
 };
 
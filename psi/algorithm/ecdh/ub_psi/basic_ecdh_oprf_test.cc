@@ -81,6 +81,30 @@ TEST_P(BasicEcdhOprfTest, Works) {
   EXPECT_EQ(server_evaluted_vec, client_evaluted_vec);
 }
 
+TEST_P(BasicEcdhOprfTest, SetPrivateKey) {
+  auto params = GetParam();
+
+  yacl::crypto::Prg<uint64_t> prg(yacl::crypto::SecureRandU64());
+
+  std::vector<uint8_t> server_sk(kEccKeySize);
+  prg.Fill(absl::MakeSpan(server_sk));
+
+  std::shared_ptr<IEcdhOprfServer> keyed_server =
+      CreateEcdhOprfServer(server_sk, OprfType::Basic, params.type);
+  std::shared_ptr<IEcdhOprfServer> dh_oprf_server =
+      CreateEcdhOprfServer(OprfType::Basic, params.type);
+  dh_oprf_server->SetPrivateKey(server_sk);
+
+  std::vector<std::string> items_vec(params.items_size);
+  for (size_t idx = 0; idx < params.items_size; ++idx) {
+    items_vec[idx].resize(kEccKeySize);
+    prg.Fill(absl::MakeSpan(items_vec[idx]));
+  }
+
+  EXPECT_EQ(dh_oprf_server->FullEvaluate(items_vec),
+            keyed_server->FullEvaluate(items_vec));
+}
+
 INSTANTIATE_TEST_SUITE_P(
     Works_Instances, BasicEcdhOprfTest,
     testing::Values(TestParams{1}, TestParams{10}, TestParams{50},
@@ -84,7 +84,9 @@ class IEcdhOprf {
     compare_length_ = compare_length;
   }
 
-  void SetPrivateKey(yacl::ByteContainerView private_key) {
+  // Implementations that derive per-key state from private_key_ override it
+  // and rebuild that state.
+  virtual void SetPrivateKey(yacl::ByteContainerView private_key) {
     YACL_ENFORCE(private_key.size() == kEccKeySize);
 
     std::memcpy(private_key_.data(), private_key.data(), private_key.size());
@@ -16,6 +16,7 @@
 
 #include <future>
 #include <numeric>
+#include <thread>
 #include <unordered_map>
 
 #include "absl/strings/escaping.h"
@@ -29,6 +30,7 @@
 #include "yacl/kernel/algorithms/base_ot.h"
 #include "yacl/kernel/algorithms/iknp_ote.h"
 #include "yacl/kernel/algorithms/kkrt_ote.h"
+#include "yacl/utils/parallel.h"
 
 #include "psi/utils/communication.h"
 #include "psi/utils/cuckoo_index.h"
@@ -43,6 +45,11 @@ constexpr size_t kStashSize = 0;
 constexpr size_t kCuckooHashNum = 3;
 constexpr size_t kStatSecParam = 40;
 constexpr size_t kKkrtOtBatchSize = (65535 / 4 / 16 * 0.8);  // NOLINT
+// items per task when computing bins and encodings in parallel.
+constexpr int64_t kBinIndexGrainSize = 4096;
+constexpr int64_t kEncodeGrainSize = 128;
+// bin index of a slot that is encoded already, or must stay random.
+constexpr uint64_t kEncodedSlot = static_cast<uint64_t>(-1);
 
 // send set size to peer
 // get peer's item size
@@ -112,9 +119,6 @@ void KkrtPsiSend(const std::shared_ptr<yacl::link::Context>& link_ctx,
                  const KkrtPsiOptions& kkrt_psi_options,  // with kkrt options
                  const yacl::crypto::OtRecvStore& ot_recv,
                  const std::vector<HashBucketCache::BucketItem>& items) {
-  YACL_ENFORCE((kkrt_psi_options.cuckoo_hash_num == 3) &&
-                   (kkrt_psi_options.stash_size == 0),
-               "now only support cuckoo HashNum = 3 , stash size = 0");
   YACL_ENFORCE(ot_recv.Size() == 512,
                "now only support baseRecvOption block size 512");
 
@@ -130,10 +134,15 @@ void KkrtPsiSend(const std::shared_ptr<yacl::link::Context>& link_ctx,
 
   CuckooIndex::Options option = CuckooIndex::SelectParams(
       peer_size, kkrt_psi_options.stash_size, kkrt_psi_options.cuckoo_hash_num);
-  size_t num_bins = option.NumBins();
+  const size_t num_bins = option.NumBins();
+  const size_t num_hash = option.num_hash;
+  // Every item is encoded once per hash function and once per stash slot, the
+  // stash slots use the OT instances after the bins.
+  const size_t num_encode = num_hash + option.num_stash;
+  const size_t num_ot = num_bins + option.num_stash;
 
   yacl::crypto::KkrtOtExtSender sender;
-  sender.Init(link_ctx, ot_recv, option.NumBins());
+  sender.Init(link_ctx, ot_recv, num_ot);
   sender.SetBatchSize(kKkrtOtBatchSize);
   uint64_t kkrtOtBatchSize = sender.GetBatchSize();
 
@@ -141,9 +150,9 @@ void KkrtPsiSend(const std::shared_ptr<yacl::link::Context>& link_ctx,
   auto f_recv_corrections = std::async([&]() {
     // while there are more corrections for be received
     size_t correction_batch_idx = 0;
-    while (recv_idx < num_bins) {
+    while (recv_idx < num_ot) {
       // compute the  size of the current step and the end index
-      size_t current_step_size = std::min(kkrtOtBatchSize, num_bins - recv_idx);
+      size_t current_step_size = std::min(kkrtOtBatchSize, num_ot - recv_idx);
 
       // receive the corrections.
       auto current_correction_buf = link_ctx->Recv(
@@ -177,78 +186,82 @@ void KkrtPsiSend(const std::shared_ptr<yacl::link::Context>& link_ctx,
   }
 
   // hash bucketing
-  yacl::Buffer encode_buf(self_size * kkrt_psi_options.cuckoo_hash_num *
-                          encode_size);
-  std::vector<std::array<uint64_t, kCuckooHashNum>> bin_indices;
-  bin_indices.resize(self_size);
-
-  for (size_t i = 0; i < self_size; ++i) {
-    CuckooIndex::HashRoom itemHash(items[i].sec_hash);
-    uint64_t bin_idx0 = itemHash.GetHash(0) % num_bins;
-    uint64_t bin_idx1 = itemHash.GetHash(1) % num_bins;
-    uint64_t bin_idx2 = itemHash.GetHash(2) % num_bins;
-
-    bin_indices[i][0] = bin_idx0;
-    // check collision
-    uint8_t c01 = (bin_idx0 == bin_idx1) ? 1 : 0;
-    bin_indices[i][1] = bin_idx1 | (c01 * static_cast<uint64_t>(-1));
-    uint8_t c02 = (bin_idx0 == bin_idx2 || bin_idx1 == bin_idx2) ? 1 : 0;
-    bin_indices[i][2] = bin_idx2 | (c02 * static_cast<uint64_t>(-1));
-    if (c01 == 1) {
-      uint8_t* encode_pos =
-          encode_buf.data<uint8_t>() +
-          (input_permute_inv[i] * kkrt_psi_options.cuckoo_hash_num + 1) *
-              encode_size;
-      prg.Fill(absl::MakeSpan(encode_pos, encode_size));
-    }
-    if (c02 == 1) {
-      uint8_t* encode_pos =
-          encode_buf.data<uint8_t>() +
-          (input_permute_inv[i] * kkrt_psi_options.cuckoo_hash_num + 2) *
-              encode_size;
-      prg.Fill(absl::MakeSpan(encode_pos, encode_size));
-    }
-  }
-
-  uint64_t t = 0;
-  uint64_t r = 0;
-  // while not all the corrections have been received, try to encode any that
-  // we can
-  // TODO(shuyan.ycf): this implementation wastes cpus if the networking is
-  // slow (Due to spin logics). Better use synchronization primitives.
-  while (r != num_bins) {
-    // process things in steps
-    for (uint64_t j = 0; j < kkrtOtBatchSize; ++j) {
-      // lets check a random item to see if it can be encoded. If so,
-      // we will write this item's encodings in the myMaskBuff at position i.
-      auto input_idx = input_permute[t];
-
-      // for each hash function, try to encode the item.
-      for (uint64_t h = 0; h < kkrt_psi_options.cuckoo_hash_num; ++h) {
-        uint64_t b_idx = bin_indices[input_idx][h];
-
-        // if the bin index is less than r, then we have received
-        // the correction and can encode it
-        if (b_idx < r) {
-          // write the encoding into encode_buf at position  t, h
+  yacl::Buffer encode_buf(self_size * num_encode * encode_size);
+  std::vector<uint64_t> bin_indices(self_size * num_encode);
+
+  yacl::parallel_for(
+      0, self_size, kBinIndexGrainSize, [&](int64_t begin, int64_t end) {
+        yacl::crypto::Prg<uint128_t> task_prg(yacl::crypto::SecureRandSeed());
+        for (int64_t i = begin; i < end; ++i) {
+          CuckooIndex::HashRoom item_hash(items[i].sec_hash);
+          uint64_t* indices = bin_indices.data() + i * num_encode;
+          for (size_t h = 0; h < num_hash; ++h) {
+            indices[h] = item_hash.GetHash(h) % num_bins;
+            // check collision, a bin hit twice is encoded only once and the
+            // other slot is filled with random bytes.
+            if (std::find(indices, indices + h, indices[h]) != indices + h) {
+              indices[h] = kEncodedSlot;
+              uint8_t* encode_pos =
+                  encode_buf.data<uint8_t>() +
+                  (input_permute_inv[i] * num_encode + h) * encode_size;
+              task_prg.Fill(absl::MakeSpan(encode_pos, encode_size));
+            }
+          }
+          for (size_t k = 0; k < option.num_stash; ++k) {
+            indices[num_hash + k] = num_bins + k;
+          }
+        }
+      });
+
+  // Encodes the slots of the items at permuted positions [begin, end) whose
+  // corrections have arrived, i.e. with OT index below `ready`.
+  auto encode_ready = [&](size_t begin, size_t end, uint64_t ready) {
+    for (size_t pos = begin; pos < end; ++pos) {
+      auto input_idx = input_permute[pos % self_size];
+      uint64_t* indices = bin_indices.data() + input_idx * num_encode;
+      for (size_t h = 0; h < num_encode; ++h) {
+        if (indices[h] < ready) {
           uint8_t* encoding =
               encode_buf.data<uint8_t>() +
-              (t * kkrt_psi_options.cuckoo_hash_num + h) * encode_size;
-          sender.Encode(b_idx, items[input_idx].sec_hash, encoding,
+              ((pos % self_size) * num_encode + h) * encode_size;
+          sender.Encode(indices[h], items[input_idx].sec_hash, encoding,
                         encode_size);
-
           // make this location as already been encoded
-          bin_indices[input_idx][h] = -1;
+          indices[h] = kEncodedSlot;
         }
       }
+    }
+  };
 
+  uint64_t t = 0;
+  uint64_t r = 0;
+  // Items visited since the corrections last grew.
+  uint64_t scanned = 0;
+  // Never visit an item twice in one step, the tasks would race on it.
+  const uint64_t encode_step_size = std::min(kkrtOtBatchSize, self_size);
+  // while not all the corrections have been received, try to encode any that
+  // we can, spread over the threads.
+  // TODO(shuyan.ycf): this implementation wastes cpus if the networking is
+  // slow (Due to spin logics). Better use synchronization primitives.
+  while (r != num_ot) {
+    if (scanned < self_size) {
+      yacl::parallel_for(0, encode_step_size, kEncodeGrainSize,
+                         [&](int64_t begin, int64_t end) {
+                           encode_ready(t + begin, t + end, r);
+                         });
       // wrap around the input looking for items that we can encode
-      t = (t + 1) % self_size;
+      t = (t + encode_step_size) % self_size;
+      scanned += encode_step_size;
+    } else {
+      // everything encodable is encoded, wait for more corrections.
+      std::this_thread::yield();
     }
 
-    // after stepSize attempts to encode items, lets see if more
-    // corrections have arrived.
-    r = recv_idx.load(std::memory_order_acquire);
+    uint64_t new_r = recv_idx.load(std::memory_order_acquire);
+    if (new_r != r) {
+      r = new_r;
+      scanned = 0;
+    }
   }
 
   // Join receiving thread and throw exceptions if any thing is wrong.
@@ -258,24 +271,17 @@ void KkrtPsiSend(const std::shared_ptr<yacl::link::Context>& link_ctx,
   for (size_t i = 0; i < self_size;) {
     size_t curr_step_item_num =
         std::min(kkrt_psi_options.psi_batch_size, self_size - i);
-    size_t curr_step_encode_num =
-        curr_step_item_num * kkrt_psi_options.cuckoo_hash_num;
+    size_t curr_step_encode_num = curr_step_item_num * num_encode;
+
+    // all corrections are here, encode whatever is left of this batch.
+    yacl::parallel_for(0, curr_step_item_num, kEncodeGrainSize,
+                       [&](int64_t begin, int64_t end) {
+                         encode_ready(i + begin, i + end, num_ot);
+                       });
 
     PsiDataBatch batch;
-    uint8_t* encoding = encode_buf.data<uint8_t>() +
-                        (i * kkrt_psi_options.cuckoo_hash_num) * encode_size;
     for (size_t j = 0; j < curr_step_item_num; ++j) {
       auto input_idx = input_permute[i + j];
-
-      for (size_t k = 0; k < kkrt_psi_options.cuckoo_hash_num; k++) {
-        uint64_t b_idx = bin_indices[input_idx][k];
-
-        if (b_idx != static_cast<uint64_t>(-1)) {
-          sender.Encode(b_idx, items[input_idx].sec_hash, encoding,
-                        encode_size);
-        }
-        encoding += encode_size;
-      }
       if (items[input_idx].extra_dup_cnt > 0) {
         batch.duplicate_item_cnt[j] = items[input_idx].extra_dup_cnt;
       }
@@ -284,8 +290,8 @@ void KkrtPsiSend(const std::shared_ptr<yacl::link::Context>& link_ctx,
     batch.item_num = curr_step_item_num;
     batch.is_last_batch = false;
 
-    encoding = encode_buf.data<uint8_t>() +
-               (i * kkrt_psi_options.cuckoo_hash_num) * encode_size;
+    const uint8_t* encoding =
+        encode_buf.data<uint8_t>() + (i * num_encode) * encode_size;
     batch.flatten_bytes.resize(encode_size * curr_step_encode_num);
     memcpy(batch.flatten_bytes.data(), encoding,
            encode_size * curr_step_encode_num);
@@ -311,10 +317,6 @@ std::pair<std::vector<size_t>, std::vector<uint32_t>> KkrtPsiRecv(
     const KkrtPsiOptions& kkrt_psi_options,  // with kkrt options
     const yacl::crypto::OtSendStore& ot_send,
     const std::vector<uint128_t>& items_hash) {
-  YACL_ENFORCE((kkrt_psi_options.cuckoo_hash_num == 3) &&
-                   (kkrt_psi_options.stash_size == 0),
-               "now only support cuckoo HashNum = 3 , stash size = 0");
-
   YACL_ENFORCE(ot_send.Size() == 512,
                "now only support yacl::OtSendStore block size 512");
 
@@ -332,25 +334,29 @@ std::pair<std::vector<size_t>, std::vector<uint32_t>> KkrtPsiRecv(
       self_size, kkrt_psi_options.stash_size, kkrt_psi_options.cuckoo_hash_num);
   CuckooIndex cuckoo_index(option);
   cuckoo_index.Insert(absl::MakeSpan(items_hash));
-  YACL_ENFORCE(cuckoo_index.stash().empty(), "stash size not 0");
-  size_t kkrt_ot_num = cuckoo_index.bins().size();
+  const auto& ck_bins = cuckoo_index.bins();
+  const auto& ck_stash = cuckoo_index.stash();
+  const size_t num_bins = ck_bins.size();
+  const size_t num_hash = option.num_hash;
+  const size_t num_encode = num_hash + ck_stash.size();
+  size_t kkrt_ot_num = num_bins + ck_stash.size();
 
   yacl::crypto::KkrtOtExtReceiver receiver;
   receiver.Init(link_ctx, ot_send, kkrt_ot_num);
   receiver.SetBatchSize(kkrt_psi_options.ot_batch_size);
   uint64_t kkrt_ot_batch_size = receiver.GetBatchSize();
 
-  std::array<std::unordered_map<std::string, size_t>, kCuckooHashNum>
-      oprf_encode_map;
-  for (size_t i = 0; i < kCuckooHashNum; i++) {
-    oprf_encode_map[i].reserve(kkrt_ot_num);
+  // one map per hash function, then one per stash slot.
+  std::vector<std::unordered_map<std::string, size_t>> oprf_encode_map(
+      num_encode);
+  for (size_t i = 0; i < num_hash; i++) {
+    oprf_encode_map[i].reserve(num_bins);
   }
   uint64_t encode_size =
       KkrtEncodeSize(kkrt_psi_options.stat_sec_param, self_size,
                      peer_size);  // by byte
 
   // encoding prf & send correction
-  auto ck_bins = cuckoo_index.bins();
   std::string encode_str(encode_size, '\0');
   const size_t ot_num_batch =
       (kkrt_ot_num + kkrt_ot_batch_size - 1) / kkrt_ot_batch_size;
@@ -361,18 +367,22 @@ std::pair<std::vector<size_t>, std::vector<uint32_t>> KkrtPsiRecv(
     size_t batch_start = batch_idx * kkrt_ot_batch_size;
     for (size_t i = 0; i < num_this_batch; ++i) {
       size_t current_idx = batch_start + i;
-      if (ck_bins[current_idx].IsEmpty()) {
+      bool in_stash = current_idx >= num_bins;
+      const CuckooIndex::Bin& bin =
+          in_stash ? ck_stash[current_idx - num_bins] : ck_bins[current_idx];
+      if (bin.IsEmpty()) {
         receiver.ZeroEncode(current_idx);
       } else {
-        uint128_t input_item = items_hash[ck_bins[current_idx].InputIdx()];
+        uint128_t input_item = items_hash[bin.InputIdx()];
         receiver.Encode(
             current_idx, input_item,
             absl::Span<uint8_t>(reinterpret_cast<uint8_t*>(encode_str.data()),
                                 encode_size));
 
-        uint8_t min_hash_idx = cuckoo_index.MinCollidingHashIdx(current_idx);
-        oprf_encode_map[min_hash_idx].emplace(encode_str,
-                                              ck_bins[current_idx].InputIdx());
+        size_t map_idx = in_stash
+                             ? num_hash + (current_idx - num_bins)
+                             : cuckoo_index.MinCollidingHashIdx(current_idx);
+        oprf_encode_map[map_idx].emplace(encode_str, bin.InputIdx());
       }
     }
     auto send_buf = receiver.ShiftCorrection(num_this_batch);
@@ -391,16 +401,14 @@ std::pair<std::vector<size_t>, std::vector<uint32_t>> KkrtPsiRecv(
     batch_count++;
 
     size_t curr_step_item_num = batch.item_num;
-    size_t curr_step_encode_num =
-        curr_step_item_num * kkrt_psi_options.cuckoo_hash_num;
+    size_t curr_step_encode_num = curr_step_item_num * num_encode;
     YACL_ENFORCE_EQ(batch.flatten_bytes.size(),
                     (curr_step_encode_num * encode_size));
 
     for (size_t i = 0; i < curr_step_item_num; ++i) {
-      for (size_t j = 0; j < kkrt_psi_options.cuckoo_hash_num; ++j) {
+      for (size_t j = 0; j < num_encode; ++j) {
         std::string encode_sub_str = batch.flatten_bytes.substr(
-            (i * kkrt_psi_options.cuckoo_hash_num + j) * encode_size,
-            encode_size);
+            (i * num_encode + j) * encode_size, encode_size);
 
         auto it = oprf_encode_map[j].find(encode_sub_str);
         if (it != oprf_encode_map[j].end()) {
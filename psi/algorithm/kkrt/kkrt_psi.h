@@ -45,8 +45,10 @@ struct KkrtPsiOptions {
   size_t psi_batch_size = 128;
 
   // cuckoo hash parameter
-  // now use stashless setting
+  // default to the stashless setting
   // stash_size = 0  cuckoo_hash_num =3
+  // cuckoo_hash_num may be 2, 3 or 4. Each stash slot costs the sender one
+  // more encoding per item, 2-way hashing always uses a stash.
   // use stat_sec_param = 40
   size_t cuckoo_hash_num = 3;
   size_t stash_size = 0;
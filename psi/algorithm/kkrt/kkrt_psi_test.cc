@@ -17,6 +17,7 @@
 #include <future>
 #include <iostream>
 #include <set>
+#include <tuple>
 
 #include "gtest/gtest.h"
 #include "yacl/base/exception.h"
@@ -131,4 +132,41 @@ INSTANTIATE_TEST_SUITE_P(
         TestParams{{}, {}}  //
         ));
 
+class KkrtPsiOptionsTest
+    : public testing::TestWithParam<std::tuple<size_t, size_t>> {};
+
+TEST_P(KkrtPsiOptionsTest, Works) {
+  auto [cuckoo_hash_num, stash_size] = GetParam();
+  KkrtPsiOptions options = GetDefaultKkrtPsiOptions();
+  options.cuckoo_hash_num = cuckoo_hash_num;
+  options.stash_size = stash_size;
+
+  TestParams params{CreateRangeItems(0, 5000), CreateRangeItems(1000, 3000)};
+  auto contexts = yacl::link::test::SetupWorld(2);
+
+  std::future<void> kkrtPsi_sender = std::async([&] {
+    auto ot_recv = GetKkrtOtSenderOptions(contexts[0], 512);
+    std::vector<HashBucketCache::BucketItem> items(params.items_a.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+      items[i].sec_hash = params.items_a[i];
+    }
+    KkrtPsiSend(contexts[0], options, ot_recv, items);
+  });
+  std::future<std::vector<std::size_t>> kkrtPsi_receiver = std::async([&] {
+    auto ot_send = GetKkrtOtReceiverOptions(contexts[1], 512);
+    return KkrtPsiRecv(contexts[1], options, ot_send, params.items_b).first;
+  });
+  kkrtPsi_sender.get();
+  auto psi_idx_result = kkrtPsi_receiver.get();
+
+  std::sort(psi_idx_result.begin(), psi_idx_result.end());
+  EXPECT_EQ(psi_idx_result, GetIntersection(params));
+}
+
+INSTANTIATE_TEST_SUITE_P(Works_Instances, KkrtPsiOptionsTest,
+                         testing::Values(std::make_tuple(2, 0),
+                                         std::make_tuple(3, 4),
+                                         std::make_tuple(4, 0),
+                                         std::make_tuple(4, 2)));
+
 }  // namespace psi::kkrt
@@ -14,7 +14,6 @@
 
 #include "psi/algorithm/kkrt/receiver.h"
 
-#include "yacl/crypto/hash/hash_utils.h"
 #include "yacl/utils/parallel.h"
 
 #include "psi/algorithm/kkrt/common.h"
@@ -48,23 +47,31 @@ void KkrtPsiReceiver::PreProcess() {
     return;
   }
 
+  const auto& kkrt_config = config_.protocol_config().kkrt_config();
+  if (kkrt_config.adaptive_bucket_size()) {
+    bucket_count_ = NegotiateBucketNum(
+        lctx_, report_.original_key_count(),
+        GetBucketResource(kkrt_config.memory_budget_mb()),
+        config_.protocol_config().protocol());
+  } else {
+    bucket_count_ = NegotiateBucketNum(lctx_, report_.original_key_count(),
+                                       kkrt_config.bucket_size(),
+                                       config_.protocol_config().protocol());
+  }
+  // a resumed run must split the input as before.
   bucket_count_ =
-      NegotiateBucketNum(lctx_, report_.original_key_count(),
-                         config_.protocol_config().kkrt_config().bucket_size(),
-                         config_.protocol_config().protocol());
+      RecoverBucketNum(lctx_, recovery_manager_.get(), bucket_count_);
 
   if (bucket_count_ > 0) {
     std::vector<std::string> keys(config_.keys().begin(), config_.keys().end());
 
     SyncWait(lctx_, [&] {
       if (recovery_manager_) {
-        input_bucket_store_ = CreateCacheFromProvider(
-            batch_provider_, recovery_manager_->input_bucket_store_path(),
-            bucket_count_);
+        input_bucket_store_ = CreateInputBucketStore(
+            recovery_manager_->input_bucket_store_path(), bucket_count_);
       } else {
-        input_bucket_store_ = CreateCacheFromProvider(
-            batch_provider_, GetTaskDir() / "input_bucket_store",
-            bucket_count_);
+        input_bucket_store_ = CreateInputBucketStore(
+            GetTaskDir() / "input_bucket_store", bucket_count_);
       }
     });
   }
@@ -123,8 +130,8 @@ void KkrtPsiReceiver::Online() {
       yacl::parallel_for(0, bucket_items_list->size(),
                          [&](int64_t begin, int64_t end) {
                            for (int64_t i = begin; i < end; ++i) {
-                             items_hash[i] = yacl::crypto::Blake3_128(
-                                 bucket_items_list->at(i).base64_data);
+                             items_hash[i] = GetBucketItemSecHash(
+                                 bucket_items_list->at(i));
                            }
                          });
       std::vector<size_t> inter_indexes;
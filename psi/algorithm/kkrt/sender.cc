@@ -52,23 +52,31 @@ void KkrtPsiSender::PreProcess() {
     return;
   }
 
+  const auto& kkrt_config = config_.protocol_config().kkrt_config();
+  if (kkrt_config.adaptive_bucket_size()) {
+    bucket_count_ = NegotiateBucketNum(
+        lctx_, report_.original_key_count(),
+        GetBucketResource(kkrt_config.memory_budget_mb()),
+        config_.protocol_config().protocol());
+  } else {
+    bucket_count_ = NegotiateBucketNum(lctx_, report_.original_key_count(),
+                                       kkrt_config.bucket_size(),
+                                       config_.protocol_config().protocol());
+  }
+  // a resumed run must split the input as before.
   bucket_count_ =
-      NegotiateBucketNum(lctx_, report_.original_key_count(),
-                         config_.protocol_config().kkrt_config().bucket_size(),
-                         config_.protocol_config().protocol());
+      RecoverBucketNum(lctx_, recovery_manager_.get(), bucket_count_);
 
   if (bucket_count_ > 0) {
     std::vector<std::string> keys(config_.keys().begin(), config_.keys().end());
 
     SyncWait(lctx_, [&] {
       if (recovery_manager_) {
-        input_bucket_store_ = CreateCacheFromProvider(
-            batch_provider_, recovery_manager_->input_bucket_store_path(),
-            bucket_count_);
+        input_bucket_store_ = CreateInputBucketStore(
+            recovery_manager_->input_bucket_store_path(), bucket_count_);
       } else {
-        input_bucket_store_ = CreateCacheFromProvider(
-            batch_provider_, GetTaskDir() / "input_bucket_store",
-            bucket_count_);
+        input_bucket_store_ = CreateInputBucketStore(
+            GetTaskDir() / "input_bucket_store", bucket_count_);
       }
     });
   }
@@ -14,9 +14,13 @@
 
 #include "psi/algorithm/rr22/common.h"
 
+#include <algorithm>
+
 #include "omp.h"
+#include "spdlog/spdlog.h"
 
 #include "psi/utils/bucket.h"
+#include "psi/utils/sync.h"
 
 namespace psi::rr22 {
 
@@ -28,4 +32,69 @@ Rr22PsiOptions GenerateRr22PsiOptions(bool low_comm_mode) {
   return options;
 }
 
+size_t GetParallelNum(const v2::Rr22Config& config, bool recovery_enabled) {
+  if (recovery_enabled && config.parallel_num() > 1) {
+    SPDLOG_WARN("buckets are processed one by one with recovery enabled");
+    return 1;
+  }
+  return std::max<size_t>(1, config.parallel_num());
+}
+
+Rr22PsiOptions GenerateRr22PsiOptions(const v2::Rr22Config& config,
+                                      size_t parallel_num) {
+  auto options = GenerateRr22PsiOptions(config.low_comm_mode());
+  if (config.read_ahead_depth() > 0) {
+    options.read_ahead_depth = config.read_ahead_depth();
+  }
+  if (config.intersection_queue_depth() > 0) {
+    options.intersection_queue_depth = config.intersection_queue_depth();
+  }
+  if (config.prepare_threads() > 0) {
+    options.prepare_threads = config.prepare_threads();
+  }
+  if (parallel_num > 1) {
+    options.num_threads =
+        config.threads_per_bucket() > 0
+            ? config.threads_per_bucket()
+            : std::max<size_t>(1, options.num_threads / parallel_num);
+  }
+  return options;
+}
+
+uint64_t GetVolePoolBytesPerItem(const v2::Rr22Config& config) {
+  if (!config.precompute_vole() || !config.vole_pool_folder().empty()) {
+    return 0;
+  }
+  // the pool runs one bucket ahead per bucket processed at the same time,
+  // and keeps as many skipped ones until they are dropped.
+  return VolePool::kBytesPerItem * 2;
+}
+
+std::shared_ptr<VolePool> StartVolePool(
+    const std::shared_ptr<yacl::link::Context>& lctx,
+    const v2::Rr22Config& config, size_t items_num, size_t bucket_num,
+    size_t parallel_num, bool is_sender, size_t begin_bucket) {
+  if (!config.precompute_vole() || bucket_num == 0) {
+    return nullptr;
+  }
+  auto items_size = AllGatherItemsSize(lctx, items_num);
+  size_t max_items_num =
+      *std::max_element(items_size.begin(), items_size.end());
+  auto begin_buckets = AllGatherItemsSize(lctx, begin_bucket);
+  begin_bucket = *std::min_element(begin_buckets.begin(), begin_buckets.end());
+
+  auto options = GenerateRr22PsiOptions(config.low_comm_mode());
+  Rr22Oprf oprf(options.oprf_bin_size, options.ssp, options.mode,
+                options.code_type, options.malicious);
+  size_t vole_size = oprf.GetVoleSize(
+      VolePool::EstimateBucketSize(max_items_num, bucket_num));
+
+  auto pool = std::make_shared<VolePool>(is_sender, options.mode,
+                                         options.code_type, options.malicious,
+                                         config.vole_pool_folder());
+  pool->StartGenerate(lctx->Spawn("vole_pool"), bucket_num, vole_size,
+                      std::max<size_t>(parallel_num, 1), begin_bucket);
+  return pool;
+}
+
 }  // namespace psi::rr22
@@ -14,9 +14,11 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 
 #include "psi/algorithm/rr22/rr22_oprf.h"
 #include "psi/algorithm/rr22/rr22_psi.h"
+#include "psi/algorithm/rr22/vole_pool.h"
 #include "psi/checkpoint/recovery.h"
 
 #include "psi/proto/psi_v2.pb.h"
@@ -31,4 +33,28 @@ constexpr bool kDefaultCompress = true;
 
 Rr22PsiOptions GenerateRr22PsiOptions(bool low_comm_mode);
 
+// Returns the number of buckets processed at the same time. Buckets finish
+// out of order in parallel, which recovery doesn't support.
+size_t GetParallelNum(const v2::Rr22Config& config, bool recovery_enabled);
+
+// Options from the config, including the pipeline settings and the threads of
+// each bucket when parallel_num buckets are processed at the same time.
+Rr22PsiOptions GenerateRr22PsiOptions(const v2::Rr22Config& config,
+                                      size_t parallel_num);
+
+// Bytes per item of a bucket the VOLE pool keeps in memory for each bucket
+// processed at the same time. 0 if the pool is off or kept in
+// vole_pool_folder.
+uint64_t GetVolePoolBytesPerItem(const v2::Rr22Config& config);
+
+// Starts generating the VOLE correlations of bucket_num buckets in the
+// background if precompute_vole is set, otherwise returns nullptr. The pool
+// runs parallel_num buckets ahead of the buckets taken. begin_bucket is the
+// first bucket this party has not processed in a former run, the pool starts
+// at the smallest one of the parties.
+std::shared_ptr<VolePool> StartVolePool(
+    const std::shared_ptr<yacl::link::Context>& lctx,
+    const v2::Rr22Config& config, size_t items_num, size_t bucket_num,
+    size_t parallel_num, bool is_sender, size_t begin_bucket = 0);
+
 }  // namespace psi::rr22
@@ -165,6 +165,7 @@ void Baxos::ImplParSolve(
   if (num_bins_ == 1) {
     Paxos<IdxType> paxos;
     paxos.Init(num_items_, paxos_param_, seed_);
+    paxos.SetNumThreads(num_threads);
 
     paxos.SetInput(inputs_param);
 
@@ -348,6 +349,9 @@ void Baxos::ImplParSolve(
     }
 
     Paxos<IdxType> paxos;
+    // when there are fewer bins than threads, the idle threads help to solve
+    // the bins.
+    paxos.SetNumThreads(num_threads / num_bins_);
 
     // this thread will iterator over its assigned bins. This thread
     // will aggregate all the items mapped to the ith bin (which are currently
@@ -497,21 +501,40 @@ void Baxos::ImplDecodeBin([[maybe_unused]] uint64_t bin_idx,
 
   YACL_ENFORCE(weight_ <= max_weight_size);
 
-  yacl::Buffer _backing_buffer(sizeof(IdxType) * max_weight_size * batch_size);
+  // rows of two batches, the rows of the next batch are built and the
+  // entries they point to are prefetched before the current one is decoded.
+  yacl::Buffer _backing_buffer(2 * sizeof(IdxType) * max_weight_size *
+                               batch_size);
   absl::Span<IdxType> _backing = absl::MakeSpan(
-      (IdxType*)(_backing_buffer.data()), max_weight_size * batch_size);
+      (IdxType*)(_backing_buffer.data()), 2 * max_weight_size * batch_size);
 
   MatrixView<IdxType> row(_backing.data(), batch_size, weight_);
 
   YACL_ENFORCE(values_buff.size() >= batch_size);
 
+  auto rows_of = [&](uint64_t i) {
+    auto slot = (i / batch_size) & 1;
+    return absl::MakeSpan(row.data() + slot * batch_size * weight_,
+                          batch_size * weight_);
+  };
+  auto build_rows = [&](uint64_t i) {
+    paxos.hasher_.BuildRow32(absl::MakeSpan(&hashes[i], batch_size),
+                             rows_of(i));
+    for (auto c : rows_of(i)) {
+      _mm_prefetch(reinterpret_cast<const char*>(PP[c]), _MM_HINT_T0);
+    }
+  };
+
   uint64_t i = 0;
 
+  if (batch_count) {
+    build_rows(0);
+  }
   for (; i < batch_count; i += batch_size) {
-    paxos.hasher_.BuildRow32(absl::MakeSpan(&hashes[i], 32),
-                             absl::MakeSpan(row.data(), batch_size * weight_));
-    paxos.Decode32(absl::MakeSpan(row.data(), batch_size * weight_),
-                   absl::MakeSpan(&hashes[i], batch_size),
+    if (i + batch_size < batch_count) {
+      build_rows(i + batch_size);
+    }
+    paxos.Decode32(rows_of(i), absl::MakeSpan(&hashes[i], batch_size),
                    absl::MakeSpan(values_buff[0], batch_size), PP, h);
 
     if (add_to_decode_) {
@@ -151,6 +151,51 @@ Galois128 Galois128::Mul(const Galois128& rhs) const {
 #endif
 }
 
+void Gf128MulBatch(absl::Span<const uint128_t> x,
+                   absl::Span<const uint128_t> y, absl::Span<uint128_t> out) {
+  YACL_ENFORCE(x.size() == y.size() && x.size() == out.size(),
+               "x.size:{}, y.size:{}, out.size:{}", x.size(), y.size(),
+               out.size());
+#ifdef __x86_64__
+  if (kHasPCLML) {
+    for (size_t i = 0; i < x.size(); ++i) {
+      yacl::block xy1, xy2;
+      mm_gf128Mul(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&x[i])),
+                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(&y[i])),
+                  xy1, xy2);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(&out[i]),
+                       mm_gf128Reduce(xy1, xy2));
+    }
+    return;
+  }
+#endif
+  for (size_t i = 0; i < x.size(); ++i) {
+    out[i] = cc_gf128Mul(x[i], y[i]);
+  }
+}
+
+void Gf128MulBatch(absl::Span<const uint128_t> x, uint128_t y,
+                   absl::Span<uint128_t> out) {
+  YACL_ENFORCE(x.size() == out.size(), "x.size:{}, out.size:{}", x.size(),
+               out.size());
+#ifdef __x86_64__
+  if (kHasPCLML) {
+    yacl::block yb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&y));
+    for (size_t i = 0; i < x.size(); ++i) {
+      yacl::block xy1, xy2;
+      mm_gf128Mul(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&x[i])),
+                  yb, xy1, xy2);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(&out[i]),
+                       mm_gf128Reduce(xy1, xy2));
+    }
+    return;
+  }
+#endif
+  for (size_t i = 0; i < x.size(); ++i) {
+    out[i] = cc_gf128Mul(x[i], y);
+  }
+}
+
 Galois128 Galois128::Pow(std::uint64_t i) const {
   Galois128 pow2(*this);
   Galois128 zeroblock(0, 0);
@@ -18,6 +18,7 @@
 #include <variant>
 
 #include "absl/strings/escaping.h"
+#include "absl/types/span.h"
 #include "spdlog/spdlog.h"
 #include "yacl/base/block.h"
 #include "yacl/base/exception.h"
@@ -93,6 +94,15 @@ class Galois128 {
 
 uint128_t cc_gf128Mul(const uint128_t a, const uint128_t b);
 
+// out[i] = x[i] * y[i]. Uses pclmul when the cpu supports it, without the
+// per element dispatch of Galois128. out may alias x or y.
+void Gf128MulBatch(absl::Span<const uint128_t> x,
+                   absl::Span<const uint128_t> y, absl::Span<uint128_t> out);
+
+// out[i] = x[i] * y. out may alias x.
+void Gf128MulBatch(absl::Span<const uint128_t> x, uint128_t y,
+                   absl::Span<uint128_t> out);
+
 }  // namespace psi::rr22::okvs
 
 namespace std {
@@ -15,6 +15,7 @@
 #include "psi/algorithm/rr22/okvs/galois128.h"
 
 #include <sstream>
+#include <vector>
 
 #include "absl/strings/escaping.h"
 #include "gtest/gtest.h"
@@ -70,6 +71,44 @@ TEST_P(GaloisTest, Works) {
   }
 }
 
+TEST(GaloisBatchTest, MulBatch) {
+  yacl::crypto::Prg<uint128_t> prg(yacl::crypto::FastRandU64());
+  // Lengths which are not a multiple of any vector width as well.
+  for (size_t n : {0, 1, 3, 4, 7, 8, 1001}) {
+    std::vector<uint128_t> x(n);
+    std::vector<uint128_t> y(n);
+    for (size_t i = 0; i < n; ++i) {
+      x[i] = prg();
+      y[i] = prg();
+    }
+    uint128_t scalar = prg();
+
+    std::vector<uint128_t> out(n);
+    Gf128MulBatch(x, y, absl::MakeSpan(out));
+    for (size_t i = 0; i < n; ++i) {
+      EXPECT_EQ(out[i], cc_gf128Mul(x[i], y[i])) << "n=" << n << ", i=" << i;
+    }
+
+    Gf128MulBatch(x, scalar, absl::MakeSpan(out));
+    for (size_t i = 0; i < n; ++i) {
+      EXPECT_EQ(out[i], cc_gf128Mul(x[i], scalar))
+          << "n=" << n << ", i=" << i;
+    }
+
+    // In place.
+    std::vector<uint128_t> xx = x;
+    Gf128MulBatch(xx, y, absl::MakeSpan(xx));
+    for (size_t i = 0; i < n; ++i) {
+      EXPECT_EQ(xx[i], cc_gf128Mul(x[i], y[i])) << "n=" << n << ", i=" << i;
+    }
+  }
+
+  std::vector<uint128_t> x(3);
+  std::vector<uint128_t> out(2);
+  EXPECT_THROW(Gf128MulBatch(x, x, absl::MakeSpan(out)),
+               ::yacl::EnforceNotMet);
+}
+
 INSTANTIATE_TEST_SUITE_P(
     Works_Instances, GaloisTest,
     testing::Values(TestParams{1, 2}, TestParams{3, 2}, TestParams{3, 4},
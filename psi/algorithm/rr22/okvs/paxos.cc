@@ -14,11 +14,14 @@
 
 #include "psi/algorithm/rr22/okvs/paxos.h"
 
+#include <atomic>
 #include <cmath>
 #include <functional>
+#include <mutex>
 #include <set>
 
 #include "yacl/base/exception.h"
+#include "yacl/utils/parallel.h"
 
 namespace psi::rr22::okvs {
 
@@ -26,6 +29,65 @@ namespace {
 
 constexpr uint8_t kPaxosBuildRowSize = 32;
 
+// the least number of rows/columns handled by a task of the parallel solver.
+constexpr uint64_t kParallelGrainSize = 1 << 14;
+
+// whether n rows/columns are worth solving with num_threads threads.
+inline bool UseParallel(uint64_t n, uint64_t num_threads) {
+  return num_threads > 1 && n >= 2 * kParallelGrainSize;
+}
+
+// runs fn(begin, end) over [0, n) with at most num_threads tasks, each of
+// which has at least grain items.
+inline void ParallelFor(uint64_t n, uint64_t grain, uint64_t num_threads,
+                        const std::function<void(uint64_t, uint64_t)>& fn) {
+  uint64_t num_tasks = std::min(num_threads, n / std::max<uint64_t>(grain, 1));
+  if (num_tasks <= 1) {
+    fn(0, n);
+    return;
+  }
+  yacl::parallel_for(0, n, (n + num_tasks - 1) / num_tasks,
+                     [&](int64_t begin, int64_t end) { fn(begin, end); });
+}
+
+// prefetches the entries of p the rows point to, so that they are cached
+// by the time the rows are decoded.
+template <typename IdxType, typename T>
+inline void PrefetchRows(absl::Span<const IdxType> rows, const T* p) {
+  for (auto c : rows) {
+    _mm_prefetch(reinterpret_cast<const char*>(p + c), _MM_HINT_T0);
+  }
+}
+
+template <typename T>
+inline void AtomicMin(std::atomic<T>& a, T v) {
+  auto cur = a.load(std::memory_order_relaxed);
+  while (v < cur &&
+         !a.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {
+  }
+}
+
+// returns values[i] plus the dense part of row i, ie add_dense(y, i), for
+// each i of main_rows in the reversed order, which is the order of back
+// propagation. The dense part only depends on the dense columns of the
+// output, which are fixed before back propagation.
+template <typename Vec, typename Helper, typename IdxType, typename AddDense>
+Vec ComputeBackfillBase(absl::Span<IdxType> main_rows, const Vec& values,
+                        Helper& h, uint64_t num_threads,
+                        const AddDense& add_dense) {
+  auto n = main_rows.size();
+  auto base = h.NewVec(n);
+  ParallelFor(n, kParallelGrainSize, num_threads,
+              [&](uint64_t begin, uint64_t end) {
+                for (uint64_t k = begin; k < end; ++k) {
+                  auto i = main_rows[n - 1 - k];
+                  h.Assign(base[k], values[i]);
+                  add_dense(base[k], i);
+                }
+              });
+  return base;
+}
+
 inline std::vector<uint128_t> MatrixGf128Inv(std::vector<uint128_t> mtx,
                                              size_t row_size, size_t col_size) {
   YACL_ENFORCE(row_size == col_size);
@@ -254,7 +316,42 @@ void Paxos<IdxType>::SetInput(absl::Span<const uint128_t> inputs) {
 
   SPDLOG_DEBUG("setInput alloc");
 
-  {
+  if (UseParallel(num_items_, num_threads_)) {
+    // hash the rows in parallel batches, and count the column weights with
+    // atomic counters, which rarely collide as the columns are random.
+    auto main = inputs.size() / kPaxosBuildRowSize * kPaxosBuildRowSize;
+    std::vector<std::atomic<IdxType>> weights(sparse_size);
+    auto count_row = [&](const IdxType* row, uint64_t n) {
+      for (uint64_t j = 0; j < n; ++j) {
+        weights[row[j]].fetch_add(1, std::memory_order_relaxed);
+      }
+    };
+
+    ParallelFor(
+        main / kPaxosBuildRowSize, kParallelGrainSize / kPaxosBuildRowSize,
+        num_threads_, [&](uint64_t begin, uint64_t end) {
+          for (uint64_t i = begin * kPaxosBuildRowSize;
+               i < end * kPaxosBuildRowSize; i += kPaxosBuildRowSize) {
+            auto rr = &rows_[i * weight];
+            hasher_.HashBuildRow32(
+                absl::MakeSpan(inputs.data() + i, kPaxosBuildRowSize),
+                absl::MakeSpan(rr, kPaxosBuildRowSize * weight),
+                absl::MakeSpan(&dense_[i], kPaxosBuildRowSize));
+            count_row(rr, kPaxosBuildRowSize * weight);
+          }
+        });
+
+    for (uint64_t i = main; i < num_items_; ++i) {
+      hasher_.HashBuildRow1(*(inputs.data() + i),
+                            absl::MakeSpan(&rows_[i * weight], weight),
+                            &dense_[i]);
+      count_row(&rows_[i * weight], weight);
+    }
+
+    for (uint64_t i = 0; i < sparse_size; ++i) {
+      col_weights[i] = weights[i].load(std::memory_order_relaxed);
+    }
+  } else {
     auto main = inputs.size() / kPaxosBuildRowSize * kPaxosBuildRowSize;
     auto in_iter = inputs.data();
     SPDLOG_DEBUG("main:{}, kPaxosBuildRowSize:{}", main, kPaxosBuildRowSize);
@@ -370,7 +467,25 @@ void Paxos<IdxType>::RebuildColumns(absl::Span<IdxType> col_weights,
                col_backing_.size());
   YACL_ENFORCE(col_iter == (col_backing_.data() + col_backing_.size()));
 
-  if (weight == 3) {
+  if (UseParallel(num_items_, num_threads_)) {
+    // each task fills the columns in its own range. Rows are visited in the
+    // same order as below, so the columns are the same.
+    ParallelFor(sparse_size, kParallelGrainSize, num_threads_,
+                [&](uint64_t begin, uint64_t end) {
+                  for (IdxType i = 0; i < num_items_; ++i) {
+                    for (size_t j = 0; j < weight; j++) {
+                      auto c = rows_[i * weight + j];
+                      if (c < begin || c >= end) {
+                        continue;
+                      }
+                      auto& col = cols_[c];
+                      auto s = col.size();
+                      col = absl::Span<IdxType>(col.data(), s + 1);
+                      col[s] = i;
+                    }
+                  }
+                });
+  } else if (weight == 3) {
     for (IdxType i = 0; i < num_items_; ++i) {
       auto& c0 = cols_[rows_[i * weight + 0]];
       auto& c1 = cols_[rows_[i * weight + 1]];
@@ -510,6 +625,11 @@ void Paxos<IdxType>::Triangulate(
   }
 
   std::vector<uint8_t> row_set(num_items_);
+  if (UseParallel(num_items_, num_threads_)) {
+    ParallelPeel(main_rows, main_cols, row_set);
+  }
+
+  // peel the rest one column at a time, the ones of the lowest weight first.
   while (weight_sets_.weight_sets.size() > 1) {
     auto& col = weight_sets_.GetMinWeightNode();
     SPDLOG_DEBUG("colIdx:{} col.mWeight:{}", weight_sets_.IdxOf(col),
@@ -588,6 +708,122 @@ void Paxos<IdxType>::Triangulate(
   SPDLOG_DEBUG("triangulate end");
 }
 
+template <typename IdxType>
+void Paxos<IdxType>::ParallelPeel(std::vector<IdxType>& main_rows,
+                                  std::vector<IdxType>& main_cols,
+                                  std::vector<uint8_t>& row_set) {
+  constexpr IdxType kNone = WeightData<IdxType>::NullNode;
+
+  // the number of rows not set yet of each column, or 0 once the column is
+  // peeled.
+  std::vector<std::atomic<IdxType>> weights(sparse_size);
+  // the columns of weight 1.
+  std::vector<IdxType> frontier;
+  for (uint64_t c = 0; c < sparse_size; ++c) {
+    auto w = weight_sets_.nodes[c].weight;
+    weights[c].store(w, std::memory_order_relaxed);
+    if (w == 1) {
+      frontier.push_back(static_cast<IdxType>(c));
+    }
+  }
+
+  // when several columns of the frontier have the same last row, the one of
+  // the smallest index peels it, so the result doesn't depend on scheduling.
+  std::vector<std::atomic<IdxType>> owners(num_items_);
+  for (auto& owner : owners) {
+    owner.store(kNone, std::memory_order_relaxed);
+  }
+
+  auto begin_size = main_cols.size();
+  std::vector<IdxType> frontier_rows;
+  std::vector<IdxType> next;
+  std::mutex next_mtx;
+  uint64_t num_rounds = 0;
+  while (!frontier.empty()) {
+    ++num_rounds;
+    frontier_rows.assign(frontier.size(), kNone);
+
+    // find the last row of each column and claim it.
+    ParallelFor(frontier.size(), kParallelGrainSize, num_threads_,
+                [&](uint64_t begin, uint64_t end) {
+                  for (uint64_t k = begin; k < end; ++k) {
+                    auto c = frontier[k];
+                    // 0 if its last row is set by others.
+                    if (weights[c].load(std::memory_order_relaxed) != 1) {
+                      continue;
+                    }
+                    for (auto r : cols_[c]) {
+                      if (row_set[r] == 0) {
+                        frontier_rows[k] = r;
+                        AtomicMin(owners[r], c);
+                        break;
+                      }
+                    }
+                  }
+                });
+
+    // set the claimed rows, and decrement the weights of their other
+    // columns. The other columns of a claimed row are never in this round,
+    // so they are peeled later just like the serial algorithm.
+    ParallelFor(
+        frontier.size(), kParallelGrainSize, num_threads_,
+        [&](uint64_t begin, uint64_t end) {
+          std::vector<IdxType> local_next;
+          for (uint64_t k = begin; k < end; ++k) {
+            auto c = frontier[k];
+            auto r = frontier_rows[k];
+            if (r == kNone || owners[r].load(std::memory_order_relaxed) != c) {
+              continue;
+            }
+            row_set[r] = 1;
+            weights[c].store(0, std::memory_order_relaxed);
+            for (size_t j = 0; j < weight; ++j) {
+              auto c2 = rows_[r * weight + j];
+              auto w = weights[c2].load(std::memory_order_relaxed);
+              while (w != 0 && !weights[c2].compare_exchange_weak(
+                                   w, static_cast<IdxType>(w - 1),
+                                   std::memory_order_relaxed)) {
+              }
+              if (w == 2) {
+                local_next.push_back(c2);
+              }
+            }
+          }
+          std::lock_guard<std::mutex> lock(next_mtx);
+          next.insert(next.end(), local_next.begin(), local_next.end());
+        });
+
+    for (uint64_t k = 0; k < frontier.size(); ++k) {
+      auto r = frontier_rows[k];
+      if (r != kNone && owners[r].load(std::memory_order_relaxed) ==
+                            frontier[k]) {
+        main_cols.push_back(frontier[k]);
+        main_rows.push_back(r);
+      }
+    }
+
+    std::sort(next.begin(), next.end());
+    frontier.swap(next);
+    next.clear();
+  }
+
+  SPDLOG_DEBUG("parallel peel {} columns in {} rounds",
+               main_cols.size() - begin_size, num_rounds);
+
+  // the remaining columns have weight 0, ie free, or at least 2. There is
+  // always a remaining column as the paxos has more columns than rows.
+  YACL_ENFORCE(main_cols.size() < sparse_size, "peeled:{} sparse_size:{}",
+               main_cols.size(), sparse_size);
+  std::vector<IdxType> col_weights(sparse_size);
+  for (uint64_t c = 0; c < sparse_size; ++c) {
+    col_weights[c] = weights[c].load(std::memory_order_relaxed);
+  }
+  weight_sets_.init(absl::MakeSpan(col_weights));
+  for (uint64_t k = begin_size; k < main_cols.size(); ++k) {
+    weight_sets_.PopNode(weight_sets_.nodes[main_cols[k]]);
+  }
+}
+
 template <typename IdxType>
 void Paxos<IdxType>::BackfillU64(
     absl::Span<IdxType> main_rows, absl::Span<IdxType> main_cols,
@@ -863,17 +1099,23 @@ void Paxos<IdxType>::BackfillGf128U64(
   auto row_iter = main_rows.rbegin();
   bool do_dense = g || prng;
 
-#define GF128_DENSE_BACKFILL                    \
-  if (do_dense) {                               \
-    uint128_t d = dense_[i];                    \
-    uint128_t x = d;                            \
-    helper.MultAdd(y, p2[0], x);                \
-                                                \
-    for (uint64_t i = 1; i < dense_size; ++i) { \
-      x = (Galois128(x) * d).get<uint128_t>(0); \
-      helper.MultAdd(y, p2[i], x);              \
-    }                                           \
-  }
+  // y += sum_j p2[j] * dense[i]^(j+1)
+  auto add_dense = [&](auto y, IdxType i) {
+    uint128_t d = dense_[i];
+    uint128_t x = d;
+    helper.MultAdd(y, p2[0], x);
+
+    for (uint64_t j = 1; j < dense_size; ++j) {
+      x = (Galois128(x) * d).get<uint128_t>(0);
+      helper.MultAdd(y, p2[j], x);
+    }
+  };
+
+  // the values plus the dense part of the main rows, in parallel.
+  bool use_base = do_dense && UseParallel(main_rows.size(), num_threads_);
+  auto base = use_base ? ComputeBackfillBase(main_rows, values, helper,
+                                             num_threads_, add_dense)
+                       : helper.NewVec(0);
 
   auto yy = helper.NewElement();
   auto y = helper.AsPtr(yy);
@@ -887,7 +1129,7 @@ void Paxos<IdxType>::BackfillGf128U64(
       SPDLOG_DEBUG("k:{}, i:{} c:{}", k, i, c);
 
       // auto y = X[i];
-      helper.Assign(y, values[i]);
+      helper.Assign(y, use_base ? base[k] : values[i]);
       SPDLOG_DEBUG("y:{}", absl::BytesToHexString(
                                absl::string_view((char*)y, sizeof(uint128_t))));
 
@@ -898,53 +1140,12 @@ void Paxos<IdxType>::BackfillGf128U64(
 
       //  y = y ^ P[cc0] ^ P[cc1] ^ P[cc2];
       helper.Add(y, output[cc0]);
-
-      SPDLOG_DEBUG("y:{}, P[{}]:{}",
-                   absl::BytesToHexString(
-                       absl::string_view((char*)y, sizeof(uint128_t))),
-                   cc0,
-                   absl::BytesToHexString(absl::string_view(
-                       (char*)&(*output[cc0]), sizeof(*output[cc0]))));
-
       helper.Add(y, output[cc1]);
-
-      SPDLOG_DEBUG("y:{}, P[{}]:{}",
-                   absl::BytesToHexString(
-                       absl::string_view((char*)y, sizeof(uint128_t))),
-                   cc1,
-                   absl::BytesToHexString(absl::string_view(
-                       (char*)&(*output[cc1]), sizeof(*output[cc1]))));
       helper.Add(y, output[cc2]);
-      SPDLOG_DEBUG("y:{}, P[{}]:{}",
-                   absl::BytesToHexString(
-                       absl::string_view((char*)y, sizeof(uint128_t))),
-                   cc2,
-                   absl::BytesToHexString(absl::string_view(
-                       (char*)&(*output[cc2]), sizeof(*output[cc2]))));
 
       SPDLOG_DEBUG("doDense:{}", do_dense);
-
-      // GF128_DENSE_BACKFILL;
-      if (do_dense) {
-        uint128_t d = dense_[i];
-        uint128_t x = d;
-        helper.MultAdd(y, p2[0], x);
-        SPDLOG_DEBUG(
-            "d:{}, y:{} mDenseSize:{}",
-            absl::BytesToHexString(absl::string_view((char*)&d, sizeof(d))),
-            absl::BytesToHexString(
-                absl::string_view((char*)y, sizeof(uint128_t))),
-            dense_size);
-
-        for (uint64_t i = 1; i < dense_size; ++i) {
-          x = (Galois128(x) * d).get<uint128_t>(0);
-          helper.MultAdd(y, p2[i], x);
-          SPDLOG_DEBUG(
-              "c:{}, y:{}",
-              absl::BytesToHexString(absl::string_view((char*)&c, sizeof(c))),
-              absl::BytesToHexString(
-                  absl::string_view((char*)y, sizeof(uint128_t))));
-        }
+      if (do_dense && !use_base) {
+        add_dense(y, i);
       }
 
       // P[c] = y;
@@ -963,7 +1164,7 @@ void Paxos<IdxType>::BackfillGf128U64(
       ++row_iter;
 
       // auto y = X[i];
-      helper.Assign(y, values[i]);
+      helper.Assign(y, use_base ? base[k] : values[i]);
 
       auto row = &rows_[i * weight];
       for (uint64_t j = 0; j < weight; ++j) {
@@ -972,7 +1173,9 @@ void Paxos<IdxType>::BackfillGf128U64(
         // y = y ^ P[cc];
       }
 
-      GF128_DENSE_BACKFILL;
+      if (do_dense && !use_base) {
+        add_dense(y, i);
+      }
 
       // P[c] = y;
       helper.Assign(output[c], y);
@@ -1064,17 +1267,23 @@ void Paxos<IdxType>::BackfillGf128(
   auto row_iter = main_rows.rbegin();
   bool do_dense = g || prng;
 
-#define GF128_DENSE_BACKFILL                    \
-  if (do_dense) {                               \
-    uint128_t d = dense_[i];                    \
-    uint128_t x = d;                            \
-    helper.MultAdd(y, p2[0], x);                \
-                                                \
-    for (uint64_t i = 1; i < dense_size; ++i) { \
-      x = (Galois128(x) * d).get<uint128_t>(0); \
-      helper.MultAdd(y, p2[i], x);              \
-    }                                           \
-  }
+  // y += sum_j p2[j] * dense[i]^(j+1)
+  auto add_dense = [&](auto y, IdxType i) {
+    uint128_t d = dense_[i];
+    uint128_t x = d;
+    helper.MultAdd(y, p2[0], x);
+
+    for (uint64_t j = 1; j < dense_size; ++j) {
+      x = (Galois128(x) * d).get<uint128_t>(0);
+      helper.MultAdd(y, p2[j], x);
+    }
+  };
+
+  // the values plus the dense part of the main rows, in parallel.
+  bool use_base = do_dense && UseParallel(main_rows.size(), num_threads_);
+  auto base = use_base ? ComputeBackfillBase(main_rows, values, helper,
+                                             num_threads_, add_dense)
+                       : helper.NewVec(0);
 
   auto yy = helper.NewElement();
   auto y = helper.AsPtr(yy);
@@ -1088,7 +1297,7 @@ void Paxos<IdxType>::BackfillGf128(
       SPDLOG_DEBUG("k:{}, i:{} c:{}", k, i, c);
 
       // auto y = X[i];
-      helper.Assign(y, values[i]);
+      helper.Assign(y, use_base ? base[k] : values[i]);
       SPDLOG_DEBUG("y:{}", absl::BytesToHexString(
                                absl::string_view((char*)y, sizeof(uint128_t))));
 
@@ -1099,53 +1308,12 @@ void Paxos<IdxType>::BackfillGf128(
 
       //  y = y ^ P[cc0] ^ P[cc1] ^ P[cc2];
       helper.Add(y, output[cc0]);
-
-      SPDLOG_DEBUG("y:{}, P[{}]:{}",
-                   absl::BytesToHexString(
-                       absl::string_view((char*)y, sizeof(uint128_t))),
-                   cc0,
-                   absl::BytesToHexString(absl::string_view(
-                       (char*)&(*output[cc0]), sizeof(*output[cc0]))));
-
       helper.Add(y, output[cc1]);
-
-      SPDLOG_DEBUG("y:{}, P[{}]:{}",
-                   absl::BytesToHexString(
-                       absl::string_view((char*)y, sizeof(uint128_t))),
-                   cc1,
-                   absl::BytesToHexString(absl::string_view(
-                       (char*)&(*output[cc1]), sizeof(*output[cc1]))));
       helper.Add(y, output[cc2]);
-      SPDLOG_DEBUG("y:{}, P[{}]:{}",
-                   absl::BytesToHexString(
-                       absl::string_view((char*)y, sizeof(uint128_t))),
-                   cc2,
-                   absl::BytesToHexString(absl::string_view(
-                       (char*)&(*output[cc2]), sizeof(*output[cc2]))));
 
       SPDLOG_DEBUG("doDense:{}", do_dense);
-
-      // GF128_DENSE_BACKFILL;
-      if (do_dense) {
-        uint128_t d = dense_[i];
-        uint128_t x = d;
-        helper.MultAdd(y, p2[0], x);
-        SPDLOG_DEBUG(
-            "d:{}, y:{} mDenseSize:{}",
-            absl::BytesToHexString(absl::string_view((char*)&d, sizeof(d))),
-            absl::BytesToHexString(
-                absl::string_view((char*)y, sizeof(uint128_t))),
-            dense_size);
-
-        for (uint64_t i = 1; i < dense_size; ++i) {
-          x = (Galois128(x) * d).get<uint128_t>(0);
-          helper.MultAdd(y, p2[i], x);
-          SPDLOG_DEBUG(
-              "c:{}, y:{}",
-              absl::BytesToHexString(absl::string_view((char*)&c, sizeof(c))),
-              absl::BytesToHexString(
-                  absl::string_view((char*)y, sizeof(uint128_t))));
-        }
+      if (do_dense && !use_base) {
+        add_dense(y, i);
       }
 
       // P[c] = y;
@@ -1164,7 +1332,7 @@ void Paxos<IdxType>::BackfillGf128(
       ++row_iter;
 
       // auto y = X[i];
-      helper.Assign(y, values[i]);
+      helper.Assign(y, use_base ? base[k] : values[i]);
 
       auto row = &rows_[i * weight];
       for (uint64_t j = 0; j < weight; ++j) {
@@ -1173,7 +1341,9 @@ void Paxos<IdxType>::BackfillGf128(
         // y = y ^ P[cc];
       }
 
-      GF128_DENSE_BACKFILL;
+      if (do_dense && !use_base) {
+        add_dense(y, i);
+      }
 
       // P[c] = y;
       helper.Assign(output[c], y);
@@ -1248,6 +1418,33 @@ void Paxos<IdxType>::BackfillBinaryU64(
       h.Randomize(p2[i], prng);
   }
 
+  // y += the dense columns selected by the bits of dense[i]
+  YACL_ENFORCE(dense_size <= 64);
+  auto add_dense = [&](auto y, IdxType i) {
+    auto d = yacl::DecomposeUInt128(dense_[i]).second;
+    if (prng) {
+      for (uint64_t j = 0; j < dense_size; ++j) {
+        if (d & 1) {
+          // y += p2[j]
+          h.Add(y, p2[j]);
+        }
+        d >>= 1;
+      }
+    } else {
+      for (uint64_t j = 0; j < gg; ++j) {
+        if (d & dense_masks[j]) {
+          h.Add(y, p2[gap_cols[j]]);
+        }
+      }
+    }
+  };
+
+  // the values plus the dense part of the main rows, in parallel.
+  bool use_base = (prng || gg) && UseParallel(main_rows.size(), num_threads_);
+  auto base = use_base ? ComputeBackfillBase(main_rows, X, h, num_threads_,
+                                             add_dense)
+                       : h.NewVec(0);
+
   auto out_col_iter = main_cols.rbegin();
   auto row_iter = main_rows.rbegin();
 
@@ -1264,8 +1461,9 @@ void Paxos<IdxType>::BackfillBinaryU64(
     ++row_iter;
 
     // y = X[i]
-    h.Assign(y, X[i]);
-
+    h.Assign(y, use_base ? base[k] : X[i]);
+    // note the rows_ is different from volepsi, here we need consider the
+    // stride
     auto row = &rows_[i * weight];
     for (uint64_t j = 0; j < weight; ++j) {
       auto cc = row[j];
@@ -1274,25 +1472,8 @@ void Paxos<IdxType>::BackfillBinaryU64(
       h.Add(y, P[cc]);
     }
 
-    YACL_ENFORCE(dense_size <= 64);
-
-    if (prng) {
-      auto d = yacl::DecomposeUInt128(dense_[i]).second;
-      for (uint64_t j = 0; j < dense_size; ++j) {
-        if (d & 1) {
-          // y += p2[j]
-          h.Add(y, p2[j]);
-        }
-        d >>= 1;
-      }
-    } else {
-      for (uint64_t j = 0; j < gg; ++j) {
-        YACL_ENFORCE(dense_size <= 64);
-
-        if (yacl::DecomposeUInt128(dense_[i]).second & dense_masks[j]) {
-          h.Add(y, p2[gap_cols[j]]);
-        }
-      }
+    if (!use_base) {
+      add_dense(y, i);
     }
 
     h.Assign(P[c], y);
@@ -1366,6 +1547,33 @@ void Paxos<IdxType>::BackfillBinary(
       h.Randomize(p2[i], prng);
   }
 
+  // y += the dense columns selected by the bits of dense[i]
+  YACL_ENFORCE(dense_size <= 64);
+  auto add_dense = [&](auto y, IdxType i) {
+    auto d = yacl::DecomposeUInt128(dense_[i]).second;
+    if (prng) {
+      for (uint64_t j = 0; j < dense_size; ++j) {
+        if (d & 1) {
+          // y += p2[j]
+          h.Add(y, p2[j]);
+        }
+        d >>= 1;
+      }
+    } else {
+      for (uint64_t j = 0; j < gg; ++j) {
+        if (d & dense_masks[j]) {
+          h.Add(y, p2[gap_cols[j]]);
+        }
+      }
+    }
+  };
+
+  // the values plus the dense part of the main rows, in parallel.
+  bool use_base = (prng || gg) && UseParallel(main_rows.size(), num_threads_);
+  auto base = use_base ? ComputeBackfillBase(main_rows, X, h, num_threads_,
+                                             add_dense)
+                       : h.NewVec(0);
+
   auto out_col_iter = main_cols.rbegin();
   auto row_iter = main_rows.rbegin();
 
@@ -1382,7 +1590,7 @@ void Paxos<IdxType>::BackfillBinary(
     ++row_iter;
 
     // y = X[i]
-    h.Assign(y, X[i]);
+    h.Assign(y, use_base ? base[k] : X[i]);
     // note the rows_ is different from volepsi, here we need consider the
     // stride
     auto row = &rows_[i * weight];
@@ -1393,25 +1601,8 @@ void Paxos<IdxType>::BackfillBinary(
       h.Add(y, P[cc]);
     }
 
-    YACL_ENFORCE(dense_size <= 64);
-
-    if (prng) {
-      auto d = yacl::DecomposeUInt128(dense_[i]).second;
-      for (uint64_t j = 0; j < dense_size; ++j) {
-        if (d & 1) {
-          // y += p2[j]
-          h.Add(y, p2[j]);
-        }
-        d >>= 1;
-      }
-    } else {
-      for (uint64_t j = 0; j < gg; ++j) {
-        YACL_ENFORCE(dense_size <= 64);
-
-        if (yacl::DecomposeUInt128(dense_[i]).second & dense_masks[j]) {
-          h.Add(y, p2[gap_cols[j]]);
-        }
-      }
+    if (!use_base) {
+      add_dense(y, i);
     }
 
     h.Assign(P[c], y);
@@ -1724,23 +1915,41 @@ void Paxos<IdxType>::DecodeU64(absl::Span<const uint128_t> inputs,
 
   auto batch_count = inputs.size() / kPaxosBuildRowSize * kPaxosBuildRowSize;
 
-  auto in_iter = inputs.data();
-
   SPDLOG_DEBUG("add_to_decode_:{}, gPaxosBuildRowSize:{}, mWeight:{}",
                add_to_decode_, kPaxosBuildRowSize, weight);
 
-  std::vector<IdxType> rows(kPaxosBuildRowSize * weight);
-  std::vector<uint128_t> dense(kPaxosBuildRowSize);
-
-  if (add_to_decode_) {
-    PxVectorU64 v = h.NewVec(kPaxosBuildRowSize);
-
-    for (uint64_t i = 0; i < batch_count;
-         i += kPaxosBuildRowSize, in_iter += kPaxosBuildRowSize) {
-      hasher_.HashBuildRow32(absl::MakeSpan(in_iter, kPaxosBuildRowSize),
-                             absl::MakeSpan(rows), absl::MakeSpan(dense));
+  // rows and dense of two batches, the next batch is hashed and its entries
+  // are prefetched before the current one is decoded.
+  std::vector<IdxType> rows(2 * kPaxosBuildRowSize * weight);
+  std::vector<uint128_t> dense(2 * kPaxosBuildRowSize);
+  auto rows_of = [&](uint64_t i) {
+    auto slot = (i / kPaxosBuildRowSize) & 1;
+    return absl::MakeSpan(rows.data() + slot * kPaxosBuildRowSize * weight,
+                          kPaxosBuildRowSize * weight);
+  };
+  auto dense_of = [&](uint64_t i) {
+    auto slot = (i / kPaxosBuildRowSize) & 1;
+    return absl::MakeSpan(dense.data() + slot * kPaxosBuildRowSize,
+                          kPaxosBuildRowSize);
+  };
+  auto hash_batch = [&](uint64_t i) {
+    hasher_.HashBuildRow32(absl::MakeSpan(&inputs[i], kPaxosBuildRowSize),
+                           rows_of(i), dense_of(i));
+    PrefetchRows<IdxType>(rows_of(i), PP[0]);
+  };
+
+  PxVectorU64 v = h.NewVec(kPaxosBuildRowSize);
+
+  if (batch_count) {
+    hash_batch(0);
+  }
+  for (uint64_t i = 0; i < batch_count; i += kPaxosBuildRowSize) {
+    if (i + kPaxosBuildRowSize < batch_count) {
+      hash_batch(i + kPaxosBuildRowSize);
+    }
 
-      Decode32U64(absl::MakeSpan(rows), absl::MakeSpan(dense),
+    if (add_to_decode_) {
+      Decode32U64(rows_of(i), dense_of(i),
                   absl::MakeSpan(v[0], kPaxosBuildRowSize), PP, h);
 
       for (uint64_t j = 0; j < kPaxosBuildRowSize; j += 8) {
@@ -1753,26 +1962,19 @@ void Paxos<IdxType>::DecodeU64(absl::Span<const uint128_t> inputs,
         h.Add(values[i + j + 6], v[j + 6]);
         h.Add(values[i + j + 7], v[j + 7]);
       }
+    } else {
+      Decode32U64(rows_of(i), dense_of(i),
+                  absl::MakeSpan(values[i], kPaxosBuildRowSize), PP, h);
     }
+  }
 
-    for (uint64_t i = batch_count; i < inputs.size(); ++i, ++in_iter) {
-      hasher_.HashBuildRow1(*in_iter, absl::MakeSpan(rows.data(), weight),
-                            &dense[0]);
+  for (uint64_t i = batch_count; i < inputs.size(); ++i) {
+    hasher_.HashBuildRow1(inputs[i], absl::MakeSpan(rows.data(), weight),
+                          &dense[0]);
+    if (add_to_decode_) {
       Decode1U64(absl::MakeSpan(rows.data(), weight), dense[0], v[0], PP, h);
       h.Add(values[i], v[0]);
-    }
-  } else {
-    for (uint64_t i = 0; i < batch_count;
-         i += kPaxosBuildRowSize, in_iter += kPaxosBuildRowSize) {
-      hasher_.HashBuildRow32(absl::MakeSpan(in_iter, kPaxosBuildRowSize),
-                             absl::MakeSpan(rows), absl::MakeSpan(dense));
-      Decode32U64(absl::MakeSpan(rows), absl::MakeSpan(dense),
-                  absl::MakeSpan(values[i], kPaxosBuildRowSize), PP, h);
-    }
-
-    for (uint64_t i = batch_count; i < inputs.size(); ++i, ++in_iter) {
-      hasher_.HashBuildRow1(*in_iter, absl::MakeSpan(rows.data(), weight),
-                            &dense[0]);
+    } else {
       Decode1U64(absl::MakeSpan(rows.data(), weight), dense[0], values[i], PP,
                  h);
     }
@@ -1792,23 +1994,41 @@ void Paxos<IdxType>::Decode(absl::Span<const uint128_t> inputs,
 
   auto batch_count = inputs.size() / kPaxosBuildRowSize * kPaxosBuildRowSize;
 
-  auto in_iter = inputs.data();
-
   SPDLOG_DEBUG("add_to_decode_:{}, gPaxosBuildRowSize:{}, mWeight:{}",
                add_to_decode_, kPaxosBuildRowSize, weight);
 
-  std::vector<IdxType> rows(kPaxosBuildRowSize * weight);
-  std::vector<uint128_t> dense(kPaxosBuildRowSize);
-
-  if (add_to_decode_) {
-    PxVector v = h.NewVec(kPaxosBuildRowSize);
-
-    for (uint64_t i = 0; i < batch_count;
-         i += kPaxosBuildRowSize, in_iter += kPaxosBuildRowSize) {
-      hasher_.HashBuildRow32(absl::MakeSpan(in_iter, kPaxosBuildRowSize),
-                             absl::MakeSpan(rows), absl::MakeSpan(dense));
+  // rows and dense of two batches, the next batch is hashed and its entries
+  // are prefetched before the current one is decoded.
+  std::vector<IdxType> rows(2 * kPaxosBuildRowSize * weight);
+  std::vector<uint128_t> dense(2 * kPaxosBuildRowSize);
+  auto rows_of = [&](uint64_t i) {
+    auto slot = (i / kPaxosBuildRowSize) & 1;
+    return absl::MakeSpan(rows.data() + slot * kPaxosBuildRowSize * weight,
+                          kPaxosBuildRowSize * weight);
+  };
+  auto dense_of = [&](uint64_t i) {
+    auto slot = (i / kPaxosBuildRowSize) & 1;
+    return absl::MakeSpan(dense.data() + slot * kPaxosBuildRowSize,
+                          kPaxosBuildRowSize);
+  };
+  auto hash_batch = [&](uint64_t i) {
+    hasher_.HashBuildRow32(absl::MakeSpan(&inputs[i], kPaxosBuildRowSize),
+                           rows_of(i), dense_of(i));
+    PrefetchRows<IdxType>(rows_of(i), PP[0]);
+  };
+
+  PxVector v = h.NewVec(kPaxosBuildRowSize);
+
+  if (batch_count) {
+    hash_batch(0);
+  }
+  for (uint64_t i = 0; i < batch_count; i += kPaxosBuildRowSize) {
+    if (i + kPaxosBuildRowSize < batch_count) {
+      hash_batch(i + kPaxosBuildRowSize);
+    }
 
-      Decode32(absl::MakeSpan(rows), absl::MakeSpan(dense),
+    if (add_to_decode_) {
+      Decode32(rows_of(i), dense_of(i),
                absl::MakeSpan(v[0], kPaxosBuildRowSize), PP, h);
 
       for (uint64_t j = 0; j < kPaxosBuildRowSize; j += 8) {
@@ -1821,26 +2041,19 @@ void Paxos<IdxType>::Decode(absl::Span<const uint128_t> inputs,
         h.Add(values[i + j + 6], v[j + 6]);
         h.Add(values[i + j + 7], v[j + 7]);
       }
+    } else {
+      Decode32(rows_of(i), dense_of(i),
+               absl::MakeSpan(values[i], kPaxosBuildRowSize), PP, h);
     }
+  }
 
-    for (uint64_t i = batch_count; i < inputs.size(); ++i, ++in_iter) {
-      hasher_.HashBuildRow1(*in_iter, absl::MakeSpan(rows.data(), weight),
-                            &dense[0]);
+  for (uint64_t i = batch_count; i < inputs.size(); ++i) {
+    hasher_.HashBuildRow1(inputs[i], absl::MakeSpan(rows.data(), weight),
+                          &dense[0]);
+    if (add_to_decode_) {
       Decode1(absl::MakeSpan(rows.data(), weight), dense[0], v[0], PP, h);
       h.Add(values[i], v[0]);
-    }
-  } else {
-    for (uint64_t i = 0; i < batch_count;
-         i += kPaxosBuildRowSize, in_iter += kPaxosBuildRowSize) {
-      hasher_.HashBuildRow32(absl::MakeSpan(in_iter, kPaxosBuildRowSize),
-                             absl::MakeSpan(rows), absl::MakeSpan(dense));
-      Decode32(absl::MakeSpan(rows), absl::MakeSpan(dense),
-               absl::MakeSpan(values[i], kPaxosBuildRowSize), PP, h);
-    }
-
-    for (uint64_t i = batch_count; i < inputs.size(); ++i, ++in_iter) {
-      hasher_.HashBuildRow1(*in_iter, absl::MakeSpan(rows.data(), weight),
-                            &dense[0]);
+    } else {
       Decode1(absl::MakeSpan(rows.data(), weight), dense[0], values[i], PP, h);
     }
   }
@@ -1960,23 +2173,17 @@ void Paxos<IdxType>::Decode32U64(absl::Span<IdxType> rows_span,
       h.MultAdd(h.IterPlus(values, 7), p2, x[7]);
     }
 
+    auto dense = absl::MakeConstSpan(dense_span.data(), 32);
+
     for (uint64_t i = 1; i < dense_size; ++i) {
       p2 = h.IterPlus(p2, 1);
 
+      Gf128MulBatch(xx, dense, absl::MakeSpan(xx));
+
       for (uint64_t k = 0; k < 4; ++k) {
         auto x = xx.data() + k * 8;
-        auto dense = dense_span.data() + k * 8;
         uint64_t* __restrict values = h.IterPlus(values_span.data(), k * 8);
 
-        x[0] = (Galois128(x[0]) * dense[0]).get<uint128_t>(0);
-        x[1] = (Galois128(x[1]) * dense[1]).get<uint128_t>(0);
-        x[2] = (Galois128(x[2]) * dense[2]).get<uint128_t>(0);
-        x[3] = (Galois128(x[3]) * dense[3]).get<uint128_t>(0);
-        x[4] = (Galois128(x[4]) * dense[4]).get<uint128_t>(0);
-        x[5] = (Galois128(x[5]) * dense[5]).get<uint128_t>(0);
-        x[6] = (Galois128(x[6]) * dense[6]).get<uint128_t>(0);
-        x[7] = (Galois128(x[7]) * dense[7]).get<uint128_t>(0);
-
         h.MultAdd(h.IterPlus(values, 0), p2, x[0]);
         h.MultAdd(h.IterPlus(values, 1), p2, x[1]);
         h.MultAdd(h.IterPlus(values, 2), p2, x[2]);
@@ -2126,50 +2333,30 @@ void Paxos<IdxType>::Decode32(absl::Span<IdxType> rows_span,
   }
 
   if (dt == DenseType::GF128) {
-    const uint128_t* __restrict p2 = h.IterPlus(p, sparse_size);
-
+    // x holds dense^(i+1) of the 32 items, px the products with the i'th
+    // dense entry of p, both are multiplied in batches.
     std::array<uint128_t, 32> xx;
+    std::array<uint128_t, 32> px;
     memcpy(xx.data(), dense_span.data(), sizeof(uint128_t) * 32);
+    auto dense = absl::MakeConstSpan(dense_span.data(), 32);
 
-    for (uint64_t k = 0; k < 4; ++k) {
-      uint128_t* __restrict values = h.IterPlus(values_span.data(), k * 8);
-      auto x = xx.data() + k * 8;
-
-      h.MultAdd(h.IterPlus(values, 0), p2, x[0]);
-      h.MultAdd(h.IterPlus(values, 1), p2, x[1]);
-      h.MultAdd(h.IterPlus(values, 2), p2, x[2]);
-      h.MultAdd(h.IterPlus(values, 3), p2, x[3]);
-      h.MultAdd(h.IterPlus(values, 4), p2, x[4]);
-      h.MultAdd(h.IterPlus(values, 5), p2, x[5]);
-      h.MultAdd(h.IterPlus(values, 6), p2, x[6]);
-      h.MultAdd(h.IterPlus(values, 7), p2, x[7]);
-    }
-
-    for (uint64_t i = 1; i < dense_size; ++i) {
-      p2 = h.IterPlus(p2, 1);
-
-      for (uint64_t k = 0; k < 4; ++k) {
-        auto x = xx.data() + k * 8;
-        auto dense = dense_span.data() + k * 8;
-        uint128_t* __restrict values = h.IterPlus(values_span.data(), k * 8);
-
-        x[0] = (Galois128(x[0]) * dense[0]).get<uint128_t>(0);
-        x[1] = (Galois128(x[1]) * dense[1]).get<uint128_t>(0);
-        x[2] = (Galois128(x[2]) * dense[2]).get<uint128_t>(0);
-        x[3] = (Galois128(x[3]) * dense[3]).get<uint128_t>(0);
-        x[4] = (Galois128(x[4]) * dense[4]).get<uint128_t>(0);
-        x[5] = (Galois128(x[5]) * dense[5]).get<uint128_t>(0);
-        x[6] = (Galois128(x[6]) * dense[6]).get<uint128_t>(0);
-        x[7] = (Galois128(x[7]) * dense[7]).get<uint128_t>(0);
-
-        h.MultAdd(h.IterPlus(values, 0), p2, x[0]);
-        h.MultAdd(h.IterPlus(values, 1), p2, x[1]);
-        h.MultAdd(h.IterPlus(values, 2), p2, x[2]);
-        h.MultAdd(h.IterPlus(values, 3), p2, x[3]);
-        h.MultAdd(h.IterPlus(values, 4), p2, x[4]);
-        h.MultAdd(h.IterPlus(values, 5), p2, x[5]);
-        h.MultAdd(h.IterPlus(values, 6), p2, x[6]);
-        h.MultAdd(h.IterPlus(values, 7), p2, x[7]);
+    for (uint64_t i = 0; i < dense_size; ++i) {
+      if (i > 0) {
+        Gf128MulBatch(xx, dense, absl::MakeSpan(xx));
+      }
+      Gf128MulBatch(xx, *h.IterPlus(p, sparse_size + i), absl::MakeSpan(px));
+
+      for (uint64_t k = 0; k < 32; k += 8) {
+        uint128_t* __restrict values = h.IterPlus(values_span.data(), k);
+
+        h.Add(h.IterPlus(values, 0), &px[k + 0]);
+        h.Add(h.IterPlus(values, 1), &px[k + 1]);
+        h.Add(h.IterPlus(values, 2), &px[k + 2]);
+        h.Add(h.IterPlus(values, 3), &px[k + 3]);
+        h.Add(h.IterPlus(values, 4), &px[k + 4]);
+        h.Add(h.IterPlus(values, 5), &px[k + 5]);
+        h.Add(h.IterPlus(values, 6), &px[k + 6]);
+        h.Add(h.IterPlus(values, 7), &px[k + 7]);
       }
     }
   } else {
@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <memory>
 #include <string>
@@ -82,6 +83,12 @@ class Paxos : public PaxosParam {
   // initialize the paxos with the given parameters.
   void Init(uint64_t num_items, PaxosParam p, uint128_t seed);
 
+  // the number of threads used by SetInput and Encode of this instance. Only
+  // large instances are worth it, small ones always run on the caller thread.
+  void SetNumThreads(uint64_t num_threads) {
+    num_threads_ = std::max<uint64_t>(1, num_threads);
+  }
+
   // set the input keys which define the paxos matrix. After that,
   // encode can be called more than once.
   void SetInput(absl::Span<const uint128_t> inputs);
@@ -180,6 +187,13 @@ class Paxos : public PaxosParam {
                    std::vector<IdxType>& main_cols,
                    std::vector<std::array<IdxType, 2>>& gap_rows);
 
+  // peels the columns of weight one round by round in parallel, until there
+  // is none. The peeled rows/columns are appended to mainRows/mainCols, and
+  // weight_sets_ is rebuilt with the remaining columns.
+  void ParallelPeel(std::vector<IdxType>& main_rows,
+                    std::vector<IdxType>& main_cols,
+                    std::vector<uint8_t>& row_set);
+
   // once triangulated, this is used to assign values
   // to output (paxos).
   void Backfill(absl::Span<IdxType> main_rows, absl::Span<IdxType> main_cols,
@@ -282,6 +296,9 @@ class Paxos : public PaxosParam {
   // when decoding, add the decoded value to the
   // output, as opposed to overwriting.
   bool add_to_decode_ = false;
+
+  // the number of threads used to solve this instance.
+  uint64_t num_threads_ = 1;
 };
 
 }  // namespace psi::rr22::okvs
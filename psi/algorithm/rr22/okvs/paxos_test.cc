@@ -110,4 +110,53 @@ TEST(PaxosTest, SolveTest) {
   }
 }
 
+TEST(PaxosTest, ParallelSolveTest) {
+  // large enough to be solved by several threads.
+  uint64_t n = 1 << 17;
+  uint64_t w = 3;
+
+  for (auto dt :
+       {PaxosParam::DenseType::Binary, PaxosParam::DenseType::GF128}) {
+    for (bool randomize : {false, true}) {
+      if (randomize && dt == PaxosParam::DenseType::Binary) {
+        continue;
+      }
+      Paxos<uint32_t> paxos;
+      paxos.Init(n, w, 40, dt, yacl::crypto::SecureRandU128());
+      paxos.SetNumThreads(4);
+
+      std::vector<uint128_t> items(n);
+      std::vector<uint128_t> values(n);
+      std::vector<uint128_t> values2(n);
+      std::vector<uint128_t> p(paxos.size());
+      yacl::crypto::Prg<uint128_t> prng(yacl::MakeUint128(0, randomize));
+      prng.Fill(absl::MakeSpan(items.data(), items.size()));
+      prng.Fill(absl::MakeSpan(values.data(), values.size()));
+
+      paxos.SetInput(absl::MakeSpan(items));
+      paxos.Encode(absl::MakeSpan(values), absl::MakeSpan(p),
+                   randomize ? std::make_shared<yacl::crypto::Prg<uint8_t>>(
+                                   yacl::MakeUint128(1, 1))
+                             : nullptr);
+      paxos.Decode(absl::MakeSpan(items), absl::MakeSpan(values2),
+                   absl::MakeSpan(p));
+
+      EXPECT_EQ(values2, values);
+
+      if (dt == PaxosParam::DenseType::Binary) {
+        std::vector<uint64_t> values64(n);
+        std::vector<uint64_t> values64_2(n);
+        std::vector<uint64_t> p64(paxos.size());
+        for (uint64_t i = 0; i < n; ++i) {
+          values64[i] = static_cast<uint64_t>(values[i]);
+        }
+        paxos.EncodeU64(absl::MakeSpan(values64), absl::MakeSpan(p64));
+        paxos.DecodeU64(absl::MakeSpan(items), absl::MakeSpan(values64_2),
+                        absl::MakeSpan(p64));
+        EXPECT_EQ(values64_2, values64);
+      }
+    }
+  }
+}
+
 }  // namespace psi::rr22::okvs
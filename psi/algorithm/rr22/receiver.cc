@@ -56,23 +56,43 @@ void Rr22PsiReceiver::PreProcess() {
     return;
   }
 
+  const auto& rr22_config = config_.protocol_config().rr22_config();
+  size_t parallel_num =
+      GetParallelNum(rr22_config, recovery_manager_ != nullptr);
+  if (rr22_config.adaptive_bucket_size()) {
+    auto resource =
+        GetBucketResource(rr22_config.memory_budget_mb(), parallel_num);
+    resource.extra_bytes_per_item = GetVolePoolBytesPerItem(rr22_config);
+    bucket_count_ = NegotiateBucketNum(lctx_, report_.original_key_count(),
+                                       resource,
+                                       config_.protocol_config().protocol());
+  } else {
+    bucket_count_ = NegotiateBucketNum(lctx_, report_.original_key_count(),
+                                       rr22_config.bucket_size(),
+                                       config_.protocol_config().protocol());
+  }
+  // a resumed run must split the input as before.
   bucket_count_ =
-      NegotiateBucketNum(lctx_, report_.original_key_count(),
-                         config_.protocol_config().rr22_config().bucket_size(),
-                         config_.protocol_config().protocol());
+      RecoverBucketNum(lctx_, recovery_manager_.get(), bucket_count_);
+
+  // VOLE of the buckets runs while the input is put into buckets, from the
+  // bucket a resumed run starts at.
+  vole_pool_ = StartVolePool(
+      lctx_, rr22_config, report_.original_key_count(), bucket_count_,
+      parallel_num, false,
+      recovery_manager_ ? recovery_manager_->checkpoint().parsed_bucket_count()
+                        : 0);
 
   if (bucket_count_ > 0) {
     std::vector<std::string> keys(config_.keys().begin(), config_.keys().end());
 
     SyncWait(lctx_, [&] {
       if (recovery_manager_) {
-        input_bucket_store_ = CreateCacheFromProvider(
-            batch_provider_, recovery_manager_->input_bucket_store_path(),
-            bucket_count_);
+        input_bucket_store_ = CreateInputBucketStore(
+            recovery_manager_->input_bucket_store_path(), bucket_count_);
       } else {
-        input_bucket_store_ = CreateCacheFromProvider(
-            batch_provider_, GetTaskDir() / "input_bucket_store",
-            bucket_count_);
+        input_bucket_store_ = CreateInputBucketStore(
+            GetTaskDir() / "input_bucket_store", bucket_count_);
       }
     });
   }
@@ -109,8 +129,12 @@ void Rr22PsiReceiver::Online() {
                      recovery_manager_->checkpoint().parsed_bucket_count())
           : 0;
 
-  Rr22PsiOptions rr22_options = GenerateRr22PsiOptions(
-      config_.protocol_config().rr22_config().low_comm_mode());
+  const auto& rr22_config = config_.protocol_config().rr22_config();
+  size_t parallel_num =
+      GetParallelNum(rr22_config, recovery_manager_ != nullptr);
+  Rr22PsiOptions rr22_options =
+      GenerateRr22PsiOptions(rr22_config, parallel_num);
+  rr22_options.vole_pool = vole_pool_;
 
   PreProcessFunc pre_f =
       [&](size_t idx) -> std::vector<HashBucketCache::BucketItem> {
@@ -119,11 +143,14 @@ void Rr22PsiReceiver::Online() {
     }
     return input_bucket_store_->LoadBucketItems(idx);
   };
+  std::mutex post_mtx;
   PostProcessFunc post_f =
       [&](size_t bucket_idx,
           const std::vector<HashBucketCache::BucketItem>& bucket_items,
           const std::vector<uint32_t>& indices,
           const std::vector<uint32_t>& peer_cnt) {
+        // buckets finish at the same time when run in parallel.
+        std::lock_guard<std::mutex> lock(post_mtx);
         for (size_t i = 0; i != indices.size(); ++i) {
           intersection_indices_writer_->WriteCache(
               bucket_items[indices[i]].index, peer_cnt[i]);
@@ -137,7 +164,21 @@ void Rr22PsiReceiver::Online() {
   Rr22Runner runner(lctx_, rr22_options, input_bucket_store_->BucketNum(),
                     config_.protocol_config().broadcast_result(), pre_f,
                     post_f);
-  SyncWait(lctx_, [&] { runner.AsyncRun(bucket_idx, false); });
+  try {
+    SyncWait(lctx_, [&] {
+      if (parallel_num > 1) {
+        runner.ParallelRun(bucket_idx, false, parallel_num);
+      } else {
+        runner.AsyncRun(bucket_idx, false);
+      }
+    });
+  } catch (...) {
+    // the peer may be gone, don't wait for its VOLE on teardown.
+    if (vole_pool_) {
+      vole_pool_->Abort();
+    }
+    throw;
+  }
   SPDLOG_INFO("[Rr22PsiReceiver::Online] end");
 }
 
@@ -42,6 +42,45 @@ constexpr uint128_t kAesHashSeed =
 
 constexpr size_t kPaxosWeight = 3;
 
+// the aes batch of AesCrHash and DavisMeyerHash.
+constexpr int64_t kHashBatchSize = 8;
+
+// batches hashed by a task of FinalizeOutputs at least.
+constexpr int64_t kHashGrainSize = 512;
+
+// outputs[i] = H(outputs[i] ^ masks[i] ^ w), masks may be empty. H is the
+// davies-meyer hash keyed by inputs[i] in malicious mode, and the aes crhash
+// otherwise. Each task masks and hashes whole aes batches of its own range,
+// so the items are hashed while they are still cached.
+void FinalizeOutputs(absl::Span<const uint128_t> inputs,
+                     absl::Span<const uint128_t> masks, uint128_t w,
+                     bool malicious, absl::Span<uint128_t> outputs) {
+  YACL_ENFORCE(inputs.size() == outputs.size());
+  YACL_ENFORCE(masks.empty() || masks.size() == outputs.size());
+  okvs::AesCrHash aes_crhash(kAesHashSeed);
+
+  int64_t size = outputs.size();
+  int64_t batch_num = (size + kHashBatchSize - 1) / kHashBatchSize;
+  yacl::parallel_for(
+      0, batch_num, kHashGrainSize, [&](int64_t begin, int64_t end) {
+        begin *= kHashBatchSize;
+        end = std::min(end * kHashBatchSize, size);
+        for (int64_t idx = begin; idx < end; ++idx) {
+          if (!masks.empty()) {
+            outputs[idx] = outputs[idx] ^ masks[idx];
+          }
+          outputs[idx] = outputs[idx] ^ w;
+        }
+
+        auto out = outputs.subspan(begin, end - begin);
+        if (malicious) {
+          DavisMeyerHash(out, inputs.subspan(begin, end - begin), out);
+        } else {
+          aes_crhash.Hash(out, out);
+        }
+      });
+}
+
 }  // namespace
 
 #define USE_MOCK 0
@@ -131,8 +170,68 @@ std::vector<uint128_t> Rr22OprfSender::Send(
   }
 }
 
+size_t Rr22Oprf::GetVoleSize(size_t init_size) const {
+  size_t paxos_size = 0;
+  if (mode_ == Rr22PsiMode::FastMode) {
+    okvs::Baxos baxos;
+    baxos.Init(init_size, bin_size_, kPaxosWeight, ssp_,
+               okvs::PaxosParam::DenseType::GF128, 0);
+    paxos_size = baxos.size();
+  } else if (mode_ == Rr22PsiMode::LowCommMode) {
+    okvs::PaxosParam paxos_param;
+    paxos_param.Init(init_size, kPaxosWeight, ssp_,
+                     okvs::PaxosParam::DenseType::Binary);
+    paxos_size = paxos_param.size();
+  } else {
+    YACL_THROW("unsupported mode:{}", int(mode_));
+  }
+  return std::max<size_t>(256, paxos_size);
+}
+
+VoleCorrelation GenerateVoleCorrelation(
+    const std::shared_ptr<yacl::link::Context>& lctx, bool is_sender,
+    size_t vole_size, Rr22PsiMode mode,
+    const yacl::crypto::CodeType& code_type, bool malicious) {
+  VoleCorrelation vole;
+  if (is_sender) {
+    vole.b = std::vector<uint128_t>(vole_size, 0);
+    SPDLOG_INFO("begin vole send");
+    if (mode == Rr22PsiMode::FastMode) {
+      yacl::crypto::SilentVoleSender vole_sender(code_type, malicious);
+      vole_sender.Send(lctx, absl::MakeSpan(vole.b));
+      vole.delta = vole_sender.GetDelta();
+    } else if (mode == Rr22PsiMode::LowCommMode) {
+      yacl::crypto::SilentVoleSender vole_sender(code_type);
+      vole_sender.SfSend(lctx, absl::MakeSpan(vole.b));
+      vole.delta = vole_sender.GetDelta();
+    } else {
+      YACL_THROW("unsupported mode:{}", int(mode));
+    }
+    SPDLOG_INFO("end vole send");
+  } else {
+    vole.c = std::vector<uint128_t>(vole_size, 0);
+    SPDLOG_INFO("begin vole recv");
+    if (mode == Rr22PsiMode::FastMode) {
+      // c + b = a * delta
+      yacl::crypto::SilentVoleReceiver vole_receiver(code_type, malicious);
+      vole.a = std::vector<uint128_t>(vole_size, 0);
+      vole_receiver.Recv(lctx, absl::MakeSpan(vole.a), absl::MakeSpan(vole.c));
+    } else if (mode == Rr22PsiMode::LowCommMode) {
+      yacl::crypto::SilentVoleReceiver vole_receiver(code_type);
+      vole.a64 = std::vector<uint64_t>(vole_size, 0);
+      vole_receiver.SfRecv(lctx, absl::MakeSpan(vole.a64),
+                           absl::MakeSpan(vole.c));
+    } else {
+      YACL_THROW("unsupported mode:{}", int(mode));
+    }
+    SPDLOG_INFO("end vole recv");
+  }
+  return vole;
+}
+
 void Rr22OprfSender::Init(const std::shared_ptr<yacl::link::Context>& lctx,
-                          size_t init_size, size_t num_threads) {
+                          size_t init_size, size_t num_threads,
+                          std::optional<VoleCorrelation> vole) {
   init_size_ = init_size;
   num_threads_ = num_threads;
   if (mode_ == Rr22PsiMode::FastMode) {
@@ -151,18 +250,6 @@ void Rr22OprfSender::Init(const std::shared_ptr<yacl::link::Context>& lctx,
                 okvs::PaxosParam::DenseType::GF128, baxos_seed);
     paxos_size_ = baxos_.size();
     SPDLOG_INFO("paxos_size:{}", paxos_size_);
-    // vole send function
-    yacl::crypto::SilentVoleSender vole_sender(code_type_, malicious_);
-    size_t v_size = std::max<size_t>(256, baxos_.size());
-    b_ = std::vector<uint128_t>(v_size, 0);
-    absl::Span<uint128_t> b128_span = absl::MakeSpan(b_);
-
-    SPDLOG_INFO("begin vole send");
-
-    vole_sender.Send(lctx, b128_span);
-    delta_ = vole_sender.GetDelta();
-
-    SPDLOG_INFO("end vole send");
   } else if (mode_ == Rr22PsiMode::LowCommMode) {
     uint128_t paxos_seed;
     SPDLOG_INFO("recv paxos seed...");
@@ -177,23 +264,22 @@ void Rr22OprfSender::Init(const std::shared_ptr<yacl::link::Context>& lctx,
                 okvs::PaxosParam::DenseType::Binary, paxos_seed);
 
     paxos_size_ = paxos_.size();
-
-    // vole send function
-
-    yacl::crypto::SilentVoleSender vole_sender(code_type_);
-    size_t v_size = std::max<size_t>(256, paxos_.size());
-    b_ = std::vector<uint128_t>(v_size, 0);
-    absl::Span<uint128_t> b128_span = absl::MakeSpan(b_);
-
-    SPDLOG_INFO("begin vole send");
-
-    vole_sender.SfSend(lctx, b128_span);
-    delta_ = vole_sender.GetDelta();
-
-    SPDLOG_INFO("end vole send");
   } else {
     YACL_THROW("unsupported mode:{}", int(mode_));
   }
+
+  size_t v_size = GetVoleSize(init_size_);
+  if (vole.has_value()) {
+    // a prefix of a longer correlation is still a correlation.
+    YACL_ENFORCE(vole->b.size() >= v_size, "precomputed vole {} < {}",
+                 vole->b.size(), v_size);
+    vole->b.resize(v_size);
+  } else {
+    vole = GenerateVoleCorrelation(lctx, true, v_size, mode_, code_type_,
+                                   malicious_);
+  }
+  b_ = std::move(vole->b);
+  delta_ = vole->delta;
 }
 
 std::vector<uint128_t> Rr22OprfSender::SendFast(
@@ -332,9 +418,6 @@ std::vector<uint128_t> Rr22OprfSender::Eval(
       for (int64_t idx = begin; idx < end; ++idx) {
         uint128_t h = aes_crhash.Hash(inputs[idx]);
         outputs[idx] = outputs[idx] ^ (delta_gf128 * h).get<uint128_t>(0);
-        if (malicious_) {
-          outputs[idx] = outputs[idx] ^ w_;
-        }
       }
     });
   } else if (mode_ == Rr22PsiMode::LowCommMode) {
@@ -347,11 +430,7 @@ std::vector<uint128_t> Rr22OprfSender::Eval(
       }
     });
   }
-  if (malicious_) {
-    DavisMeyerHash(outputs_span, inputs, outputs_span);
-  } else {
-    aes_crhash.Hash(outputs_span, outputs_span);
-  }
+  FinalizeOutputs(inputs, {}, w_, malicious_, outputs_span);
   return outputs;
 }
 
@@ -360,46 +439,58 @@ std::vector<uint128_t> Rr22OprfSender::Eval(
     absl::Span<const uint128_t> inputs_hash) {
   YACL_ENFORCE(b_.size() > 0, "Must use Send() first");
   std::vector<uint128_t> outputs(inputs.size());
-  auto outputs_span = absl::MakeSpan(outputs);
-  absl::Span<uint128_t> b128_span =
-      absl::MakeSpan(reinterpret_cast<uint128_t*>(b_.data()), paxos_size_);
 
   SPDLOG_INFO("paxos decode (mode:{}) ...",
               mode_ == Rr22PsiMode::FastMode ? "Fast" : "LowComm");
+  EvalChunk(inputs, inputs_hash, absl::MakeSpan(outputs));
+  SPDLOG_INFO("paxos decode finished");
+  b_.clear();
 
-  if (mode_ == Rr22PsiMode::FastMode) {
-    baxos_.Decode(inputs, outputs_span, b128_span, num_threads_);
+  return outputs;
+}
 
-  } else if (mode_ == Rr22PsiMode::LowCommMode) {
-    paxos_.Decode(inputs, outputs_span, b128_span);
-  } else {
-    YACL_THROW("unsupported rr22 psi mode");
+void Rr22OprfSender::Eval(const absl::Span<const uint128_t>& inputs,
+                          absl::Span<const uint128_t> inputs_hash,
+                          size_t chunk_size, const OprfSink& sink) {
+  YACL_ENFORCE(b_.size() > 0, "Must use Send() first");
+  YACL_ENFORCE(chunk_size > 0);
+  YACL_ENFORCE(inputs.size() == inputs_hash.size());
+  std::vector<uint128_t> outputs(std::min(chunk_size, inputs.size()));
+
+  SPDLOG_INFO("paxos decode (mode:{}) in chunks of {} ...",
+              mode_ == Rr22PsiMode::FastMode ? "Fast" : "LowComm",
+              chunk_size);
+  for (size_t offset = 0; offset < inputs.size(); offset += chunk_size) {
+    size_t size = std::min(chunk_size, inputs.size() - offset);
+    auto outputs_span = absl::MakeSpan(outputs.data(), size);
+    EvalChunk(inputs.subspan(offset, size), inputs_hash.subspan(offset, size),
+              outputs_span);
+    sink(offset, outputs_span);
   }
   SPDLOG_INFO("paxos decode finished");
   b_.clear();
+}
 
-  yacl::parallel_for(0, inputs.size(), [&](int64_t begin, int64_t end) {
-    for (int64_t idx = begin; idx < end; ++idx) {
-      outputs[idx] = outputs[idx] ^ inputs_hash[idx];
-
-      if (malicious_) {
-        outputs[idx] = outputs[idx] ^ w_;
-      }
-    }
-  });
+void Rr22OprfSender::EvalChunk(absl::Span<const uint128_t> inputs,
+                               absl::Span<const uint128_t> inputs_hash,
+                               absl::Span<uint128_t> outputs) {
+  absl::Span<uint128_t> b128_span =
+      absl::MakeSpan(reinterpret_cast<uint128_t*>(b_.data()), paxos_size_);
 
-  if (malicious_) {
-    DavisMeyerHash(outputs_span, inputs, outputs_span);
+  if (mode_ == Rr22PsiMode::FastMode) {
+    baxos_.Decode(inputs, outputs, b128_span, num_threads_);
+  } else if (mode_ == Rr22PsiMode::LowCommMode) {
+    paxos_.Decode(inputs, outputs, b128_span);
   } else {
-    okvs::AesCrHash aes_crhash(kAesHashSeed);
-
-    aes_crhash.Hash(outputs_span, outputs_span);
+    YACL_THROW("unsupported rr22 psi mode");
   }
-  return outputs;
+
+  FinalizeOutputs(inputs, inputs_hash, w_, malicious_, outputs);
 }
 
 void Rr22OprfReceiver::Init(const std::shared_ptr<yacl::link::Context>& lctx,
-                            size_t init_size, size_t num_threads) {
+                            size_t init_size, size_t num_threads,
+                            std::optional<VoleCorrelation> vole) {
   num_threads_ = num_threads;
   if (mode_ == Rr22PsiMode::FastMode) {
     uint128_t baxos_seed = 1;
@@ -411,16 +502,6 @@ void Rr22OprfReceiver::Init(const std::shared_ptr<yacl::link::Context>& lctx,
                 okvs::PaxosParam::DenseType::GF128, baxos_seed);
     paxos_size_ = baxos_.size();
     SPDLOG_INFO("baxos_size:{}", paxos_size_);
-    // c + b = a * delta
-    // vole recv
-    yacl::crypto::SilentVoleReceiver vole_receiver(code_type_, malicious_);
-    size_t v_size = std::max<size_t>(256, baxos_.size());
-    a_ = std::vector<uint128_t>(v_size, 0);
-    c_ = std::vector<uint128_t>(v_size, 0);
-
-    SPDLOG_INFO("begin vole recv");
-    vole_receiver.Recv(lctx, absl::MakeSpan(a_), absl::MakeSpan(c_));
-    SPDLOG_INFO("end vole recv");
   } else if (mode_ == Rr22PsiMode::LowCommMode) {
     uint128_t paxos_seed = yacl::crypto::SecureRandU128();
     yacl::ByteContainerView paxos_seed_buf(&paxos_seed, sizeof(uint128_t));
@@ -432,21 +513,28 @@ void Rr22OprfReceiver::Init(const std::shared_ptr<yacl::link::Context>& lctx,
     paxos_.Init(init_size, kPaxosWeight, ssp_,
                 okvs::PaxosParam::DenseType::Binary, paxos_seed);
     paxos_size_ = paxos_.size();
-
-    // vole recv function
-    SPDLOG_INFO("use SilentVoleReceiver");
-    yacl::crypto::SilentVoleReceiver vole_receiver(code_type_);
-    size_t v_size = std::max<size_t>(256, paxos_.size());
-    a64_ = std::vector<uint64_t>(v_size, 0);
-    c_ = std::vector<uint128_t>(v_size, 0);
-
-    SPDLOG_INFO("begin vole recv");
-    vole_receiver.SfRecv(lctx, absl::MakeSpan(a64_), absl::MakeSpan(c_));
-    SPDLOG_INFO("end vole recv");
-
   } else {
     YACL_THROW("unsupported mode:{}", int(mode_));
   }
+
+  size_t v_size = GetVoleSize(init_size);
+  if (vole.has_value()) {
+    // a prefix of a longer correlation is still a correlation.
+    YACL_ENFORCE(vole->c.size() >= v_size, "precomputed vole {} < {}",
+                 vole->c.size(), v_size);
+    vole->c.resize(v_size);
+    if (mode_ == Rr22PsiMode::FastMode) {
+      vole->a.resize(v_size);
+    } else {
+      vole->a64.resize(v_size);
+    }
+  } else {
+    vole = GenerateVoleCorrelation(lctx, false, v_size, mode_, code_type_,
+                                   malicious_);
+  }
+  a_ = std::move(vole->a);
+  a64_ = std::move(vole->a64);
+  c_ = std::move(vole->c);
 }
 
 std::vector<uint128_t> Rr22OprfReceiver::Recv(
@@ -510,19 +598,7 @@ std::vector<uint128_t> Rr22OprfReceiver::RecvFast(
     baxos_.Decode(inputs, outputs_span,
                   absl::MakeSpan(c_.data(), baxos_.size()), num_threads_);
     c_.clear();
-    if (malicious_) {
-      for (size_t i = 0; i < outputs.size(); ++i) {
-        outputs[i] = outputs[i] ^ w;
-      }
-    }
-
-    if (malicious_) {
-      SPDLOG_INFO("call Davis-Meyer hash");
-      DavisMeyerHash(outputs_span, inputs, outputs_span);
-    } else {
-      SPDLOG_INFO("call aes crhash");
-      aes_crhash.Hash(outputs_span, outputs_span);
-    }
+    FinalizeOutputs(inputs, {}, w, malicious_, outputs_span);
     SPDLOG_INFO("end compute self oprf");
   });
 
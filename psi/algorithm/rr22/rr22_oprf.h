@@ -16,6 +16,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <vector>
 
 #include "yacl/base/int128.h"
@@ -23,6 +24,7 @@
 #include "yacl/link/context.h"
 
 #include "psi/algorithm/rr22/okvs/baxos.h"
+#include "psi/algorithm/rr22/rr22_utils.h"
 
 // Reference:
 // Blazing Fast PSI from Improved OKVS and Subfield VOLE
@@ -69,6 +71,23 @@ class MocRr22VoleReceiver {
   uint128_t seed_;
 };
 
+// VOLE correlation of one party, the sender has delta and b, the receiver has
+// a (a64 in LowCommMode) and c, where c + b = a * delta.
+struct VoleCorrelation {
+  uint128_t delta = 0;
+  std::vector<uint128_t> b;
+
+  std::vector<uint128_t> a;
+  std::vector<uint64_t> a64;
+  std::vector<uint128_t> c;
+};
+
+// Runs the silent VOLE used by Rr22OprfSender/Rr22OprfReceiver::Init.
+VoleCorrelation GenerateVoleCorrelation(
+    const std::shared_ptr<yacl::link::Context>& lctx, bool is_sender,
+    size_t vole_size, Rr22PsiMode mode,
+    const yacl::crypto::CodeType& code_type, bool malicious);
+
 class Rr22Oprf {
  public:
   Rr22Oprf(
@@ -97,6 +116,9 @@ class Rr22Oprf {
 
   size_t GetPaxosSize() { return paxos_size_; }
 
+  // Size of the VOLE correlation needed by Init with init_size.
+  size_t GetVoleSize(size_t init_size) const;
+
  protected:
   //
   uint64_t bin_size_ = 0;
@@ -129,8 +151,11 @@ class Rr22OprfSender : public Rr22Oprf {
       YACL_THROW("RR22 malicious psi not support LowCommMode");
     }
   }
+  // Runs the VOLE unless vole is given, which must not be used again and must
+  // be at least GetVoleSize(init_size) long.
   void Init(const std::shared_ptr<yacl::link::Context>& lctx, size_t init_size,
-            size_t num_threads = 0);
+            size_t num_threads = 0,
+            std::optional<VoleCorrelation> vole = std::nullopt);
 
   std::vector<uint128_t> Send(const std::shared_ptr<yacl::link::Context>& lctx,
                               const absl::Span<const uint128_t>& inputs);
@@ -140,7 +165,18 @@ class Rr22OprfSender : public Rr22Oprf {
   std::vector<uint128_t> Eval(const absl::Span<const uint128_t>& inputs,
                               absl::Span<const uint128_t> inputs_hash);
 
+  // Evaluates chunk_size inputs at a time and hands the outputs to sink in
+  // order, so that only one chunk of outputs is kept in memory. The chunk
+  // passed to sink is reused for the next one.
+  void Eval(const absl::Span<const uint128_t>& inputs,
+            absl::Span<const uint128_t> inputs_hash, size_t chunk_size,
+            const OprfSink& sink);
+
  private:
+  void EvalChunk(absl::Span<const uint128_t> inputs,
+                 absl::Span<const uint128_t> inputs_hash,
+                 absl::Span<uint128_t> outputs);
+
   std::vector<uint128_t> SendFast(
       const std::shared_ptr<yacl::link::Context>& lctx,
       const absl::Span<const uint128_t>& inputs);
@@ -174,8 +210,11 @@ class Rr22OprfReceiver : public Rr22Oprf {
     }
   }
 
+  // Runs the VOLE unless vole is given, which must not be used again and must
+  // be at least GetVoleSize(init_size) long.
   void Init(const std::shared_ptr<yacl::link::Context>& lctx, size_t init_size,
-            size_t num_threads = 0);
+            size_t num_threads = 0,
+            std::optional<VoleCorrelation> vole = std::nullopt);
 
   std::vector<uint128_t> Recv(const std::shared_ptr<yacl::link::Context>& lctx,
                               const absl::Span<const uint128_t>& inputs);
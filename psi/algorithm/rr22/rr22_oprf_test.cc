@@ -14,6 +14,7 @@
 
 #include "psi/algorithm/rr22/rr22_oprf.h"
 
+#include <algorithm>
 #include <future>
 #include <vector>
 
@@ -122,6 +123,58 @@ TEST_P(Rr22OprfTest, OprfTest) {
   EXPECT_EQ(oprf_a, oprf_b);
 }
 
+TEST_P(Rr22OprfTest, ChunkedEvalTest) {
+  auto params = GetParam();
+
+  auto lctxs = yacl::link::test::SetupWorld("ab", 2);
+
+  uint128_t seed = yacl::MakeUint128(0, 0);
+  yacl::crypto::Prg<uint128_t> prng(seed);
+
+  size_t item_size = params.items_num;
+  std::vector<uint128_t> values(item_size);
+
+  prng.Fill(absl::MakeSpan(values));
+
+  Rr22OprfSender oprf_sender(kRr22OprfBinSize, kRr22DefaultSsp, params.mode,
+                             yacl::crypto::CodeType::ExAcc7, params.malicious);
+  Rr22OprfReceiver oprf_receiver(kRr22OprfBinSize, kRr22DefaultSsp,
+                                 params.mode, yacl::crypto::CodeType::ExAcc7,
+                                 params.malicious);
+
+  std::vector<uint128_t> oprf_a(item_size);
+  std::vector<uint128_t> oprf_b(item_size);
+  // not a divisor of item_size, so the last chunk is smaller.
+  constexpr size_t kChunkSize = 1000;
+
+  auto oprf_sender_proc = std::async([&] {
+    oprf_sender.Init(lctxs[0], item_size);
+    auto sender_inputs_hash = oprf_sender.Send(lctxs[0], values);
+
+    size_t next_offset = 0;
+    oprf_sender.Eval(values, absl::MakeSpan(sender_inputs_hash), kChunkSize,
+                     [&](size_t offset, absl::Span<uint128_t> oprfs) {
+                       EXPECT_EQ(offset, next_offset);
+                       EXPECT_LE(oprfs.size(), kChunkSize);
+                       std::copy(oprfs.begin(), oprfs.end(),
+                                 oprf_a.begin() + offset);
+                       next_offset += oprfs.size();
+                     });
+    EXPECT_EQ(next_offset, item_size);
+    lctxs[0]->WaitLinkTaskFinish();
+  });
+  auto oprf_receiver_proc = std::async([&] {
+    oprf_receiver.Init(lctxs[1], item_size, 1);
+    oprf_b = oprf_receiver.Recv(lctxs[1], values);
+    lctxs[1]->WaitLinkTaskFinish();
+  });
+
+  oprf_sender_proc.get();
+  oprf_receiver_proc.get();
+
+  EXPECT_EQ(oprf_a, oprf_b);
+}
+
 INSTANTIATE_TEST_SUITE_P(
     OprfTest_Instances, Rr22OprfTest,
     testing::Values(TestParams{1 << 12, Rr22PsiMode::LowCommMode},
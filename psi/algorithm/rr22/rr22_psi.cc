@@ -15,13 +15,18 @@
 #include "psi/algorithm/rr22/rr22_psi.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <future>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <random>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -32,6 +37,7 @@
 #include "psi/algorithm/rr22/rr22_oprf.h"
 #include "psi/algorithm/rr22/rr22_utils.h"
 #include "psi/utils/bucket.h"
+#include "psi/utils/serialize.h"
 #include "psi/utils/sync.h"
 
 namespace psi::rr22 {
@@ -51,8 +57,74 @@ size_t ComputeTruncateSize(size_t self_size, size_t peer_size, size_t ssp,
   return truncate_size;
 }
 
+double ElapsedMs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Hands buckets to the next stage in bucket order. A bucket can be pushed
+// only when it is less than depth ahead of the next one to pop, so the
+// queue holds at most depth buckets and the next bucket never blocks.
+class BucketQueue {
+ public:
+  BucketQueue(size_t start_idx, size_t depth)
+      : next_idx_(start_idx), depth_(std::max<size_t>(1, depth)) {}
+
+  // returns the time waiting for room.
+  double Push(size_t idx, std::shared_ptr<BucketRr22Core> runner) {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock lock(mtx_);
+    cv_.wait(lock, [&] { return idx < next_idx_ + depth_; });
+    double wait_ms = ElapsedMs(start);
+    runners_.emplace(idx, std::move(runner));
+    max_size_ = std::max(max_size_, runners_.size());
+    cv_.notify_all();
+    return wait_ms;
+  }
+
+  // returns the next bucket and adds the time waiting for it to wait_ms.
+  std::shared_ptr<BucketRr22Core> Pop(double* wait_ms) {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock lock(mtx_);
+    cv_.wait(lock, [&] { return runners_.count(next_idx_) > 0; });
+    *wait_ms += ElapsedMs(start);
+    auto iter = runners_.find(next_idx_);
+    auto runner = std::move(iter->second);
+    runners_.erase(iter);
+    next_idx_++;
+    cv_.notify_all();
+    return runner;
+  }
+
+  size_t max_size() const {
+    std::unique_lock lock(mtx_);
+    return max_size_;
+  }
+
+ private:
+  mutable std::mutex mtx_;
+  std::condition_variable cv_;
+  std::map<size_t, std::shared_ptr<BucketRr22Core>> runners_;
+  size_t next_idx_;
+  size_t depth_;
+  size_t max_size_ = 0;
+};
+
 }  // namespace
 
+std::string Rr22PipelineStats::ToString() const {
+  auto stage_str = [](const Stage& stage) {
+    return fmt::format("busy={:.1f}ms starved={:.1f}ms blocked={:.1f}ms",
+                       stage.busy_ms, stage.starved_ms, stage.blocked_ms);
+  };
+  return fmt::format(
+      "prepare: {}, oprf: {}, intersection: {}, max_prepared={}, "
+      "max_oprf_done={}",
+      stage_str(prepare), stage_str(oprf), stage_str(intersection),
+      max_prepared, max_oprf_done);
+}
+
 std::pair<size_t, size_t> ExchangeTruncateSize(
     const std::shared_ptr<yacl::link::Context>& lctx, size_t self_size,
     const Rr22PsiOptions& options) {
@@ -88,11 +160,14 @@ void BucketRr22Sender::Prepare(
   inputs_hash_ = std::vector<uint128_t>(bucket_items_.size());
   yacl::parallel_for(0, bucket_items_.size(), [&](int64_t begin, int64_t end) {
     for (int64_t i = begin; i < end; ++i) {
-      inputs_hash_[i] = yacl::crypto::Blake3_128(bucket_items_[i].base64_data);
+      inputs_hash_[i] = GetBucketItemSecHash(bucket_items_[i]);
     }
   });
-  oprf_sender_.Init(lctx, std::max(self_size_, peer_size_),
-                    rr22_options_.num_threads);
+  size_t init_size = std::max(self_size_, peer_size_);
+  oprf_sender_.Init(lctx, init_size, rr22_options_.num_threads,
+                    VolePool::TakeAgreed(rr22_options_.vole_pool, lctx,
+                                         bucket_idx_,
+                                         oprf_sender_.GetVoleSize(init_size)));
 }
 
 void BucketRr22Sender::RunOprf(
@@ -100,8 +175,8 @@ void BucketRr22Sender::RunOprf(
   if (null_bucket_) {
     return;
   }
-  auto inputs_hash = oprf_sender_.Send(lctx, inputs_hash_);
-  oprfs_ = oprf_sender_.Eval(inputs_hash_, inputs_hash);
+  // oprfs are evaluated in chunks while sending in GetIntersection.
+  inputs_hash_mul_delta_ = oprf_sender_.Send(lctx, inputs_hash_);
 }
 
 void BucketRr22Sender::GetIntersection(
@@ -114,7 +189,12 @@ void BucketRr22Sender::GetIntersection(
   std::vector<uint32_t> indices;
   std::vector<uint32_t> peer_cnt;
   std::tie(indices, peer_cnt) = GetIntersectionSender(
-      oprfs_, bucket_items_, lctx, mask_size_, broadcast_result_);
+      [&](const OprfSink& sink) {
+        oprf_sender_.Eval(inputs_hash_, inputs_hash_mul_delta_,
+                          kSendChunkSize, sink);
+      },
+      bucket_items_, lctx, mask_size_, broadcast_result_);
+  inputs_hash_mul_delta_.clear();
   SPDLOG_INFO("get intersection end");
   post_f_(bucket_idx_, bucket_items_, indices, peer_cnt);
   SPDLOG_INFO("get intersection post f");
@@ -136,7 +216,7 @@ void BucketRr22Receiver::Prepare(
   inputs_hash_ = std::vector<uint128_t>(std::max(peer_size_, self_size_));
   yacl::parallel_for(0, bucket_items_.size(), [&](int64_t begin, int64_t end) {
     for (int64_t i = begin; i < end; ++i) {
-      inputs_hash_[i] = yacl::crypto::Blake3_128(bucket_items_[i].base64_data);
+      inputs_hash_[i] = GetBucketItemSecHash(bucket_items_[i]);
     }
   });
   if (peer_size_ > self_size_) {
@@ -144,7 +224,10 @@ void BucketRr22Receiver::Prepare(
       inputs_hash_[idx] = yacl::crypto::SecureRandU128();
     }
   }
-  oprf_receiver_.Init(lctx, inputs_hash_.size(), rr22_options_.num_threads);
+  oprf_receiver_.Init(
+      lctx, inputs_hash_.size(), rr22_options_.num_threads,
+      VolePool::TakeAgreed(rr22_options_.vole_pool, lctx, bucket_idx_,
+                           oprf_receiver_.GetVoleSize(inputs_hash_.size())));
 }
 
 void BucketRr22Receiver::RunOprf(
@@ -171,4 +254,121 @@ void BucketRr22Receiver::GetIntersection(
   post_f_(bucket_idx_, bucket_items_, indices, peer_cnt);
   SPDLOG_INFO("get intersection post f");
 }
+
+void Rr22Runner::AsyncRun(size_t start_idx, bool is_sender) {
+  pipeline_stats_ = Rr22PipelineStats();
+  if (bucket_num_ <= start_idx + 1) {
+    Run(start_idx, is_sender);
+    return;
+  }
+
+  size_t prepare_threads =
+      std::min(std::max<size_t>(1, rr22_options_.prepare_threads),
+               bucket_num_ - start_idx);
+  BucketQueue prepared_queue(start_idx, rr22_options_.read_ahead_depth);
+  BucketQueue oprf_queue(start_idx, rr22_options_.intersection_queue_depth);
+  std::mutex stats_mtx;
+
+  // buckets are assigned to prepare threads round robin, so both parties
+  // prepare the same bucket on the same link.
+  std::vector<std::future<void>> prepare_futures(prepare_threads);
+  for (size_t t = 0; t < prepare_threads; t++) {
+    prepare_futures[t] = std::async(std::launch::async, [&, t]() {
+      auto lctx = prepare_threads > 1 ? read_lctx_->Spawn(std::to_string(t))
+                                      : read_lctx_;
+      Rr22PipelineStats::Stage stage;
+      for (size_t i = start_idx + t; i < bucket_num_; i += prepare_threads) {
+        auto start = std::chrono::steady_clock::now();
+        auto runner = CreateBucketRunner(i, is_sender);
+        runner->Prepare(lctx);
+        stage.busy_ms += ElapsedMs(start);
+        stage.blocked_ms += prepared_queue.Push(i, std::move(runner));
+      }
+      std::unique_lock lock(stats_mtx);
+      pipeline_stats_.prepare.busy_ms += stage.busy_ms;
+      pipeline_stats_.prepare.blocked_ms += stage.blocked_ms;
+    });
+  }
+  auto run_f = std::async(std::launch::async, [&]() {
+    auto& stage = pipeline_stats_.oprf;
+    for (size_t i = start_idx; i < bucket_num_; i++) {
+      auto runner = prepared_queue.Pop(&stage.starved_ms);
+      auto start = std::chrono::steady_clock::now();
+      runner->RunOprf(run_lctx_);
+      stage.busy_ms += ElapsedMs(start);
+      stage.blocked_ms += oprf_queue.Push(i, std::move(runner));
+    }
+  });
+  auto intersection_f = std::async(std::launch::async, [&]() {
+    auto& stage = pipeline_stats_.intersection;
+    for (size_t i = start_idx; i < bucket_num_; i++) {
+      auto runner = oprf_queue.Pop(&stage.starved_ms);
+      auto start = std::chrono::steady_clock::now();
+      runner->GetIntersection(intersection_lctx_);
+      stage.busy_ms += ElapsedMs(start);
+    }
+  });
+  run_f.get();
+  for (auto& f : prepare_futures) {
+    f.get();
+  }
+  intersection_f.get();
+
+  pipeline_stats_.max_prepared = prepared_queue.max_size();
+  pipeline_stats_.max_oprf_done = oprf_queue.max_size();
+  SPDLOG_INFO("rr22 pipeline stats: {}", pipeline_stats_.ToString());
+}
+
+void Rr22Runner::ParallelRun(size_t start_idx, bool is_sender,
+                             size_t parallel_num) {
+  if (start_idx >= bucket_num_) {
+    return;
+  }
+  parallel_num = std::min(parallel_num, bucket_num_ - start_idx);
+  if (parallel_num <= 1) {
+    Run(start_idx, is_sender);
+    return;
+  }
+
+  // the next bucket to run, only used by the receiver.
+  std::atomic<size_t> next_idx(start_idx);
+  std::vector<std::future<void>> futures(parallel_num);
+  for (size_t i = 0; i < parallel_num; i++) {
+    futures[i] = std::async(
+        std::launch::async,
+        [&](size_t thread_idx) {
+          auto tag = std::to_string(thread_idx);
+          auto spawn_read_lctx = read_lctx_->Spawn(tag);
+          auto spawn_run_lctx = run_lctx_->Spawn(tag);
+          auto spawn_intersection_lctx = intersection_lctx_->Spawn(tag);
+          auto spawn_schedule_lctx = schedule_lctx_->Spawn(tag);
+          while (true) {
+            // bucket_num_ means no bucket left.
+            size_t idx = 0;
+            if (is_sender) {
+              idx = utils::DeserializeSize(spawn_schedule_lctx->Recv(
+                  spawn_schedule_lctx->NextRank(), "RR22:NEXT_BUCKET"));
+            } else {
+              idx = std::min(next_idx.fetch_add(1), bucket_num_);
+              spawn_schedule_lctx->SendAsyncThrottled(
+                  spawn_schedule_lctx->NextRank(), utils::SerializeSize(idx),
+                  fmt::format("RR22:NEXT_BUCKET={}", idx));
+            }
+            if (idx >= bucket_num_) {
+              break;
+            }
+            SPDLOG_INFO("worker {} runs bucket {}", thread_idx, idx);
+            auto runner = CreateBucketRunner(idx, is_sender);
+            runner->Prepare(spawn_read_lctx);
+            runner->RunOprf(spawn_run_lctx);
+            runner->GetIntersection(spawn_intersection_lctx);
+          }
+        },
+        i);
+  }
+  for (auto& f : futures) {
+    f.get();
+  }
+}
+
 }  // namespace psi::rr22
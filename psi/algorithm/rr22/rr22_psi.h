@@ -22,7 +22,6 @@
 #include <memory>
 #include <mutex>
 #include <optional>
-#include <queue>
 #include <string>
 #include <thread>
 #include <vector>
@@ -32,6 +31,7 @@
 #include "yacl/link/context.h"
 
 #include "psi/algorithm/rr22/rr22_oprf.h"
+#include "psi/algorithm/rr22/vole_pool.h"
 #include "psi/utils/bucket.h"
 #include "psi/utils/hash_bucket_cache.h"
 
@@ -73,6 +73,40 @@ struct Rr22PsiOptions {
 
   yacl::crypto::CodeType code_type = yacl::crypto::CodeType::ExAcc7;
   const size_t oprf_bin_size = 1 << 14;
+
+  // pipeline of Rr22Runner::AsyncRun
+  // number of buckets prepared ahead of the oprf stage
+  size_t read_ahead_depth = 1;
+  // number of buckets waiting for the intersection stage
+  size_t intersection_queue_depth = 1;
+  // number of threads loading buckets, must be the same for both parties
+  size_t prepare_threads = 1;
+
+  // optional, VOLE correlations generated ahead of the buckets
+  std::shared_ptr<VolePool> vole_pool;
+};
+
+// Back-pressure metrics of Rr22Runner::AsyncRun. Times are in milliseconds
+// and summed over the threads of a stage.
+struct Rr22PipelineStats {
+  struct Stage {
+    // doing the work of the stage
+    double busy_ms = 0;
+    // waiting for the previous stage
+    double starved_ms = 0;
+    // waiting for room in the queue to the next stage
+    double blocked_ms = 0;
+  };
+
+  Stage prepare;
+  Stage oprf;
+  Stage intersection;
+
+  // peak number of buckets waiting in the queues
+  size_t max_prepared = 0;
+  size_t max_oprf_done = 0;
+
+  std::string ToString() const;
 };
 
 using PreProcessFunc =
@@ -133,6 +167,7 @@ class BucketRr22Sender : public BucketRr22Core {
   PreProcessFunc pre_f_;
   PostProcessFunc post_f_;
   Rr22OprfSender oprf_sender_;
+  std::vector<uint128_t> inputs_hash_mul_delta_;
 };
 
 class BucketRr22Receiver : public BucketRr22Core {
@@ -176,6 +211,7 @@ class Rr22Runner {
     intersection_lctx_ = lctx->Spawn("intersection");
     read_lctx_ = lctx->Spawn("read");
     run_lctx_ = lctx->Spawn("run");
+    schedule_lctx_ = lctx->Spawn("schedule");
   }
   void Run(size_t start_idx, bool is_sender) {
     for (size_t idx = start_idx; idx < bucket_num_; ++idx) {
@@ -186,98 +222,20 @@ class Rr22Runner {
     }
   }
 
-  void AsyncRun(size_t start_idx, bool is_sender) {
-    // cache size meaning the size you can prepare input data into queue
-    // bigger cache size may run a little fast but consume more memory
-    constexpr size_t cache_size = 1;
-    if (bucket_num_ <= cache_size) {
-      Run(start_idx, is_sender);
-      return;
-    }
-    std::queue<std::shared_ptr<BucketRr22Core>> prepared_runner_queue;
-    std::queue<std::shared_ptr<BucketRr22Core>> oprf_runner_queue;
-    std::mutex prepare_mtx;
-    std::condition_variable prepare_cv;
-    std::mutex oprf_mtx;
-    std::condition_variable oprf_cv;
-    auto prepare_f = std::async(std::launch::async, [&]() {
-      for (size_t i = start_idx; i < bucket_num_; i++) {
-        auto runner = CreateBucketRunner(i, is_sender);
-        runner->Prepare(read_lctx_);
-        std::unique_lock lock(prepare_mtx);
-        prepare_cv.wait(
-            lock, [&] { return prepared_runner_queue.size() < cache_size; });
-        prepared_runner_queue.push(runner);
-        prepare_cv.notify_all();
-      }
-    });
-    auto run_f = std::async(std::launch::async, [&]() {
-      for (int i = start_idx; i < static_cast<int>(bucket_num_); ++i) {
-        std::shared_ptr<BucketRr22Core> runner;
-        {
-          std::unique_lock lock(prepare_mtx);
-          prepare_cv.wait(lock, [&] { return !prepared_runner_queue.empty(); });
-          runner = prepared_runner_queue.front();
-          prepared_runner_queue.pop();
-          prepare_cv.notify_all();
-        }
-        runner->RunOprf(run_lctx_);
-        {
-          std::unique_lock lock(oprf_mtx);
-          oprf_runner_queue.push(runner);
-          oprf_cv.notify_all();
-        }
-      }
-    });
-    auto intersection_f = std::async(std::launch::async, [&]() {
-      for (int i = start_idx; i < static_cast<int>(bucket_num_); ++i) {
-        std::shared_ptr<BucketRr22Core> runner;
-        {
-          std::unique_lock lock(oprf_mtx);
-          oprf_cv.wait(lock, [&] { return !oprf_runner_queue.empty(); });
-          runner = oprf_runner_queue.front();
-          oprf_runner_queue.pop();
-          oprf_cv.notify_all();
-        }
-        runner->GetIntersection(intersection_lctx_);
-      }
-    });
-    run_f.get();
-    prepare_f.get();
-    intersection_f.get();
-  }
+  // Runs prepare, oprf and intersection of successive buckets at the same
+  // time. The stages are linked by bounded queues, whose depths are given by
+  // rr22_options, and several threads may prepare buckets.
+  void AsyncRun(size_t start_idx, bool is_sender);
 
-  void ParallelRun(size_t start_idx, bool is_sender, int parallel_num = 6) {
-    if (static_cast<int>(bucket_num_) <= parallel_num) {
-      Run(start_idx, is_sender);
-      return;
-    }
-    std::vector<std::future<void>> futures(parallel_num);
-    for (size_t i = 0; i < static_cast<size_t>(parallel_num); i++) {
-      futures[i] = std::async(
-          std::launch::async,
-          [&](size_t thread_idx) {
-            std::shared_ptr<yacl::link::Context> spawn_read_lctx =
-                read_lctx_->Spawn(std::to_string(thread_idx));
-            std::shared_ptr<yacl::link::Context> spawn_run_lctx =
-                run_lctx_->Spawn(std::to_string(thread_idx));
-            std::shared_ptr<yacl::link::Context> spawn_intersection_lctx =
-                intersection_lctx_->Spawn(std::to_string(thread_idx));
-            for (size_t j = 0; j < bucket_num_; j++) {
-              if (j % parallel_num == thread_idx) {
-                auto runner = CreateBucketRunner(j, is_sender);
-                runner->Prepare(spawn_read_lctx);
-                runner->RunOprf(spawn_run_lctx);
-                runner->GetIntersection(spawn_intersection_lctx);
-              }
-            }
-          },
-          i);
-    }
-    for (auto& f : futures) {
-      f.get();
-    }
-  }
+  // Metrics of the last AsyncRun.
+  const Rr22PipelineStats& pipeline_stats() const { return pipeline_stats_; }
+
+  // Runs parallel_num buckets at the same time, each worker with its own
+  // links. An idle worker of the receiver takes the next bucket, and tells
+  // the peer worker of the sender which one it is, so skewed buckets don't
+  // hold up other workers. parallel_num must be the same for both parties.
+  // Buckets may finish out of order, so post_f must be thread safe.
+  void ParallelRun(size_t start_idx, bool is_sender, size_t parallel_num);
 
  private:
   std::shared_ptr<BucketRr22Core> CreateBucketRunner(size_t idx,
@@ -295,11 +253,13 @@ class Rr22Runner {
   std::shared_ptr<yacl::link::Context> intersection_lctx_;
   std::shared_ptr<yacl::link::Context> read_lctx_;
   std::shared_ptr<yacl::link::Context> run_lctx_;
+  std::shared_ptr<yacl::link::Context> schedule_lctx_;
   Rr22PsiOptions rr22_options_;
   size_t bucket_num_;
   bool broadcast_result_;
   PreProcessFunc pre_f_;
   PostProcessFunc post_f_;
+  Rr22PipelineStats pipeline_stats_;
 };
 
 }  // namespace psi::rr22
@@ -14,9 +14,12 @@
 
 #include "psi/algorithm/rr22/rr22_psi.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <functional>
 #include <future>
 #include <mutex>
+#include <numeric>
 #include <random>
 #include <string>
 #include <tuple>
@@ -68,6 +71,77 @@ struct TestParams {
   bool malicious = false;
 };
 
+// Runs 5 buckets with the same inputs and checks all of them are done.
+void CheckMultiBucketRun(
+    const Rr22PsiOptions& psi_options,
+    const std::function<void(Rr22Runner&, bool is_sender)>& run_f) {
+  auto lctxs = yacl::link::test::SetupWorld("ab", 2);
+
+  std::vector<uint128_t> inputs_a;
+  std::vector<uint128_t> inputs_b;
+  std::vector<uint32_t> indices;
+  std::tie(inputs_a, inputs_b, indices) = GenerateTestData(1 << 12);
+
+  size_t bucket_num = 5;
+
+  auto make_pre_f = [](const std::vector<uint128_t>& inputs) {
+    return PreProcessFunc([&inputs](size_t) {
+      std::vector<HashBucketCache::BucketItem> bucket_items(inputs.size());
+      for (size_t i = 0; i < inputs.size(); ++i) {
+        bucket_items[i] = {.index = i, .data = fmt::format("{}", inputs[i])};
+      }
+      return bucket_items;
+    });
+  };
+  PreProcessFunc receiver_pre_f = make_pre_f(inputs_a);
+  PreProcessFunc sender_pre_f = make_pre_f(inputs_b);
+
+  std::mutex mtx;
+  std::vector<size_t> finished_buckets;
+  std::vector<uint32_t> indices_psi;
+  PostProcessFunc receiver_post_f =
+      [&](size_t bucket_idx,
+          const std::vector<HashBucketCache::BucketItem>& bucket_items,
+          const std::vector<uint32_t>& indices,
+          const std::vector<uint32_t>&) {
+        std::unique_lock lock(mtx);
+        finished_buckets.push_back(bucket_idx);
+        for (auto index : indices) {
+          indices_psi.push_back(bucket_items[index].index);
+        }
+      };
+  PostProcessFunc sender_post_f =
+      [&](size_t, const std::vector<HashBucketCache::BucketItem>&,
+          const std::vector<uint32_t>&,
+          const std::vector<uint32_t>&) { return; };
+
+  auto psi_receiver_proc = std::async([&] {
+    Rr22Runner runner(lctxs[0], psi_options, bucket_num, false, receiver_pre_f,
+                      receiver_post_f);
+    run_f(runner, false);
+  });
+  auto psi_sender_proc = std::async([&] {
+    Rr22Runner runner(lctxs[1], psi_options, bucket_num, false, sender_pre_f,
+                      sender_post_f);
+    run_f(runner, true);
+  });
+  psi_sender_proc.get();
+  psi_receiver_proc.get();
+
+  std::sort(finished_buckets.begin(), finished_buckets.end());
+  std::vector<size_t> expected_buckets(bucket_num);
+  std::iota(expected_buckets.begin(), expected_buckets.end(), 0);
+  EXPECT_EQ(finished_buckets, expected_buckets);
+
+  std::vector<uint32_t> indices_result;
+  for (size_t i = 0; i < bucket_num; i++) {
+    indices_result.insert(indices_result.end(), indices.begin(), indices.end());
+  }
+  std::sort(indices_result.begin(), indices_result.end());
+  std::sort(indices_psi.begin(), indices_psi.end());
+  EXPECT_EQ(indices_result, indices_psi);
+}
+
 }  // namespace
 
 class Rr22PsiTest : public testing::TestWithParam<TestParams> {};
@@ -97,7 +171,7 @@ TEST_P(Rr22PsiTest, CorrectTest) {
     std::vector<HashBucketCache::BucketItem> bucket_items(inputs_a.size());
     for (size_t i = 0; i < inputs_a.size(); ++i) {
       bucket_items[i] = {.index = i,
-                         .base64_data = fmt::format("{}", inputs_a[i])};
+                         .data = fmt::format("{}", inputs_a[i])};
     }
     return bucket_items;
   };
@@ -120,7 +194,7 @@ TEST_P(Rr22PsiTest, CorrectTest) {
     std::vector<HashBucketCache::BucketItem> bucket_items(inputs_b.size());
     for (size_t i = 0; i < inputs_b.size(); ++i) {
       bucket_items[i] = {.index = i,
-                         .base64_data = fmt::format("{}", inputs_b[i])};
+                         .data = fmt::format("{}", inputs_b[i])};
     }
     return bucket_items;
   };
@@ -154,6 +228,26 @@ TEST_P(Rr22PsiTest, CorrectTest) {
   EXPECT_EQ(indices_result, indices_psi);
 }
 
+TEST(Rr22RunnerTest, ParallelRunTest) {
+  Rr22PsiOptions psi_options(40, 1, true);
+  CheckMultiBucketRun(psi_options, [](Rr22Runner& runner, bool is_sender) {
+    runner.ParallelRun(0, is_sender, 2);
+  });
+}
+
+TEST(Rr22RunnerTest, AsyncRunPipelineTest) {
+  Rr22PsiOptions psi_options(40, 1, true);
+  psi_options.read_ahead_depth = 3;
+  psi_options.intersection_queue_depth = 2;
+  psi_options.prepare_threads = 2;
+  CheckMultiBucketRun(psi_options, [](Rr22Runner& runner, bool is_sender) {
+    runner.AsyncRun(0, is_sender);
+    const auto& stats = runner.pipeline_stats();
+    EXPECT_LE(stats.max_prepared, 3U);
+    EXPECT_LE(stats.max_oprf_done, 2U);
+  });
+}
+
 INSTANTIATE_TEST_SUITE_P(
     CorrectTest_Instances, Rr22PsiTest,
     testing::Values(TestParams{1 << 17, Rr22PsiMode::FastMode},
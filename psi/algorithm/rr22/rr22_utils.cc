@@ -19,7 +19,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
-#include <future>
+#include <mutex>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -46,92 +46,219 @@ struct NoHash {
   }
 };
 
-}  // namespace
+uint128_t GetTruncateMask(size_t mask_size) {
+  auto truncate_mask = yacl::MakeUint128(0, 0);
+  if (mask_size == sizeof(uint128_t)) {
+    return ~truncate_mask;
+  }
+  for (size_t i = 0; i < mask_size; ++i) {
+    truncate_mask = 0xff | (truncate_mask << 8);
+    SPDLOG_DEBUG(
+        "{}, truncate_mask:{}", i,
+        (std::ostringstream() << okvs::Galois128(truncate_mask)).str());
+  }
+  return truncate_mask;
+}
 
-std::pair<std::vector<uint32_t>, std::vector<uint32_t>> GetIntersectionReceiver(
-    const std::vector<uint128_t>& self_oprfs,
-    const std::vector<HashBucketCache::BucketItem>& self_items,
-    size_t peer_items_num, const std::shared_ptr<yacl::link::Context>& lctx,
-    size_t num_threads, size_t mask_size, bool broadcast_result) {
-  bool compress = mask_size != sizeof(uint128_t);
-  google::dense_hash_map<uint128_t, size_t, NoHash> dense_map(
-      self_oprfs.size());
-  dense_map.set_empty_key(yacl::MakeUint128(0, 0));
-  auto map_f = std::async([&]() {
-    auto truncate_mask = yacl::MakeUint128(0, 0);
-    if (compress) {
-      for (size_t i = 0; i < mask_size; ++i) {
-        truncate_mask = 0xff | (truncate_mask << 8);
-        SPDLOG_DEBUG(
-            "{}, truncate_mask:{}", i,
-            (std::ostringstream() << okvs::Galois128(truncate_mask)).str());
-      }
+// Maps truncated oprfs to their indices. Oprfs are partitioned into shards by
+// hash, so that all threads fill the table at the same time.
+class ShardedOprfMap {
+ public:
+  using Shard = google::dense_hash_map<uint128_t, size_t, NoHash>;
+
+  ShardedOprfMap(const std::vector<uint128_t>& oprfs, size_t mask_size,
+                 size_t num_threads) {
+    num_threads = std::max<size_t>(1, num_threads);
+    // a few shards per thread for load balance.
+    while (oprfs.size() >= kMinShardSize << shard_bits_ &&
+           (size_t{1} << shard_bits_) < num_threads * 4 &&
+           shard_bits_ < kMaxShardBits) {
+      shard_bits_++;
     }
-    for (size_t i = 0; i < self_oprfs.size(); ++i) {
-      if (compress) {
-        dense_map.insert(std::make_pair(self_oprfs[i] & truncate_mask, i));
-      } else {
-        dense_map.insert(std::make_pair(self_oprfs[i], i));
+    size_t shard_num = size_t{1} << shard_bits_;
+    auto truncate_mask = GetTruncateMask(mask_size);
+
+    // split the oprfs into contiguous chunks, and sort the indices of each
+    // chunk by shard, so that the smaller index is inserted first as before.
+    size_t chunk_num = std::min(num_threads, std::max<size_t>(1, oprfs.size()));
+    std::vector<std::vector<std::vector<uint32_t>>> chunk_indices(
+        chunk_num, std::vector<std::vector<uint32_t>>(shard_num));
+    yacl::parallel_for(0, chunk_num, 1, [&](int64_t begin, int64_t end) {
+      for (int64_t c = begin; c < end; ++c) {
+        size_t first = oprfs.size() * c / chunk_num;
+        size_t last = oprfs.size() * (c + 1) / chunk_num;
+        for (size_t i = first; i < last; ++i) {
+          chunk_indices[c][ShardOf(oprfs[i] & truncate_mask)].push_back(i);
+        }
       }
+    });
+
+    shards_.resize(shard_num);
+    yacl::parallel_for(0, shard_num, 1, [&](int64_t begin, int64_t end) {
+      for (int64_t s = begin; s < end; ++s) {
+        size_t shard_size = 0;
+        for (const auto& indices : chunk_indices) {
+          shard_size += indices[s].size();
+        }
+        shards_[s] = Shard(shard_size);
+        shards_[s].set_empty_key(yacl::MakeUint128(0, 0));
+        for (const auto& indices : chunk_indices) {
+          for (auto i : indices[s]) {
+            shards_[s].insert(std::make_pair(oprfs[i] & truncate_mask, i));
+          }
+        }
+      }
+    });
+  }
+
+  // thread safe
+  bool Find(const uint128_t& oprf, size_t* index) const {
+    const auto& shard = shards_[ShardOf(oprf)];
+    auto iter = shard.find(oprf);
+    if (iter == shard.end()) {
+      return false;
     }
-  });
-  SPDLOG_INFO("recv rr22 oprf begin");
-  auto peer_buffer = lctx->Recv(lctx->NextRank(), fmt::format("paxos_solve"));
-  YACL_ENFORCE(peer_items_num == peer_buffer.size() / mask_size);
-  SPDLOG_INFO("recv rr22 oprf finished: {} vector:{}", peer_buffer.size(),
-              peer_items_num);
-  auto cnt_buffer = lctx->Recv(lctx->NextRank(), fmt::format("items_cnt"));
-  auto peer_item_cnt_map = utils::DeserializeItemsCnt(cnt_buffer);
-  for (uint32_t i = 0; i < peer_items_num; ++i) {
-    (void)peer_item_cnt_map[i];
+    *index = iter->second;
+    return true;
   }
 
-  map_f.get();
-  auto* peer_data_ptr = peer_buffer.data<uint8_t>();
-  std::mutex merge_mtx;
-  std::vector<uint32_t> self_indices;
-  std::vector<uint32_t> peer_cnt;
-  std::vector<uint32_t> peer_indices;
-  std::vector<uint32_t> self_cnt;
-  size_t grain_size = (peer_items_num + num_threads - 1) / num_threads;
-  yacl::parallel_for(
-      0, peer_items_num, grain_size, [&](int64_t begin, int64_t end) {
-        std::vector<uint32_t> tmp_indexs;
-        std::vector<uint32_t> tmp_peer_cnt;
+ private:
+  static constexpr size_t kMinShardSize = 1 << 14;
+  static constexpr size_t kMaxShardBits = 10;
 
-        std::vector<uint32_t> tmp_peer_indexs;
-        std::vector<uint32_t> tmp_self_cnt;
+  // uses the high bits of a multiplicative hash, NoHash inside a shard uses
+  // the low bits.
+  size_t ShardOf(const uint128_t& oprf) const {
+    if (shard_bits_ == 0) {
+      return 0;
+    }
+    uint32_t v32;
+    std::memcpy(&v32, &oprf, sizeof(uint32_t));
+    return (v32 * 0x9e3779b1U) >> (32 - shard_bits_);
+  }
 
+  size_t shard_bits_ = 0;
+  std::vector<Shard> shards_;
+};
+
+// Looks up a chunk of peer oprfs with all threads. peer_offset is the peer
+// index of the first oprf in the chunk. Returns the matched
+// {self index, peer index}, in no particular order.
+std::vector<std::pair<uint32_t, uint32_t>> ProbeChunk(
+    const ShardedOprfMap& oprf_map, const yacl::Buffer& chunk,
+    size_t peer_offset, size_t mask_size, size_t num_threads) {
+  size_t chunk_items = chunk.size() / mask_size;
+  const auto* data_ptr = chunk.data<uint8_t>();
+  std::mutex merge_mtx;
+  std::vector<std::pair<uint32_t, uint32_t>> matches;
+  size_t grain_size =
+      std::max<size_t>(1, (chunk_items + num_threads - 1) / num_threads);
+  yacl::parallel_for(
+      0, chunk_items, grain_size, [&](int64_t begin, int64_t end) {
+        std::vector<std::pair<uint32_t, uint32_t>> tmp_matches;
         uint128_t data = yacl::MakeUint128(0, 0);
+        size_t self_idx = 0;
         for (int64_t j = begin; j < end; j++) {
-          std::memcpy(&data, peer_data_ptr + (j * mask_size), mask_size);
-          auto iter = dense_map.find(data);
-          if (iter != dense_map.end()) {
-            tmp_indexs.push_back(iter->second);
-            tmp_peer_cnt.push_back(peer_item_cnt_map[j]);
-            if (broadcast_result) {
-              tmp_peer_indexs.push_back(j);
-              YACL_ENFORCE(
-                  iter->second < self_items.size(),
-                  "random str matched in result, which is not expected.");
-              tmp_self_cnt.push_back(self_items[iter->second].extra_dup_cnt);
-            }
+          std::memcpy(&data, data_ptr + (j * mask_size), mask_size);
+          if (oprf_map.Find(data, &self_idx)) {
+            tmp_matches.emplace_back(self_idx, peer_offset + j);
           }
         }
-        if (!tmp_indexs.empty()) {
+        if (!tmp_matches.empty()) {
           std::lock_guard<std::mutex> lock(merge_mtx);
-          self_indices.insert(self_indices.end(), tmp_indexs.begin(),
-                              tmp_indexs.end());
-          peer_cnt.insert(peer_cnt.end(), tmp_peer_cnt.begin(),
-                          tmp_peer_cnt.end());
-          if (broadcast_result) {
-            peer_indices.insert(peer_indices.end(), tmp_peer_indexs.begin(),
-                                tmp_peer_indexs.end());
-            self_cnt.insert(self_cnt.end(), tmp_self_cnt.begin(),
-                            tmp_self_cnt.end());
-          }
+          matches.insert(matches.end(), tmp_matches.begin(),
+                         tmp_matches.end());
         }
       });
+  return matches;
+}
+
+// Receives the chunks of peer oprfs sent by SendOprfChunked, and probes each
+// chunk once it arrives. Later chunks keep arriving in the background.
+std::vector<std::pair<uint32_t, uint32_t>> RecvAndProbe(
+    const ShardedOprfMap& oprf_map, size_t peer_items_num,
+    const std::shared_ptr<yacl::link::Context>& lctx, size_t num_threads,
+    size_t mask_size) {
+  std::vector<std::pair<uint32_t, uint32_t>> matches;
+  size_t recv_item_count = 0;
+  while (recv_item_count < peer_items_num) {
+    auto buffer = lctx->Recv(lctx->NextRank(), fmt::format("oprf_value"));
+    YACL_ENFORCE(buffer.size() % mask_size == 0,
+                 "bad oprf chunk size: {}, mask_size: {}", buffer.size(),
+                 mask_size);
+    size_t chunk_items = buffer.size() / mask_size;
+    YACL_ENFORCE(chunk_items > 0 &&
+                     recv_item_count + chunk_items <= peer_items_num,
+                 "received {} oprfs after {}, expected {} in total",
+                 chunk_items, recv_item_count, peer_items_num);
+    auto chunk_matches =
+        ProbeChunk(oprf_map, buffer, recv_item_count, mask_size, num_threads);
+    matches.insert(matches.end(), chunk_matches.begin(), chunk_matches.end());
+    recv_item_count += chunk_items;
+  }
+  SPDLOG_INFO("recv rr22 oprf finished: {} vector:{}",
+              recv_item_count * mask_size, peer_items_num);
+  return matches;
+}
+
+// Truncates a chunk of oprfs to mask_size bytes in place, and sends it.
+void SendOprfChunk(absl::Span<uint128_t> oprfs,
+                   const std::shared_ptr<yacl::link::Context>& lctx,
+                   size_t mask_size) {
+  auto* data_ptr = reinterpret_cast<std::byte*>(oprfs.data());
+  if (mask_size != sizeof(uint128_t)) {
+    for (size_t i = 0; i < oprfs.size(); ++i) {
+      std::memcpy(data_ptr + (i * mask_size), &oprfs[i], mask_size);
+    }
+  }
+  yacl::ByteContainerView send_buffer(data_ptr, oprfs.size() * mask_size);
+  lctx->SendAsyncThrottled(lctx->NextRank(), send_buffer,
+                           fmt::format("oprf_value"));
+}
+
+// Sends oprfs in chunks of kSendChunkSize items.
+void SendOprfChunked(std::vector<uint128_t>& oprfs,
+                     const std::shared_ptr<yacl::link::Context>& lctx,
+                     size_t mask_size) {
+  auto oprfs_span = absl::MakeSpan(oprfs);
+  for (size_t i = 0; i < oprfs.size(); i += kSendChunkSize) {
+    SendOprfChunk(
+        oprfs_span.subspan(i, std::min(kSendChunkSize, oprfs.size() - i)),
+        lctx, mask_size);
+  }
+}
+
+}  // namespace
+
+std::pair<std::vector<uint32_t>, std::vector<uint32_t>> GetIntersectionReceiver(
+    const std::vector<uint128_t>& self_oprfs,
+    const std::vector<HashBucketCache::BucketItem>& self_items,
+    size_t peer_items_num, const std::shared_ptr<yacl::link::Context>& lctx,
+    size_t num_threads, size_t mask_size, bool broadcast_result) {
+  ShardedOprfMap oprf_map(self_oprfs, mask_size, num_threads);
+  SPDLOG_INFO("recv rr22 oprf begin");
+  auto matches =
+      RecvAndProbe(oprf_map, peer_items_num, lctx, num_threads, mask_size);
+  auto cnt_buffer = lctx->Recv(lctx->NextRank(), fmt::format("items_cnt"));
+  auto peer_item_cnt_map = utils::DeserializeItemsCnt(cnt_buffer);
+
+  std::vector<uint32_t> self_indices(matches.size());
+  std::vector<uint32_t> peer_cnt(matches.size(), 0);
+  std::vector<uint32_t> peer_indices;
+  std::vector<uint32_t> self_cnt;
+  for (size_t i = 0; i < matches.size(); ++i) {
+    self_indices[i] = matches[i].first;
+    auto iter = peer_item_cnt_map.find(matches[i].second);
+    if (iter != peer_item_cnt_map.end()) {
+      peer_cnt[i] = iter->second;
+    }
+    if (broadcast_result) {
+      peer_indices.push_back(matches[i].second);
+      YACL_ENFORCE(matches[i].first < self_items.size(),
+                   "random str matched in result, which is not expected.");
+      self_cnt.push_back(self_items[matches[i].first].extra_dup_cnt);
+    }
+  }
   if (broadcast_result) {
     auto buffer = yacl::Buffer(peer_indices.data(),
                                peer_indices.size() * sizeof(uint32_t));
@@ -153,71 +280,16 @@ std::vector<uint32_t> GetIntersectionReceiver(
     std::vector<uint128_t> self_oprfs, size_t peer_items_num,
     const std::shared_ptr<yacl::link::Context>& lctx, size_t num_threads,
     size_t mask_size, bool broadcast_result) {
-  bool compress = mask_size != sizeof(uint128_t);
-  google::dense_hash_map<uint128_t, size_t, NoHash> dense_map(
-      self_oprfs.size());
-  dense_map.set_empty_key(yacl::MakeUint128(0, 0));
-  auto map_f = std::async([&]() {
-    auto truncate_mask = yacl::MakeUint128(0, 0);
-    if (compress) {
-      for (size_t i = 0; i < mask_size; ++i) {
-        truncate_mask = 0xff | (truncate_mask << 8);
-        SPDLOG_DEBUG(
-            "{}, truncate_mask:{}", i,
-            (std::ostringstream() << okvs::Galois128(truncate_mask)).str());
-      }
-    }
-    for (size_t i = 0; i < self_oprfs.size(); ++i) {
-      if (compress) {
-        dense_map.insert(std::make_pair(self_oprfs[i] & truncate_mask, i));
-      } else {
-        dense_map.insert(std::make_pair(self_oprfs[i], i));
-      }
-    }
-  });
+  ShardedOprfMap oprf_map(self_oprfs, mask_size, num_threads);
   SPDLOG_INFO("recv rr22 oprf begin");
-  yacl::Buffer peer_buffer(peer_items_num * mask_size);
-  size_t recv_item_count = 0;
-  while (recv_item_count < peer_items_num) {
-    auto buffer = lctx->Recv(lctx->NextRank(), fmt::format("oprf_value"));
-    std::memcpy(peer_buffer.data<uint8_t>() + (recv_item_count * mask_size),
-                buffer.data<uint8_t>(), buffer.size());
-    recv_item_count += buffer.size() / mask_size;
+  auto matches =
+      RecvAndProbe(oprf_map, peer_items_num, lctx, num_threads, mask_size);
+  std::vector<uint32_t> self_indices(matches.size());
+  std::vector<uint32_t> peer_indices(matches.size());
+  for (size_t i = 0; i < matches.size(); ++i) {
+    self_indices[i] = matches[i].first;
+    peer_indices[i] = matches[i].second;
   }
-  YACL_ENFORCE(peer_items_num == peer_buffer.size() / mask_size);
-  SPDLOG_INFO("recv rr22 oprf finished: {} vector:{}", peer_buffer.size(),
-              peer_items_num);
-  map_f.get();
-  auto* peer_data_ptr = peer_buffer.data<uint8_t>();
-  std::mutex merge_mtx;
-  std::vector<uint32_t> self_indices;
-  std::vector<uint32_t> peer_indices;
-  size_t grain_size = (peer_items_num + num_threads - 1) / num_threads;
-  yacl::parallel_for(
-      0, peer_items_num, grain_size, [&](int64_t begin, int64_t end) {
-        std::vector<uint32_t> tmp_indexs;
-        std::vector<uint32_t> tmp_peer_indexs;
-        uint128_t data = yacl::MakeUint128(0, 0);
-        for (int64_t j = begin; j < end; j++) {
-          std::memcpy(&data, peer_data_ptr + (j * mask_size), mask_size);
-          auto iter = dense_map.find(data);
-          if (iter != dense_map.end()) {
-            tmp_indexs.push_back(iter->second);
-            if (broadcast_result) {
-              tmp_peer_indexs.push_back(j);
-            }
-          }
-        }
-        if (!tmp_indexs.empty()) {
-          std::lock_guard<std::mutex> lock(merge_mtx);
-          self_indices.insert(self_indices.end(), tmp_indexs.begin(),
-                              tmp_indexs.end());
-          if (broadcast_result) {
-            peer_indices.insert(peer_indices.end(), tmp_peer_indexs.begin(),
-                                tmp_peer_indexs.end());
-          }
-        }
-      });
   if (broadcast_result) {
     auto buffer = yacl::Buffer(peer_indices.data(),
                                peer_indices.size() * sizeof(uint32_t));
@@ -231,24 +303,26 @@ std::pair<std::vector<uint32_t>, std::vector<uint32_t>> GetIntersectionSender(
     const std::vector<HashBucketCache::BucketItem>& items,
     const std::shared_ptr<yacl::link::Context>& lctx, size_t mask_size,
     bool broadcast_result) {
+  return GetIntersectionSender(
+      [&](const OprfSink& sink) {
+        auto oprfs_span = absl::MakeSpan(self_oprfs);
+        for (size_t i = 0; i < self_oprfs.size(); i += kSendChunkSize) {
+          sink(i, oprfs_span.subspan(
+                      i, std::min(kSendChunkSize, self_oprfs.size() - i)));
+        }
+      },
+      items, lctx, mask_size, broadcast_result);
+}
+
+std::pair<std::vector<uint32_t>, std::vector<uint32_t>> GetIntersectionSender(
+    const std::function<void(const OprfSink&)>& eval_f,
+    const std::vector<HashBucketCache::BucketItem>& items,
+    const std::shared_ptr<yacl::link::Context>& lctx, size_t mask_size,
+    bool broadcast_result) {
   std::vector<uint32_t> result;
-  bool compress = mask_size != sizeof(uint128_t);
-  auto truncate_mask = yacl::MakeUint128(0, 0);
-  auto* data_ptr = reinterpret_cast<std::byte*>(self_oprfs.data());
-  if (compress) {
-    for (size_t i = 0; i < mask_size; ++i) {
-      truncate_mask = 0xff | (truncate_mask << 8);
-      SPDLOG_DEBUG(
-          "{}, truncate_mask:{}", i,
-          (std::ostringstream() << okvs::Galois128(truncate_mask)).str());
-    }
-    for (size_t i = 0; i < self_oprfs.size(); ++i) {
-      std::memcpy(data_ptr + (i * mask_size), &self_oprfs[i], mask_size);
-    }
-  }
-  yacl::ByteContainerView send_buffer(data_ptr, self_oprfs.size() * mask_size);
-  lctx->SendAsyncThrottled(lctx->NextRank(), send_buffer,
-                           fmt::format("oprf_value"));
+  eval_f([&](size_t, absl::Span<uint128_t> oprfs) {
+    SendOprfChunk(oprfs, lctx, mask_size);
+  });
   std::unordered_map<uint32_t, uint32_t> self_cnt;
   for (size_t i = 0; i != items.size(); ++i) {
     if (items[i].extra_dup_cnt > 0) {
@@ -277,26 +351,7 @@ std::vector<uint32_t> GetIntersectionSender(
     const std::shared_ptr<yacl::link::Context>& lctx, size_t mask_size,
     bool broadcast_result) {
   std::vector<uint32_t> result;
-  bool compress = mask_size != sizeof(uint128_t);
-  auto truncate_mask = yacl::MakeUint128(0, 0);
-  auto* data_ptr = reinterpret_cast<std::byte*>(self_oprfs.data());
-  if (compress) {
-    for (size_t i = 0; i < mask_size; ++i) {
-      truncate_mask = 0xff | (truncate_mask << 8);
-      SPDLOG_DEBUG(
-          "{}, truncate_mask:{}", i,
-          (std::ostringstream() << okvs::Galois128(truncate_mask)).str());
-    }
-    for (size_t i = 0; i < self_oprfs.size(); ++i) {
-      std::memcpy(data_ptr + (i * mask_size), &self_oprfs[i], mask_size);
-    }
-  }
-  for (size_t i = 0; i < self_oprfs.size(); i += kSendChunkSize) {
-    yacl::ByteContainerView send_buffer(
-        data_ptr + (i * mask_size),
-        std::min<size_t>(kSendChunkSize, self_oprfs.size() - i) * mask_size);
-    lctx->Send(lctx->NextRank(), send_buffer, fmt::format("send oprf_buf"));
-  }
+  SendOprfChunked(self_oprfs, lctx, mask_size);
   if (broadcast_result) {
     auto buffer = lctx->Recv(lctx->NextRank(), "broadcast_result");
     result.resize(buffer.size() / sizeof(uint32_t));
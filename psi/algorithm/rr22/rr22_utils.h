@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -27,6 +28,10 @@ namespace psi::rr22 {
 
 constexpr size_t kSendChunkSize = 100000;
 
+// Consumes oprfs chunk by chunk: offset of the chunk, oprfs of the chunk. The
+// chunk may be modified in place.
+using OprfSink = std::function<void(size_t, absl::Span<uint128_t>)>;
+
 std::vector<uint32_t> GetIntersectionReceiver(
     std::vector<uint128_t> self_oprfs, size_t peer_items_num,
     const std::shared_ptr<yacl::link::Context>& lctx, size_t num_threads,
@@ -44,6 +49,15 @@ std::pair<std::vector<uint32_t>, std::vector<uint32_t>> GetIntersectionSender(
     const std::shared_ptr<yacl::link::Context>& lctx, size_t mask_size,
     bool broadcast_result);
 
+// Same as above, but the oprfs are produced by eval_f, which calls the sink on
+// chunks in order. Each chunk is sent once produced, so the oprfs of the
+// bucket never have to be in memory at the same time.
+std::pair<std::vector<uint32_t>, std::vector<uint32_t>> GetIntersectionSender(
+    const std::function<void(const OprfSink&)>& eval_f,
+    const std::vector<HashBucketCache::BucketItem>& items,
+    const std::shared_ptr<yacl::link::Context>& lctx, size_t mask_size,
+    bool broadcast_result);
+
 // indexes of intersection, peer_dup_cnt of each index
 std::pair<std::vector<uint32_t>, std::vector<uint32_t>> GetIntersectionReceiver(
     const std::vector<uint128_t>& self_oprfs,
@@ -14,6 +14,7 @@
 #pragma once
 
 #include "psi/algorithm/rr22/rr22_psi.h"
+#include "psi/algorithm/rr22/vole_pool.h"
 #include "psi/interface.h"
 #include "psi/utils/hash_bucket_cache.h"
 
@@ -40,6 +41,8 @@ class Rr22PsiSender final : public AbstractPsiSender {
   uint64_t bucket_count_ = 0;
 
   std::unique_ptr<HashBucketCache> input_bucket_store_;
+
+  std::shared_ptr<VolePool> vole_pool_;
 };
 
 }  // namespace psi::rr22
@@ -0,0 +1,421 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "psi/algorithm/rr22/vole_pool.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "fmt/format.h"
+#include "openssl/crypto.h"
+#include "spdlog/spdlog.h"
+#include "yacl/base/exception.h"
+
+#include "psi/utils/sync.h"
+
+namespace psi::rr22 {
+
+namespace {
+
+// "RR22VOLE" in little endian.
+constexpr uint64_t kFileMagic = 0x454c4f5632325252;
+constexpr uint32_t kFileVersion = 1;
+
+template <typename T>
+void CleanseVector(std::vector<T>* v) {
+  if (!v->empty()) {
+    OPENSSL_cleanse(v->data(), v->size() * sizeof(T));
+  }
+  v->clear();
+  v->shrink_to_fit();
+}
+
+void CleanseVole(VoleCorrelation* vole) {
+  OPENSSL_cleanse(&vole->delta, sizeof(vole->delta));
+  CleanseVector(&vole->b);
+  CleanseVector(&vole->a);
+  CleanseVector(&vole->a64);
+  CleanseVector(&vole->c);
+}
+
+void WriteAll(int fd, const void* data, size_t size,
+              const std::filesystem::path& path) {
+  const auto* ptr = static_cast<const char*>(data);
+  while (size > 0) {
+    ssize_t written = ::write(fd, ptr, size);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    YACL_ENFORCE(written > 0, "write file {} failed: {}", path.string(),
+                 std::strerror(errno));
+    ptr += written;
+    size -= written;
+  }
+}
+
+template <typename T>
+void WriteVector(int fd, const std::vector<T>& v,
+                 const std::filesystem::path& path) {
+  uint64_t size = v.size();
+  WriteAll(fd, &size, sizeof(size), path);
+  WriteAll(fd, v.data(), size * sizeof(T), path);
+}
+
+template <typename T>
+void ReadPod(std::ifstream& in, uint64_t* remaining, T* value) {
+  YACL_ENFORCE(*remaining >= sizeof(T), "vole file is truncated");
+  in.read(reinterpret_cast<char*>(value), sizeof(T));
+  *remaining -= sizeof(T);
+}
+
+template <typename T>
+void ReadVector(std::ifstream& in, uint64_t* remaining, std::vector<T>* v) {
+  uint64_t size = 0;
+  ReadPod(in, remaining, &size);
+  YACL_ENFORCE(size <= *remaining / sizeof(T),
+               "vole file is truncated, size: {}", size);
+  v->resize(size);
+  in.read(reinterpret_cast<char*>(v->data()), size * sizeof(T));
+  *remaining -= size * sizeof(T);
+}
+
+}  // namespace
+
+struct VolePool::State {
+  State(bool is_sender, Rr22PsiMode mode,
+        const yacl::crypto::CodeType& code_type, bool malicious,
+        std::filesystem::path folder)
+      : is_sender(is_sender),
+        mode(mode),
+        code_type(code_type),
+        malicious(malicious),
+        folder(std::move(folder)) {}
+
+  ~State() {
+    std::unique_lock lock(mtx);
+    while (!stored.empty()) {
+      Drop(*stored.begin());
+    }
+  }
+
+  // Whether bucket_idx is behind the buckets taken so far and won't be taken
+  // any more, e.g. an empty bucket. Requires mtx.
+  bool Passed(size_t bucket_idx) const {
+    return closed || bucket_idx + max_ahead < requested_num;
+  }
+
+  // Wipes the correlation of bucket_idx. Requires mtx.
+  void Drop(size_t bucket_idx) {
+    stored.erase(bucket_idx);
+    if (folder.empty()) {
+      auto iter = voles.find(bucket_idx);
+      if (iter != voles.end()) {
+        CleanseVole(&iter->second);
+        voles.erase(iter);
+      }
+      return;
+    }
+    std::error_code ec;
+    std::filesystem::remove(GetPath(bucket_idx), ec);
+  }
+
+  void Store(size_t bucket_idx, VoleCorrelation vole);
+
+  std::optional<VoleCorrelation> Load(size_t bucket_idx);
+
+  std::filesystem::path GetPath(size_t bucket_idx) const {
+    return folder / fmt::format("vole_{}.bin", bucket_idx);
+  }
+
+  const bool is_sender;
+  const Rr22PsiMode mode;
+  const yacl::crypto::CodeType code_type;
+  const bool malicious;
+  const std::filesystem::path folder;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  size_t bucket_num = 0;
+  size_t max_ahead = 1;
+  // number of buckets generated.
+  size_t generated_num = 0;
+  // one past the largest bucket asked for.
+  size_t requested_num = 0;
+  bool finished = false;
+  // the generation is aborted.
+  bool stopped = false;
+  // the pool is destroyed, correlations generated from now on are dropped.
+  bool closed = false;
+  // buckets generated and neither taken nor dropped.
+  std::set<size_t> stored;
+  std::map<size_t, VoleCorrelation> voles;
+};
+
+void VolePool::State::Store(size_t bucket_idx, VoleCorrelation vole) {
+  if (folder.empty()) {
+    std::unique_lock lock(mtx);
+    if (Passed(bucket_idx)) {
+      CleanseVole(&vole);
+      return;
+    }
+    voles.emplace(bucket_idx, std::move(vole));
+    stored.insert(bucket_idx);
+    return;
+  }
+
+  auto path = GetPath(bucket_idx);
+  // a file left by an earlier run is replaced, never opened.
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  YACL_ENFORCE(fd >= 0, "create file {} failed: {}", path.string(),
+               std::strerror(errno));
+  try {
+    uint8_t role = is_sender ? 1 : 0;
+    WriteAll(fd, &kFileMagic, sizeof(kFileMagic), path);
+    WriteAll(fd, &kFileVersion, sizeof(kFileVersion), path);
+    WriteAll(fd, &role, sizeof(role), path);
+    WriteAll(fd, &vole.delta, sizeof(vole.delta), path);
+    WriteVector(fd, vole.b, path);
+    WriteVector(fd, vole.a, path);
+    WriteVector(fd, vole.a64, path);
+    WriteVector(fd, vole.c, path);
+    YACL_ENFORCE(::close(fd) == 0, "close file {} failed: {}", path.string(),
+                 std::strerror(errno));
+  } catch (...) {
+    ::close(fd);
+    std::filesystem::remove(path, ec);
+    CleanseVole(&vole);
+    throw;
+  }
+  CleanseVole(&vole);
+
+  std::unique_lock lock(mtx);
+  stored.insert(bucket_idx);
+  if (Passed(bucket_idx)) {
+    Drop(bucket_idx);
+  }
+}
+
+std::optional<VoleCorrelation> VolePool::State::Load(size_t bucket_idx) {
+  VoleCorrelation vole;
+  {
+    std::unique_lock lock(mtx);
+    if (stored.erase(bucket_idx) == 0) {
+      return std::nullopt;
+    }
+    if (folder.empty()) {
+      auto iter = voles.find(bucket_idx);
+      vole = std::move(iter->second);
+      voles.erase(iter);
+      return vole;
+    }
+  }
+
+  auto path = GetPath(bucket_idx);
+  try {
+    std::ifstream in(path, std::ios::binary);
+    YACL_ENFORCE(in.is_open(), "open file {} failed", path.string());
+    uint64_t remaining = std::filesystem::file_size(path);
+    uint64_t magic = 0;
+    uint32_t version = 0;
+    uint8_t role = 0;
+    ReadPod(in, &remaining, &magic);
+    ReadPod(in, &remaining, &version);
+    ReadPod(in, &remaining, &role);
+    YACL_ENFORCE(magic == kFileMagic && version == kFileVersion,
+                 "file {} is not a vole file of version {}", path.string(),
+                 kFileVersion);
+    YACL_ENFORCE(role == (is_sender ? 1 : 0),
+                 "file {} holds the vole of the other role", path.string());
+    ReadPod(in, &remaining, &vole.delta);
+    ReadVector(in, &remaining, &vole.b);
+    ReadVector(in, &remaining, &vole.a);
+    ReadVector(in, &remaining, &vole.a64);
+    ReadVector(in, &remaining, &vole.c);
+    YACL_ENFORCE(!in.fail() && remaining == 0, "read file {} failed",
+                 path.string());
+  } catch (const std::exception& e) {
+    SPDLOG_WARN("drop vole of bucket {}: {}", bucket_idx, e.what());
+    CleanseVole(&vole);
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    return std::nullopt;
+  }
+  std::filesystem::remove(path);
+  return vole;
+}
+
+VolePool::VolePool(bool is_sender, Rr22PsiMode mode,
+                   const yacl::crypto::CodeType& code_type, bool malicious,
+                   std::filesystem::path folder)
+    : state_(std::make_shared<State>(is_sender, mode, code_type, malicious,
+                                     std::move(folder))) {
+  if (!state_->folder.empty()) {
+    std::filesystem::create_directories(state_->folder);
+  }
+}
+
+VolePool::~VolePool() {
+  if (!generate_thread_.joinable()) {
+    return;
+  }
+  bool aborted = false;
+  {
+    std::unique_lock lock(state_->mtx);
+    aborted = state_->stopped;
+    // the peer generates all buckets as well, keep in step with it but drop
+    // what nobody takes any more.
+    state_->closed = true;
+    state_->cv.notify_all();
+  }
+  if (aborted) {
+    // the thread keeps the state, and wipes it once the link gives up.
+    generate_thread_.detach();
+  } else {
+    generate_thread_.join();
+  }
+}
+
+void VolePool::StartGenerate(const std::shared_ptr<yacl::link::Context>& lctx,
+                             size_t bucket_num, size_t vole_size,
+                             size_t max_ahead, size_t begin_bucket) {
+  YACL_ENFORCE(!generate_thread_.joinable(), "vole pool is generated already");
+  YACL_ENFORCE(max_ahead > 0, "max_ahead must be positive");
+  begin_bucket = std::min(begin_bucket, bucket_num);
+  {
+    std::unique_lock lock(state_->mtx);
+    state_->bucket_num = bucket_num;
+    state_->max_ahead = max_ahead;
+    // buckets before begin_bucket are never generated nor taken.
+    state_->generated_num = begin_bucket;
+    state_->requested_num = begin_bucket;
+  }
+  generate_thread_ = std::thread(&VolePool::Generate, state_, lctx, vole_size,
+                                 begin_bucket);
+}
+
+void VolePool::Generate(const std::shared_ptr<State>& state,
+                        const std::shared_ptr<yacl::link::Context>& lctx,
+                        size_t vole_size, size_t begin_bucket) {
+  SPDLOG_INFO("generate vole of buckets [{}, {}), vole_size: {}", begin_bucket,
+              state->bucket_num, vole_size);
+  try {
+    for (size_t idx = begin_bucket; idx < state->bucket_num; ++idx) {
+      {
+        std::unique_lock lock(state->mtx);
+        state->cv.wait(lock, [&] {
+          return state->stopped || state->closed ||
+                 idx < state->requested_num + state->max_ahead;
+        });
+        if (state->stopped) {
+          break;
+        }
+      }
+      state->Store(idx, GenerateVoleCorrelation(
+                            lctx, state->is_sender, vole_size, state->mode,
+                            state->code_type, state->malicious));
+      std::unique_lock lock(state->mtx);
+      state->generated_num = idx + 1;
+      state->cv.notify_all();
+    }
+  } catch (const std::exception& e) {
+    SPDLOG_WARN("generate vole failed at bucket {}: {}", state->generated_num,
+                e.what());
+  }
+  std::unique_lock lock(state->mtx);
+  state->finished = true;
+  state->cv.notify_all();
+  SPDLOG_INFO("generate vole of buckets [{}, {}) finished", begin_bucket,
+              state->generated_num);
+}
+
+std::optional<VoleCorrelation> VolePool::Take(size_t bucket_idx,
+                                              size_t vole_size) {
+  {
+    std::unique_lock lock(state_->mtx);
+    state_->requested_num = std::max(state_->requested_num, bucket_idx + 1);
+    // frees the slots of buckets skipped, the generation moves on.
+    while (!state_->stored.empty() && state_->Passed(*state_->stored.begin())) {
+      state_->Drop(*state_->stored.begin());
+    }
+    state_->cv.notify_all();
+    state_->cv.wait(lock, [&] {
+      return state_->generated_num > bucket_idx || state_->finished;
+    });
+  }
+  auto vole = state_->Load(bucket_idx);
+  if (!vole.has_value()) {
+    return std::nullopt;
+  }
+  size_t size = state_->is_sender ? vole->b.size() : vole->c.size();
+  if (size < vole_size) {
+    SPDLOG_WARN("precomputed vole of bucket {} is too small: {} < {}",
+                bucket_idx, size, vole_size);
+    CleanseVole(&*vole);
+    return std::nullopt;
+  }
+  return vole;
+}
+
+std::optional<VoleCorrelation> VolePool::TakeAgreed(
+    const std::shared_ptr<VolePool>& pool,
+    const std::shared_ptr<yacl::link::Context>& lctx, size_t bucket_idx,
+    size_t vole_size) {
+  if (!pool) {
+    return std::nullopt;
+  }
+  auto vole = pool->Take(bucket_idx, vole_size);
+  auto usable = AllGatherItemsSize(lctx, vole.has_value() ? 1 : 0);
+  for (auto flag : usable) {
+    if (flag == 0) {
+      if (vole.has_value()) {
+        CleanseVole(&*vole);
+      }
+      return std::nullopt;
+    }
+  }
+  return vole;
+}
+
+void VolePool::Abort() {
+  std::unique_lock lock(state_->mtx);
+  state_->stopped = true;
+  state_->cv.notify_all();
+}
+
+size_t VolePool::EstimateBucketSize(size_t items_num, size_t bucket_num) {
+  if (bucket_num == 0) {
+    return 0;
+  }
+  size_t mean = (items_num + bucket_num - 1) / bucket_num;
+  // bucket sizes are about binomial, 8 standard deviations is enough.
+  return mean + 8 * static_cast<size_t>(std::ceil(std::sqrt(mean))) + 64;
+}
+
+}  // namespace psi::rr22
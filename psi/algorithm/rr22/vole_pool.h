@@ -0,0 +1,88 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <thread>
+
+#include "yacl/link/context.h"
+
+#include "psi/algorithm/rr22/rr22_oprf.h"
+
+namespace psi::rr22 {
+
+// Holds the VOLE correlations of the buckets, generated in the background
+// while the buckets are processed, so that the online phase of a bucket
+// doesn't wait for the silent VOLE. The pool runs at most max_ahead buckets
+// ahead of the last bucket taken. Correlations are kept in memory, or in
+// folder if it is not empty, in files only the owner can read. A correlation
+// is wiped once taken or dropped, it must never be used twice.
+class VolePool {
+ public:
+  // Rough memory of a correlation per item of its bucket.
+  static constexpr size_t kBytesPerItem = 48;
+
+  VolePool(bool is_sender, Rr22PsiMode mode,
+           const yacl::crypto::CodeType& code_type, bool malicious,
+           std::filesystem::path folder = {});
+
+  ~VolePool();
+
+  // Starts generating correlations of vole_size for buckets
+  // [begin_bucket, bucket_num) in order, on its own link. A resumed run
+  // begins at the first bucket not processed yet. Both parties must call it
+  // with the same arguments.
+  void StartGenerate(const std::shared_ptr<yacl::link::Context>& lctx,
+                     size_t bucket_num, size_t vole_size, size_t max_ahead,
+                     size_t begin_bucket = 0);
+
+  // Waits until the correlation of bucket_idx is generated, and returns it if
+  // it has at least vole_size entries. Returns nothing if the generation
+  // failed or the correlation was dropped, the bucket then runs the VOLE
+  // itself.
+  std::optional<VoleCorrelation> Take(size_t bucket_idx, size_t vole_size);
+
+  // Whether both parties can use their correlations of a bucket. Takes the
+  // correlation anyway, and keeps it only if the peer can use it as well.
+  static std::optional<VoleCorrelation> TakeAgreed(
+      const std::shared_ptr<VolePool>& pool,
+      const std::shared_ptr<yacl::link::Context>& lctx, size_t bucket_idx,
+      size_t vole_size);
+
+  // Stops the generation after the current bucket. Called once the protocol
+  // failed: the destructor then doesn't wait for the VOLE running, which may
+  // block until the link times out.
+  void Abort();
+
+  // Expected size of the largest bucket when items_num items are hashed into
+  // bucket_num buckets, with some slack.
+  static size_t EstimateBucketSize(size_t items_num, size_t bucket_num);
+
+ private:
+  // Shared with the generating thread, which outlives the pool if aborted.
+  struct State;
+
+  static void Generate(const std::shared_ptr<State>& state,
+                       const std::shared_ptr<yacl::link::Context>& lctx,
+                       size_t vole_size, size_t begin_bucket);
+
+  std::shared_ptr<State> state_;
+  std::thread generate_thread_;
+};
+
+}  // namespace psi::rr22
@@ -0,0 +1,277 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "psi/algorithm/rr22/vole_pool.h"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "yacl/crypto/tools/prg.h"
+#include "yacl/link/test_util.h"
+
+#include "psi/algorithm/rr22/okvs/galois128.h"
+
+namespace psi::rr22 {
+
+class VolePoolTest : public testing::TestWithParam<bool> {};
+
+TEST_P(VolePoolTest, Works) {
+  bool use_folder = GetParam();
+  auto lctxs = yacl::link::test::SetupWorld("ab", 2);
+
+  std::filesystem::path folder;
+  if (use_folder) {
+    folder = std::filesystem::temp_directory_path() /
+             ("vole_pool_test_" + std::to_string(getpid()));
+  }
+  constexpr size_t kBucketNum = 3;
+  constexpr size_t kVoleSize = 1024;
+
+  auto sender_pool = std::make_shared<VolePool>(
+      true, Rr22PsiMode::FastMode, yacl::crypto::CodeType::ExAcc7, false,
+      folder.empty() ? folder : folder / "sender");
+  auto receiver_pool = std::make_shared<VolePool>(
+      false, Rr22PsiMode::FastMode, yacl::crypto::CodeType::ExAcc7, false,
+      folder.empty() ? folder : folder / "receiver");
+  sender_pool->StartGenerate(lctxs[0]->Spawn("pool"), kBucketNum, kVoleSize,
+                             1);
+  receiver_pool->StartGenerate(lctxs[1]->Spawn("pool"), kBucketNum, kVoleSize,
+                               1);
+
+  for (size_t idx = 0; idx < kBucketNum; ++idx) {
+    // the last bucket asks for more than generated.
+    size_t vole_size = idx + 1 == kBucketNum ? kVoleSize + 1 : kVoleSize - idx;
+    auto sender_f = std::async([&] {
+      return VolePool::TakeAgreed(sender_pool, lctxs[0], idx, vole_size);
+    });
+    auto receiver_f = std::async([&] {
+      return VolePool::TakeAgreed(receiver_pool, lctxs[1], idx, vole_size);
+    });
+    auto sender_vole = sender_f.get();
+    auto receiver_vole = receiver_f.get();
+
+    if (idx + 1 == kBucketNum) {
+      EXPECT_FALSE(sender_vole.has_value());
+      EXPECT_FALSE(receiver_vole.has_value());
+      continue;
+    }
+    ASSERT_TRUE(sender_vole.has_value());
+    ASSERT_TRUE(receiver_vole.has_value());
+    ASSERT_EQ(sender_vole->b.size(), kVoleSize);
+    ASSERT_EQ(receiver_vole->a.size(), kVoleSize);
+    ASSERT_EQ(receiver_vole->c.size(), kVoleSize);
+    okvs::Galois128 delta(sender_vole->delta);
+    for (size_t i = 0; i < kVoleSize; ++i) {
+      // c + b = a * delta
+      EXPECT_EQ(receiver_vole->c[i] ^ sender_vole->b[i],
+                (delta * receiver_vole->a[i]).get<uint128_t>(0));
+    }
+    if (use_folder) {
+      EXPECT_FALSE(std::filesystem::exists(
+          folder / "sender" / fmt::format("vole_{}.bin", idx)));
+    }
+  }
+
+  sender_pool.reset();
+  receiver_pool.reset();
+  if (use_folder) {
+    EXPECT_TRUE(std::filesystem::is_empty(folder / "sender"));
+    EXPECT_TRUE(std::filesystem::is_empty(folder / "receiver"));
+    std::filesystem::remove_all(folder);
+  }
+}
+
+TEST(VolePoolTest, OprfWithPool) {
+  auto lctxs = yacl::link::test::SetupWorld("ab", 2);
+
+  size_t item_size = 1 << 12;
+  std::vector<uint128_t> values(item_size);
+  yacl::crypto::Prg<uint128_t> prng(yacl::MakeUint128(0, 0));
+  prng.Fill(absl::MakeSpan(values));
+
+  Rr22OprfSender oprf_sender(1 << 14, 40);
+  Rr22OprfReceiver oprf_receiver(1 << 14, 40);
+  // generated for a larger bucket.
+  size_t vole_size = oprf_sender.GetVoleSize(item_size * 2);
+
+  auto sender_pool = std::make_shared<VolePool>(
+      true, Rr22PsiMode::FastMode, yacl::crypto::CodeType::ExAcc7, false);
+  auto receiver_pool = std::make_shared<VolePool>(
+      false, Rr22PsiMode::FastMode, yacl::crypto::CodeType::ExAcc7, false);
+  sender_pool->StartGenerate(lctxs[0]->Spawn("pool"), 1, vole_size, 1);
+  receiver_pool->StartGenerate(lctxs[1]->Spawn("pool"), 1, vole_size, 1);
+
+  std::vector<uint128_t> oprf_a;
+  std::vector<uint128_t> oprf_b;
+  auto oprf_sender_proc = std::async([&] {
+    oprf_sender.Init(lctxs[0], item_size, 1,
+                     VolePool::TakeAgreed(sender_pool, lctxs[0], 0,
+                                          oprf_sender.GetVoleSize(item_size)));
+    auto inputs_hash = oprf_sender.Send(lctxs[0], values);
+    oprf_a = oprf_sender.Eval(values, absl::MakeSpan(inputs_hash));
+  });
+  auto oprf_receiver_proc = std::async([&] {
+    oprf_receiver.Init(
+        lctxs[1], item_size, 1,
+        VolePool::TakeAgreed(receiver_pool, lctxs[1], 0,
+                             oprf_receiver.GetVoleSize(item_size)));
+    oprf_b = oprf_receiver.Recv(lctxs[1], values);
+  });
+  oprf_sender_proc.get();
+  oprf_receiver_proc.get();
+
+  EXPECT_EQ(oprf_a, oprf_b);
+}
+
+TEST(VolePoolTest, BoundedPrivateFiles) {
+  auto lctxs = yacl::link::test::SetupWorld("ab", 2);
+  auto folder = std::filesystem::temp_directory_path() /
+                ("vole_pool_bounded_test_" + std::to_string(getpid()));
+  constexpr size_t kBucketNum = 4;
+  constexpr size_t kVoleSize = 256;
+
+  auto sender_pool = std::make_shared<VolePool>(
+      true, Rr22PsiMode::FastMode, yacl::crypto::CodeType::ExAcc7, false,
+      folder / "sender");
+  auto receiver_pool = std::make_shared<VolePool>(
+      false, Rr22PsiMode::FastMode, yacl::crypto::CodeType::ExAcc7, false,
+      folder / "receiver");
+  sender_pool->StartGenerate(lctxs[0]->Spawn("pool"), kBucketNum, kVoleSize,
+                             1);
+  receiver_pool->StartGenerate(lctxs[1]->Spawn("pool"), kBucketNum,
+                               kVoleSize, 1);
+
+  auto take = [&](size_t idx) {
+    auto sender_f = std::async([&] {
+      return VolePool::TakeAgreed(sender_pool, lctxs[0], idx, kVoleSize);
+    });
+    auto receiver_f = std::async([&] {
+      return VolePool::TakeAgreed(receiver_pool, lctxs[1], idx, kVoleSize);
+    });
+    return std::make_pair(sender_f.get(), receiver_f.get());
+  };
+  auto sender_file = [&](size_t idx) {
+    return folder / "sender" / fmt::format("vole_{}.bin", idx);
+  };
+
+  auto voles = take(0);
+  EXPECT_TRUE(voles.first.has_value());
+  EXPECT_TRUE(voles.second.has_value());
+  // one bucket ahead of bucket 0.
+  while (!std::filesystem::exists(sender_file(1))) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  EXPECT_FALSE(std::filesystem::exists(sender_file(2)));
+  EXPECT_EQ(std::filesystem::status(sender_file(1)).permissions(),
+            std::filesystem::perms::owner_read |
+                std::filesystem::perms::owner_write);
+
+  // a foreign file is rejected by both parties.
+  {
+    std::ofstream out(sender_file(1), std::ios::binary | std::ios::trunc);
+    out << "not a vole";
+  }
+  voles = take(1);
+  EXPECT_FALSE(voles.first.has_value());
+  EXPECT_FALSE(voles.second.has_value());
+
+  // bucket 2 is skipped.
+  voles = take(3);
+  EXPECT_TRUE(voles.first.has_value());
+  EXPECT_TRUE(voles.second.has_value());
+
+  sender_pool.reset();
+  receiver_pool.reset();
+  EXPECT_TRUE(std::filesystem::is_empty(folder / "sender"));
+  EXPECT_TRUE(std::filesystem::is_empty(folder / "receiver"));
+  std::filesystem::remove_all(folder);
+}
+
+TEST(VolePoolTest, BeginBucket) {
+  auto lctxs = yacl::link::test::SetupWorld("ab", 2);
+  auto folder = std::filesystem::temp_directory_path() /
+                ("vole_pool_begin_test_" + std::to_string(getpid()));
+  constexpr size_t kBucketNum = 4;
+  constexpr size_t kVoleSize = 256;
+
+  auto sender_pool = std::make_shared<VolePool>(
+      true, Rr22PsiMode::FastMode, yacl::crypto::CodeType::ExAcc7, false,
+      folder / "sender");
+  auto receiver_pool = std::make_shared<VolePool>(
+      false, Rr22PsiMode::FastMode, yacl::crypto::CodeType::ExAcc7, false,
+      folder / "receiver");
+  // a resumed run, buckets 0 and 1 are done.
+  sender_pool->StartGenerate(lctxs[0]->Spawn("pool"), kBucketNum, kVoleSize,
+                             1, 2);
+  receiver_pool->StartGenerate(lctxs[1]->Spawn("pool"), kBucketNum,
+                               kVoleSize, 1, 2);
+
+  for (size_t idx = 2; idx < kBucketNum; ++idx) {
+    auto sender_f = std::async([&] {
+      return VolePool::TakeAgreed(sender_pool, lctxs[0], idx, kVoleSize);
+    });
+    auto receiver_f = std::async([&] {
+      return VolePool::TakeAgreed(receiver_pool, lctxs[1], idx, kVoleSize);
+    });
+    EXPECT_TRUE(sender_f.get().has_value());
+    EXPECT_TRUE(receiver_f.get().has_value());
+  }
+
+  sender_pool.reset();
+  receiver_pool.reset();
+  EXPECT_TRUE(std::filesystem::is_empty(folder / "sender"));
+  EXPECT_TRUE(std::filesystem::is_empty(folder / "receiver"));
+  std::filesystem::remove_all(folder);
+
+  // nothing is left to generate, so no VOLE waits for the peer.
+  auto idle_pool = std::make_shared<VolePool>(
+      false, Rr22PsiMode::FastMode, yacl::crypto::CodeType::ExAcc7, false);
+  idle_pool->StartGenerate(lctxs[1]->Spawn("idle"), kBucketNum, kVoleSize, 1,
+                           kBucketNum);
+  auto f = std::async(std::launch::async, [&] {
+    EXPECT_FALSE(idle_pool->Take(kBucketNum - 1, kVoleSize).has_value());
+    idle_pool.reset();
+  });
+  EXPECT_EQ(f.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+}
+
+TEST(VolePoolTest, AbortDoesNotWait) {
+  auto lctxs = yacl::link::test::SetupWorld("ab", 2);
+
+  // the peer never joins, the VOLE blocks.
+  auto receiver_pool = std::make_shared<VolePool>(
+      false, Rr22PsiMode::FastMode, yacl::crypto::CodeType::ExAcc7, false);
+  receiver_pool->StartGenerate(lctxs[1]->Spawn("pool"), 2, 256, 1);
+  receiver_pool->Abort();
+
+  auto f = std::async(std::launch::async, [&] { receiver_pool.reset(); });
+  EXPECT_EQ(f.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+}
+
+INSTANTIATE_TEST_SUITE_P(VolePoolTest_Instances, VolePoolTest,
+                         testing::Values(false, true));
+
+}  // namespace psi::rr22
@@ -237,6 +237,14 @@ void RecoveryManager::UpdateParsedBucketCount(uint64_t cnt) {
   SaveCheckpointFile();
 }
 
+void RecoveryManager::UpdateBucketNum(uint64_t num) {
+  SPDLOG_INFO("RecoveryManager::UpdateBucketNum, num = {}", num);
+  checkpoint_.set_bucket_num(num);
+
+  // save checkpoint file
+  SaveCheckpointFile();
+}
+
 void RecoveryManager::MarkOnlineEnd() {
   if (checkpoint_.stage() < v2::RecoveryCheckpoint::STAGE_ONLINE_END) {
     checkpoint_.set_stage(v2::RecoveryCheckpoint::STAGE_ONLINE_END);
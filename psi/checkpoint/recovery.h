@@ -54,6 +54,8 @@ class RecoveryManager {
 
   void UpdateParsedBucketCount(uint64_t cnt);
 
+  void UpdateBucketNum(uint64_t num);
+
   void MarkOnlineEnd();
 
   void MarkPostProcessEnd();
@@ -32,82 +32,124 @@ namespace psi {
 
 namespace {
 
-std::unique_ptr<IEccCryptor> GetIppCryptor() {
+bool HasAvx512Ifma() {
 #ifdef __x86_64__
-  if (yacl::hasAVX512ifma()) {
-    SPDLOG_INFO("Using IPPCP");
-    return std::make_unique<IppEccCryptor>();
-  }
+  return yacl::hasAVX512ifma();
+#else
+  return false;
 #endif
-  return {};
-}
-
-std::unique_ptr<IEccCryptor> GetSodiumCryptor() {
-  SPDLOG_INFO("Using libSodium");
-  return std::make_unique<SodiumCurve25519Cryptor>();
 }
 
-std::unique_ptr<IEccCryptor> GetElligator2IppCryptor() {
+bool HasAvx2() {
 #ifdef __x86_64__
-  if (yacl::hasAVX512ifma()) {
-    SPDLOG_INFO("Using IPPCP elligator2");
-    return std::make_unique<IppElligator2Cryptor>();
-  }
+  return yacl::hasAVX2();
+#else
+  return false;
 #endif
-  return {};
 }
 
-std::unique_ptr<IEccCryptor> GetElligator2SodiumCryptor() {
-  SPDLOG_INFO("Using libSodium elligator2");
-  return std::make_unique<SodiumElligator2Cryptor>();
+void EnforceBackend(CurveType type, EccBackend backend, bool supported) {
+  YACL_ENFORCE(supported,
+               "ecc backend {} is not supported by curve {} on this cpu",
+               EccBackend_Name(backend), CurveType_Name(type));
 }
 
-std::unique_ptr<IEccCryptor> GetFourQCryptor() {
+std::unique_ptr<IEccCryptor> Create25519Cryptor(EccBackend backend,
+                                                bool elligator2) {
+  if (backend == EccBackend::ECC_BACKEND_AUTO) {
+    backend = HasAvx512Ifma() ? EccBackend::ECC_BACKEND_AVX512_IFMA
+                              : EccBackend::ECC_BACKEND_SCALAR;
+  }
+  switch (backend) {
 #ifdef __x86_64__
-  if (yacl::hasAVX2()) {
+    case EccBackend::ECC_BACKEND_AVX512_IFMA:
+      EnforceBackend(CurveType::CURVE_25519, backend, HasAvx512Ifma());
+      if (elligator2) {
+        SPDLOG_INFO("Using IPPCP elligator2");
+        return std::make_unique<IppElligator2Cryptor>();
+      }
+      SPDLOG_INFO("Using IPPCP");
+      return std::make_unique<IppEccCryptor>();
 #endif
-    SPDLOG_INFO("Using FourQ");
-    return std::make_unique<FourQEccCryptor>();  // fourq has an arm impl,
-                                                 // so always works on ARM
-                                                 // platform
+    case EccBackend::ECC_BACKEND_SCALAR:
+      if (elligator2) {
+        SPDLOG_INFO("Using libSodium elligator2");
+        return std::make_unique<SodiumElligator2Cryptor>();
+      }
+      SPDLOG_INFO("Using libSodium");
+      return std::make_unique<SodiumCurve25519Cryptor>();
+    default:
+      EnforceBackend(CurveType::CURVE_25519, backend, false);
+      return {};
+  }
+}
+
+std::unique_ptr<IEccCryptor> CreateFourQCryptor(EccBackend backend) {
 #ifdef __x86_64__
+  // fourq has an arm impl, so always works on ARM platform
+  EnforceBackend(CurveType::CURVE_FOURQ, backend,
+                 (backend == EccBackend::ECC_BACKEND_AUTO ||
+                  backend == EccBackend::ECC_BACKEND_AVX2) &&
+                     HasAvx2());
+#else
+  EnforceBackend(CurveType::CURVE_FOURQ, backend,
+                 backend == EccBackend::ECC_BACKEND_AUTO ||
+                     backend == EccBackend::ECC_BACKEND_SCALAR);
+#endif
+  SPDLOG_INFO("Using FourQ");
+  return std::make_unique<FourQEccCryptor>();
+}
+
+std::unique_ptr<IEccCryptor> CreateSm2Cryptor(EccBackend backend) {
+  if (backend == EccBackend::ECC_BACKEND_AUTO) {
+    backend = HasAvx512Ifma() ? EccBackend::ECC_BACKEND_AVX512_IFMA
+                              : EccBackend::ECC_BACKEND_SCALAR;
   }
+  switch (backend) {
+#ifdef __x86_64__
+    case EccBackend::ECC_BACKEND_AVX512_IFMA:
+      EnforceBackend(CurveType::CURVE_SM2, backend, HasAvx512Ifma());
+      SPDLOG_INFO("Using IPPCP SM2");
+      return std::make_unique<IppSm2Cryptor>();
 #endif
-  return {};
+    case EccBackend::ECC_BACKEND_SCALAR:
+      SPDLOG_INFO("Using SM2");
+      return std::make_unique<Sm2Cryptor>(CurveType::CURVE_SM2);
+    default:
+      EnforceBackend(CurveType::CURVE_SM2, backend, false);
+      return {};
+  }
 }
+
 }  // namespace
 
-std::unique_ptr<IEccCryptor> CreateEccCryptor(CurveType type) {
+std::unique_ptr<IEccCryptor> CreateEccCryptor(CurveType type,
+                                              EccBackend backend) {
   std::unique_ptr<IEccCryptor> cryptor;
   switch (type) {
     case CurveType::CURVE_25519: {
-      cryptor = GetIppCryptor();
-      if (cryptor == nullptr) {
-        cryptor = GetSodiumCryptor();
-      }
+      cryptor = Create25519Cryptor(backend, false);
       break;
     }
     case CurveType::CURVE_FOURQ: {
-      cryptor = GetFourQCryptor();
-      YACL_ENFORCE(cryptor != nullptr, "FourQ requires AVX2 instruction");
+      cryptor = CreateFourQCryptor(backend);
       break;
     }
     case CurveType::CURVE_SM2: {
-      SPDLOG_INFO("Using SM2");
-      cryptor = std::make_unique<Sm2Cryptor>(type);
+      cryptor = CreateSm2Cryptor(backend);
       break;
     }
     case CurveType::CURVE_SECP256K1: {
+      EnforceBackend(type, backend,
+                     backend == EccBackend::ECC_BACKEND_AUTO ||
+                         backend == EccBackend::ECC_BACKEND_SCALAR);
       SPDLOG_INFO("Using Secp256k1");
       cryptor = std::make_unique<Sm2Cryptor>(type);
       break;
     }
 
     case CURVE_25519_ELLIGATOR2: {
-      cryptor = GetElligator2IppCryptor();
-      if (cryptor == nullptr) {
-        cryptor = GetElligator2SodiumCryptor();
-      }
+      cryptor = Create25519Cryptor(backend, true);
       break;
     }
     default: {
@@ -20,6 +20,10 @@
 
 namespace psi {
 
-std::unique_ptr<IEccCryptor> CreateEccCryptor(CurveType type);
+// Creates the cryptor of `type`. With ECC_BACKEND_AUTO the fastest kernel the
+// cpu supports is picked at runtime, any other backend is enforced and throws
+// if the curve or the cpu does not support it.
+std::unique_ptr<IEccCryptor> CreateEccCryptor(
+    CurveType type, EccBackend backend = EccBackend::ECC_BACKEND_AUTO);
 
 }  // namespace psi
@@ -14,6 +14,8 @@
 
 #include "psi/cryptor/ecc_cryptor.h"
 
+#include <algorithm>
+#include <string>
 #include <vector>
 
 #include "yacl/crypto/hash/hash_utils.h"
@@ -23,13 +25,10 @@ namespace psi {
 
 std::vector<yacl::crypto::EcPoint> IEccCryptor::EccMask(
     const std::vector<yacl::crypto::EcPoint>& points) const {
-  yacl::math::MPInt sk(0, kEccKeySize * CHAR_BIT);
-  sk.FromMagBytes(private_key_, yacl::Endian::little);
-
   std::vector<yacl::crypto::EcPoint> ret(points.size());
   yacl::parallel_for(0, points.size(), [&](int64_t begin, int64_t end) {
     for (int64_t idx = begin; idx < end; ++idx) {
-      ret[idx] = this->EccMask(points.at(idx), sk);
+      ret[idx] = this->EccMask(points.at(idx), sk_);
     }
   });
   return ret;
@@ -46,12 +45,38 @@ size_t IEccCryptor::GetMaskLength() const {
   return ec_group_->GetSerializeLength();
 }
 
+std::vector<yacl::crypto::EcPoint> IEccCryptor::BatchHashToCurve(
+    absl::Span<const std::string> items) const {
+  std::vector<yacl::crypto::EcPoint> ret(items.size());
+  for (size_t idx = 0; idx < items.size(); ++idx) {
+    ret[idx] = HashToCurve(items[idx]);
+  }
+  return ret;
+}
+
 std::vector<yacl::crypto::EcPoint> IEccCryptor::HashInputs(
     const std::vector<std::string>& items) const {
   std::vector<yacl::crypto::EcPoint> ret(items.size());
   yacl::parallel_for(0, items.size(), [&](int64_t begin, int64_t end) {
-    for (int64_t idx = begin; idx < end; ++idx) {
-      ret[idx] = HashToCurve(items[idx]);
+    auto points = BatchHashToCurve(
+        absl::MakeConstSpan(items).subspan(begin, end - begin));
+    std::move(points.begin(), points.end(), ret.begin() + begin);
+  });
+  return ret;
+}
+
+std::vector<std::string> IEccCryptor::HashAndMask(
+    const std::vector<std::string>& items) const {
+  std::vector<std::string> ret(items.size());
+  yacl::parallel_for(0, items.size(), [&](int64_t begin, int64_t end) {
+    for (int64_t start = begin; start < end; start += kHashBatchSize) {
+      int64_t size = std::min<int64_t>(kHashBatchSize, end - start);
+      auto points =
+          BatchHashToCurve(absl::MakeConstSpan(items).subspan(start, size));
+      for (int64_t idx = 0; idx < size; ++idx) {
+        ret[start + idx] =
+            this->SerializeEcPoint(this->EccMask(points[idx], sk_));
+      }
     }
   });
   return ret;
@@ -79,4 +104,15 @@ std::vector<yacl::crypto::EcPoint> IEccCryptor::DeserializeEcPoints(
   return ret;
 }
 
+std::vector<yacl::crypto::EcPoint> IEccCryptor::DeserializeEcPoints(
+    const std::vector<std::string_view>& items) const {
+  std::vector<yacl::crypto::EcPoint> ret(items.size());
+  yacl::parallel_for(0, items.size(), [&](int64_t begin, int64_t end) {
+    for (int64_t idx = begin; idx < end; ++idx) {
+      ret[idx] = this->DeserializeEcPoint(items[idx]);
+    }
+  });
+  return ret;
+}
+
 }  // namespace psi
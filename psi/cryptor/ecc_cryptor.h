@@ -15,6 +15,7 @@
 #pragma once
 
 #include <array>
+#include <climits>
 #include <cstring>
 #include <memory>
 #include <string>
@@ -34,19 +35,27 @@ namespace psi {
 
 inline constexpr int kEccKeySize = 32;
 
+// Number of items handed to BatchHashToCurve at a time by HashAndMask.
+inline constexpr int64_t kHashBatchSize = 256;
+
 // Make ECDH implementation plugable.
 class IEccCryptor {
  public:
   IEccCryptor() {
     YACL_ENFORCE(RAND_bytes(private_key_.data(), kEccKeySize) == 1,
                  "Cannot create random private key");
+    UpdatePrivateKey();
   }
 
-  virtual ~IEccCryptor() { OPENSSL_cleanse(private_key_.data(), kEccKeySize); }
+  virtual ~IEccCryptor() {
+    OPENSSL_cleanse(private_key_.data(), kEccKeySize);
+    sk_.SetZero();
+  }
 
   virtual void SetPrivateKey(absl::Span<const uint8_t> key) {
     YACL_ENFORCE(key.size() == kEccKeySize);
     std::memcpy(private_key_.data(), key.data(), key.size());
+    UpdatePrivateKey();
   }
 
   /// Get current curve type
@@ -64,6 +73,11 @@ class IEccCryptor {
   virtual yacl::crypto::EcPoint HashToCurve(
       absl::Span<const char> input) const = 0;
 
+  // Perform hash on a batch of inputs. Cryptors whose hash can share work
+  // across items override it, the default hashes items one by one.
+  virtual std::vector<yacl::crypto::EcPoint> BatchHashToCurve(
+      absl::Span<const std::string> items) const;
+
   [[nodiscard]] virtual yacl::Buffer SerializeEcPoint(
       const yacl::crypto::EcPoint& point) const {
     YACL_ENFORCE(ec_group_, "not implemented");
@@ -79,18 +93,37 @@ class IEccCryptor {
   std::vector<yacl::crypto::EcPoint> HashInputs(
       const std::vector<std::string>& items) const;
 
+  // Fused HashToCurve -> EccMask -> SerializeEcPoint. Every item goes through
+  // all three steps in a single parallel pass, so no intermediate EcPoint
+  // vectors are materialised. Result equals
+  // SerializeEcPoints(EccMask(HashInputs(items))).
+  virtual std::vector<std::string> HashAndMask(
+      const std::vector<std::string>& items) const;
+
   std::vector<std::string> SerializeEcPoints(
       const std::vector<yacl::crypto::EcPoint>& points) const;
 
   std::vector<yacl::crypto::EcPoint> DeserializeEcPoints(
       const std::vector<std::string>& items) const;
 
+  std::vector<yacl::crypto::EcPoint> DeserializeEcPoints(
+      const std::vector<std::string_view>& items) const;
+
   [[nodiscard]] std::array<uint8_t, kEccKeySize> GetPrivateKey() const {
     return private_key_;
   }
 
  protected:
+  // Rebuilds the state derived from private_key_. Must be called whenever
+  // private_key_ is written directly.
+  void UpdatePrivateKey() {
+    sk_ = yacl::math::MPInt(0, kEccKeySize * CHAR_BIT);
+    sk_.FromMagBytes(private_key_, yacl::Endian::little);
+  }
+
   std::array<uint8_t, kEccKeySize> private_key_ = {};
+  // private_key_ parsed once, shared by all masking calls.
+  yacl::math::MPInt sk_;
   std::unique_ptr<yacl::crypto::EcGroup> ec_group_ = nullptr;
 };
 
@@ -14,15 +14,15 @@
 
 #include "psi/cryptor/hash_to_curve_elligator2.h"
 
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstring>
 #include <string>
-#include <utility>
 #include <vector>
 
-#include "absl/strings/escaping.h"
-#include "spdlog/spdlog.h"
+#include "yacl/base/exception.h"
 #include "yacl/crypto/hash/ssl_hash.h"
-#include "yacl/math/mpint/mp_int.h"
 
 namespace psi {
 
@@ -30,74 +30,260 @@ namespace {
 
 constexpr int kEccKeySize = 32;
 
+// Element of GF(2^255 - 19) in radix 2^51: v[0] + v[1]*2^51 + ... +
+// v[4]*2^204. Limbs are kept below 2^52 between operations, which leaves
+// enough headroom for the 128-bit products in FeMul/FeSq.
+struct Fe {
+  uint64_t v[5];
+};
+
+using uint128_t = unsigned __int128;
+
+constexpr uint64_t kMask51 = (uint64_t(1) << 51) - 1;
+
+constexpr Fe kFeZero = {{0, 0, 0, 0, 0}};
+constexpr Fe kFeOne = {{1, 0, 0, 0, 0}};
+
 // y^2 = x^3 + 486662 * x^2 + x
-// p = 2^255 - 19
-constexpr std::array<uint8_t, kEccKeySize> p_bytes = {
-    0xed, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f};
-
-// c1 = (p+3)/8
-constexpr std::array<uint8_t, kEccKeySize> c1_bytes = {
-    0xfe, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xf};
-
-// c2 = 2^c1
+constexpr uint64_t k25519J = 486662;
+
+// c2 = 2^c1, c1 = (p+3)/8, little endian
 constexpr std::array<uint8_t, kEccKeySize> c2_bytes = {
     0xb1, 0xa0, 0xe,  0x4a, 0x27, 0x1b, 0xee, 0xc4, 0x78, 0xe4, 0x2f,
     0xad, 0x6,  0x18, 0x43, 0x2f, 0xa7, 0xd7, 0xfb, 0x3d, 0x99, 0x0,
     0x4d, 0x2b, 0xb,  0xdf, 0xc1, 0x4f, 0x80, 0x24, 0x83, 0x2b};
 
-// c3 = sqrt(p-1)
+// c3 = sqrt(p-1), little endian
 constexpr std::array<uint8_t, kEccKeySize> sqrtm1_bytes = {
     0x3d, 0x5f, 0xf1, 0xb5, 0xd8, 0xe4, 0x11, 0x3b, 0x87, 0x1b, 0xd0,
     0x52, 0xf9, 0xe7, 0xbc, 0xd0, 0x58, 0x28, 0x4,  0xc2, 0x66, 0xff,
     0xb2, 0xd4, 0xf4, 0x20, 0x3e, 0xb0, 0x7f, 0xdb, 0x7c, 0x54};
 
-// c4 = (p-5)/8
-constexpr std::array<uint8_t, kEccKeySize> c4_bytes = {
-    0xfd, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xf};
+inline uint64_t Load64(const uint8_t *s) {
+  uint64_t r = 0;
+  for (int i = 7; i >= 0; --i) {
+    r = (r << 8) | s[i];
+  }
+  return r;
+}
 
-yacl::math::MPInt DeserializeMPInt(yacl::ByteContainerView buffer,
-                                   yacl::Endian endian = yacl::Endian::native) {
-  YACL_ENFORCE(buffer.size() == kEccKeySize);
-  yacl::math::MPInt mp;
+// Loads 255 bits from little endian bytes, the top bit is ignored.
+Fe FeFromBytes(const uint8_t *s) {
+  Fe h;
+  h.v[0] = Load64(s) & kMask51;
+  h.v[1] = (Load64(s + 6) >> 3) & kMask51;
+  h.v[2] = (Load64(s + 12) >> 6) & kMask51;
+  h.v[3] = (Load64(s + 19) >> 1) & kMask51;
+  h.v[4] = (Load64(s + 24) >> 12) & kMask51;
+  return h;
+}
 
-  mp.FromMagBytes(buffer, endian);
+inline void FeCarry(Fe &h) {
+  uint64_t c = h.v[0] >> 51;
+  h.v[0] &= kMask51;
+  h.v[1] += c;
+  c = h.v[1] >> 51;
+  h.v[1] &= kMask51;
+  h.v[2] += c;
+  c = h.v[2] >> 51;
+  h.v[2] &= kMask51;
+  h.v[3] += c;
+  c = h.v[3] >> 51;
+  h.v[3] &= kMask51;
+  h.v[4] += c;
+  c = h.v[4] >> 51;
+  h.v[4] &= kMask51;
+  h.v[0] += c * 19;
+}
 
-  return mp;
+// Stores the canonical value, i.e. fully reduced mod p, as little endian.
+void FeToBytes(uint8_t *s, const Fe &f) {
+  Fe h = f;
+  FeCarry(h);
+  FeCarry(h);
+  // Now h < 2^255 + small, subtract p once if h >= p.
+  uint64_t q = (h.v[0] + 19) >> 51;
+  q = (h.v[1] + q) >> 51;
+  q = (h.v[2] + q) >> 51;
+  q = (h.v[3] + q) >> 51;
+  q = (h.v[4] + q) >> 51;
+  h.v[0] += 19 * q;
+  FeCarry(h);
+  // The carry out of v[4] is exactly q and is dropped, that is -2^255.
+
+  uint64_t w0 = h.v[0] | (h.v[1] << 51);
+  uint64_t w1 = (h.v[1] >> 13) | (h.v[2] << 38);
+  uint64_t w2 = (h.v[2] >> 26) | (h.v[3] << 25);
+  uint64_t w3 = (h.v[3] >> 39) | (h.v[4] << 12);
+  for (int i = 0; i < 8; ++i) {
+    s[i] = static_cast<uint8_t>(w0 >> (8 * i));
+    s[8 + i] = static_cast<uint8_t>(w1 >> (8 * i));
+    s[16 + i] = static_cast<uint8_t>(w2 >> (8 * i));
+    s[24 + i] = static_cast<uint8_t>(w3 >> (8 * i));
+  }
 }
 
-void MPIntToBytesWithPad(unsigned char *buf, size_t buf_len,
-                         const yacl::math::MPInt &mp) {
-  YACL_ENFORCE(buf_len == kEccKeySize);
-  yacl::Buffer mpbuf = mp.ToMagBytes(yacl::Endian::big);
-  YACL_ENFORCE((size_t)(mpbuf.size()) <= buf_len, "{},{}", mpbuf.size(),
-               buf_len);
+inline Fe FeAdd(const Fe &a, const Fe &b) {
+  Fe h;
+  for (int i = 0; i < 5; ++i) {
+    h.v[i] = a.v[i] + b.v[i];
+  }
+  FeCarry(h);
+  return h;
+}
+
+// a - b computed as a + 4p - b so that no limb underflows.
+inline Fe FeSub(const Fe &a, const Fe &b) {
+  Fe h;
+  h.v[0] = a.v[0] + 0x1fffffffffffb4 - b.v[0];
+  for (int i = 1; i < 5; ++i) {
+    h.v[i] = a.v[i] + 0x1ffffffffffffc - b.v[i];
+  }
+  FeCarry(h);
+  return h;
+}
+
+inline Fe FeNeg(const Fe &a) { return FeSub(kFeZero, a); }
+
+inline Fe FeReduceProducts(uint128_t t0, uint128_t t1, uint128_t t2,
+                           uint128_t t3, uint128_t t4) {
+  Fe h;
+  t1 += static_cast<uint64_t>(t0 >> 51);
+  h.v[0] = static_cast<uint64_t>(t0) & kMask51;
+  t2 += static_cast<uint64_t>(t1 >> 51);
+  h.v[1] = static_cast<uint64_t>(t1) & kMask51;
+  t3 += static_cast<uint64_t>(t2 >> 51);
+  h.v[2] = static_cast<uint64_t>(t2) & kMask51;
+  t4 += static_cast<uint64_t>(t3 >> 51);
+  h.v[3] = static_cast<uint64_t>(t3) & kMask51;
+  h.v[0] += static_cast<uint64_t>(t4 >> 51) * 19;
+  h.v[4] = static_cast<uint64_t>(t4) & kMask51;
+  h.v[1] += h.v[0] >> 51;
+  h.v[0] &= kMask51;
+  return h;
+}
+
+Fe FeMul(const Fe &a, const Fe &b) {
+  const uint64_t b1_19 = b.v[1] * 19;
+  const uint64_t b2_19 = b.v[2] * 19;
+  const uint64_t b3_19 = b.v[3] * 19;
+  const uint64_t b4_19 = b.v[4] * 19;
+
+  uint128_t t0 = (uint128_t)a.v[0] * b.v[0] + (uint128_t)a.v[1] * b4_19 +
+                 (uint128_t)a.v[2] * b3_19 + (uint128_t)a.v[3] * b2_19 +
+                 (uint128_t)a.v[4] * b1_19;
+  uint128_t t1 = (uint128_t)a.v[0] * b.v[1] + (uint128_t)a.v[1] * b.v[0] +
+                 (uint128_t)a.v[2] * b4_19 + (uint128_t)a.v[3] * b3_19 +
+                 (uint128_t)a.v[4] * b2_19;
+  uint128_t t2 = (uint128_t)a.v[0] * b.v[2] + (uint128_t)a.v[1] * b.v[1] +
+                 (uint128_t)a.v[2] * b.v[0] + (uint128_t)a.v[3] * b4_19 +
+                 (uint128_t)a.v[4] * b3_19;
+  uint128_t t3 = (uint128_t)a.v[0] * b.v[3] + (uint128_t)a.v[1] * b.v[2] +
+                 (uint128_t)a.v[2] * b.v[1] + (uint128_t)a.v[3] * b.v[0] +
+                 (uint128_t)a.v[4] * b4_19;
+  uint128_t t4 = (uint128_t)a.v[0] * b.v[4] + (uint128_t)a.v[1] * b.v[3] +
+                 (uint128_t)a.v[2] * b.v[2] + (uint128_t)a.v[3] * b.v[1] +
+                 (uint128_t)a.v[4] * b.v[0];
+
+  return FeReduceProducts(t0, t1, t2, t3, t4);
+}
 
-  std::memcpy(buf + (kEccKeySize - mpbuf.size()), mpbuf.data(), mpbuf.size());
+Fe FeSq(const Fe &a) {
+  const uint64_t d0 = a.v[0] * 2;
+  const uint64_t d1 = a.v[1] * 2;
+  const uint64_t d2 = a.v[2] * 2 * 19;
+  const uint64_t d419 = a.v[4] * 19;
+  const uint64_t d4 = d419 * 2;
+
+  uint128_t t0 = (uint128_t)a.v[0] * a.v[0] + (uint128_t)d4 * a.v[1] +
+                 (uint128_t)d2 * a.v[3];
+  uint128_t t1 = (uint128_t)d0 * a.v[1] + (uint128_t)d4 * a.v[2] +
+                 (uint128_t)a.v[3] * (a.v[3] * 19);
+  uint128_t t2 = (uint128_t)d0 * a.v[2] + (uint128_t)a.v[1] * a.v[1] +
+                 (uint128_t)d4 * a.v[3];
+  uint128_t t3 = (uint128_t)d0 * a.v[3] + (uint128_t)d1 * a.v[2] +
+                 (uint128_t)a.v[4] * d419;
+  uint128_t t4 = (uint128_t)d0 * a.v[4] + (uint128_t)d1 * a.v[3] +
+                 (uint128_t)a.v[2] * a.v[2];
+
+  return FeReduceProducts(t0, t1, t2, t3, t4);
 }
 
-constexpr size_t k25519J = 486662;
-const yacl::math::MPInt kMp1(1);
-const yacl::math::MPInt kMp2(2);
-const yacl::math::MPInt kMp3(3);
-const yacl::math::MPInt kMp8(8);
-const yacl::math::MPInt kMp25519J(k25519J);
-const yacl::math::MPInt kMp25519 =
-    DeserializeMPInt(p_bytes, yacl::Endian::little);
-const yacl::math::MPInt kMpSqrtm1 =
-    DeserializeMPInt(sqrtm1_bytes, yacl::Endian::little);
-
-const yacl::math::MPInt kMpC1 =
-    DeserializeMPInt(c1_bytes, yacl::Endian::little);
-const yacl::math::MPInt kMpC2 =
-    DeserializeMPInt(c2_bytes, yacl::Endian::little);
-const yacl::math::MPInt kMpC4 =
-    DeserializeMPInt(c4_bytes, yacl::Endian::little);
+// a^(2^n)
+Fe FeSqN(const Fe &a, int n) {
+  Fe h = FeSq(a);
+  for (int i = 1; i < n; ++i) {
+    h = FeSq(h);
+  }
+  return h;
+}
+
+Fe FeMulSmall(const Fe &a, uint64_t b) {
+  return FeReduceProducts((uint128_t)a.v[0] * b, (uint128_t)a.v[1] * b,
+                          (uint128_t)a.v[2] * b, (uint128_t)a.v[3] * b,
+                          (uint128_t)a.v[4] * b);
+}
+
+// z^(2^250 - 1), shared by FeInvert and FePow22523. Also returns z^11 in
+// `z11`.
+Fe FePow2501(const Fe &z, Fe *z11) {
+  Fe z2 = FeSq(z);                          // 2
+  Fe z9 = FeMul(FeSqN(z2, 2), z);           // 9
+  *z11 = FeMul(z9, z2);                     // 11
+  Fe t = FeMul(FeSq(*z11), z9);             // 2^5 - 2^0
+  Fe t10 = FeMul(FeSqN(t, 5), t);           // 2^10 - 2^0
+  Fe t20 = FeMul(FeSqN(t10, 10), t10);      // 2^20 - 2^0
+  Fe t40 = FeMul(FeSqN(t20, 20), t20);      // 2^40 - 2^0
+  Fe t50 = FeMul(FeSqN(t40, 10), t10);      // 2^50 - 2^0
+  Fe t100 = FeMul(FeSqN(t50, 50), t50);     // 2^100 - 2^0
+  Fe t200 = FeMul(FeSqN(t100, 100), t100);  // 2^200 - 2^0
+  return FeMul(FeSqN(t200, 50), t50);       // 2^250 - 2^0
+}
+
+// z^(p-2), zero maps to zero.
+Fe FeInvert(const Fe &z) {
+  Fe z11;
+  Fe t = FePow2501(z, &z11);
+  return FeMul(FeSqN(t, 5), z11);  // 2^255 - 21
+}
+
+// z^((p-5)/8) = z^(2^252 - 3)
+Fe FePow22523(const Fe &z) {
+  Fe z11;
+  Fe t = FePow2501(z, &z11);
+  return FeMul(FeSqN(t, 2), z);
+}
+
+bool FeEqual(const Fe &a, const Fe &b) {
+  std::array<uint8_t, kEccKeySize> sa;
+  std::array<uint8_t, kEccKeySize> sb;
+  FeToBytes(sa.data(), a);
+  FeToBytes(sb.data(), b);
+  return sa == sb;
+}
+
+bool FeIsZero(const Fe &a) { return FeEqual(a, kFeZero); }
+
+// RFC9380 4.1 sgn0 for m = 1
+bool FeSgn0(const Fe &a) {
+  std::array<uint8_t, kEccKeySize> s;
+  FeToBytes(s.data(), a);
+  return (s[0] & 1) != 0;
+}
+
+inline Fe FeSelect(const Fe &a, const Fe &b, bool choose_b) {
+  return choose_b ? b : a;
+}
+
+const Fe kFeSqrtm1 = FeFromBytes(sqrtm1_bytes.data());
+const Fe kFeC2 = FeFromBytes(c2_bytes.data());
+const Fe kFeJ = {{k25519J, 0, 0, 0, 0}};
+
+// Curve25519 x-only projective point (X : Z).
+struct ProjectiveX {
+  Fe x;
+  Fe z;
+};
 
 // rfc8017 4.1 I2OSP
 // I2OSP - Integer-to-Octet-String primitive
@@ -187,521 +373,181 @@ std::vector<uint8_t> ExpandMessageXmd(yacl::ByteContainerView msg,
   return ret;
 }
 
-// RFC9380 5.2.  hash_to_field Implementation
-std::vector<std::vector<uint8_t>> HashToField(yacl::ByteContainerView msg,
-                                              size_t count,
-                                              const std::string &dst) {
-  size_t L = std::ceil(static_cast<double>(256 + 128) / 8);
-
-  size_t len_in_bytes = count * L;
-
-  std::vector<uint8_t> uniform_bytes = ExpandMessageXmd(msg, dst, len_in_bytes);
-
-  std::vector<std::vector<uint8_t>> ret(count);
-
-  for (size_t i = 0; i < count; ++i) {
-    size_t elm_offset = L * i;
-    absl::Span<uint8_t> data = absl::MakeSpan(&uniform_bytes[elm_offset], L);
-
-    yacl::math::MPInt e_j;
-    e_j.FromMagBytes(data, yacl::Endian::big);
-
-    yacl::math::MPInt e_jp = e_j.Mod(kMp25519);
-
-    ret[i].resize(kEccKeySize);
-    MPIntToBytesWithPad(ret[i].data(), kEccKeySize, e_jp);
-  }
-
-  return ret;
-}
-
-bool IsSquare(const yacl::math::MPInt &v, const yacl::math::MPInt &mod) {
-  yacl::math::MPInt t1 = mod.SubMod(kMp1, mod);  // mod - 1
-  yacl::math::MPInt t2;
-  yacl::math::MPInt::InvertMod(kMp2, mod, &t2);  // inverse 2
-
-  yacl::math::MPInt t3 = t1.MulMod(t2, mod);  // (q-1)/2
-  yacl::math::MPInt t4 = v.PowMod(t3, mod);   // x^((q-1)/2)
-
-  if (t4.IsOne() || t4.IsZero()) {
-    return true;
-  }
-  return false;
-}
-
-// RFC9380 I.2 sqrt for q = 5 (mod 8)
-yacl::math::MPInt Curve25519Sqrt(const yacl::math::MPInt &v,
-                                 const yacl::math::MPInt &mod) {
-  yacl::math::MPInt c2;
-  yacl::math::MPInt::Add(mod, kMp3, &c2);
-  yacl::math::MPInt c;
-  yacl::math::MPInt d;
-  yacl::math::MPInt::Div(c2, kMp8, &c, &d);
-  c2 = c;
-
-  yacl::math::MPInt tv1 = v.PowMod(c2, mod);
-  yacl::math::MPInt tv2 = tv1.MulMod(kMpSqrtm1, mod);
-
-  c = tv1.MulMod(tv1, mod);
-  if (c == v) {
-    return tv1;
-  }
-  return tv2;
-}
-
-bool Curve25519Sgn0(const yacl::math::MPInt &v) {
-  yacl::math::MPInt c;
-  yacl::math::MPInt d;
-  yacl::math::MPInt::Div(v, kMp2, &c, &d);
-
-  bool ret = 1;
-  if (d.IsZero()) {
-    ret = 0;
-  }
-
-  return ret;
-}
-
-// RFC9380 G.2.  Elligator 2 Method  map_to_curve_elligator2
-[[maybe_unused]] std::pair<std::vector<uint8_t>, std::vector<uint8_t>>
-MapToCurveG2(yacl::ByteContainerView ubuf) {
-  YACL_ENFORCE(ubuf.size() > 0);
-
-  yacl::math::MPInt u;
-  u.FromMagBytes(ubuf, yacl::Endian::big);
-
-  yacl::math::MPInt tv1;
-  yacl::math::MPInt::MulMod(u, u, kMp25519, &tv1);  // 1. tv1 = u^2
-
-  tv1 = tv1.MulMod(kMp2, kMp25519);  // 2. tv1 = 2*tv1
-
-  yacl::math::MPInt xd;
-  yacl::math::MPInt::AddMod(tv1, kMp1, kMp25519, &xd);  // 3. xd = tv1 + 1
-
-  yacl::math::MPInt x1n = kMp25519J;
-  x1n.NegateInplace();  // 4. x1n = -J
-
-  yacl::math::MPInt tv2;
-  yacl::math::MPInt::MulMod(xd, xd, kMp25519, &tv2);  // 5. tv2 = xd^2
-
-  yacl::math::MPInt gxd;
-  yacl::math::MPInt::MulMod(tv2, xd, kMp25519, &gxd);  // 6. gxd = xd^3
-
-  yacl::math::MPInt gx1;
-  yacl::math::MPInt::MulMod(kMp25519J, tv1, kMp25519,
-                            &gx1);  // 7. gx1 = J * tv1
-
-  gx1 = gx1.MulMod(x1n, kMp25519);  // 8. gx1 = gx1 * x1n
-  gx1 = gx1.AddMod(tv2, kMp25519);  // 9. gx1 = gx1 + tv2
-  gx1 = gx1.MulMod(x1n, kMp25519);  // 10. gx1 = gx1 * x1n
-
-  yacl::math::MPInt tv3;
-  yacl::math::MPInt::MulMod(gxd, gxd, kMp25519, &tv3);  // 11. tv3 = gxd^2
-
-  yacl::math::MPInt::MulMod(tv3, tv3, kMp25519, &tv2);  // 12. tv2 = tv3^2
-
-  tv3 = tv3.MulMod(gxd, kMp25519);  // 13. tv3 = tv3 * gxd
-  tv3 = tv3.MulMod(gx1, kMp25519);  // 14. tv3 = tv3 * gx1
-  tv2 = tv2.MulMod(tv3, kMp25519);  // 15. tv2 = tv2 * tv3
-
-  yacl::math::MPInt y11;
-  yacl::math::MPInt::PowMod(tv2, kMpC4, kMp25519, &y11);  // 16. y11 = tv2^c4
-  y11 = y11.MulMod(tv3, kMp25519);                        // 17. y11 = y11 * tv3
-
-  yacl::math::MPInt y12 =
-      y11.MulMod(kMpSqrtm1, kMp25519);                  // 18. y12 = y11 * c3
-  yacl::math::MPInt::MulMod(y11, y11, kMp25519, &tv2);  // 19. tv2 = y11^2
-
-  tv2 = tv2.MulMod(gxd, kMp25519);  // 20. tv2 = tv2 * gxd
-  bool e1 = (tv2 == gx1);           // 21. e1 = tv2 == gx1
-
-  yacl::math::MPInt y1;  // 22. y1 = CMOV(y12, y11, e1)
-  if (e1) {
-    y1 = y11;
-  } else {
-    y1 = y12;
-  }
-
-  yacl::math::MPInt x2n = x1n.MulMod(tv1, kMp25519);  // 23. x2n = x1n * tv1
-  yacl::math::MPInt y21 = y11.MulMod(u, kMp25519);    // 24. y21 = y11 * u
-  y21 = y21.MulMod(kMpC2, kMp25519);                  // 25. y21 = y21 * c2
-  yacl::math::MPInt y22 =
-      y21.MulMod(kMpSqrtm1, kMp25519);                // 26. y22 = y21 * c3
-  yacl::math::MPInt gx2 = gx1.MulMod(tv1, kMp25519);  // 27. gx2 = gx1 * tv1
-
-  yacl::math::MPInt::MulMod(y21, y21, kMp25519, &tv2);  // 28. tv2 = y21^2
-  tv2 = tv2.MulMod(gxd, kMp25519);                      // 29. tv2 = tv2 * gxd
-
-  bool e2 = (tv2 == gx2);  // 30. e2 = tv2 == gx2
-  yacl::math::MPInt y2;    // 31. y2 = CMOV(y22, y21, e2)
-  if (e2) {
-    y2 = y21;
-  } else {
-    y2 = y22;
-  }
-  yacl::math::MPInt::MulMod(y1, y1, kMp25519, &tv2);  // 32. tv2 = y1^2
-  tv2 = tv2.MulMod(gxd, kMp25519);                    // 33. tv2 = tv2 * gxd
-
-  bool e3 = (tv2 == gx1);  // 34. e3 = tv2 == gx1
-
-  yacl::math::MPInt xn;  // 35. xn = CMOV(x2n, x1n, e3)
-  yacl::math::MPInt y;   // 36. y = CMOV(y2, y1, e3)
-  if (e3) {
-    xn = x1n;
-    y = y1;
-  } else {
-    xn = x2n;
-    y = y2;
-  }
-
-  bool e4 = Curve25519Sgn0(y) == 1;  // 37. e4 = sgn0(y)==1
-
-  if (e3 ^ e4) {
-    y.NegateInplace();
-  }
-  if (y.IsNegative()) {
-    y = y.AddMod(kMp25519, kMp25519);
-  }
-  yacl::math::MPInt xd1;
-  yacl::math::MPInt::InvertMod(xd, kMp25519, &xd1);
-  xn = xn.MulMod(xd1, kMp25519);
-
-  std::vector<uint8_t> xvec(kEccKeySize);
-  std::vector<uint8_t> yvec(kEccKeySize);
-
-  MPIntToBytesWithPad(xvec.data(), xvec.size(), xn);
-  MPIntToBytesWithPad(yvec.data(), yvec.size(), y);
-
-  return std::make_pair(xvec, yvec);
-}
-
-// RFC9380 F.3.  Elligator 2 Method  map_to_curve_elligator2
-[[maybe_unused]] std::pair<std::vector<uint8_t>, std::vector<uint8_t>>
-MapToCurveElligator2(yacl::ByteContainerView ubuf) {
-  size_t J = k25519J;
-
-  // size_t K = 1;
-  //  Z: 2
-  yacl::math::MPInt Z(2);
-  // h_eff: 8
-  // c1 = J / K
-  // c2 = 1 / K^2
-  yacl::math::MPInt c1(J);
-  yacl::math::MPInt c2(1);
-
-  yacl::math::MPInt u;
-  u.FromMagBytes(ubuf, yacl::Endian::big);
-
-  yacl::math::MPInt tmp;
-  yacl::math::MPInt neg1(1);
-  neg1.NegateInplace();
-
-  yacl::math::MPInt tv1;
-  yacl::math::MPInt::MulMod(u, u, kMp25519, &tv1);  // tv1 = u^2
-
-  yacl::math::MPInt::MulMod(tv1, Z, kMp25519, &tmp);  // tv1 = Z * tv1
-  tv1 = tmp;
-
-  if (tv1 == neg1) {  // # if tv1 == -1, set tv1 = 0
-    tv1 = yacl::math::MPInt(0);
-  }
-  yacl::math::MPInt x2 = tv1.AddMod(kMp1, kMp25519);
-  yacl::math::MPInt x1 = x2.InvertMod(kMp25519);
-  yacl::math::MPInt neg_c1;
-  c1.Negate(&neg_c1);
-
-  x2 = x1;
-  x1 = x2.MulMod(neg_c1, kMp25519);  // x1 = -c1 * x1;
-
-  yacl::math::MPInt gx1 = x1.AddMod(c1, kMp25519);  // gx1 = x1 + c1
-  x2 = gx1;
-
-  gx1 = x2.MulMod(x1, kMp25519);  // gx1 = gx1 * x1
-  x2 = gx1;
-  gx1 = gx1.AddMod(c2, kMp25519);  // gx1 = gx1 + c2
-  x2 = gx1;
-  gx1 = x2.MulMod(x1, kMp25519);  // gx1 = gx1 + c2
-  yacl::math::MPInt neg_x1;
-  x1.Negate(&neg_x1);
-
-  x2 = neg_x1.AddMod(neg_c1, kMp25519);  // x2 = -x1 - c1;
-
-  tmp = gx1;
-  yacl::math::MPInt gx2 = tmp.MulMod(tv1, kMp25519);  // gx2 = tv1 * gx1
-  bool e2 = IsSquare(gx1, kMp25519);
-
-  yacl::math::MPInt xmp;
-
-  yacl::math::MPInt y2;
-  if (e2) {
-    xmp = x1;
-    y2 = gx1;
-  } else {
-    xmp = x2;
-    y2 = gx2;
-  }
-
-  yacl::math::MPInt ymp = Curve25519Sqrt(y2, kMp25519);  // y = sqrt(y2)
-
-  bool e3 = Curve25519Sgn0(ymp);
-
-  if (e2 ^ e3) {
-    ymp.NegateInplace();
-    if (ymp.IsNegative()) {
-      ymp = ymp.AddMod(kMp25519, kMp25519);
+// RFC9380 5.2.  hash_to_field Implementation, count = 2
+std::array<Fe, 2> HashToField(yacl::ByteContainerView msg,
+                              const std::string &dst) {
+  constexpr size_t L = (256 + 128 + 7) / 8;
+
+  std::vector<uint8_t> uniform_bytes = ExpandMessageXmd(msg, dst, 2 * L);
+
+  std::array<Fe, 2> ret;
+  for (size_t i = 0; i < 2; ++i) {
+    // e = hi * 2^256 + lo, and 2^256 = 38 mod p.
+    std::array<uint8_t, kEccKeySize> lo = {};
+    std::array<uint8_t, kEccKeySize> hi = {};
+    const uint8_t *data = &uniform_bytes[L * i];
+    for (size_t j = 0; j < L - kEccKeySize; ++j) {
+      hi[j] = data[L - kEccKeySize - 1 - j];
+    }
+    for (size_t j = 0; j < kEccKeySize; ++j) {
+      lo[j] = data[L - 1 - j];
     }
+    Fe e = FeFromBytes(lo.data());
+    // The top bit of lo is 2^255 = 19 mod p.
+    e.v[0] += 19 * (lo[kEccKeySize - 1] >> 7);
+    ret[i] = FeAdd(e, FeMulSmall(FeFromBytes(hi.data()), 38));
   }
 
-  std::vector<uint8_t> xvec(kEccKeySize);
-  std::vector<uint8_t> yvec(kEccKeySize);
-
-  MPIntToBytesWithPad(xvec.data(), kEccKeySize, xmp);
-  MPIntToBytesWithPad(yvec.data(), kEccKeySize, ymp);
-
-  return std::make_pair(xvec, yvec);
+  return ret;
 }
 
-inline yacl::math::MPInt ToMpInt(yacl::ByteContainerView msgx) {
-  yacl::math::MPInt mp_u;
-  mp_u.FromMagBytes(msgx, yacl::Endian::big);
-
-  return mp_u;
+// RFC9380 G.2.  Elligator 2 Method  map_to_curve_elligator2_curve25519
+// Returns the affine point as (xn / xd, y).
+void MapToCurveG2(const Fe &u, Fe *xn, Fe *xd, Fe *y) {
+  Fe tv1 = FeSq(u);                       // 1. tv1 = u^2
+  tv1 = FeAdd(tv1, tv1);                  // 2. tv1 = 2 * tv1
+  *xd = FeAdd(tv1, kFeOne);               // 3. xd = tv1 + 1
+  Fe x1n = FeNeg(kFeJ);                   // 4. x1n = -J
+  Fe tv2 = FeSq(*xd);                     // 5. tv2 = xd^2
+  Fe gxd = FeMul(tv2, *xd);               // 6. gxd = tv2 * xd
+  Fe gx1 = FeMulSmall(tv1, k25519J);      // 7. gx1 = J * tv1
+  gx1 = FeMul(gx1, x1n);                  // 8. gx1 = gx1 * x1n
+  gx1 = FeAdd(gx1, tv2);                  // 9. gx1 = gx1 + tv2
+  gx1 = FeMul(gx1, x1n);                  // 10. gx1 = gx1 * x1n
+  Fe tv3 = FeSq(gxd);                     // 11. tv3 = gxd^2
+  tv2 = FeSq(tv3);                        // 12. tv2 = tv3^2
+  tv3 = FeMul(tv3, gxd);                  // 13. tv3 = tv3 * gxd
+  tv3 = FeMul(tv3, gx1);                  // 14. tv3 = tv3 * gx1
+  tv2 = FeMul(tv2, tv3);                  // 15. tv2 = tv2 * tv3
+  Fe y11 = FePow22523(tv2);               // 16. y11 = tv2^c4
+  y11 = FeMul(y11, tv3);                  // 17. y11 = y11 * tv3
+  Fe y12 = FeMul(y11, kFeSqrtm1);         // 18. y12 = y11 * c3
+  tv2 = FeMul(FeSq(y11), gxd);            // 19-20. tv2 = y11^2 * gxd
+  bool e1 = FeEqual(tv2, gx1);            // 21. e1 = tv2 == gx1
+  Fe y1 = FeSelect(y12, y11, e1);         // 22. y1 = CMOV(y12, y11, e1)
+  Fe x2n = FeMul(x1n, tv1);               // 23. x2n = x1n * tv1
+  Fe y21 = FeMul(y11, u);                 // 24. y21 = y11 * u
+  y21 = FeMul(y21, kFeC2);                // 25. y21 = y21 * c2
+  Fe y22 = FeMul(y21, kFeSqrtm1);         // 26. y22 = y21 * c3
+  Fe gx2 = FeMul(gx1, tv1);               // 27. gx2 = gx1 * tv1
+  tv2 = FeMul(FeSq(y21), gxd);            // 28-29. tv2 = y21^2 * gxd
+  bool e2 = FeEqual(tv2, gx2);            // 30. e2 = tv2 == gx2
+  Fe y2 = FeSelect(y22, y21, e2);         // 31. y2 = CMOV(y22, y21, e2)
+  tv2 = FeMul(FeSq(y1), gxd);             // 32-33. tv2 = y1^2 * gxd
+  bool e3 = FeEqual(tv2, gx1);            // 34. e3 = tv2 == gx1
+  *xn = FeSelect(x2n, x1n, e3);           // 35. xn = CMOV(x2n, x1n, e3)
+  *y = FeSelect(y2, y1, e3);              // 36. y = CMOV(y2, y1, e3)
+  bool e4 = FeSgn0(*y);                   // 37. e4 = sgn0(y) == 1
+  *y = FeSelect(*y, FeNeg(*y), e3 ^ e4);  // 38. y = CMOV(y, -y, e3 XOR e4)
 }
 
 // https://martin.kleppmann.com/papers/curve25519.pdf
-// 4.2 P18  affine coordinates point add
-[[maybe_unused]] std::pair<std::vector<uint8_t>, std::vector<uint8_t>> PointAdd(
-    yacl::ByteContainerView pxbuf, yacl::ByteContainerView pybuf,
-    yacl::ByteContainerView qxbuf, yacl::ByteContainerView qybuf) {
-  YACL_ENFORCE((std::memcmp(pxbuf.data(), qxbuf.data(), pxbuf.size()) != 0) ||
-               (std::memcmp(pybuf.data(), qybuf.data(), pybuf.size()) != 0));
-
-  yacl::math::MPInt px = ToMpInt(pxbuf);
-  yacl::math::MPInt py = ToMpInt(pybuf);
-  yacl::math::MPInt qx = ToMpInt(qxbuf);
-  yacl::math::MPInt qy = ToMpInt(qybuf);
-
-  // lambda = (y2-y1)/(x2-x2)
-  yacl::math::MPInt s1 = qx.SubMod(px, kMp25519);  //  x2-x1
-  yacl::math::MPInt s2 = qy.SubMod(py, kMp25519);  // y2-y1
-
-  yacl::math::MPInt d = s1.InvertMod(kMp25519);
-  yacl::math::MPInt l = s2.MulMod(d, kMp25519);  // (y2-y1)/(x2-x1)
-
-  yacl::math::MPInt l2 = l.MulMod(l, kMp25519);  // (y2-y1)/(x2-x1) ^2
-
-  // x coordinate
-  yacl::math::MPInt t1 =
-      l2.SubMod(kMp25519J, kMp25519);  // (y2-y1)/(x2-x1) ^2-A-x1-x2
-  yacl::math::MPInt t2 = t1.SubMod(px, kMp25519);
-  yacl::math::MPInt tx = t2.SubMod(qx, kMp25519);
-  if (tx.IsNegative()) {
-    tx = tx.AddMod(kMp25519, kMp25519);
-  }
-
-  // y coordinate
-  yacl::math::MPInt l3 = l2.MulMod(l, kMp25519);  // (y2-y1)/(x2-x1) ^3
-  t1 = px.MulMod(kMp2, kMp25519);                 // 2*x1
-  t2 = t1.AddMod(qx, kMp25519);                   // 2*x1 + x2
-  t1 = t2.AddMod(kMp25519J, kMp25519);            // 2*x1 + x2 + A
-  t2 = t1.MulMod(l, kMp25519);                    // (2*x1 + x2 + A) * lambda
-  t1 = t2.SubMod(l3, kMp25519);  // (2*x1 + x2 + A) * lambda - labmba^3
-  yacl::math::MPInt ty =
-      t1.SubMod(py, kMp25519);  // (2*x1 + x2 + A) * lambda - labmba^3 -y1
-
-  if (ty.IsNegative()) {
-    ty = ty.AddMod(kMp25519, kMp25519);
-  }
-
-  std::vector<uint8_t> xbuf(kEccKeySize);
-  std::vector<uint8_t> ybuf(kEccKeySize);
-
-  MPIntToBytesWithPad(xbuf.data(), kEccKeySize, tx);
-  MPIntToBytesWithPad(ybuf.data(), kEccKeySize, ty);
-
-  return std::make_pair(xbuf, ybuf);
-}
-
-// point add return x coordinate
-[[maybe_unused]] yacl::crypto::Array32 PointAddX(
-    yacl::ByteContainerView pxbuf, yacl::ByteContainerView pybuf,
-    yacl::ByteContainerView qxbuf, yacl::ByteContainerView qybuf) {
-  YACL_ENFORCE((std::memcmp(pxbuf.data(), qxbuf.data(), pxbuf.size()) != 0) ||
-               (std::memcmp(pybuf.data(), qybuf.data(), pybuf.size()) != 0));
-
-  yacl::math::MPInt px = ToMpInt(pxbuf);
-  yacl::math::MPInt py = ToMpInt(pybuf);
-  yacl::math::MPInt qx = ToMpInt(qxbuf);
-  yacl::math::MPInt qy = ToMpInt(qybuf);
-
-  // lambda = (y2-y1)/(x2-x2)
-  yacl::math::MPInt s1 = qx.SubMod(px, kMp25519);  // x2-x1
-  yacl::math::MPInt s2 = qy.SubMod(py, kMp25519);  // y2-y1
-
-  yacl::math::MPInt d = s1.InvertMod(kMp25519);  // 1/(x2-x1)
-  yacl::math::MPInt l = s2.MulMod(d, kMp25519);  // (y2-y1)/(x2-x1)
-
-  // x coordinate
-  yacl::math::MPInt l2 = l.MulMod(l, kMp25519);  // (y2-y1)/(x2-x1) ^2
-
-  yacl::math::MPInt t1 =
-      l2.SubMod(kMp25519J, kMp25519);  // (y2-y1)/(x2-x1) ^2-A-x1-x2
-  yacl::math::MPInt t2 = t1.SubMod(px, kMp25519);
-  yacl::math::MPInt tx = t2.SubMod(qx, kMp25519);
-  if (tx.IsNegative()) {
-    tx = tx.AddMod(kMp25519, kMp25519);
-  }
-
-  yacl::crypto::Array32 xbuf = {0};
-
-  MPIntToBytesWithPad(xbuf.data(), xbuf.size(), tx);
-
-  return xbuf;
-}
-
-// affine coordinates point double
-[[maybe_unused]] std::pair<std::vector<uint8_t>, std::vector<uint8_t>> PointDbl(
-    yacl::ByteContainerView pxbuf, yacl::ByteContainerView pybuf) {
-  yacl::math::MPInt px = ToMpInt(pxbuf);
-  yacl::math::MPInt py = ToMpInt(pybuf);
-
-  yacl::math::MPInt px2 = px.MulMod(px, kMp25519);     // x^2
-  yacl::math::MPInt px3 = px2.MulMod(kMp3, kMp25519);  // 3*x^2
-
-  yacl::math::MPInt ax = px.MulMod(kMp25519J, kMp25519);  // x*A
-  yacl::math::MPInt ax2 = ax.MulMod(kMp2, kMp25519);      // 2*x*A
-
-  px2 = px3.AddMod(ax2, kMp25519);  // 3*x^2 + 2*x*A
-  ax = px2.AddMod(kMp1, kMp25519);  // 3*x^2 + 2*x*A +1
-
-  yacl::math::MPInt y2 = py.MulMod(kMp2, kMp25519);  // 2*y
-
-  yacl::math::MPInt d = y2.InvertMod(kMp25519);
-
-  yacl::math::MPInt l = ax.MulMod(d, kMp25519);  // 3*x^2 + 2*x*A +1 / 2*y
-
-  yacl::math::MPInt l2 = l.PowMod(kMp2, kMp25519);  // lambda^2
-  yacl::math::MPInt l3 = l.PowMod(kMp3, kMp25519);  // lambda^3
-
-  yacl::math::MPInt xt1 = l2.SubMod(kMp25519J, kMp25519);  // lambda^2-A
-  yacl::math::MPInt x2 = px.MulMod(kMp2, kMp25519);        // 2*x
-  yacl::math::MPInt tx = xt1.SubMod(x2, kMp25519);         // lambda^2-A-2*x
-
-  yacl::math::MPInt x3 = px.MulMod(kMp3, kMp25519);
-  xt1 = x3.AddMod(kMp25519J, kMp25519);
-  d = xt1.MulMod(l, kMp25519);
-
-  xt1 = d.SubMod(l3, kMp25519);
-  yacl::math::MPInt ty = xt1.SubMod(py, kMp25519);
-
-  std::vector<uint8_t> xbuf(kEccKeySize);
-  std::vector<uint8_t> ybuf(kEccKeySize);
-
-  MPIntToBytesWithPad(xbuf.data(), kEccKeySize, tx);
-  MPIntToBytesWithPad(ybuf.data(), kEccKeySize, ty);
-
-  return std::make_pair(xbuf, ybuf);
+// 4.2 P18  affine coordinates point add, x coordinate only:
+//   lambda = (y1 - y0) / (x1 - x0)
+//   x = lambda^2 - A - x0 - x1
+// with x0 = xn0 / xd0 and x1 = xn1 / xd1 the result is kept projective.
+ProjectiveX PointAddX(const Fe &xn0, const Fe &xd0, const Fe &y0,
+                      const Fe &xn1, const Fe &xd1, const Fe &y1) {
+  Fe xd01 = FeMul(xd0, xd1);
+  Fe n = FeMul(FeSub(y1, y0), xd01);
+  Fe d = FeSub(FeMul(xn1, xd0), FeMul(xn0, xd1));
+  Fe d2 = FeSq(d);
+
+  Fe sum = FeAdd(FeAdd(FeMulSmall(xd01, k25519J), FeMul(xn0, xd1)),
+                 FeMul(xn1, xd0));
+  ProjectiveX r;
+  r.x = FeSub(FeMul(FeSq(n), xd01), FeMul(sum, d2));
+  r.z = FeMul(d2, xd01);
+  return r;
 }
 
 // https://martin.kleppmann.com/papers/curve25519.pdf
 // Projective formulas for point doubling
 // 4.4 P23 formulas 25
-[[maybe_unused]] yacl::crypto::Array32 PointDblProjective(
-    yacl::ByteContainerView pxbuf) {
-  yacl::math::MPInt px = ToMpInt(pxbuf);
-
-  yacl::math::MPInt px2 = px.MulMod(px, kMp25519);       // px2 = px^2
-  yacl::math::MPInt px21 = px2.SubMod(kMp1, kMp25519);   // px21 = px^2-1
-  yacl::math::MPInt px22 = px21.MulMod(px21, kMp25519);  // px22 = px21^2
-
-  yacl::math::MPInt pxa = px.MulMod(kMp25519J, kMp25519);  // A*X
-  yacl::math::MPInt pz1 =
-      px2.AddMod(pxa, kMp25519).AddMod(kMp1, kMp25519);  // x^2+Axz+z^2
-  yacl::math::MPInt pz2 = pz1.MulMod(px, kMp25519);      // x*(x^2+Axz+z^2)
-
-  pz1 = pz2.MulMod(yacl::math::MPInt(4), kMp25519);
-
-  yacl::math::MPInt::InvertMod(pz1, kMp25519, &pz2);
-
-  px = px22.MulMod(pz2, kMp25519);
-
-  yacl::crypto::Array32 xbuf = {0};
-
-  MPIntToBytesWithPad(xbuf.data(), xbuf.size(), px);
-
-  return xbuf;
+ProjectiveX PointDblProjective(const ProjectiveX &p) {
+  Fe xx = FeSq(p.x);
+  Fe zz = FeSq(p.z);
+  Fe xz = FeMul(p.x, p.z);
+  ProjectiveX r;
+  r.x = FeSq(FeSub(xx, zz));  // (X^2 - Z^2)^2
+  r.z = FeMulSmall(FeMul(xz, FeAdd(FeAdd(xx, FeMulSmall(xz, k25519J)), zz)),
+                   4);  // 4XZ(X^2 + AXZ + Z^2)
+  return r;
 }
 
-[[maybe_unused]] yacl::crypto::Array32 PointClearCofactorProjective(
-    yacl::ByteContainerView pxbuf) {
-  // [2]P
-  auto x2buf = PointDblProjective(pxbuf);
-  // [4]P
-  auto x4buf = PointDblProjective(x2buf);
+ProjectiveX PointClearCofactorProjective(const ProjectiveX &p) {
   // [8]P
-  auto x8buf = PointDblProjective(x4buf);
-
-  return x8buf;
+  return PointDblProjective(PointDblProjective(PointDblProjective(p)));
 }
 
-[[maybe_unused]] std::pair<std::vector<uint8_t>, std::vector<uint8_t>>
-PointClearCofactor(yacl::ByteContainerView pxbuf,
-                   yacl::ByteContainerView pybuf) {
-  // [2]P
-  std::vector<uint8_t> x2buf(kEccKeySize);
-  std::vector<uint8_t> y2buf(kEccKeySize);
-  std::tie(x2buf, y2buf) = PointDbl(pxbuf, pybuf);
-
-  // [4]P
-  std::vector<uint8_t> x4buf(kEccKeySize);
-  std::vector<uint8_t> y4buf(kEccKeySize);
-  std::tie(x4buf, y4buf) = PointDbl(x2buf, y2buf);
+// Everything of the hash except the final inversion.
+ProjectiveX HashToCurveProjective(yacl::ByteContainerView buffer,
+                                  const std::string &dst) {
+  YACL_ENFORCE((dst.size() >= 16) && (dst.size() <= 255),
+               "domain separation tag length: {} not in 16B-255B", dst.size());
 
-  std::vector<uint8_t> xbuf(kEccKeySize);
-  std::vector<uint8_t> ybuf(kEccKeySize);
+  std::array<Fe, 2> u = HashToField(buffer, dst);
 
-  // [8]P
-  std::tie(xbuf, ybuf) = PointDbl(x4buf, y4buf);
+  Fe q0xn;
+  Fe q0xd;
+  Fe q0y;
+  Fe q1xn;
+  Fe q1xd;
+  Fe q1y;
+  MapToCurveG2(u[0], &q0xn, &q0xd, &q0y);
+  MapToCurveG2(u[1], &q1xn, &q1xd, &q1y);
 
-  return std::make_pair(xbuf, ybuf);
+  return PointClearCofactorProjective(
+      PointAddX(q0xn, q0xd, q0y, q1xn, q1xd, q1y));
 }
 
-[[maybe_unused]] bool CheckPoint(yacl::ByteContainerView msgx,
-                                 yacl::ByteContainerView msgy) {
-  yacl::math::MPInt mp_x = ToMpInt(msgx);
-  yacl::math::MPInt mp_y = ToMpInt(msgy);
-
-  yacl::math::MPInt x3 = mp_x.PowMod(kMp3, kMp25519);
-  yacl::math::MPInt x2 = mp_x.PowMod(kMp2, kMp25519);
-  yacl::math::MPInt Ax2 = x2.MulMod(kMp25519J, kMp25519);
-  yacl::math::MPInt x3Ax2 = x3.AddMod(Ax2, kMp25519);
-  yacl::math::MPInt x3Ax2x = x3Ax2.AddMod(mp_x, kMp25519);
-
-  yacl::math::MPInt y2 = mp_y.PowMod(kMp2, kMp25519);
-
-  return x3Ax2x == y2;
+// The affine x coordinate is stored big endian, as in RFC9380 test vectors.
+yacl::crypto::Array32 ToAffineX(const ProjectiveX &p, const Fe &z_inv) {
+  std::array<uint8_t, kEccKeySize> le;
+  FeToBytes(le.data(), FeMul(p.x, z_inv));
+  yacl::crypto::Array32 ret;
+  std::reverse_copy(le.begin(), le.end(), ret.begin());
+  return ret;
 }
 
 }  // namespace
 
 yacl::crypto::Array32 HashToCurveElligator2(yacl::ByteContainerView buffer,
                                             const std::string &dst) {
-  YACL_ENFORCE((dst.size() >= 16) && (dst.size() <= 255),
-               "domain separation tag length: {} not in 16B-255B", dst.size());
-
-  std::vector<std::vector<uint8_t>> u = HashToField(buffer, 2, dst);
-
-  std::vector<uint8_t> q0x(kEccKeySize);
-  std::vector<uint8_t> q0y(kEccKeySize);
-  std::vector<uint8_t> q1x(kEccKeySize);
-  std::vector<uint8_t> q1y(kEccKeySize);
+  ProjectiveX p = HashToCurveProjective(buffer, dst);
+  return ToAffineX(p, FeInvert(p.z));
+}
 
-  std::tie(q0x, q0y) = MapToCurveG2(u[0]);
-  std::tie(q1x, q1y) = MapToCurveG2(u[1]);
+std::vector<yacl::crypto::Array32> HashToCurveElligator2(
+    absl::Span<const std::string> buffers, const std::string &dst) {
+  std::vector<ProjectiveX> points(buffers.size());
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    points[i] = HashToCurveProjective(buffers[i], dst);
+  }
 
-  yacl::crypto::Array32 px1 = PointAddX(q0x, q0y, q1x, q1y);
+  // Montgomery's trick: one inversion for the whole batch. Zero z (point at
+  // infinity, negligible probability) is skipped and maps to x = 0 like
+  // FeInvert does.
+  std::vector<Fe> prefix(points.size());
+  Fe acc = kFeOne;
+  for (size_t i = 0; i < points.size(); ++i) {
+    prefix[i] = acc;
+    if (!FeIsZero(points[i].z)) {
+      acc = FeMul(acc, points[i].z);
+    }
+  }
+  Fe acc_inv = FeInvert(acc);
 
-  return PointClearCofactorProjective(px1);
+  std::vector<yacl::crypto::Array32> ret(points.size());
+  for (size_t i = points.size(); i-- > 0;) {
+    if (FeIsZero(points[i].z)) {
+      ret[i] = ToAffineX(points[i], kFeZero);
+      continue;
+    }
+    ret[i] = ToAffineX(points[i], FeMul(acc_inv, prefix[i]));
+    acc_inv = FeMul(acc_inv, points[i].z);
+  }
+  return ret;
 }
 
 }  // namespace psi
@@ -57,4 +57,20 @@ TEST(Elligator2Test, HashToCurve) {
   }
 }
 
+TEST(Elligator2Test, BatchHashToCurve) {
+  std::vector<std::string> items;
+  for (size_t i = 0; i < 100; ++i) {
+    items.push_back(std::to_string(i));
+  }
+  items.emplace_back();
+
+  std::vector<yacl::crypto::Array32> batch =
+      HashToCurveElligator2(absl::MakeConstSpan(items));
+
+  ASSERT_EQ(batch.size(), items.size());
+  for (size_t i = 0; i < items.size(); ++i) {
+    EXPECT_EQ(batch[i], HashToCurveElligator2(items[i]));
+  }
+}
+
 }  // namespace psi
@@ -16,7 +16,11 @@
 
 #include <algorithm>
 #include <array>
+#include <optional>
+#include <string>
+#include <utility>
 
+#include "crypto_mb/sm2.h"
 #include "crypto_mb/x25519.h"
 #include "yacl/crypto/hash/hash_utils.h"
 #include "yacl/utils/parallel.h"
@@ -25,8 +29,10 @@
 
 namespace psi {
 
+using yacl::crypto::AffinePoint;
 using yacl::crypto::Array32;
 using yacl::crypto::EcPoint;
+using yacl::math::MPInt;
 
 std::vector<EcPoint> IppEccCryptor::EccMask(
     const std::vector<EcPoint> &points) const {
@@ -69,6 +75,48 @@ std::vector<EcPoint> IppEccCryptor::EccMask(
   return ret;
 }
 
+std::vector<std::string> IppEccCryptor::HashAndMask(
+    const std::vector<std::string> &items) const {
+  std::array<const int8u *, 8> ptr_sk;
+  std::fill(ptr_sk.begin(), ptr_sk.end(),
+            static_cast<const int8u *>(&private_key_[0]));
+
+  std::vector<std::string> ret(items.size());
+  yacl::parallel_for(0, items.size(), 8, [&](int64_t begin, int64_t end) {
+    int8u key_data[8][32];  // Junk buffer
+    for (int64_t start = begin; start < end; start += kHashBatchSize) {
+      int64_t size = std::min<int64_t>(kHashBatchSize, end - start);
+      auto hashed =
+          BatchHashToCurve(absl::MakeConstSpan(items).subspan(start, size));
+
+      for (int64_t idx = 0; idx < size; idx += 8) {
+        int64_t current_batch_size =
+            std::min(static_cast<int64_t>(8), size - idx);
+
+        std::array<const int8u *, 8> ptr_pk;
+        std::array<int8u *, 8> ptr_key;
+        for (int64_t i = 0; i < 8; i++) {
+          if (i < current_batch_size) {
+            auto &out = ret[start + idx + i];
+            out.resize(kEccKeySize);
+            ptr_pk[i] = static_cast<const int8u *>(
+                std::get<Array32>(hashed[idx + i]).data());
+            ptr_key[i] = reinterpret_cast<int8u *>(out.data());
+          } else {
+            ptr_pk[i] = ptr_pk[0];
+            ptr_key[i] = static_cast<int8u *>(key_data[i]);
+          }
+        }
+        mbx_status status =
+            mbx_x25519_mb8(ptr_key.data(), ptr_sk.data(), ptr_pk.data());
+        YACL_ENFORCE(status == 0, "ippc mbx_x25519_mb8 Error: ", status);
+      }
+    }
+  });
+
+  return ret;
+}
+
 yacl::crypto::EcPoint IppEccCryptor::HashToCurve(
     absl::Span<const char> input) const {
   return yacl::crypto::Sha256(input);
@@ -90,9 +138,181 @@ yacl::crypto::EcPoint IppEccCryptor::DeserializeEcPoint(
   return p;
 }
 
+namespace {
+
+constexpr size_t kSm2CoordSize = 32;
+
+using Sm2Limbs = std::array<int64u, kSm2CoordSize / sizeof(int64u)>;
+
+static_assert(sizeof(Sm2Limbs) == kEccKeySize);
+
+Sm2Limbs ToLimbs(const MPInt &v) {
+  Sm2Limbs limbs = {};
+  yacl::Buffer buf = v.ToMagBytes(yacl::Endian::little);
+  YACL_ENFORCE(static_cast<size_t>(buf.size()) <= kSm2CoordSize);
+  memcpy(limbs.data(), buf.data(), buf.size());
+  return limbs;
+}
+
+}  // namespace
+
+void IppSm2Cryptor::InitCurve() {
+  field_ = ec_group_->GetField();
+  generator_ = ec_group_->GetGenerator();
+  // b = gy^2 - gx^3 - a * gx, with a = -3.
+  auto g = ec_group_->GetAffinePoint(generator_);
+  curve_b_ = g.y.MulMod(g.y, field_).SubMod(
+      g.x.MulMod(g.x, field_).SubMod(MPInt(3), field_).MulMod(g.x, field_),
+      field_);
+}
+
+void IppSm2Cryptor::UpdateKeyLimbs() {
+  // crypto_mb wants the key in [0, n), which does not change sk * P.
+  MPInt sk = sk_.Mod(ec_group_->GetOrder());
+  Sm2Limbs limbs = ToLimbs(sk);
+  memcpy(sk_limbs_.data(), limbs.data(), sizeof(limbs));
+  OPENSSL_cleanse(limbs.data(), sizeof(limbs));
+
+  auto pk = ec_group_->MulBase(sk);
+  sk.SetZero();
+  YACL_ENFORCE(!ec_group_->IsInfinity(pk), "invalid sm2 private key");
+  pk_ = ec_group_->GetAffinePoint(pk);
+}
+
+std::array<MPInt, 8> IppSm2Cryptor::MulX8(
+    absl::Span<const AffinePoint> points) const {
+  YACL_ENFORCE(!points.empty() && points.size() <= 8);
+  std::array<const int64u *, 8> ptr_sk;
+  std::fill(ptr_sk.begin(), ptr_sk.end(),
+            reinterpret_cast<const int64u *>(sk_limbs_.data()));
+
+  std::array<Sm2Limbs, 8> px;
+  std::array<Sm2Limbs, 8> py;
+  int8u shared[8][kSm2CoordSize];
+  std::array<const int64u *, 8> ptr_x;
+  std::array<const int64u *, 8> ptr_y;
+  std::array<int8u *, 8> ptr_shared;
+  for (size_t i = 0; i < 8; i++) {
+    const auto &point = points[i < points.size() ? i : 0];
+    px[i] = ToLimbs(point.x);
+    py[i] = ToLimbs(point.y);
+    ptr_x[i] = px[i].data();
+    ptr_y[i] = py[i].data();
+    ptr_shared[i] = shared[i];
+  }
+
+  mbx_status status =
+      mbx_sm2_ecdh_mb8(ptr_shared.data(), ptr_sk.data(), ptr_x.data(),
+                       ptr_y.data(), nullptr, nullptr);
+  YACL_ENFORCE(status == MBX_STATUS_OK, "ippc mbx_sm2_ecdh_mb8 Error: {}",
+               status);
+
+  std::array<MPInt, 8> ret;
+  for (size_t i = 0; i < points.size(); i++) {
+    ret[i].FromMagBytes(yacl::ByteContainerView(shared[i], kSm2CoordSize),
+                        yacl::Endian::big);
+  }
+  return ret;
+}
+
+// With R = (xr, y), S = (xs, ys) and lambda = (y - ys) / (xr - xs),
+// xt = lambda^2 - xr - xs gives
+//   y^2 - 2 * y * ys + ys^2 = (xt + xr + xs) * (xr - xs)^2,
+// where y^2 = xr^3 - 3 * xr + b, so y is found without a square root.
+std::optional<MPInt> IppSm2Cryptor::RecoverY(const MPInt &xr,
+                                             const MPInt &xt) const {
+  const auto &p = field_;
+  if (xr == pk_.x) {
+    return std::nullopt;
+  }
+  MPInt dx = xr.SubMod(pk_.x, p);
+  MPInt k = xt.AddMod(xr, p).AddMod(pk_.x, p).MulMod(dx.MulMod(dx, p), p);
+  MPInt y2 = xr.MulMod(xr, p).SubMod(MPInt(3), p).MulMod(xr, p).AddMod(
+      curve_b_, p);
+  MPInt num = y2.AddMod(pk_.y.MulMod(pk_.y, p), p).SubMod(k, p);
+  return num.MulMod(pk_.y.AddMod(pk_.y, p).InvertMod(p), p);
+}
+
+std::vector<EcPoint> IppSm2Cryptor::MaskPoints(
+    absl::Span<const EcPoint> points) const {
+  std::vector<EcPoint> ret(points.size());
+  std::vector<AffinePoint> p;
+  std::vector<AffinePoint> q;
+  for (size_t idx = 0; idx < points.size(); idx += 8) {
+    size_t batch_size = std::min<size_t>(8, points.size() - idx);
+
+    // The kernel masks P and P + G. Points it can't take are masked by the
+    // scalar path.
+    std::array<bool, 8> scalar = {};
+    p.assign(batch_size, AffinePoint{});
+    q.assign(batch_size, AffinePoint{});
+    for (size_t i = 0; i < batch_size; i++) {
+      const auto &point = points[idx + i];
+      if (!ec_group_->IsInfinity(point)) {
+        auto sum = ec_group_->Add(point, generator_);
+        if (!ec_group_->IsInfinity(sum)) {
+          p[i] = ec_group_->GetAffinePoint(point);
+          q[i] = ec_group_->GetAffinePoint(sum);
+          continue;
+        }
+      }
+      scalar[i] = true;
+      p[i] = pk_;
+      q[i] = pk_;
+    }
+
+    auto xr = MulX8(p);
+    auto xt = MulX8(q);
+    for (size_t i = 0; i < batch_size; i++) {
+      std::optional<MPInt> y;
+      if (!scalar[i]) {
+        y = RecoverY(xr[i], xt[i]);
+      }
+      ret[idx + i] =
+          y.has_value()
+              ? ec_group_->CopyPoint(AffinePoint{std::move(xr[i]), *y})
+              : ec_group_->Mul(points[idx + i], sk_);
+    }
+  }
+  return ret;
+}
+
+std::vector<EcPoint> IppSm2Cryptor::EccMask(
+    const std::vector<EcPoint> &points) const {
+  std::vector<EcPoint> ret(points.size());
+  yacl::parallel_for(0, points.size(), 8, [&](int64_t begin, int64_t end) {
+    auto masked =
+        MaskPoints(absl::MakeConstSpan(points).subspan(begin, end - begin));
+    std::move(masked.begin(), masked.end(), ret.begin() + begin);
+  });
+  return ret;
+}
+
+std::vector<std::string> IppSm2Cryptor::HashAndMask(
+    const std::vector<std::string> &items) const {
+  std::vector<std::string> ret(items.size());
+  yacl::parallel_for(0, items.size(), [&](int64_t begin, int64_t end) {
+    for (int64_t start = begin; start < end; start += kHashBatchSize) {
+      int64_t size = std::min<int64_t>(kHashBatchSize, end - start);
+      auto points = MaskPoints(
+          BatchHashToCurve(absl::MakeConstSpan(items).subspan(start, size)));
+      for (int64_t idx = 0; idx < size; ++idx) {
+        ret[start + idx] = this->SerializeEcPoint(points[idx]);
+      }
+    }
+  });
+  return ret;
+}
+
 EcPoint IppElligator2Cryptor::HashToCurve(
     absl::Span<const char> item_data) const {
   return HashToCurveElligator2(item_data);
 }
 
+std::vector<EcPoint> IppElligator2Cryptor::BatchHashToCurve(
+    absl::Span<const std::string> items) const {
+  auto hashed = HashToCurveElligator2(items);
+  return std::vector<EcPoint>(hashed.begin(), hashed.end());
+}
+
 }  // namespace psi
@@ -14,6 +14,10 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
 #include <vector>
 
 #include "openssl/crypto.h"
@@ -21,6 +25,7 @@
 #include "yacl/base/exception.h"
 
 #include "psi/cryptor/ecc_cryptor.h"
+#include "psi/cryptor/sm2_cryptor.h"
 
 namespace psi {
 
@@ -35,6 +40,9 @@ class IppEccCryptor : public IEccCryptor {
   std::vector<yacl::crypto::EcPoint> EccMask(
       const std::vector<yacl::crypto::EcPoint>& points) const override;
 
+  std::vector<std::string> HashAndMask(
+      const std::vector<std::string>& items) const override;
+
   size_t GetMaskLength() const override { return kEccKeySize; }
 
   yacl::crypto::EcPoint HashToCurve(
@@ -50,6 +58,65 @@ class IppEccCryptor : public IEccCryptor {
 class IppElligator2Cryptor : public IppEccCryptor {
   yacl::crypto::EcPoint HashToCurve(
       absl::Span<const char> item_data) const override;
+
+  std::vector<yacl::crypto::EcPoint> BatchHashToCurve(
+      absl::Span<const std::string> items) const override;
+};
+
+// SM2 with the IPP-CP crypto_mb 8-way ECDH kernel.
+//
+// The kernel only outputs the x coordinate of sk * P. The kernel also masks
+// P + G, and y of sk * P is recovered from x(sk * P), x(sk * P + sk * G) and
+// the public key sk * G, so masked points are the same as Sm2Cryptor's.
+class IppSm2Cryptor : public Sm2Cryptor {
+ public:
+  IppSm2Cryptor() : Sm2Cryptor(CurveType::CURVE_SM2) {
+    InitCurve();
+    UpdateKeyLimbs();
+  }
+
+  ~IppSm2Cryptor() override {
+    OPENSSL_cleanse(sk_limbs_.data(), sizeof(sk_limbs_));
+  }
+
+  void SetPrivateKey(absl::Span<const uint8_t> key) override {
+    Sm2Cryptor::SetPrivateKey(key);
+    UpdateKeyLimbs();
+  }
+
+  std::vector<yacl::crypto::EcPoint> EccMask(
+      const std::vector<yacl::crypto::EcPoint>& points) const override;
+
+  std::vector<std::string> HashAndMask(
+      const std::vector<std::string>& items) const override;
+
+ private:
+  // Returns sk * points[i], without parallelism.
+  std::vector<yacl::crypto::EcPoint> MaskPoints(
+      absl::Span<const yacl::crypto::EcPoint> points) const;
+
+  // Returns x(sk * points[i]) of at most 8 points with one kernel call.
+  std::array<yacl::math::MPInt, 8> MulX8(
+      absl::Span<const yacl::crypto::AffinePoint> points) const;
+
+  // Returns y of R = sk * P from xr = x(R) and xt = x(R + sk * G), or nullopt
+  // if R = +-sk * G.
+  std::optional<yacl::math::MPInt> RecoverY(const yacl::math::MPInt& xr,
+                                            const yacl::math::MPInt& xt) const;
+
+  void InitCurve();
+
+  // Caches sk mod n as little-endian 64-bit limbs, the form crypto_mb takes,
+  // and the public key.
+  void UpdateKeyLimbs();
+
+  std::array<uint64_t, kEccKeySize / sizeof(uint64_t)> sk_limbs_ = {};
+  // sk * G.
+  yacl::crypto::AffinePoint pk_;
+  yacl::crypto::EcPoint generator_;
+  yacl::math::MPInt field_;
+  // Coefficient b of y^2 = x^3 - 3 * x + b.
+  yacl::math::MPInt curve_b_;
 };
 
 }  // namespace psi
@@ -0,0 +1,102 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "psi/cryptor/ipp_ecc_cryptor.h"
+
+#include <array>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "yacl/crypto/tools/prg.h"
+#include "yacl/utils/platform_utils.h"
+
+#include "psi/cryptor/sm2_cryptor.h"
+
+namespace psi {
+
+namespace {
+
+using yacl::crypto::EcPoint;
+using yacl::crypto::PointOctetFormat;
+
+// Serializes masked points in `format`, so that both mask lengths are
+// covered.
+template <typename Base>
+class FormatCryptor : public Base {
+ public:
+  explicit FormatCryptor(PointOctetFormat format) : format_(format) {}
+
+  size_t GetMaskLength() const override {
+    return this->ec_group_->GetSerializeLength(format_);
+  }
+
+  [[nodiscard]] yacl::Buffer SerializeEcPoint(
+      const EcPoint& point) const override {
+    return this->ec_group_->SerializePoint(point, format_);
+  }
+
+  EcPoint Generator() const { return this->ec_group_->GetGenerator(); }
+
+  EcPoint Negate(const EcPoint& point) const {
+    return this->ec_group_->Negate(point);
+  }
+
+ private:
+  PointOctetFormat format_;
+};
+
+}  // namespace
+
+class IppSm2CryptorTest : public ::testing::TestWithParam<PointOctetFormat> {
+};
+
+TEST_P(IppSm2CryptorTest, SameAsSm2Cryptor) {
+  if (!yacl::hasAVX512ifma()) {
+    GTEST_SKIP() << "avx512 ifma is not supported";
+  }
+
+  std::random_device rd;
+  yacl::crypto::Prg<uint64_t> prg(rd());
+
+  for (size_t round = 0; round < 4; ++round) {
+    FormatCryptor<IppSm2Cryptor> ipp(GetParam());
+    FormatCryptor<Sm2Cryptor> scalar(GetParam());
+    std::array<uint8_t, kEccKeySize> key;
+    prg.Fill(absl::MakeSpan(key));
+    ipp.SetPrivateKey(key);
+    scalar.SetPrivateKey(key);
+
+    // Not a multiple of the batch sizes.
+    std::vector<std::string> items(1001, std::string(kEccKeySize, '\0'));
+    for (auto& item : items) {
+      prg.Fill(absl::MakeSpan(item.data(), item.size()));
+    }
+    EXPECT_EQ(ipp.HashAndMask(items), scalar.HashAndMask(items));
+
+    // G and -G are masked by the scalar path.
+    auto points = scalar.HashInputs(items);
+    points.push_back(scalar.Generator());
+    points.push_back(scalar.Negate(scalar.Generator()));
+    EXPECT_EQ(ipp.SerializeEcPoints(ipp.EccMask(points)),
+              scalar.SerializeEcPoints(scalar.EccMask(points)));
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(MaskLength, IppSm2CryptorTest,
+                         testing::Values(PointOctetFormat::X962Compressed,
+                                         PointOctetFormat::X962Uncompressed));
+
+}  // namespace psi
@@ -37,6 +37,7 @@ class Sm2Cryptor : public IEccCryptor {
       : curve_type_(type) {
     YACL_ENFORCE(key.size() == kEccKeySize);
     std::copy(key.begin(), key.end(), private_key_.begin());
+    UpdatePrivateKey();
     ec_group_ = yacl::crypto::EcGroupFactory::Instance().Create(
         "sm2", yacl::ArgLib = "openssl");
   }
@@ -16,6 +16,8 @@
 
 #include <future>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include "absl/strings/escaping.h"
 #include "gtest/gtest.h"
@@ -80,6 +82,21 @@ TEST_P(Sm2CryptorTest, Works) {
             sm2_cryptor_a->SerializeEcPoints(masked_ba));
 }
 
+TEST_P(Sm2CryptorTest, HashAndMask) {
+  auto params = GetParam();
+
+  auto sm2_cryptor = std::make_shared<Sm2Cryptor>(params.type);
+
+  std::vector<std::string> items;
+  for (size_t idx = 0; idx < params.items_size; ++idx) {
+    items.push_back(std::to_string(idx));
+  }
+
+  EXPECT_EQ(sm2_cryptor->HashAndMask(items),
+            sm2_cryptor->SerializeEcPoints(
+                sm2_cryptor->EccMask(sm2_cryptor->HashInputs(items))));
+}
+
 INSTANTIATE_TEST_SUITE_P(
     Works_Instances, Sm2CryptorTest,
     testing::Values(TestParams{1}, TestParams{10}, TestParams{50},
@@ -32,9 +32,7 @@ yacl::crypto::EcPoint SodiumCurve25519Cryptor::HashToCurve(
 
 std::vector<uint8_t> SodiumCurve25519Cryptor::KeyExchange(
     const std::shared_ptr<yacl::link::Context>& link_ctx) {
-  yacl::math::MPInt sk(0, kEccKeySize * CHAR_BIT);
-  sk.FromMagBytes(private_key_, yacl::Endian::little);
-  auto self_public_key = ec_group_->MulBase(sk);
+  auto self_public_key = ec_group_->MulBase(sk_);
   link_ctx->SendAsyncThrottled(
       link_ctx->NextRank(), ec_group_->SerializePoint(self_public_key),
       fmt::format("send rank-{} public key", link_ctx->Rank()));
@@ -42,7 +40,7 @@ std::vector<uint8_t> SodiumCurve25519Cryptor::KeyExchange(
       link_ctx->NextRank(),
       fmt::format("recv rank-{} public key", link_ctx->NextRank()));
   auto peer_public_key = ec_group_->DeserializePoint(peer_pubkey_buf);
-  auto dh_key = ec_group_->Mul(peer_public_key, sk);
+  auto dh_key = ec_group_->Mul(peer_public_key, sk_);
   const auto shared_key =
       yacl::crypto::Blake3(ec_group_->SerializePoint(dh_key));
   return {shared_key.begin(), shared_key.end()};
@@ -53,4 +51,10 @@ yacl::crypto::EcPoint SodiumElligator2Cryptor::HashToCurve(
   return HashToCurveElligator2(item_data);
 }
 
+std::vector<yacl::crypto::EcPoint> SodiumElligator2Cryptor::BatchHashToCurve(
+    absl::Span<const std::string> items) const {
+  auto hashed = HashToCurveElligator2(items);
+  return std::vector<yacl::crypto::EcPoint>(hashed.begin(), hashed.end());
+}
+
 }  // namespace psi
@@ -49,6 +49,7 @@ class SodiumCurve25519Cryptor : public IEccCryptor {
     private_key_[0] &= 248;
     private_key_[31] &= 127;
     private_key_[31] |= 64;
+    UpdatePrivateKey();
 
     ec_group_ = yacl::crypto::EcGroupFactory::Instance().Create(
         "Curve25519", yacl::ArgLib = "libsodium");
@@ -68,6 +69,9 @@ class SodiumCurve25519Cryptor : public IEccCryptor {
 class SodiumElligator2Cryptor : public SodiumCurve25519Cryptor {
   yacl::crypto::EcPoint HashToCurve(
       absl::Span<const char> item_data) const override;
+
+  std::vector<yacl::crypto::EcPoint> BatchHashToCurve(
+      absl::Span<const std::string> items) const override;
 };
 
 }  // namespace psi
@@ -31,6 +31,7 @@
 #include "psi/trace_categories.h"
 #include "psi/utils/bucket.h"
 #include "psi/utils/key.h"
+#include "psi/utils/preprocess_cache.h"
 #include "psi/utils/random_str.h"
 #include "psi/utils/sync.h"
 
@@ -63,6 +64,44 @@ std::filesystem::path AbstractPsiParty::GetTaskDir() {
   }
 }
 
+std::filesystem::path AbstractPsiParty::GetPreprocessDir() {
+  if (preprocess_cache_entry_) {
+    return preprocess_cache_entry_->Dir();
+  }
+  return GetTaskDir();
+}
+
+std::unique_ptr<HashBucketCache> AbstractPsiParty::CreateInputBucketStore(
+    const std::filesystem::path &cache_dir, uint32_t bucket_num) {
+  auto compression = config_.compress_bucket_store()
+                         ? BucketCompression::kZstd
+                         : BucketCompression::kNone;
+  if (preprocess_cache_entry_) {
+    bool digest_items = digest_provider_ != nullptr;
+    auto dir = preprocess_cache_entry_->GetOrBuildDir(
+        fmt::format("input_{}bucket_store_{}", digest_items ? "digest_" : "",
+                    bucket_num),
+        [&](const std::filesystem::path &tmp_dir) {
+          if (digest_items) {
+            CreateCacheFromDigestProvider(digest_provider_, tmp_dir,
+                                          bucket_num, false, compression);
+          } else {
+            CreateCacheFromProvider(batch_provider_, tmp_dir, bucket_num,
+                                    false, compression);
+          }
+        });
+    return std::make_unique<HashBucketCache>(dir, bucket_num, false,
+                                             compression, digest_items);
+  }
+
+  if (digest_provider_) {
+    return CreateCacheFromDigestProvider(digest_provider_, cache_dir,
+                                         bucket_num, true, compression);
+  }
+  return CreateCacheFromProvider(batch_provider_, cache_dir, bucket_num, true,
+                                 compression);
+}
+
 void AbstractPsiParty::Init() {
   TRACE_EVENT("init", "AbstractPsiParty::Init");
   SPDLOG_INFO("[AbstractPsiParty::Init] start");
@@ -76,11 +115,31 @@ void AbstractPsiParty::Init() {
 
   CheckPeerConfig();
 
-  join_processor_ = JoinProcessor::Make(config_, GetTaskDir());
+  const auto &cache_config = config_.preprocess_cache_config();
+  std::unique_ptr<PreprocessCache> preprocess_cache;
+  if (!cache_config.folder().empty()) {
+    preprocess_cache = std::make_unique<PreprocessCache>(
+        cache_config.folder(), cache_config.max_size_bytes(),
+        cache_config.max_age_seconds());
+  }
 
   SyncWait(lctx_, [&] {
     SPDLOG_INFO("[AbstractPsiParty::Init][Check csv pre-process] start");
 
+    if (preprocess_cache) {
+      // Input attributes decide which files are built in the entry.
+      auto tag = fmt::format("keys_unique={},keys_sorted={}",
+                             config_.input_attr().keys_unique(),
+                             config_.input_attr().keys_sorted());
+      preprocess_cache_entry_ =
+          preprocess_cache->Open(PreprocessCache::Fingerprint(
+              config_.input_config().path(), selected_keys_, tag));
+    }
+    join_processor_ = JoinProcessor::Make(
+        config_, GetTaskDir(),
+        preprocess_cache_entry_ ? preprocess_cache_entry_->Dir()
+                                : std::filesystem::path());
+
     // TODO(huocun): construct batch provider according to input_attr field
     keys_info_ = join_processor_->GetUniqueKeysInfo();
     keys_hash_ = keys_info_->KeysHash();
@@ -88,6 +147,15 @@ void AbstractPsiParty::Init() {
     report_.set_original_key_count(keys_info_->KeyCnt());
 
     batch_provider_ = keys_info_->GetKeysProviderWithDupCnt();
+    if (config_.compact_key_digest()) {
+      digest_provider_ = keys_info_->GetDigestProvider(
+          (GetPreprocessDir() / "key_digest.bin").string());
+    }
+
+    if (preprocess_cache) {
+      preprocess_cache_entry_->MarkReady();
+      preprocess_cache->Evict();
+    }
     SPDLOG_INFO("[AbstractPsiParty::Init][Check csv pre-process] end");
   });
 
@@ -198,6 +266,17 @@ void AbstractPsiParty::CheckSelfConfig() {
     }
   }
 
+  if (config_.compact_key_digest() &&
+      config_.protocol_config().protocol() != v2::PROTOCOL_KKRT &&
+      config_.protocol_config().protocol() != v2::PROTOCOL_RR22) {
+    YACL_THROW("compact_key_digest is only supported by KKRT and RR22.");
+  }
+
+  if (!config_.preprocess_cache_config().folder().empty() &&
+      config_.recovery_config().enabled()) {
+    YACL_THROW("Preprocessing cache can't be used with recovery.");
+  }
+
   if (config_.protocol_config().role() != role_) {
     YACL_THROW("Role doesn't match.");
   }
@@ -236,10 +315,30 @@ void AbstractPsiParty::CheckPeerConfig() {
   config.mutable_debug_options()->Clear();
   config.set_disable_alignment(false);
   config.mutable_input_attr()->set_keys_unique(false);
+  config.mutable_input_attr()->set_keys_sorted(false);
+  config.mutable_output_attr()->set_shard_num(0);
+  config.mutable_preprocess_cache_config()->Clear();
+  config.set_compress_bucket_store(false);
+  // The settings below only affect local computation.
+  auto* rr22_config = config.mutable_protocol_config()->mutable_rr22_config();
+  rr22_config->set_threads_per_bucket(0);
+  rr22_config->set_read_ahead_depth(0);
+  rr22_config->set_intersection_queue_depth(0);
+  rr22_config->set_vole_pool_folder("");
+  rr22_config->set_memory_budget_mb(0);
+  auto* kkrt_config = config.mutable_protocol_config()->mutable_kkrt_config();
+  kkrt_config->set_memory_budget_mb(0);
+  auto* ecdh_config = config.mutable_protocol_config()->mutable_ecdh_config();
+  ecdh_config->set_backend(ECC_BACKEND_AUTO);
+  // Batches are rechunked and acknowledged on the sending side only, and the
+  // peer accepts batches of any size.
+  ecdh_config->mutable_flow_control()->Clear();
 
   // Recovery must be enabled by all parties at the same time.
   config.mutable_recovery_config()->set_folder("");
 
+  config.set_protocol_version(kPsiProtocolVersion);
+
   std::string serialized;
   YACL_ENFORCE(config.SerializeToString(&serialized));
 
@@ -260,6 +359,14 @@ void AbstractPsiParty::CheckPeerConfig() {
   v2::PsiConfig rank1_config;
   YACL_ENFORCE(rank1_config.ParseFromString(rank1_serialized));
 
+  // Former versions don't send protocol_version, which reads as 0.
+  YACL_ENFORCE(rank0_config.protocol_version() ==
+                   rank1_config.protocol_version(),
+               "PSI protocol versions are not consistent between parties. "
+               "Rank 0: {} while Rank 1: {}. Upgrade the older party.",
+               rank0_config.protocol_version(),
+               rank1_config.protocol_version());
+
   if (rank0_config.protocol_config().role() ==
       rank1_config.protocol_config().role()) {
     YACL_THROW("The role of parties must be different.");
@@ -16,6 +16,7 @@
 
 #include <sys/types.h>
 
+#include <cstdint>
 #include <filesystem>
 #include <memory>
 #include <string>
@@ -24,14 +25,21 @@
 #include "yacl/link/algorithm/barrier.h"
 
 #include "psi/checkpoint/recovery.h"
+#include "psi/utils/hash_bucket_cache.h"
 #include "psi/utils/index_store.h"
 #include "psi/utils/join_processor.h"
+#include "psi/utils/preprocess_cache.h"
 #include "psi/utils/resource_manager.h"
 
 #include "psi/proto/psi_v2.pb.h"
 
 namespace psi {
 
+// Version of the conventions parties must share, compared with the peer by
+// AbstractPsiParty::CheckPeerConfig.
+// 1: bucket items are hashed as raw bytes instead of base64 strings.
+inline constexpr uint32_t kPsiProtocolVersion = 1;
+
 class AbstractPsiParty {
  public:
   AbstractPsiParty() = delete;
@@ -81,6 +89,16 @@ class AbstractPsiParty {
 
   std::filesystem::path GetTaskDir();
 
+  // Directory of preprocessed input, which is the entry of preprocessing cache
+  // if enabled, or the task dir.
+  std::filesystem::path GetPreprocessDir();
+
+  // Dump self keys into buckets, as digests if compact_key_digest is enabled.
+  // If preprocessing cache is enabled, `cache_dir` is ignored and the buckets
+  // are kept in the cache entry.
+  std::unique_ptr<HashBucketCache> CreateInputBucketStore(
+      const std::filesystem::path &cache_dir, uint32_t bucket_num);
+
   // Including tasks independent to protocol:
   // - Compose output.
   // - Sort output.
@@ -109,9 +127,14 @@ class AbstractPsiParty {
   std::vector<uint8_t> keys_hash_;
   std::shared_ptr<KeyInfo> keys_info_;
   std::shared_ptr<IBasicBatchProvider> batch_provider_;
+  // Only set if compact_key_digest is enabled.
+  std::shared_ptr<IDigestBatchProvider> digest_provider_;
 
   std::shared_ptr<DirResource> dir_resource_;
 
+  // Only set if preprocessing cache is enabled.
+  std::shared_ptr<PreprocessCache::Entry> preprocess_cache_entry_;
+
  private:
   void CheckPeerConfig();
 
@@ -427,7 +427,7 @@ std::vector<uint64_t> BucketPsi::RunBucketPsi(
     std::vector<std::string> item_data_list;
     item_data_list.reserve(bucket_items_list.size());
     for (const auto& item : bucket_items_list) {
-      item_data_list.push_back(item.base64_data);
+      item_data_list.push_back(item.data);
     }
 
     auto result_list = mem_psi_->Run(item_data_list);
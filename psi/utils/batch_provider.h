@@ -21,6 +21,9 @@
 #include <utility>
 #include <vector>
 
+#include "absl/types/span.h"
+#include "yacl/base/int128.h"
+
 namespace psi {
 
 /// Interface which produce batch of strings.
@@ -55,6 +58,19 @@ class IBasicBatchProvider : virtual public IBatchProvider {
   }
 };
 
+class IDigestBatchProvider : virtual public IBatchProvider {
+ public:
+  explicit IDigestBatchProvider() : IBatchProvider() {}
+
+  virtual ~IDigestBatchProvider() = default;
+
+  // Read 128-bit digests of at most `batch_size` items. An empty returned span
+  // is treated as the end of stream. The span is only valid until the next
+  // call. `dup_cnts` has the same meaning as in ReadNextBatchWithDupCnt.
+  virtual absl::Span<const uint128_t> ReadNextDigestBatch(
+      std::unordered_map<uint32_t, uint32_t>* dup_cnts) = 0;
+};
+
 class ILabeledBatchProvider : virtual public IBatchProvider {
  public:
   explicit ILabeledBatchProvider() : IBatchProvider() {}
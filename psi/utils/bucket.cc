@@ -14,24 +14,118 @@
 
 #include "psi/utils/bucket.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <string>
 #include <unordered_map>
 
 #include "yacl/crypto/hash/hash_utils.h"
 
 #include "psi/prelude.h"
+#include "psi/utils/resource.h"
 #include "psi/utils/sync.h"
 
 namespace psi {
 
+namespace {
+
+// Cost of a bucket in the time of handling one item on one thread.
+struct BucketCostModel {
+  // Peak bytes per item of a bucket, counting the larger input.
+  double bytes_per_item;
+
+  // Fixed overhead of a bucket: base OTs, VOLE setup and round trips.
+  double bucket_overhead;
+
+  // The least items a thread is worth in a bucket.
+  double items_per_thread;
+
+  // Extra cost per item each time a bucket doubles beyond cached_items, as
+  // its tables fall out of cache.
+  double cache_penalty;
+  double cached_items;
+};
+
+BucketCostModel GetBucketCostModel(v2::Protocol protocol) {
+  switch (protocol) {
+    case v2::PROTOCOL_KKRT:
+      return {512, 1 << 14, 1 << 12, 0.03, 1 << 16};
+    case v2::PROTOCOL_RR22:
+      return {256, 1 << 17, 1 << 14, 0.05, 1 << 16};
+    default:
+      YACL_THROW("adaptive bucket size is not supported by protocol {}",
+                 v2::Protocol_Name(protocol));
+  }
+}
+
+double GetBucketNumCost(const BucketCostModel& model, size_t items_count,
+                        size_t bucket_num, size_t thread_num) {
+  double bucket_size = std::ceil(static_cast<double>(items_count) / bucket_num);
+  double threads = std::clamp(bucket_size / model.items_per_thread, 1.0,
+                              static_cast<double>(thread_num));
+  double item_cost =
+      1 + model.cache_penalty *
+              std::max(0.0, std::log2(bucket_size / model.cached_items));
+  return bucket_num *
+         (model.bucket_overhead + bucket_size * item_cost / threads);
+}
+
+// Digest items carry no data, and are broadcast as their raw digest.
+std::string GetBucketItemKey(const HashBucketCache::BucketItem& item) {
+  if (item.is_digest) {
+    return std::string(reinterpret_cast<const char*>(&item.sec_hash),
+                       sizeof(uint128_t));
+  }
+  return item.data;
+}
+
+uint128_t ParseItemDigest(const std::string& key) {
+  YACL_ENFORCE(key.size() == sizeof(uint128_t),
+               "unexpected digest size={} in result", key.size());
+  uint128_t digest;
+  std::memcpy(&digest, key.data(), sizeof(uint128_t));
+  return digest;
+}
+
+// Digests are uniformly distributed already.
+struct DigestHash {
+  size_t operator()(uint128_t digest) const {
+    return static_cast<size_t>(digest);
+  }
+};
+
+template <typename Map, typename Key>
+void WriteSenderResult(
+    const std::vector<HashBucketCache::BucketItem>& bucket_items_list,
+    const Map& peer_result, Key HashBucketCache::BucketItem::*key,
+    IndexWriter* writer) {
+  for (const auto& item : bucket_items_list) {
+    auto iter = peer_result.find(item.*key);
+    if (iter != peer_result.end()) {
+      writer->WriteCache(item.index, iter->second);
+    }
+  }
+}
+
+}  // namespace
+
 void CalcBucketItemSecHash(std::vector<HashBucketCache::BucketItem>& items) {
   yacl::parallel_for(0, items.size(), [&](int64_t begin, int64_t end) {
     for (int64_t i = begin; i < end; ++i) {
-      items[i].sec_hash = yacl::crypto::Blake3_128(items[i].base64_data);
+      items[i].sec_hash = GetBucketItemSecHash(items[i]);
     }
   });
 }
 
+uint128_t GetBucketItemSecHash(const HashBucketCache::BucketItem& item) {
+  if (item.is_digest) {
+    return item.sec_hash;
+  }
+  return yacl::crypto::Blake3_128(item.data);
+}
+
 std::optional<std::vector<HashBucketCache::BucketItem>> PrepareBucketData(
     v2::Protocol protocol, size_t bucket_idx,
     const std::shared_ptr<yacl::link::Context>& lctx,
@@ -78,23 +172,22 @@ void HandleBucketResultBySender(
     if (result_list.empty()) {
       return;
     }
-    std::unordered_map<std::string, uint32_t> peer_result;
-    for (size_t i = 0; i != result_list.size(); ++i) {
-      peer_result[result_list[i]] = duplicate_item_cnt[i];
-    }
-
-    if (result_list.size() == bucket_items_list.size()) {
-      for (const auto& item : bucket_items_list) {
-        writer->WriteCache(item.index, peer_result[item.base64_data]);
+    bool digest_items =
+        !bucket_items_list.empty() && bucket_items_list.front().is_digest;
+    if (digest_items) {
+      std::unordered_map<uint128_t, uint32_t, DigestHash> peer_result;
+      for (size_t i = 0; i != result_list.size(); ++i) {
+        peer_result[ParseItemDigest(result_list[i])] = duplicate_item_cnt[i];
       }
+      WriteSenderResult(bucket_items_list, peer_result,
+                        &HashBucketCache::BucketItem::sec_hash, writer);
     } else {
-      std::sort(result_list.begin(), result_list.end());
-      for (const auto& item : bucket_items_list) {
-        auto iter = peer_result.find(item.base64_data);
-        if (iter != peer_result.end()) {
-          writer->WriteCache(item.index, iter->second);
-        }
+      std::unordered_map<std::string, uint32_t> peer_result;
+      for (size_t i = 0; i != result_list.size(); ++i) {
+        peer_result[result_list[i]] = duplicate_item_cnt[i];
       }
+      WriteSenderResult(bucket_items_list, peer_result,
+                        &HashBucketCache::BucketItem::data, writer);
     }
 
     writer->Commit();
@@ -119,7 +212,7 @@ void HandleBucketResultByReceiver(
     item_data_list.reserve(result_list.size());
     std::unordered_map<uint32_t, uint32_t> duplicate_item_cnt;
     for (size_t i = 0; i != result_list.size(); ++i) {
-      item_data_list.emplace_back(result_list[i].base64_data);
+      item_data_list.emplace_back(GetBucketItemKey(result_list[i]));
       if (result_list[i].extra_dup_cnt > 0) {
         duplicate_item_cnt[i] = result_list[i].extra_dup_cnt;
       }
@@ -176,4 +269,126 @@ size_t NegotiateBucketNum(const std::shared_ptr<yacl::link::Context>& lctx,
   return max_bucket_count;
 }
 
+BucketResource GetBucketResource(uint64_t memory_budget_mb,
+                                 size_t concurrency) {
+  concurrency = std::max<size_t>(concurrency, 1);
+  uint64_t memory_budget = memory_budget_mb > 0 ? memory_budget_mb << 20
+                                                : GetMemoryLimit() / 2;
+  size_t thread_num = std::max(GetCpuCount(), 1);
+
+  BucketResource resource;
+  resource.memory_budget = memory_budget / concurrency;
+  resource.thread_num = std::max<size_t>(thread_num / concurrency, 1);
+  return resource;
+}
+
+size_t GetAdaptiveBucketNum(size_t items_count, const BucketResource& resource,
+                            v2::Protocol protocol) {
+  if (items_count == 0) {
+    return 0;
+  }
+  auto model = GetBucketCostModel(protocol);
+  YACL_ENFORCE(resource.memory_budget > 0, "memory budget is 0");
+
+  double max_bucket_size =
+      std::max(resource.memory_budget /
+                   (model.bytes_per_item + resource.extra_bytes_per_item),
+               1.0);
+  auto min_bucket_num = static_cast<size_t>(
+      std::ceil(static_cast<double>(items_count) / max_bucket_size));
+  min_bucket_num = std::clamp<size_t>(min_bucket_num, 1, items_count);
+  // more buckets than this never pay off their overhead.
+  size_t max_bucket_num = std::max(
+      min_bucket_num,
+      static_cast<size_t>(items_count / model.items_per_thread) + 1);
+
+  size_t best_num = min_bucket_num;
+  double best_cost =
+      GetBucketNumCost(model, items_count, best_num, resource.thread_num);
+  for (size_t num = min_bucket_num + 1; num <= max_bucket_num;
+       num = std::max(num + 1, num * 17 / 16)) {
+    double cost =
+        GetBucketNumCost(model, items_count, num, resource.thread_num);
+    if (cost < best_cost) {
+      best_cost = cost;
+      best_num = num;
+    }
+  }
+  return best_num;
+}
+
+size_t NegotiateBucketNum(const std::shared_ptr<yacl::link::Context>& lctx,
+                          size_t self_items_count,
+                          const BucketResource& self_resource,
+                          v2::Protocol protocol) {
+  std::vector<size_t> items_size_list =
+      AllGatherItemsSize(lctx, self_items_count);
+  // the budgets are compared without the extra memory of each party.
+  auto model = GetBucketCostModel(protocol);
+  auto self_budget = static_cast<uint64_t>(
+      self_resource.memory_budget * model.bytes_per_item /
+      (model.bytes_per_item + self_resource.extra_bytes_per_item));
+  std::vector<size_t> memory_budget_list =
+      AllGatherItemsSize(lctx, self_budget);
+  std::vector<size_t> thread_num_list =
+      AllGatherItemsSize(lctx, self_resource.thread_num);
+
+  size_t max_item_size = 0;
+  size_t min_item_size = self_items_count;
+  BucketResource resource = self_resource;
+  resource.memory_budget = self_budget;
+  resource.extra_bytes_per_item = 0;
+  for (size_t idx = 0; idx < items_size_list.size(); idx++) {
+    SPDLOG_INFO(
+        "psi protocol={}, rank={} item_size={}, memory_budget={}, "
+        "thread_num={}",
+        protocol, idx, items_size_list[idx], memory_budget_list[idx],
+        thread_num_list[idx]);
+    max_item_size = std::max(max_item_size, items_size_list[idx]);
+    min_item_size = std::min(min_item_size, items_size_list[idx]);
+    resource.memory_budget =
+        std::min<uint64_t>(resource.memory_budget, memory_budget_list[idx]);
+    resource.thread_num = std::min(resource.thread_num, thread_num_list[idx]);
+  }
+
+  // one party item_size is 0, no need to do intersection
+  if (min_item_size == 0) {
+    SPDLOG_INFO("psi protocol={}, min_item_size=0", protocol);
+    return 0;
+  }
+
+  size_t bucket_num = GetAdaptiveBucketNum(max_item_size, resource, protocol);
+  SPDLOG_INFO("psi protocol={}, adaptive bucket_num={}, bucket_size={}",
+              protocol, bucket_num,
+              (max_item_size + bucket_num - 1) / bucket_num);
+  return bucket_num;
+}
+
+size_t RecoverBucketNum(const std::shared_ptr<yacl::link::Context>& lctx,
+                        RecoveryManager* recovery_manager, size_t bucket_num) {
+  if (recovery_manager == nullptr) {
+    return bucket_num;
+  }
+  std::vector<size_t> saved_list =
+      AllGatherItemsSize(lctx, recovery_manager->checkpoint().bucket_num());
+  size_t saved = 0;
+  for (size_t num : saved_list) {
+    if (num == 0) {
+      continue;
+    }
+    YACL_ENFORCE(saved == 0 || saved == num,
+                 "bucket numbers saved by the parties differ: {} vs {}", saved,
+                 num);
+    saved = num;
+  }
+  if (saved == 0) {
+    saved = bucket_num;
+  } else if (saved != bucket_num) {
+    SPDLOG_WARN("keep bucket_num={} of the recovered run instead of {}",
+                saved, bucket_num);
+  }
+  recovery_manager->UpdateBucketNum(saved);
+  return saved;
+}
+
 }  // namespace psi
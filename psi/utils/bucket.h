@@ -28,6 +28,9 @@ constexpr uint64_t kDefaultBucketSize = 1 << 20;
 
 void CalcBucketItemSecHash(std::vector<HashBucketCache::BucketItem>& items);
 
+// Digest items carry their hash already, others are hashed here.
+uint128_t GetBucketItemSecHash(const HashBucketCache::BucketItem& item);
+
 std::optional<std::vector<HashBucketCache::BucketItem>> PrepareBucketData(
     v2::Protocol protocol, size_t bucket_idx,
     const std::shared_ptr<yacl::link::Context>& lctx,
@@ -53,4 +56,43 @@ bool HashListEqualTest(const std::vector<yacl::Buffer>& hash_list);
 size_t NegotiateBucketNum(const std::shared_ptr<yacl::link::Context>& lctx,
                           size_t self_items_count, size_t self_bucket_size,
                           int psi_type);
+
+// Resources a party gives to the buckets of a protocol.
+struct BucketResource {
+  // Bytes a bucket may take.
+  uint64_t memory_budget = 0;
+
+  // Threads working on a bucket.
+  size_t thread_num = 1;
+
+  // Bytes per item of a bucket kept outside of it and counted in
+  // memory_budget, e.g. correlations generated ahead.
+  uint64_t extra_bytes_per_item = 0;
+};
+
+// Resources of this host for each of the concurrency buckets processed at the
+// same time. If memory_budget_mb is 0, half of the memory limit is used.
+BucketResource GetBucketResource(uint64_t memory_budget_mb,
+                                 size_t concurrency = 1);
+
+// The bucket number of items_count items which costs the least in the model
+// of protocol, with each bucket fitting in the memory budget. The model
+// weighs the fixed overhead of a bucket against the slowdown of large ones.
+size_t GetAdaptiveBucketNum(size_t items_count, const BucketResource& resource,
+                            v2::Protocol protocol);
+
+// Negotiates the bucket number from the resources of all parties instead of a
+// bucket size: the largest input and the smallest budget and thread number
+// decide the number. Returns 0 if one party has no items.
+size_t NegotiateBucketNum(const std::shared_ptr<yacl::link::Context>& lctx,
+                          size_t self_items_count,
+                          const BucketResource& self_resource,
+                          v2::Protocol protocol);
+
+// The bucket number of a run resumed by recovery_manager, whose buckets are
+// partly processed already, agreed by all parties. Otherwise saves and
+// returns bucket_num. Returns bucket_num if recovery_manager is nullptr.
+size_t RecoverBucketNum(const std::shared_ptr<yacl::link::Context>& lctx,
+                        RecoveryManager* recovery_manager, size_t bucket_num);
+
 }  // namespace psi
@@ -0,0 +1,139 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "psi/utils/bucket.h"
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <future>
+#include <string>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "yacl/link/test_util.h"
+
+namespace psi {
+
+TEST(AdaptiveBucketNumTest, FitsMemoryBudget) {
+  constexpr size_t kItems = 100'000'000;
+  size_t last_num = kItems;
+  for (uint64_t budget_mb : {64, 256, 1024, 4096, 65536}) {
+    BucketResource resource;
+    resource.memory_budget = budget_mb << 20;
+    resource.thread_num = 8;
+    for (auto protocol : {v2::PROTOCOL_KKRT, v2::PROTOCOL_RR22}) {
+      size_t num = GetAdaptiveBucketNum(kItems, resource, protocol);
+      ASSERT_GT(num, 0U);
+      // no more than 512 bytes per item in any model.
+      EXPECT_LE((kItems + num - 1) / num * 512, resource.memory_budget * 2);
+    }
+    size_t num = GetAdaptiveBucketNum(kItems, resource, v2::PROTOCOL_RR22);
+    // more memory never needs more buckets.
+    EXPECT_LE(num, last_num);
+    last_num = num;
+  }
+  // per bucket overhead keeps large buckets when memory allows.
+  EXPECT_LT(last_num, 64U);
+}
+
+TEST(AdaptiveBucketNumTest, SmallInput) {
+  BucketResource resource;
+  resource.memory_budget = 1 << 30;
+  resource.thread_num = 4;
+  EXPECT_EQ(GetAdaptiveBucketNum(0, resource, v2::PROTOCOL_RR22), 0U);
+  EXPECT_EQ(GetAdaptiveBucketNum(1000, resource, v2::PROTOCOL_RR22), 1U);
+  EXPECT_EQ(GetAdaptiveBucketNum(1000, resource, v2::PROTOCOL_KKRT), 1U);
+  EXPECT_ANY_THROW(GetAdaptiveBucketNum(1000, resource, v2::PROTOCOL_ECDH));
+}
+
+TEST(AdaptiveBucketNumTest, ExtraMemory) {
+  constexpr size_t kItems = 100'000'000;
+  BucketResource resource;
+  resource.memory_budget = 256 << 20;
+  resource.thread_num = 8;
+  size_t num = GetAdaptiveBucketNum(kItems, resource, v2::PROTOCOL_RR22);
+  // memory kept outside the buckets leaves less to each of them.
+  resource.extra_bytes_per_item = 256;
+  EXPECT_GT(GetAdaptiveBucketNum(kItems, resource, v2::PROTOCOL_RR22), num);
+}
+
+TEST(AdaptiveBucketNumTest, Negotiate) {
+  auto lctxs = yacl::link::test::SetupWorld(2);
+
+  BucketResource resource_a;
+  resource_a.memory_budget = 256 << 20;
+  resource_a.thread_num = 16;
+  BucketResource resource_b;
+  resource_b.memory_budget = 1 << 30;
+  resource_b.thread_num = 2;
+
+  auto num_a = std::async([&] {
+    return NegotiateBucketNum(lctxs[0], 20'000'000, resource_a,
+                              v2::PROTOCOL_RR22);
+  });
+  auto num_b = std::async([&] {
+    return NegotiateBucketNum(lctxs[1], 50'000'000, resource_b,
+                              v2::PROTOCOL_RR22);
+  });
+
+  BucketResource smaller;
+  smaller.memory_budget = resource_a.memory_budget;
+  smaller.thread_num = resource_b.thread_num;
+  size_t expected =
+      GetAdaptiveBucketNum(50'000'000, smaller, v2::PROTOCOL_RR22);
+  EXPECT_EQ(num_a.get(), expected);
+  EXPECT_EQ(num_b.get(), expected);
+}
+
+TEST(AdaptiveBucketNumTest, NegotiateEmpty) {
+  auto lctxs = yacl::link::test::SetupWorld(2);
+
+  BucketResource resource;
+  resource.memory_budget = 1 << 30;
+  auto num_a = std::async([&] {
+    return NegotiateBucketNum(lctxs[0], 0, resource, v2::PROTOCOL_KKRT);
+  });
+  auto num_b = std::async([&] {
+    return NegotiateBucketNum(lctxs[1], 1000, resource, v2::PROTOCOL_KKRT);
+  });
+  EXPECT_EQ(num_a.get(), 0U);
+  EXPECT_EQ(num_b.get(), 0U);
+}
+
+TEST(RecoverBucketNumTest, KeepsSavedNum) {
+  auto lctxs = yacl::link::test::SetupWorld(2);
+  auto folder = std::filesystem::temp_directory_path() /
+                ("recover_bucket_num_test_" + std::to_string(getpid()));
+
+  using NumPair = std::pair<size_t, size_t>;
+  auto recover = [&](size_t num_a, size_t num_b) {
+    RecoveryManager manager_a((folder / "a").string());
+    RecoveryManager manager_b((folder / "b").string());
+    auto f_a = std::async(
+        [&] { return RecoverBucketNum(lctxs[0], &manager_a, num_a); });
+    auto f_b = std::async(
+        [&] { return RecoverBucketNum(lctxs[1], &manager_b, num_b); });
+    return NumPair(f_a.get(), f_b.get());
+  };
+
+  EXPECT_EQ(recover(7, 7), NumPair(7, 7));
+  // resources changed on restart.
+  EXPECT_EQ(recover(9, 9), NumPair(7, 7));
+  EXPECT_EQ(RecoverBucketNum(lctxs[0], nullptr, 9), 9U);
+
+  std::filesystem::remove_all(folder);
+}
+
+}  // namespace psi
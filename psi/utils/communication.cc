@@ -14,11 +14,128 @@
 
 #include "psi/utils/communication.h"
 
+#include <utility>
+
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/wire_format_lite.h"
 #include "spdlog/spdlog.h"
 #include "yacl/base/exception.h"
 
 namespace psi {
 
+namespace {
+
+using google::protobuf::internal::WireFormatLite;
+
+// Field numbers of PsiDataBatchProto.
+constexpr int kItemNumField = 1;
+constexpr int kFlattenBytesField = 2;
+constexpr int kIsLastBatchField = 3;
+constexpr int kBatchIndexField = 4;
+constexpr int kTypeField = 5;
+constexpr int kDuplicateItemCntField = 6;
+
+// Map entries are encoded as messages with key = 1 and value = 2.
+std::pair<uint32_t, uint32_t> ReadMapEntry(
+    google::protobuf::io::CodedInputStream* input) {
+  uint32_t length = 0;
+  YACL_ENFORCE(input->ReadVarint32(&length), "bad PsiDataBatch map entry");
+  auto limit = input->PushLimit(static_cast<int>(length));
+  std::pair<uint32_t, uint32_t> entry{0, 0};
+  while (uint32_t tag = input->ReadTag()) {
+    switch (WireFormatLite::GetTagFieldNumber(tag)) {
+      case 1:
+        YACL_ENFORCE(input->ReadVarint32(&entry.first),
+                     "bad PsiDataBatch map key");
+        break;
+      case 2:
+        YACL_ENFORCE(input->ReadVarint32(&entry.second),
+                     "bad PsiDataBatch map value");
+        break;
+      default:
+        YACL_ENFORCE(WireFormatLite::SkipField(input, tag),
+                     "bad PsiDataBatch map entry");
+    }
+  }
+  input->PopLimit(limit);
+  return entry;
+}
+
+}  // namespace
+
+// Walks the wire format of PsiDataBatchProto by hand, so that flatten_bytes
+// is only located in `buf` instead of being copied out by the proto parser.
+PsiDataBatchView PsiDataBatchView::Deserialize(yacl::Buffer buf) {
+  PsiDataBatchView batch;
+  batch.buf_ = std::move(buf);
+
+  const auto* data = batch.buf_.data<uint8_t>();
+  google::protobuf::io::CodedInputStream input(
+      data, static_cast<int>(batch.buf_.size()));
+  while (uint32_t tag = input.ReadTag()) {
+    uint32_t value = 0;
+    switch (WireFormatLite::GetTagFieldNumber(tag)) {
+      case kItemNumField:
+        YACL_ENFORCE(input.ReadVarint32(&batch.item_num),
+                     "bad PsiDataBatch item_num");
+        break;
+      case kFlattenBytesField: {
+        YACL_ENFORCE(input.ReadVarint32(&value),
+                     "bad PsiDataBatch flatten_bytes");
+        batch.flatten_bytes_offset_ = input.CurrentPosition();
+        batch.flatten_bytes_size_ = value;
+        YACL_ENFORCE(input.Skip(static_cast<int>(value)),
+                     "bad PsiDataBatch flatten_bytes");
+        break;
+      }
+      case kIsLastBatchField:
+        YACL_ENFORCE(input.ReadVarint32(&value),
+                     "bad PsiDataBatch is_last_batch");
+        batch.is_last_batch = value != 0;
+        break;
+      case kBatchIndexField:
+        YACL_ENFORCE(input.ReadVarint32(&value),
+                     "bad PsiDataBatch batch_index");
+        batch.batch_index = static_cast<int32_t>(value);
+        break;
+      case kTypeField:
+        YACL_ENFORCE(input.ReadVarint32(&value), "bad PsiDataBatch type");
+        YACL_ENFORCE(input.ReadString(&batch.type, static_cast<int>(value)),
+                     "bad PsiDataBatch type");
+        break;
+      case kDuplicateItemCntField: {
+        auto [k, v] = ReadMapEntry(&input);
+        batch.duplicate_item_cnt[k] = v;
+        break;
+      }
+      default:
+        YACL_ENFORCE(WireFormatLite::SkipField(&input, tag),
+                     "bad PsiDataBatch field {}",
+                     WireFormatLite::GetTagFieldNumber(tag));
+    }
+  }
+  YACL_ENFORCE(input.ConsumedEntireMessage() &&
+                   input.CurrentPosition() ==
+                       static_cast<int>(batch.buf_.size()),
+               "bad PsiDataBatch");
+  YACL_ENFORCE(batch.item_num == 0 ||
+                   batch.flatten_bytes_size_ % batch.item_num == 0,
+               "PsiDataBatch flatten_bytes size {} is not a multiple of "
+               "item_num {}",
+               batch.flatten_bytes_size_, batch.item_num);
+
+  return batch;
+}
+
+std::vector<std::string_view> PsiDataBatchView::Items() const {
+  std::vector<std::string_view> items;
+  items.reserve(item_num);
+  for (size_t i = 0; i < item_num; ++i) {
+    items.push_back(item(i));
+  }
+  return items;
+}
+
 std::shared_ptr<yacl::link::Context> CreateP2PLinkCtx(
     const std::string& id_prefix,
     const std::shared_ptr<yacl::link::Context>& link_ctx, size_t peer_rank) {
@@ -17,7 +17,9 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include "yacl/base/buffer.h"
 #include "yacl/link/link.h"
@@ -101,6 +103,44 @@ struct PsiDataBatch {
   }
 };
 
+// Read-only view of a received PsiDataBatch. It keeps the received buffer and
+// exposes the fixed width items as string_views into it, so no per item
+// strings are allocated on the receiving side.
+class PsiDataBatchView {
+ public:
+  PsiDataBatchView() = default;
+
+  static PsiDataBatchView Deserialize(yacl::Buffer buf);
+
+  std::string_view flatten_bytes() const {
+    return {buf_.data<char>() + flatten_bytes_offset_, flatten_bytes_size_};
+  }
+
+  size_t item_size() const {
+    return item_num == 0 ? 0 : flatten_bytes_size_ / item_num;
+  }
+
+  std::string_view item(size_t idx) const {
+    return flatten_bytes().substr(idx * item_size(), item_size());
+  }
+
+  // Views are valid as long as this batch is alive.
+  std::vector<std::string_view> Items() const;
+
+  bool empty() const { return item_num == 0; }
+
+  uint32_t item_num = 0;
+  int32_t batch_index = 0;
+  bool is_last_batch = false;
+  std::string type;
+  std::unordered_map<uint32_t, uint32_t> duplicate_item_cnt;
+
+ private:
+  yacl::Buffer buf_;
+  size_t flatten_bytes_offset_ = 0;
+  size_t flatten_bytes_size_ = 0;
+};
+
 std::shared_ptr<yacl::link::Context> CreateP2PLinkCtx(
     const std::string& id_prefix,
     const std::shared_ptr<yacl::link::Context>& link_ctx, size_t peer_rank);
@@ -0,0 +1,64 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "psi/utils/communication.h"
+
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace psi {
+
+TEST(PsiDataBatchViewTest, Works) {
+  PsiDataBatch batch;
+  batch.item_num = 3;
+  batch.flatten_bytes = "aaabbbccc";
+  batch.batch_index = 7;
+  batch.is_last_batch = false;
+  batch.type = "enc";
+  batch.duplicate_item_cnt = {{1, 5}, {2, 9}};
+
+  auto view = PsiDataBatchView::Deserialize(batch.Serialize());
+
+  EXPECT_EQ(view.item_num, 3);
+  EXPECT_EQ(view.batch_index, 7);
+  EXPECT_FALSE(view.is_last_batch);
+  EXPECT_EQ(view.type, "enc");
+  EXPECT_EQ(view.duplicate_item_cnt, batch.duplicate_item_cnt);
+  EXPECT_EQ(view.item_size(), 3);
+  EXPECT_EQ(view.Items(),
+            std::vector<std::string_view>({"aaa", "bbb", "ccc"}));
+}
+
+TEST(PsiDataBatchViewTest, Empty) {
+  PsiDataBatch batch;
+  batch.batch_index = 2;
+  batch.is_last_batch = true;
+
+  auto view = PsiDataBatchView::Deserialize(batch.Serialize());
+
+  EXPECT_TRUE(view.empty());
+  EXPECT_TRUE(view.is_last_batch);
+  EXPECT_EQ(view.batch_index, 2);
+  EXPECT_TRUE(view.Items().empty());
+}
+
+TEST(PsiDataBatchViewTest, BadBuffer) {
+  std::string junk = "\xff\xff\xff";
+  EXPECT_ANY_THROW(
+      PsiDataBatchView::Deserialize(yacl::Buffer(junk.data(), junk.size())));
+}
+
+}  // namespace psi
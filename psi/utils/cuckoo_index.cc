@@ -14,11 +14,39 @@
 
 #include "psi/utils/cuckoo_index.h"
 
+#include <algorithm>
 #include <cmath>
 #include <set>
 
+#include "yacl/utils/parallel.h"
+
 namespace psi {
 
+namespace {
+
+// Bins filled by one thread at least, smaller tables are built serially.
+constexpr size_t kMinBinsPerPart = 1 << 14;
+
+// Stash needed by 2-way hashing with 2.4n bins for a failure probability of
+// 2^-40, from PSZ18 (https://eprint.iacr.org/2016/930.pdf) table 3.
+uint64_t TwoWayStashSize(uint64_t n) {
+  if (n <= (1 << 8)) {
+    return 12;
+  }
+  if (n <= (1 << 12)) {
+    return 6;
+  }
+  if (n <= (1 << 16)) {
+    return 4;
+  }
+  if (n <= (1 << 20)) {
+    return 3;
+  }
+  return 2;
+}
+
+}  // namespace
+
 CuckooIndex::CuckooIndex(const Options& options) : options_(options) {
   bins_.resize(options_.NumBins());
   stash_.resize(options_.num_stash);
@@ -46,6 +74,13 @@ void CuckooIndex::Insert(absl::Span<const HashType> codes) {
     candidates[i].set_encoded(input_offset + i);
   }
 
+  size_t num_parts = std::min<size_t>(yacl::get_num_threads(),
+                                      num_bins / kMinBinsPerPart);
+  if (num_parts > 1 && size >= num_bins / 4) {
+    candidates = InsertPartitioned(std::move(candidates), num_parts);
+  }
+
+  // Evict serially whatever the partitions left.
   size_t try_count = 0;
   std::vector<Bin> evicted;
 
@@ -72,6 +107,61 @@ void CuckooIndex::Insert(absl::Span<const HashType> codes) {
   }
 }
 
+std::vector<CuckooIndex::Bin> CuckooIndex::InsertPartitioned(
+    std::vector<Bin> candidates, size_t num_parts) {
+  const size_t num_bins = options_.NumBins();
+  const size_t part_bins = (num_bins + num_parts - 1) / num_parts;
+  auto target_bin = [&](const Bin& candid) {
+    return hashes_[candid.InputIdx()].GetHash(candid.HashIdx()) % num_bins;
+  };
+
+  std::vector<std::vector<Bin>> parts(num_parts);
+  for (auto& part : parts) {
+    part.reserve(candidates.size() / num_parts);
+  }
+  for (const Bin& candid : candidates) {
+    parts[target_bin(candid) / part_bins].push_back(candid);
+  }
+
+  // Each thread only writes the bins of its own part, an evicted item whose
+  // next bin falls into another part is left to the serial pass.
+  std::vector<std::vector<Bin>> left(num_parts);
+  yacl::parallel_for(0, num_parts, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t part_idx = begin; part_idx < end; ++part_idx) {
+      auto& part = parts[part_idx];
+      size_t try_count = 0;
+      while (!part.empty() && try_count++ < options_.max_try_count) {
+        size_t write_idx = 0;
+        for (size_t i = 0; i < part.size(); ++i) {
+          const Bin candid = part[i];
+          Bin evicted_bin =
+              Bin(bins_[target_bin(candid)].Swap(candid.encoded()));
+          if (evicted_bin.IsEmpty()) {
+            continue;
+          }
+          Bin next_candid(
+              Bin::Encode(evicted_bin.InputIdx(),
+                          (evicted_bin.HashIdx() + 1) % options_.num_hash));
+          if (target_bin(next_candid) / part_bins ==
+              static_cast<size_t>(part_idx)) {
+            part[write_idx++] = next_candid;
+          } else {
+            left[part_idx].push_back(next_candid);
+          }
+        }
+        part.resize(write_idx);
+      }
+      left[part_idx].insert(left[part_idx].end(), part.begin(), part.end());
+    }
+  });
+
+  candidates.clear();
+  for (const auto& part : left) {
+    candidates.insert(candidates.end(), part.begin(), part.end());
+  }
+  return candidates;
+}
+
 void CuckooIndex::PutToStash(uint64_t input_idx) {
   // `stash` is small enough to do a linear search.
   for (auto& s : stash_) {
@@ -114,7 +204,7 @@ CuckooIndex::Options CuckooIndex::SelectParams(uint64_t n, uint64_t stash_size,
                                                uint64_t stat_sec_param) {
   auto h = hash_num != 0 ? hash_num : 3;
 
-  if (stash_size == 0 && h == 3) {
+  if (h == 3) {
     double a = 240;
     double b = -std::log2(n) - 256;
 
@@ -126,7 +216,19 @@ CuckooIndex::Options CuckooIndex::SelectParams(uint64_t n, uint64_t stash_size,
     //   e = (statSecParam - b) / a
     //
 
-    return CuckooIndex::Options{n, 0, h, e};
+    // A stash only lowers the failure probability further.
+    return CuckooIndex::Options{n, stash_size, h, e};
+  }
+
+  if (h == 4) {
+    // PSZ18 reports 1.09n bins for 4-way stashless hashing, keep some room
+    // for the bounded number of evictions per insert.
+    return CuckooIndex::Options{n, stash_size, h, 1.15};
+  }
+
+  if (h == 2) {
+    return CuckooIndex::Options{n, std::max(stash_size, TwoWayStashSize(n)),
+                                h, 2.4};
   }
 
   YACL_THROW("not support for stash_size={} and hash_num={}", stash_size,
@@ -139,12 +139,20 @@ class CuckooIndex {
   // For debug only.
   void SanityCheck() const;
 
+  // Supports 2, 3 or 4 hash functions. 2-way hashing always needs a stash,
+  // the returned `num_stash` may be larger than `stash_size`.
   static Options SelectParams(uint64_t n, uint64_t stash_size,
                               uint64_t hash_num, uint64_t stat_sec_param = 40);
 
   uint8_t MinCollidingHashIdx(uint64_t bin_index) const;
 
  private:
+  // Places candidates with the bins split into `num_parts` ranges, each range
+  // filled by its own thread. Returns the candidates left out, whose
+  // eviction chain crosses into another range.
+  std::vector<Bin> InsertPartitioned(std::vector<Bin> candidates,
+                                     size_t num_parts);
+
   void PutToStash(uint64_t input_idx);
 
   const Options options_;
@@ -16,6 +16,7 @@
 
 #include <algorithm>
 #include <random>
+#include <tuple>
 
 #include "gtest/gtest.h"
 #include "yacl/crypto/rand/rand.h"
@@ -68,6 +69,38 @@ INSTANTIATE_TEST_SUITE_P(
         CuckooIndex::Options{(1 << 0), 0, 3, 1.2}         // dummy
         ));
 
+class CuckooIndexSelectParamsTest
+    : public testing::TestWithParam<std::tuple<uint64_t, uint64_t>> {};
+
+TEST_P(CuckooIndexSelectParamsTest, Works) {
+  auto [num_input, num_hash] = GetParam();
+  auto param = CuckooIndex::SelectParams(num_input, 0, num_hash);
+  EXPECT_EQ(param.num_hash, num_hash);
+  if (num_hash == 2) {
+    EXPECT_GT(param.num_stash, 0U);
+  }
+
+  // Large inputs are inserted by several threads.
+  CuckooIndex cuckoo_index(param);
+  auto inputs = yacl::crypto::RandVec<uint128_t>(num_input);
+  ASSERT_NO_THROW(cuckoo_index.Insert(absl::MakeSpan(inputs)));
+  ASSERT_NO_THROW(cuckoo_index.SanityCheck());
+
+  for (size_t i = 0; i < cuckoo_index.bins().size(); ++i) {
+    const auto& bin = cuckoo_index.bins()[i];
+    if (!bin.IsEmpty()) {
+      EXPECT_EQ(cuckoo_index.hashes()[bin.InputIdx()].GetHash(bin.HashIdx()) %
+                    param.NumBins(),
+                i);
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Works_Instances, CuckooIndexSelectParamsTest,
+    testing::Combine(testing::Values(1, 100, 1 << 12, (1 << 18) + 3),
+                     testing::Values(2, 3, 4)));
+
 TEST(CuckooIndexTest, Bad_StashTooSmall) {
   CuckooIndex cuckoo_index(CuckooIndex::Options{1 << 16, 0, 3, 1.1});
   auto inputs = yacl::crypto::RandVec<uint128_t>(1 << 16);
@@ -17,11 +17,18 @@
 #include <omp.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <climits>
 #include <condition_variable>
 #include <cstdint>
+#include <cstring>
+#include <deque>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <future>
+#include <limits>
 #include <mutex>
 #include <optional>
 #include <thread>
@@ -35,15 +42,16 @@
 #include "spdlog/spdlog.h"
 
 #include "psi/utils/arrow_csv_batch_provider.h"
+#include "psi/utils/resource.h"
 
 namespace psi {
 
-void MemoryEcPointStore::Save(const std::string& ciphertext,
+void MemoryEcPointStore::Save(std::string_view ciphertext,
                               uint32_t duplicate_cnt) {
   if (duplicate_cnt > 0) {
     item_extra_dup_cnt_map_[store_.size()] = duplicate_cnt;
   }
-  store_.push_back(std::move(ciphertext));
+  store_.emplace_back(ciphertext);
   item_cnt_++;
 }
 
@@ -55,7 +63,7 @@ HashBucketEcPointStore::HashBucketEcPointStore(const std::string& cache_dir,
                                              use_scoped_tmp_dir);
 }
 
-void HashBucketEcPointStore::Save(const std::string& ciphertext,
+void HashBucketEcPointStore::Save(std::string_view ciphertext,
                                   uint32_t duplicate_cnt) {
   cache_->WriteItem(ciphertext, duplicate_cnt);
 }
@@ -64,32 +72,165 @@ uint64_t HashBucketEcPointStore::ItemCount() { return cache_->ItemCount(); }
 
 HashBucketEcPointStore::~HashBucketEcPointStore() { Flush(); }
 
-std::vector<uint64_t> FinalizeAndComputeIndices(
-    const std::shared_ptr<HashBucketEcPointStore>& self,
-    const std::shared_ptr<HashBucketEcPointStore>& peer) {
+namespace {
+
+// Open addressing hash set over the first 8 bytes of items. Items are
+// referenced by their positions, full items are compared only when prefixes
+// match.
+class PrefixHashSet {
+ public:
+  explicit PrefixHashSet(const HashBucketCache::BucketView& items)
+      : items_(items) {
+    YACL_ENFORCE(items_.size() < kEmpty, "too many items in one bin: {}",
+                 items_.size());
+    size_t bits = 4;
+    while ((size_t{1} << bits) < items_.size() * 2) {
+      bits++;
+    }
+    shift_ = 64 - bits;
+    mask_ = (size_t{1} << bits) - 1;
+    slots_.resize(size_t{1} << bits, Slot{0, kEmpty});
+    for (uint32_t i = 0; i < items_.size(); ++i) {
+      uint64_t prefix = Prefix(items_.Data(i));
+      size_t pos = Position(prefix);
+      while (slots_[pos].item_idx != kEmpty) {
+        pos = (pos + 1) & mask_;
+      }
+      slots_[pos] = Slot{prefix, i};
+    }
+  }
+
+  // Returns meta of the first inserted item equals to `data`, or nullptr.
+  const HashBucketCache::ItemMeta* Find(std::string_view data) const {
+    uint64_t prefix = Prefix(data);
+    for (size_t pos = Position(prefix); slots_[pos].item_idx != kEmpty;
+         pos = (pos + 1) & mask_) {
+      const auto& slot = slots_[pos];
+      if (slot.prefix == prefix && items_.Data(slot.item_idx) == data) {
+        return &items_.Meta(slot.item_idx);
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  static constexpr uint32_t kEmpty = std::numeric_limits<uint32_t>::max();
+
+  struct Slot {
+    uint64_t prefix;
+    uint32_t item_idx;
+  };
+
+  static uint64_t Prefix(std::string_view data) {
+    uint64_t prefix = 0;
+    std::memcpy(&prefix, data.data(), std::min(sizeof(prefix), data.size()));
+    return prefix ^ data.size();
+  }
+
+  // High bits of fibonacci hashing, leading bytes of ciphertext (e.g. the
+  // compression flag of ec points) may not be random.
+  size_t Position(uint64_t prefix) const {
+    return (prefix * 0x9E3779B97F4A7C15ULL) >> shift_;
+  }
+
+  const HashBucketCache::BucketView& items_;
+  std::vector<Slot> slots_;
+  size_t shift_;
+  size_t mask_;
+};
+
+struct BinJoinResult {
+  // self item index, peer extra duplicate count.
+  std::vector<std::pair<uint64_t, uint32_t>> matches;
+  uint64_t peer_total_cnt = 0;
+  uint64_t peer_inter_cnt = 0;
+};
+
+BinJoinResult JoinBin(HashBucketEcPointStore* self,
+                      HashBucketEcPointStore* peer, size_t bin_idx) {
+  auto peer_future =
+      std::async(std::launch::async, [&] { return peer->LoadBin(bin_idx); });
+  HashBucketCache::BucketView self_items = self->LoadBin(bin_idx);
+  HashBucketCache::BucketView peer_items = peer_future.get();
+
+  BinJoinResult result;
+  for (size_t i = 0; i < peer_items.size(); ++i) {
+    result.peer_total_cnt += peer_items.Meta(i).extra_dup_cnt + 1;
+  }
+  PrefixHashSet peer_set(peer_items);
+  for (size_t i = 0; i < self_items.size(); ++i) {
+    const auto* peer_meta = peer_set.Find(self_items.Data(i));
+    if (peer_meta != nullptr) {
+      result.matches.emplace_back(self_items.Meta(i).index,
+                                  peer_meta->extra_dup_cnt);
+      result.peer_inter_cnt += peer_meta->extra_dup_cnt + 1;
+    }
+  }
+  return result;
+}
+
+// Join bins on a bounded number of workers. Bins are scheduled in order, so
+// files of following bins are loaded while former bins are being joined.
+// `consumer` is called in the order of bins.
+void JoinBins(const std::shared_ptr<HashBucketEcPointStore>& self,
+              const std::shared_ptr<HashBucketEcPointStore>& peer,
+              const BinJoinOptions& options,
+              const std::function<void(BinJoinResult)>& consumer) {
   YACL_ENFORCE_EQ(self->num_bins(), peer->num_bins());
   self->Flush();
   peer->Flush();
 
-  // Compute indices
-  std::vector<uint64_t> indices;
+  size_t thread_num = options.thread_num;
+  if (thread_num == 0) {
+    thread_num = std::max(GetCpuCount(), 1);
+  }
+  uint64_t memory_limit = options.memory_limit;
+  if (memory_limit == 0) {
+    memory_limit = GetMemoryLimit() / 8;
+  }
+  SPDLOG_INFO("Begin join {} bins, thread_num={}, memory_limit={}",
+              self->num_bins(), thread_num, memory_limit);
+
+  std::deque<std::pair<std::future<BinJoinResult>, uint64_t>> in_flight;
+  uint64_t in_flight_bytes = 0;
+  auto consume_front = [&]() {
+    auto& [future, bytes] = in_flight.front();
+    consumer(future.get());
+    in_flight_bytes -= bytes;
+    in_flight.pop_front();
+  };
+
   for (size_t bin_idx = 0; bin_idx < self->num_bins(); ++bin_idx) {
-    std::vector<HashBucketCache::BucketItem> self_results =
-        self->LoadBucketItems(bin_idx);
-    std::vector<HashBucketCache::BucketItem> peer_results =
-        peer->LoadBucketItems(bin_idx);
-    std::unordered_set<std::string> peer_set;
-    peer_set.reserve(peer_results.size());
-    std::for_each(peer_results.begin(), peer_results.end(),
-                  [&](HashBucketCache::BucketItem& item) {
-                    peer_set.insert(std::move(item.base64_data));
-                  });
-    for (const auto& item : self_results) {
-      if (peer_set.find(item.base64_data) != peer_set.end()) {
-        indices.push_back(item.index);
-      }
+    uint64_t bytes = self->BinLoadSize(bin_idx) + peer->BinLoadSize(bin_idx);
+    while (!in_flight.empty() &&
+           (in_flight.size() >= thread_num ||
+            in_flight_bytes + bytes > memory_limit)) {
+      consume_front();
     }
+    in_flight.emplace_back(std::async(std::launch::async, JoinBin, self.get(),
+                                      peer.get(), bin_idx),
+                           bytes);
+    in_flight_bytes += bytes;
+  }
+  while (!in_flight.empty()) {
+    consume_front();
   }
+  SPDLOG_INFO("End join {} bins", self->num_bins());
+}
+
+}  // namespace
+
+std::vector<uint64_t> FinalizeAndComputeIndices(
+    const std::shared_ptr<HashBucketEcPointStore>& self,
+    const std::shared_ptr<HashBucketEcPointStore>& peer,
+    const BinJoinOptions& options) {
+  // Compute indices
+  std::vector<uint64_t> indices;
+  JoinBins(self, peer, options, [&](BinJoinResult result) {
+    for (const auto& match : result.matches) {
+      indices.push_back(match.first);
+    }
+  });
   // Sort to make `FilterFileByIndices` happy.
   std::sort(indices.begin(), indices.end());
   return indices;
@@ -98,36 +239,172 @@ std::vector<uint64_t> FinalizeAndComputeIndices(
 std::pair<uint32_t, uint32_t> FinalizeAndComputeIndices(
     const std::shared_ptr<HashBucketEcPointStore>& self,
     const std::shared_ptr<HashBucketEcPointStore>& peer,
-    IndexWriter* index_writer) {
-  YACL_ENFORCE_EQ(self->num_bins(), peer->num_bins());
-  self->Flush();
-  peer->Flush();
+    IndexWriter* index_writer, const BinJoinOptions& options) {
   uint32_t peer_inter_cnt = 0;
   uint32_t peer_total_cnt = 0;
 
   // Compute indices
-  for (size_t bin_idx = 0; bin_idx < self->num_bins(); ++bin_idx) {
-    std::vector<HashBucketCache::BucketItem> self_results =
-        self->LoadBucketItems(bin_idx);
-    std::vector<HashBucketCache::BucketItem> peer_results =
-        peer->LoadBucketItems(bin_idx);
-    std::for_each(peer_results.begin(), peer_results.end(), [&](auto& item) {
-      peer_total_cnt += item.extra_dup_cnt + 1;
+  JoinBins(self, peer, options, [&](BinJoinResult result) {
+    for (const auto& [index, peer_dup_cnt] : result.matches) {
+      index_writer->WriteCache(index, peer_dup_cnt);
+    }
+    index_writer->Commit();
+    peer_total_cnt += result.peer_total_cnt;
+    peer_inter_cnt += result.peer_inter_cnt;
+  });
+  return {peer_total_cnt, peer_inter_cnt};
+}
+
+namespace {
+
+constexpr size_t kRadixBits = 8;
+constexpr size_t kRadixNum = size_t(1) << kRadixBits;
+
+struct SortEntry {
+  // First 8 bytes of the ciphertext as a big-endian integer, zero padded.
+  uint64_t prefix;
+  uint32_t index;
+};
+
+uint64_t CiphertextPrefix(std::string_view ciphertext) {
+  uint64_t prefix = 0;
+  size_t len = std::min(ciphertext.size(), sizeof(prefix));
+  for (size_t i = 0; i < len; ++i) {
+    prefix |= uint64_t(static_cast<uint8_t>(ciphertext[i]))
+              << (CHAR_BIT * (sizeof(prefix) - 1 - i));
+  }
+  return prefix;
+}
+
+size_t RadixOf(uint64_t prefix) {
+  return prefix >> (sizeof(prefix) * CHAR_BIT - kRadixBits);
+}
+
+// Runs fn(task_idx) for task_idx in [0, task_num) on at most thread_num
+// threads.
+void RunTasks(size_t task_num, size_t thread_num,
+              const std::function<void(size_t)>& fn) {
+  std::atomic<size_t> next{0};
+  std::vector<std::future<void>> futures;
+  for (size_t i = 0; i < std::min(task_num, thread_num); ++i) {
+    futures.push_back(std::async(std::launch::async, [&]() {
+      for (size_t task = next++; task < task_num; task = next++) {
+        fn(task);
+      }
+    }));
+  }
+  for (auto& f : futures) {
+    f.get();
+  }
+}
+
+// Stable parallel radix partition of `items` on RadixOf(prefix). Returns the
+// entries and the begin offset of every radix, with a trailing total.
+std::pair<std::vector<SortEntry>, std::vector<size_t>> RadixPartition(
+    const std::vector<std::string>& items, size_t thread_num) {
+  YACL_ENFORCE(items.size() <= std::numeric_limits<uint32_t>::max());
+  size_t chunk_num = std::max<size_t>(1, std::min(thread_num, items.size()));
+  size_t chunk_size = (items.size() + chunk_num - 1) / chunk_num;
+
+  std::vector<SortEntry> entries(items.size());
+  std::vector<std::array<size_t, kRadixNum>> histograms(chunk_num);
+  RunTasks(chunk_num, thread_num, [&](size_t chunk) {
+    auto& histogram = histograms[chunk];
+    histogram.fill(0);
+    size_t end = std::min(items.size(), (chunk + 1) * chunk_size);
+    for (size_t i = chunk * chunk_size; i < end; ++i) {
+      entries[i] = {CiphertextPrefix(items[i]), static_cast<uint32_t>(i)};
+      histogram[RadixOf(entries[i].prefix)]++;
+    }
+  });
+
+  // Offsets of (radix, chunk), chunks of a radix are placed in order.
+  std::vector<size_t> radix_offsets(kRadixNum + 1, 0);
+  size_t offset = 0;
+  for (size_t radix = 0; radix < kRadixNum; ++radix) {
+    radix_offsets[radix] = offset;
+    for (auto& histogram : histograms) {
+      size_t cnt = histogram[radix];
+      histogram[radix] = offset;
+      offset += cnt;
+    }
+  }
+  radix_offsets[kRadixNum] = offset;
+
+  std::vector<SortEntry> partitioned(items.size());
+  RunTasks(chunk_num, thread_num, [&](size_t chunk) {
+    auto& cursor = histograms[chunk];
+    size_t end = std::min(items.size(), (chunk + 1) * chunk_size);
+    for (size_t i = chunk * chunk_size; i < end; ++i) {
+      partitioned[cursor[RadixOf(entries[i].prefix)]++] = entries[i];
+    }
+  });
+  return {std::move(partitioned), std::move(radix_offsets)};
+}
+
+// Orders by prefix, falls back to the full ciphertext only on prefix ties.
+int CompareEntry(const SortEntry& a, const std::vector<std::string>& a_items,
+                 const SortEntry& b, const std::vector<std::string>& b_items) {
+  if (a.prefix != b.prefix) {
+    return a.prefix < b.prefix ? -1 : 1;
+  }
+  return a_items[a.index].compare(b_items[b.index]);
+}
+
+}  // namespace
+
+std::vector<uint64_t> ComputeIndices(const MemoryEcPointStore& self,
+                                     const MemoryEcPointStore& peer,
+                                     const MergeJoinOptions& options) {
+  size_t thread_num = options.thread_num;
+  if (thread_num == 0) {
+    thread_num = std::max(GetCpuCount(), 1);
+  }
+  const auto& self_items = self.content();
+  const auto& peer_items = peer.content();
+
+  auto [self_entries, self_offsets] = RadixPartition(self_items, thread_num);
+  auto [peer_entries, peer_offsets] = RadixPartition(peer_items, thread_num);
+
+  std::vector<uint8_t> matched(self_items.size(), 0);
+  RunTasks(kRadixNum, thread_num, [&](size_t radix) {
+    auto self_begin = self_entries.begin() + self_offsets[radix];
+    auto self_end = self_entries.begin() + self_offsets[radix + 1];
+    auto peer_begin = peer_entries.begin() + peer_offsets[radix];
+    auto peer_end = peer_entries.begin() + peer_offsets[radix + 1];
+    if (self_begin == self_end || peer_begin == peer_end) {
+      return;
+    }
+    std::sort(self_begin, self_end, [&](const auto& a, const auto& b) {
+      return CompareEntry(a, self_items, b, self_items) < 0;
+    });
+    std::sort(peer_begin, peer_end, [&](const auto& a, const auto& b) {
+      return CompareEntry(a, peer_items, b, peer_items) < 0;
     });
-    std::unordered_set<HashBucketCache::BucketItem,
-                       HashBucketCache::HashBucketIter>
-        peer_set(peer_results.begin(), peer_results.end());
-    for (const auto& item : self_results) {
-      auto peer = peer_set.find(item);
-      if (peer != peer_set.end()) {
-        index_writer->WriteCache(item.index, peer->extra_dup_cnt);
-        peer_inter_cnt += peer->extra_dup_cnt + 1;
+
+    auto peer_iter = peer_begin;
+    for (auto self_iter = self_begin;
+         self_iter != self_end && peer_iter != peer_end;) {
+      int cmp = CompareEntry(*self_iter, self_items, *peer_iter, peer_items);
+      if (cmp < 0) {
+        ++self_iter;
+      } else if (cmp > 0) {
+        ++peer_iter;
+      } else {
+        // Keep peer_iter, following self items may be equal duplicates.
+        matched[self_iter->index] = 1;
+        ++self_iter;
       }
     }
+  });
 
-    index_writer->Commit();
+  std::vector<uint64_t> indices;
+  for (size_t i = 0; i < matched.size(); ++i) {
+    if (matched[i] != 0) {
+      indices.push_back(i);
+    }
   }
-  return {peer_total_cnt, peer_inter_cnt};
+  return indices;
 }
 
 IntersectionIndexInfo ComputeIndicesWithDupCnt(
@@ -425,7 +702,7 @@ void UbPsiClientCacheFileStore::Flush() {
   DumpMeta();
 }
 
-void UbPsiClientCacheFileStore::Save(const std::string& ciphertext,
+void UbPsiClientCacheFileStore::Save(std::string_view ciphertext,
                                      uint32_t duplicate_cnt) {
   YACL_ENFORCE(ciphertext.size() == cipher_len_,
                "ciphertext size:{} != cipher_len:{}", ciphertext.size(),
@@ -442,9 +719,9 @@ UbPsiClientCacheMemoryStore::UbPsiClientCacheMemoryStore() = default;
 
 UbPsiClientCacheMemoryStore::~UbPsiClientCacheMemoryStore() {}
 
-void UbPsiClientCacheMemoryStore::Save(const std::string& ciphertext,
+void UbPsiClientCacheMemoryStore::Save(std::string_view ciphertext,
                                        uint32_t duplicate_cnt) {
-  cache_[ciphertext] =
+  cache_[std::string(ciphertext)] =
       CacheIndex{.index = item_cnt_, .duplicate_cnt = duplicate_cnt};
   item_cnt_++;
 }
@@ -21,6 +21,7 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -35,9 +36,9 @@ class IEcPointStore {
  public:
   virtual ~IEcPointStore() = default;
 
-  virtual void Save(const std::string& ciphertext) { Save(ciphertext, 0); }
+  virtual void Save(std::string_view ciphertext) { Save(ciphertext, 0); }
 
-  virtual void Save(const std::string& ciphertext, uint32_t duplicate_cnt) = 0;
+  virtual void Save(std::string_view ciphertext, uint32_t duplicate_cnt) = 0;
 
   virtual void Flush() = 0;
 
@@ -60,15 +61,36 @@ class IEcPointStore {
     }
   }
 
+  virtual void Save(const std::vector<std::string_view>& ciphertext) {
+    for (const auto& ct : ciphertext) {
+      Save(ct);
+    }
+  }
+
+  virtual void Save(
+      const std::vector<std::string_view>& ciphertext,
+      const std::unordered_map<uint32_t, uint32_t>& duplicate_cnt) {
+    for (uint32_t i = 0; i < ciphertext.size(); ++i) {
+      auto iter = duplicate_cnt.find(i);
+      if (iter != duplicate_cnt.end()) {
+        Save(ciphertext[i], iter->second);
+      } else {
+        Save(ciphertext[i]);
+      }
+    }
+  }
+
   virtual uint64_t ItemCount() = 0;
 };
 
 class MemoryEcPointStore : public IEcPointStore {
  public:
-  void Save(const std::string& ciphertext, uint32_t duplicate_cnt) override;
+  void Save(std::string_view ciphertext, uint32_t duplicate_cnt) override;
 
   std::vector<std::string>& content() { return store_; }
 
+  const std::vector<std::string>& content() const { return store_; }
+
   void Flush() override {}
 
   uint64_t ItemCount() override { return item_cnt_; }
@@ -87,7 +109,7 @@ class HashBucketEcPointStore : public IEcPointStore {
 
   ~HashBucketEcPointStore() override;
 
-  void Save(const std::string& ciphertext, uint32_t duplicate_cnt) override;
+  void Save(std::string_view ciphertext, uint32_t duplicate_cnt) override;
 
   [[nodiscard]] size_t num_bins() const { return num_bins_; }
 
@@ -99,6 +121,14 @@ class HashBucketEcPointStore : public IEcPointStore {
     return cache_->LoadBucketItems(bin_idx);
   };
 
+  HashBucketCache::BucketView LoadBin(size_t bin_idx) {
+    return cache_->LoadBucket(bin_idx);
+  }
+
+  uint64_t BinLoadSize(size_t bin_idx) const {
+    return cache_->BucketLoadSize(bin_idx);
+  }
+
  protected:
   std::unique_ptr<HashBucketCache> cache_;
 
@@ -123,7 +153,7 @@ class UbPsiClientCacheFileStore : public IEcPointStore {
 
   ~UbPsiClientCacheFileStore() override;
 
-  void Save(const std::string& ciphertext, uint32_t duplicate_cnt) override;
+  void Save(std::string_view ciphertext, uint32_t duplicate_cnt) override;
 
   void Flush() override;
 
@@ -160,7 +190,7 @@ class UbPsiClientCacheMemoryStore : public IEcPointStore {
 
   ~UbPsiClientCacheMemoryStore() override;
 
-  void Save(const std::string& ciphertext, uint32_t duplicate_cnt) override;
+  void Save(std::string_view ciphertext, uint32_t duplicate_cnt) override;
 
   uint64_t ItemCount() override { return item_cnt_; }
 
@@ -179,14 +209,47 @@ std::vector<uint64_t> GetIndicesByItems(
     const std::vector<std::string>& selected_fields,
     const std::vector<std::string>& items, size_t batch_size);
 
+struct BinJoinOptions {
+  // Max number of bins loaded and joined concurrently. If 0, cpu count of
+  // current cgroup is used.
+  size_t thread_num = 0;
+
+  // Max total size in bytes of bins loaded at the same time, counting
+  // decompressed blocks, see HashBucketCache::BucketLoadSize. If 0, an eighth
+  // of the memory limit is used. A bin larger than the limit is still joined,
+  // alone.
+  uint64_t memory_limit = 0;
+};
+
+// Bins are joined concurrently, results are in the order of bins, then the
+// order of self items in each bin.
 std::vector<uint64_t> FinalizeAndComputeIndices(
     const std::shared_ptr<HashBucketEcPointStore>& self,
-    const std::shared_ptr<HashBucketEcPointStore>& peer);
+    const std::shared_ptr<HashBucketEcPointStore>& peer,
+    const BinJoinOptions& options = {});
 
 std::pair<uint32_t, uint32_t> FinalizeAndComputeIndices(
     const std::shared_ptr<HashBucketEcPointStore>& self,
     const std::shared_ptr<HashBucketEcPointStore>& peer,
-    IndexWriter* index_writer);
+    IndexWriter* index_writer, const BinJoinOptions& options = {});
+
+struct MergeJoinOptions {
+  // Number of threads sorting and merging. If 0, cpu count of current cgroup
+  // is used.
+  size_t thread_num = 0;
+};
+
+// Indices of self items that are also saved in peer, in ascending order.
+//
+// Both sides are radix partitioned on the first byte of the ciphertext, each
+// partition is sorted on a fixed-width 8 byte prefix and merge joined with the
+// partition of the same radix. Partitions are independent, so sorting and
+// merging spread over `thread_num` threads. Apart from the result, memory
+// used is 16 bytes per item of both sides, twice that for the side being
+// partitioned.
+std::vector<uint64_t> ComputeIndices(const MemoryEcPointStore& self,
+                                     const MemoryEcPointStore& peer,
+                                     const MergeJoinOptions& options = {});
 
 struct IntersectionIndexInfo {
   std::vector<uint32_t> self_indices;
@@ -0,0 +1,98 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "psi/utils/ec_point_store.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace psi {
+
+namespace {
+
+std::string RandomCiphertext(std::mt19937* rng, size_t len) {
+  std::string ret(len, '\0');
+  for (auto& c : ret) {
+    c = static_cast<char>((*rng)() & 0xff);
+  }
+  return ret;
+}
+
+void SaveAll(IEcPointStore* store, const std::vector<std::string>& items) {
+  store->Save(items);
+}
+
+}  // namespace
+
+TEST(MemoryEcPointStoreTest, ComputeIndices) {
+  std::mt19937 rng(0);
+  std::vector<std::string> peer_items;
+  for (size_t i = 0; i < 20000; ++i) {
+    peer_items.push_back(RandomCiphertext(&rng, 12));
+  }
+  // Same 8 byte prefix, only the tail differs.
+  peer_items.push_back(std::string(8, 'a') + "peer");
+  // Shorter than the prefix.
+  peer_items.push_back("ab");
+
+  std::vector<std::string> self_items;
+  for (size_t i = 0; i < 30000; ++i) {
+    if (rng() % 3 == 0) {
+      self_items.push_back(peer_items[rng() % peer_items.size()]);
+    } else {
+      self_items.push_back(RandomCiphertext(&rng, 12));
+    }
+  }
+  self_items.push_back(std::string(8, 'a') + "self");
+  self_items.push_back("ab");
+  self_items.push_back(std::string("ab\0", 3));
+  self_items.push_back(self_items.front());
+
+  MemoryEcPointStore self;
+  MemoryEcPointStore peer;
+  SaveAll(&self, self_items);
+  SaveAll(&peer, peer_items);
+
+  std::unordered_set<std::string> peer_set(peer_items.begin(),
+                                           peer_items.end());
+  std::vector<uint64_t> expected;
+  for (size_t i = 0; i < self_items.size(); ++i) {
+    if (peer_set.count(self_items[i]) > 0) {
+      expected.push_back(i);
+    }
+  }
+
+  for (size_t thread_num : {1, 3, 8}) {
+    MergeJoinOptions options;
+    options.thread_num = thread_num;
+    EXPECT_EQ(ComputeIndices(self, peer, options), expected);
+  }
+}
+
+TEST(MemoryEcPointStoreTest, ComputeIndicesEmpty) {
+  MemoryEcPointStore self;
+  MemoryEcPointStore peer;
+  EXPECT_TRUE(ComputeIndices(self, peer).empty());
+
+  SaveAll(&self, {"abc"});
+  EXPECT_TRUE(ComputeIndices(self, peer).empty());
+  EXPECT_TRUE(ComputeIndices(peer, self).empty());
+}
+
+}  // namespace psi
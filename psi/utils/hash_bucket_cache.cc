@@ -14,22 +14,92 @@
 
 #include "psi/utils/hash_bucket_cache.h"
 
+#include <fcntl.h>
 #include <spdlog/spdlog.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <cerrno>
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <limits>
 #include <memory>
+#include <optional>
+#include <unordered_map>
 #include <utility>
 
 #include "absl/strings/escaping.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "yacl/utils/scope_guard.h"
+#include "zstd.h"
 
 #include "psi/utils/arrow_csv_batch_provider.h"
 
 namespace psi {
 
+namespace {
+
+// Items of a bucket are buffered until their data reaches this size, then
+// written as one block.
+constexpr size_t kBlockDataSize = 64 * 1024;
+
+constexpr int kZstdLevel = 1;
+
+std::string SerializeLegacyItem(const HashBucketCache::BucketItem& item,
+                                const std::string& base64_data) {
+  return fmt::format("{},{},{}", item.index, item.extra_dup_cnt, base64_data);
+}
+
+HashBucketCache::BucketItem DeserializeLegacyItem(std::string_view data_str) {
+  HashBucketCache::BucketItem item;
+  std::vector<absl::string_view> tokens = absl::StrSplit(data_str, ',');
+  YACL_ENFORCE(tokens.size() == 3, "should have three tokens, actual: {}",
+               tokens.size());
+  YACL_ENFORCE(absl::SimpleAtoi(tokens[0], &item.index),
+               "cannot convert {} to idx",
+               std::string(tokens[0].data(), tokens[0].size()));
+  YACL_ENFORCE(absl::SimpleAtoi(tokens[1], &item.extra_dup_cnt),
+               "cannot convert {} to duplicate_cnt",
+               std::string(tokens[1].data(), tokens[1].size()));
+  YACL_ENFORCE(absl::Base64Unescape(tokens[2], &item.data),
+               "cannot decode base64 data {}",
+               std::string(tokens[2].data(), tokens[2].size()));
+  return item;
+}
+
+// Read the whole file with one pread.
+std::vector<char> ReadFile(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  YACL_ENFORCE(fd >= 0, "open file {} failed: {}", path, std::strerror(errno));
+  ON_SCOPE_EXIT([&] { close(fd); });
+
+  struct stat st;
+  YACL_ENFORCE(fstat(fd, &st) == 0, "stat file {} failed: {}", path,
+               std::strerror(errno));
+  std::vector<char> buf(st.st_size);
+  size_t offset = 0;
+  while (offset < buf.size()) {
+    auto ret = pread(fd, buf.data() + offset, buf.size() - offset, offset);
+    YACL_ENFORCE(ret > 0, "read file {} failed: {}", path,
+                 ret == 0 ? "unexpected eof" : std::strerror(errno));
+    offset += ret;
+  }
+  return buf;
+}
+
+}  // namespace
+
 HashBucketCache::HashBucketCache(const std::string& target_dir,
-                                 uint32_t bucket_num, bool use_scoped_tmp_dir)
-    : bucket_num_(bucket_num), item_index_(0) {
+                                 uint32_t bucket_num, bool use_scoped_tmp_dir,
+                                 BucketCompression compression,
+                                 bool digest_items)
+    : bucket_num_(bucket_num),
+      item_index_(0),
+      compression_(compression),
+      digest_items_(digest_items) {
   YACL_ENFORCE(bucket_num_ > 0);
   if (!std::filesystem::exists(target_dir)) {
     SPDLOG_INFO("target dir={} does not exists, create it", target_dir);
@@ -38,55 +108,332 @@ HashBucketCache::HashBucketCache(const std::string& target_dir,
   disk_cache_ = std::make_unique<MultiplexDiskCache>(
       std::filesystem::path(target_dir), use_scoped_tmp_dir);
   YACL_ENFORCE(disk_cache_, "cannot create disk cache from dir={}", target_dir);
+
+  // Bucket files may exist already if the cache dir is not scoped.
+  std::vector<bool> file_empty(bucket_num_);
+  for (uint32_t i = 0; i < bucket_num_; ++i) {
+    auto path = disk_cache_->GetPath(i);
+    file_empty[i] = !std::filesystem::exists(path) ||
+                    std::filesystem::file_size(path) == 0;
+  }
+  DetectFormat();
+  YACL_ENFORCE(!digest_items_ || format_ == BucketFileFormat::kBinary,
+               "digest items are not supported by legacy bucket files");
+
   disk_cache_->CreateOutputStreams(bucket_num_, &bucket_os_vec_);
+  if (format_ == BucketFileFormat::kBinary) {
+    pending_blocks_.resize(bucket_num_);
+    FileHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.flags = digest_items_ ? kFlagDigestItems : 0;
+    for (uint32_t i = 0; i < bucket_num_; ++i) {
+      if (file_empty[i]) {
+        bucket_os_vec_[i]->Write(&header, sizeof(header));
+        bucket_os_vec_[i]->Flush();
+      }
+    }
+  }
 }
 
 HashBucketCache::~HashBucketCache() {
+  try {
+    Flush();
+  } catch (const std::exception& e) {
+    SPDLOG_ERROR("flush hash bucket cache failed: {}", e.what());
+  }
   bucket_os_vec_.clear();
   disk_cache_ = nullptr;
 }
 
-void HashBucketCache::WriteItem(const std::string& data,
+void HashBucketCache::DetectFormat() {
+  std::optional<BucketFileFormat> detected;
+  for (uint32_t i = 0; i < bucket_num_; ++i) {
+    auto path = disk_cache_->GetPath(i);
+    if (!std::filesystem::exists(path) ||
+        std::filesystem::file_size(path) == 0) {
+      continue;
+    }
+    FileHeader header{};
+    std::ifstream in(path, std::ios::binary);
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    BucketFileFormat format = BucketFileFormat::kLegacyCsv;
+    if (in.gcount() == sizeof(header) &&
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0) {
+      YACL_ENFORCE(header.version <= kVersion,
+                   "unsupported bucket file version {} of {}", header.version,
+                   path);
+      format = BucketFileFormat::kBinary;
+      YACL_ENFORCE(((header.flags & kFlagDigestItems) != 0) == digest_items_,
+                   "bucket file {} is not written with digest_items={}", path,
+                   digest_items_);
+    }
+    YACL_ENFORCE(!detected.has_value() || *detected == format,
+                 "bucket files in {} have different formats",
+                 disk_cache_->cache_dir().string());
+    detected = format;
+  }
+  if (detected.has_value()) {
+    format_ = *detected;
+    SPDLOG_INFO("reuse bucket files in {}, format={}",
+                disk_cache_->cache_dir().string(),
+                static_cast<uint32_t>(format_));
+  }
+}
+
+void HashBucketCache::WriteItem(std::string_view data,
                                 uint32_t duplicate_cnt) {
-  BucketItem bucket_item;
-  bucket_item.index = item_index_;
-  bucket_item.extra_dup_cnt = duplicate_cnt;
-  bucket_item.base64_data = absl::Base64Escape(data);
-
-  auto& out = bucket_os_vec_[std::hash<std::string>()(bucket_item.base64_data) %
-                             bucket_os_vec_.size()];
-  out->Write(bucket_item.Serialize());
-  out->Write("\n");
+  // Items are assigned to buckets by their base64 encoding as in the legacy
+  // layout, so that a key lands in the same bucket whichever layout the
+  // parties use.
+  legacy_key_.clear();
+  absl::Base64Escape(data, &legacy_key_);
+  size_t bucket_idx = std::hash<std::string>()(legacy_key_) % bucket_num_;
+
+  if (format_ == BucketFileFormat::kLegacyCsv) {
+    BucketItem bucket_item;
+    bucket_item.index = item_index_;
+    bucket_item.extra_dup_cnt = duplicate_cnt;
+
+    auto& out = bucket_os_vec_[bucket_idx];
+    out->Write(SerializeLegacyItem(bucket_item, legacy_key_));
+    out->Write("\n");
+    item_index_++;
+    return;
+  }
+
+  YACL_ENFORCE(!digest_items_, "use WriteDigest for digest items");
+  YACL_ENFORCE(data.size() <= std::numeric_limits<uint32_t>::max(),
+               "item is too large: {}", data.size());
+  AppendItem(bucket_idx, data, duplicate_cnt);
+}
+
+void HashBucketCache::WriteDigest(uint128_t digest, uint32_t duplicate_cnt) {
+  YACL_ENFORCE(digest_items_, "cache is not created for digest items");
+  // Digests are uniformly distributed already.
+  AppendItem(static_cast<uint64_t>(digest) % bucket_num_,
+             std::string_view(reinterpret_cast<const char*>(&digest),
+                              sizeof(digest)),
+             duplicate_cnt);
+}
+
+void HashBucketCache::AppendItem(uint32_t bucket_idx, std::string_view data,
+                                 uint32_t duplicate_cnt) {
+  auto& block = pending_blocks_[bucket_idx];
+  block.metas.push_back(ItemMeta{item_index_, duplicate_cnt,
+                                 static_cast<uint32_t>(data.size())});
+  block.data.append(data);
+  if (block.data.size() >= kBlockDataSize) {
+    WriteBlock(bucket_idx);
+  }
   item_index_++;
 }
 
+void HashBucketCache::WriteBlock(uint32_t index) {
+  auto& block = pending_blocks_[index];
+  if (block.metas.empty()) {
+    return;
+  }
+
+  std::string raw(block.metas.size() * sizeof(ItemMeta) + block.data.size(),
+                  '\0');
+  std::memcpy(raw.data(), block.metas.data(),
+              block.metas.size() * sizeof(ItemMeta));
+  std::memcpy(raw.data() + block.metas.size() * sizeof(ItemMeta),
+              block.data.data(), block.data.size());
+
+  BlockHeader header{};
+  header.item_num = block.metas.size();
+  header.compression = static_cast<uint32_t>(compression_);
+  header.raw_size = raw.size();
+
+  auto& out = bucket_os_vec_[index];
+  if (compression_ == BucketCompression::kZstd) {
+    std::string compressed(ZSTD_compressBound(raw.size()), '\0');
+    auto size = ZSTD_compress(compressed.data(), compressed.size(), raw.data(),
+                              raw.size(), kZstdLevel);
+    YACL_ENFORCE(!ZSTD_isError(size), "zstd compress failed: {}",
+                 ZSTD_getErrorName(size));
+    header.stored_size = size;
+    out->Write(&header, sizeof(header));
+    out->Write(compressed.data(), size);
+  } else {
+    header.stored_size = raw.size();
+    out->Write(&header, sizeof(header));
+    out->Write(raw.data(), raw.size());
+  }
+
+  block.metas.clear();
+  block.data.clear();
+}
+
 void HashBucketCache::Flush() {
+  for (uint32_t i = 0; i < pending_blocks_.size(); ++i) {
+    WriteBlock(i);
+  }
   // Flush files.
   for (const auto& out : bucket_os_vec_) {
     out->Flush();
   }
 }
 
+HashBucketCache::BucketView HashBucketCache::LoadBucket(uint32_t index) {
+  if (format_ == BucketFileFormat::kLegacyCsv) {
+    return LoadLegacyBucket(index);
+  }
+
+  auto path = disk_cache_->GetPath(index);
+  BucketView view;
+  view.file_ = ReadFile(path);
+  const auto& buf = view.file_;
+  YACL_ENFORCE(buf.size() >= sizeof(FileHeader) &&
+                   std::memcmp(buf.data(), kMagic, sizeof(kMagic)) == 0,
+               "bad header of bucket file {}", path);
+
+  // Locate blocks first, so that all compressed blocks are decompressed into
+  // one buffer which is never reallocated.
+  std::vector<std::pair<BlockHeader, size_t>> blocks;
+  size_t decompressed_size = 0;
+  size_t item_num = 0;
+  size_t pos = sizeof(FileHeader);
+  while (pos < buf.size()) {
+    YACL_ENFORCE(pos + sizeof(BlockHeader) <= buf.size(),
+                 "truncated block header in {}, offset={}", path, pos);
+    BlockHeader header;
+    std::memcpy(&header, buf.data() + pos, sizeof(header));
+    pos += sizeof(header);
+    YACL_ENFORCE(header.stored_size <= buf.size() - pos,
+                 "truncated block in {}, offset={}", path, pos);
+    if (header.compression == static_cast<uint32_t>(BucketCompression::kZstd)) {
+      decompressed_size += header.raw_size;
+    } else {
+      YACL_ENFORCE(
+          header.compression == static_cast<uint32_t>(BucketCompression::kNone),
+          "unknown compression {} in {}", header.compression, path);
+      YACL_ENFORCE(header.raw_size == header.stored_size, "bad block in {}",
+                   path);
+    }
+    blocks.emplace_back(header, pos);
+    item_num += header.item_num;
+    pos += header.stored_size;
+  }
+
+  view.decompressed_.resize(decompressed_size);
+  view.metas_.resize(item_num);
+  view.data_.reserve(item_num);
+  size_t decompressed_pos = 0;
+  size_t item_idx = 0;
+  for (const auto& [header, offset] : blocks) {
+    const char* raw = buf.data() + offset;
+    if (header.compression == static_cast<uint32_t>(BucketCompression::kZstd)) {
+      char* dst = view.decompressed_.data() + decompressed_pos;
+      auto size = ZSTD_decompress(dst, header.raw_size, raw,
+                                  header.stored_size);
+      YACL_ENFORCE(!ZSTD_isError(size) && size == header.raw_size,
+                   "zstd decompress block in {} failed, offset={}", path,
+                   offset);
+      raw = dst;
+      decompressed_pos += header.raw_size;
+    }
+
+    size_t data_offset = header.item_num * sizeof(ItemMeta);
+    YACL_ENFORCE(data_offset <= header.raw_size, "bad block in {}", path);
+    std::memcpy(view.metas_.data() + item_idx, raw, data_offset);
+    for (uint32_t i = 0; i < header.item_num; ++i) {
+      const auto& meta = view.metas_[item_idx + i];
+      YACL_ENFORCE(meta.data_size <= header.raw_size - data_offset,
+                   "bad block in {}", path);
+      YACL_ENFORCE(!digest_items_ || meta.data_size == sizeof(uint128_t),
+                   "bad digest item in {}", path);
+      view.data_.emplace_back(raw + data_offset, meta.data_size);
+      data_offset += meta.data_size;
+    }
+    item_idx += header.item_num;
+  }
+  return view;
+}
+
 std::vector<HashBucketCache::BucketItem> HashBucketCache::LoadBucketItems(
     uint32_t index) {
-  std::vector<BucketItem> ret;
+  auto view = LoadBucket(index);
+  std::vector<BucketItem> ret(view.size());
+  for (size_t i = 0; i < view.size(); ++i) {
+    auto& item = ret[i];
+    item.index = view.Meta(i).index;
+    item.extra_dup_cnt = view.Meta(i).extra_dup_cnt;
+    auto data = view.Data(i);
+    if (digest_items_) {
+      YACL_ENFORCE(data.size() == sizeof(uint128_t),
+                   "unexpected digest size={} in bucket {}", data.size(),
+                   index);
+      std::memcpy(&item.sec_hash, data.data(), sizeof(uint128_t));
+      item.is_digest = true;
+    } else {
+      item.data = data;
+    }
+  }
+  return ret;
+}
+
+uint64_t HashBucketCache::BucketLoadSize(uint32_t index) const {
+  auto path = disk_cache_->GetPath(index);
+  uint64_t file_size = std::filesystem::file_size(path);
+  if (format_ == BucketFileFormat::kLegacyCsv) {
+    // Lines are decoded into items first, then copied into the view.
+    return file_size * 2;
+  }
+
+  int fd = open(path.c_str(), O_RDONLY);
+  YACL_ENFORCE(fd >= 0, "open file {} failed: {}", path, std::strerror(errno));
+  ON_SCOPE_EXIT([&] { close(fd); });
+
+  uint64_t load_size = file_size;
+  uint64_t pos = sizeof(FileHeader);
+  while (pos + sizeof(BlockHeader) <= file_size) {
+    BlockHeader header;
+    auto ret = pread(fd, &header, sizeof(header), pos);
+    YACL_ENFORCE(ret == sizeof(header), "read block header of {} failed: {}",
+                 path, ret < 0 ? std::strerror(errno) : "unexpected eof");
+    if (header.compression == static_cast<uint32_t>(BucketCompression::kZstd)) {
+      load_size += header.raw_size;
+    }
+    load_size += header.item_num * sizeof(std::string_view);
+    pos += sizeof(header) + header.stored_size;
+  }
+  return load_size;
+}
+
+HashBucketCache::BucketView HashBucketCache::LoadLegacyBucket(uint32_t index) {
+  std::vector<BucketItem> items;
   auto in = disk_cache_->CreateInputStream(index);
 
   std::string line;
+  size_t data_size = 0;
   while (in->GetLine(&line)) {
-    auto item = BucketItem::Deserialize(line);
-    ret.push_back(std::move(item));
+    auto item = DeserializeLegacyItem(line);
+    data_size += item.data.size();
+    items.push_back(std::move(item));
   }
-  return ret;
+
+  BucketView view;
+  view.decompressed_.resize(data_size);
+  view.metas_.reserve(items.size());
+  view.data_.reserve(items.size());
+  char* dst = view.decompressed_.data();
+  for (const auto& item : items) {
+    view.metas_.push_back(ItemMeta{item.index, item.extra_dup_cnt,
+                                   static_cast<uint32_t>(item.data.size())});
+    std::memcpy(dst, item.data.data(), item.data.size());
+    view.data_.emplace_back(dst, item.data.size());
+    dst += item.data.size();
+  }
+  return view;
 }
 
 std::unique_ptr<HashBucketCache> CreateCacheFromCsv(
     const std::string& csv_path, const std::vector<std::string>& schema_names,
     const std::string& cache_dir, uint32_t bucket_num, uint32_t read_batch_size,
     bool use_scoped_tmp_dir) {
-  auto bucket_cache = std::make_unique<HashBucketCache>(cache_dir, bucket_num,
-                                                        use_scoped_tmp_dir);
-
   std::shared_ptr<IBasicBatchProvider> batch_provider =
       std::make_unique<ArrowCsvBatchProvider>(csv_path, schema_names,
                                               read_batch_size);
@@ -97,9 +444,10 @@ std::unique_ptr<HashBucketCache> CreateCacheFromCsv(
 
 std::unique_ptr<HashBucketCache> CreateCacheFromProvider(
     std::shared_ptr<IBasicBatchProvider> provider, const std::string& cache_dir,
-    uint32_t bucket_num, bool use_scoped_tmp_dir) {
-  auto bucket_cache = std::make_unique<HashBucketCache>(cache_dir, bucket_num,
-                                                        use_scoped_tmp_dir);
+    uint32_t bucket_num, bool use_scoped_tmp_dir,
+    BucketCompression compression) {
+  auto bucket_cache = std::make_unique<HashBucketCache>(
+      cache_dir, bucket_num, use_scoped_tmp_dir, compression);
 
   while (true) {
     auto [items, duplicate_cnt] = provider->ReadNextBatchWithDupCnt();
@@ -109,8 +457,31 @@ std::unique_ptr<HashBucketCache> CreateCacheFromProvider(
     for (size_t i = 0; i < items.size(); ++i) {
       bucket_cache->WriteItem(items[i], duplicate_cnt[i]);
     }
-    bucket_cache->Flush();
   }
+  bucket_cache->Flush();
+  return bucket_cache;
+}
+
+std::unique_ptr<HashBucketCache> CreateCacheFromDigestProvider(
+    std::shared_ptr<IDigestBatchProvider> provider,
+    const std::string& cache_dir, uint32_t bucket_num, bool use_scoped_tmp_dir,
+    BucketCompression compression) {
+  auto bucket_cache = std::make_unique<HashBucketCache>(
+      cache_dir, bucket_num, use_scoped_tmp_dir, compression, true);
+
+  std::unordered_map<uint32_t, uint32_t> duplicate_cnt;
+  while (true) {
+    auto digests = provider->ReadNextDigestBatch(&duplicate_cnt);
+    if (digests.empty()) {
+      break;
+    }
+    for (size_t i = 0; i < digests.size(); ++i) {
+      auto iter = duplicate_cnt.find(i);
+      bucket_cache->WriteDigest(
+          digests[i], iter == duplicate_cnt.end() ? 0 : iter->second);
+    }
+  }
+  bucket_cache->Flush();
   return bucket_cache;
 }
 
@@ -21,7 +21,6 @@
 #include <string_view>
 #include <vector>
 
-#include "absl/strings/str_split.h"
 #include "batch_provider.h"
 #include "fmt/format.h"
 #include "yacl/base/exception.h"
@@ -32,73 +31,175 @@
 
 namespace psi {
 
+// Bucket file layout of HashBucketCache.
+//
+// kBinary:
+//   FileHeader | Block | Block | ...
+//   Each block is BlockHeader followed by a payload, which is optionally
+//   compressed. The raw payload is an array of ItemMeta, followed by data of
+//   all items of the block. If kFlagDigestItems is set in the file header,
+//   data of every item is its 128-bit key digest.
+//
+// kLegacyCsv:
+//   One `index,extra_dup_cnt,base64(data)` line per item. This layout is
+//   written by former versions, and is still recognised when reopening an
+//   existing cache, e.g. in recovery.
+//
+// In both layouts, an item is put into bucket
+// `std::hash<std::string>()(base64(data)) % bucket_num`, and a digest into
+// bucket `digest % bucket_num`.
+enum class BucketFileFormat : uint32_t {
+  kLegacyCsv = 0,
+  kBinary = 1,
+};
+
+enum class BucketCompression : uint32_t {
+  kNone = 0,
+  kZstd = 1,
+};
+
 class HashBucketCache {
  public:
   struct BucketItem {
     uint128_t sec_hash = 0;
     uint64_t index = 0;
     uint32_t extra_dup_cnt = 0;
-    uint32_t pad = 0;
-    std::string base64_data;
-
-    std::string Serialize() {
-      return fmt::format("{},{},{}", index, extra_dup_cnt, base64_data);
-    }
+    // `sec_hash` is the key digest, and `data` is left empty.
+    bool is_digest = false;
+    std::string data;
 
     static size_t hash(const BucketItem& item) {
-      return std::hash<std::string>()(item.base64_data);
+      return std::hash<std::string>()(item.data);
     }
 
     bool operator==(const BucketItem& other) const {
-      return base64_data == other.base64_data;
-    }
-
-    static BucketItem Deserialize(std::string_view data_str) {
-      BucketItem item;
-      std::vector<absl::string_view> tokens = absl::StrSplit(data_str, ',');
-      YACL_ENFORCE(tokens.size() == 3, "should have three tokens, actual: {}",
-                   tokens.size());
-      YACL_ENFORCE(absl::SimpleAtoi(tokens[0], &item.index),
-                   "cannot convert {} to idx",
-                   std::string(tokens[0].data(), tokens[0].size()));
-      YACL_ENFORCE(absl::SimpleAtoi(tokens[1], &item.extra_dup_cnt),
-                   "cannot convert {} to duplicate_cnt",
-                   std::string(tokens[1].data(), tokens[1].size()));
-      item.base64_data = std::string(tokens[2].data(), tokens[2].size());
-
-      return item;
+      return data == other.data;
     }
   };
 
   struct HashBucketIter {
     size_t operator()(const BucketItem& item) const {
-      return std::hash<std::string>()(item.base64_data);
+      return std::hash<std::string>()(item.data);
     }
   };
 
+  static constexpr char kMagic[8] = {'P', 'S', 'I', 'H', 'B', 'K', 'T', '\0'};
+  static constexpr uint32_t kVersion = 1;
+  static constexpr uint32_t kFlagDigestItems = 1;
+
+  struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+  };
+
+  struct BlockHeader {
+    uint32_t item_num;
+    uint32_t compression;
+    uint64_t raw_size;
+    uint64_t stored_size;
+  };
+
+  struct ItemMeta {
+    uint64_t index;
+    uint32_t extra_dup_cnt;
+    uint32_t data_size;
+  };
+
+  // Items of a bucket in contiguous memory, i.e. the bucket file read with
+  // one pread and the decompressed blocks. Data of items is not copied.
+  class BucketView {
+   public:
+    BucketView() = default;
+    // Data points into buffers owned by the view, which survive a move but
+    // not a copy.
+    BucketView(const BucketView&) = delete;
+    BucketView& operator=(const BucketView&) = delete;
+    BucketView(BucketView&&) = default;
+    BucketView& operator=(BucketView&&) = default;
+
+    size_t size() const { return metas_.size(); }
+
+    const ItemMeta& Meta(size_t i) const { return metas_[i]; }
+
+    std::string_view Data(size_t i) const { return data_[i]; }
+
+   private:
+    friend class HashBucketCache;
+
+    std::vector<char> file_;
+    std::vector<char> decompressed_;
+    std::vector<ItemMeta> metas_;
+    // Points into `file_` or `decompressed_`.
+    std::vector<std::string_view> data_;
+  };
+
   HashBucketCache(const std::string& target_dir, uint32_t bucket_num,
-                  bool use_scoped_tmp_dir = true);
+                  bool use_scoped_tmp_dir = true,
+                  BucketCompression compression = BucketCompression::kNone,
+                  bool digest_items = false);
 
   ~HashBucketCache();
 
-  void WriteItem(const std::string& data, uint32_t duplicate_cnt = 0);
+  void WriteItem(std::string_view data, uint32_t duplicate_cnt = 0);
+
+  // Only for caches created with `digest_items`.
+  void WriteDigest(uint128_t digest, uint32_t duplicate_cnt = 0);
 
   void Flush();
 
+  BucketView LoadBucket(uint32_t index);
+
+  // Same as LoadBucket, but every item owns a copy of its data, because
+  // protocols sort and keep the items after the bucket is released.
   std::vector<BucketItem> LoadBucketItems(uint32_t index);
 
+  // Bytes a bucket takes in memory once loaded by LoadBucket, i.e. the file,
+  // the decompressed blocks and the item views. Only block headers are read.
+  uint64_t BucketLoadSize(uint32_t index) const;
+
   uint32_t BucketNum() const { return bucket_num_; }
 
   uint64_t ItemCount() const { return item_index_; }
 
+  BucketFileFormat Format() const { return format_; }
+
+  bool DigestItems() const { return digest_items_; }
+
  private:
+  struct PendingBlock {
+    std::vector<ItemMeta> metas;
+    std::string data;
+  };
+
+  void DetectFormat();
+
+  void WriteBlock(uint32_t index);
+
+  void AppendItem(uint32_t bucket_idx, std::string_view data,
+                  uint32_t duplicate_cnt);
+
+  BucketView LoadLegacyBucket(uint32_t index);
+
   std::unique_ptr<MultiplexDiskCache> disk_cache_;
 
   std::vector<std::unique_ptr<io::OutputStream>> bucket_os_vec_;
 
+  // Items not written to bucket files yet, only used by kBinary.
+  std::vector<PendingBlock> pending_blocks_;
+
   uint32_t bucket_num_;
 
   uint64_t item_index_;
+
+  BucketFileFormat format_ = BucketFileFormat::kBinary;
+
+  BucketCompression compression_;
+
+  bool digest_items_;
+
+  // Reused buffer of the legacy bucket key of an item.
+  std::string legacy_key_;
 };
 
 std::unique_ptr<HashBucketCache> CreateCacheFromCsv(
@@ -108,6 +209,13 @@ std::unique_ptr<HashBucketCache> CreateCacheFromCsv(
 
 std::unique_ptr<HashBucketCache> CreateCacheFromProvider(
     std::shared_ptr<IBasicBatchProvider> provider, const std::string& cache_dir,
-    uint32_t bucket_num, bool use_scoped_tmp_dir = true);
+    uint32_t bucket_num, bool use_scoped_tmp_dir = true,
+    BucketCompression compression = BucketCompression::kNone);
+
+std::unique_ptr<HashBucketCache> CreateCacheFromDigestProvider(
+    std::shared_ptr<IDigestBatchProvider> provider,
+    const std::string& cache_dir, uint32_t bucket_num,
+    bool use_scoped_tmp_dir = true,
+    BucketCompression compression = BucketCompression::kNone);
 
 }  // namespace psi
@@ -0,0 +1,179 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "psi/utils/hash_bucket_cache.h"
+
+#include <filesystem>
+#include <functional>
+#include <fstream>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "absl/strings/escaping.h"
+#include "gtest/gtest.h"
+
+namespace psi {
+
+namespace {
+
+using ItemTuple = std::tuple<uint64_t, uint32_t, std::string>;
+
+std::set<ItemTuple> LoadAll(HashBucketCache* cache) {
+  std::set<ItemTuple> ret;
+  for (uint32_t i = 0; i < cache->BucketNum(); ++i) {
+    for (auto& item : cache->LoadBucketItems(i)) {
+      ret.emplace(item.index, item.extra_dup_cnt, std::move(item.data));
+    }
+  }
+  return ret;
+}
+
+}  // namespace
+
+class HashBucketCacheTest
+    : public ::testing::TestWithParam<BucketCompression> {
+ protected:
+  void SetUp() override {
+    tmp_dir_ = "./tmp_hash_bucket_cache_test";
+    std::filesystem::create_directory(tmp_dir_);
+  }
+  void TearDown() override {
+    std::error_code ec;
+    std::filesystem::remove_all(tmp_dir_, ec);
+  }
+
+  std::string tmp_dir_;
+};
+
+TEST_P(HashBucketCacheTest, Works) {
+  HashBucketCache cache(tmp_dir_, 7, true, GetParam());
+  EXPECT_EQ(cache.Format(), BucketFileFormat::kBinary);
+
+  std::set<ItemTuple> expected;
+  for (uint32_t i = 0; i < 100000; ++i) {
+    // Binary data with separators should be kept as it is.
+    std::string data = fmt::format("{},\n{}", i, std::string(i % 40, '\0'));
+    cache.WriteItem(data, i % 3);
+    expected.emplace(i, i % 3, data);
+  }
+  cache.Flush();
+
+  EXPECT_EQ(cache.ItemCount(), 100000);
+  EXPECT_EQ(LoadAll(&cache), expected);
+}
+
+TEST_P(HashBucketCacheTest, LoadBucket) {
+  HashBucketCache cache(tmp_dir_, 5, true, GetParam());
+  for (uint32_t i = 0; i < 1000; ++i) {
+    cache.WriteItem(fmt::format("key{}", i), i % 2);
+  }
+  cache.Flush();
+
+  size_t item_num = 0;
+  for (uint32_t i = 0; i < cache.BucketNum(); ++i) {
+    auto view = cache.LoadBucket(i);
+    auto items = cache.LoadBucketItems(i);
+    ASSERT_EQ(view.size(), items.size());
+    // Not less than the decompressed items.
+    EXPECT_GE(cache.BucketLoadSize(i),
+              view.size() * (sizeof(HashBucketCache::ItemMeta) + 6));
+    for (size_t j = 0; j < view.size(); ++j) {
+      EXPECT_EQ(view.Meta(j).index, items[j].index);
+      EXPECT_EQ(view.Meta(j).extra_dup_cnt, items[j].extra_dup_cnt);
+      EXPECT_EQ(view.Data(j), items[j].data);
+      // Same bucket as in the legacy layout.
+      EXPECT_EQ(
+          std::hash<std::string>()(absl::Base64Escape(items[j].data)) % 5, i);
+    }
+    item_num += view.size();
+  }
+  EXPECT_EQ(item_num, 1000);
+}
+
+INSTANTIATE_TEST_SUITE_P(Compression, HashBucketCacheTest,
+                         testing::Values(BucketCompression::kNone,
+                                         BucketCompression::kZstd));
+
+TEST_F(HashBucketCacheTest, Reopen) {
+  std::set<ItemTuple> expected;
+  {
+    HashBucketCache cache(tmp_dir_, 3, false);
+    for (uint32_t i = 0; i < 100; ++i) {
+      cache.WriteItem(std::to_string(i));
+      expected.emplace(i, 0, std::to_string(i));
+    }
+  }
+
+  HashBucketCache cache(tmp_dir_, 3, false, BucketCompression::kZstd);
+  EXPECT_EQ(cache.Format(), BucketFileFormat::kBinary);
+  cache.WriteItem("new");
+  cache.Flush();
+  expected.emplace(0, 0, "new");
+  EXPECT_EQ(LoadAll(&cache), expected);
+}
+
+TEST_F(HashBucketCacheTest, DigestItems) {
+  std::set<ItemTuple> expected;
+  {
+    HashBucketCache cache(tmp_dir_, 3, false, BucketCompression::kNone, true);
+    for (uint32_t i = 0; i < 100; ++i) {
+      uint128_t digest = yacl::MakeUint128(i, i * 7);
+      cache.WriteDigest(digest, i % 2);
+      expected.emplace(
+          i, i % 2,
+          std::string(reinterpret_cast<const char*>(&digest), sizeof(digest)));
+    }
+    EXPECT_THROW(cache.WriteItem("a"), ::yacl::EnforceNotMet);
+  }
+
+  // Reopening a digest cache as a normal one is refused.
+  EXPECT_THROW(HashBucketCache(tmp_dir_, 3, false), ::yacl::EnforceNotMet);
+
+  HashBucketCache cache(tmp_dir_, 3, false, BucketCompression::kNone, true);
+  std::set<ItemTuple> loaded;
+  for (uint32_t i = 0; i < cache.BucketNum(); ++i) {
+    for (const auto& item : cache.LoadBucketItems(i)) {
+      EXPECT_TRUE(item.is_digest);
+      EXPECT_TRUE(item.data.empty());
+      loaded.emplace(item.index, item.extra_dup_cnt,
+                     std::string(reinterpret_cast<const char*>(&item.sec_hash),
+                                 sizeof(item.sec_hash)));
+    }
+  }
+  EXPECT_EQ(loaded, expected);
+}
+
+TEST_F(HashBucketCacheTest, LegacyCsv) {
+  // Layout written by former versions.
+  {
+    std::ofstream out(tmp_dir_ + "/0");
+    out << "0,1," << absl::Base64Escape("a") << "\n";
+  }
+  {
+    std::ofstream out(tmp_dir_ + "/1");
+    out << "1,0," << absl::Base64Escape("b") << "\n";
+  }
+
+  HashBucketCache cache(tmp_dir_, 2, false);
+  EXPECT_EQ(cache.Format(), BucketFileFormat::kLegacyCsv);
+  cache.WriteItem("c");
+  cache.Flush();
+
+  EXPECT_EQ(LoadAll(&cache),
+            std::set<ItemTuple>({{0, 1, "a"}, {1, 0, "b"}, {0, 0, "c"}}));
+}
+
+}  // namespace psi
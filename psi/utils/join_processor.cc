@@ -14,27 +14,29 @@
 
 #include "psi/utils/join_processor.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <filesystem>
-#include <fstream>
 #include <memory>
 #include <random>
-#include <sstream>
 #include <string>
 
+#include "absl/strings/str_join.h"
 #include "spdlog/spdlog.h"
 #include "table_utils.h"
 #include "yacl/base/exception.h"
 
-#include "psi/utils/io.h"
+#include "psi/utils/key.h"
 #include "psi/utils/random_str.h"
+#include "psi/utils/result_writer.h"
 
 #include "psi/proto/psi_v2.pb.h"
 
 namespace psi {
 
 std::shared_ptr<JoinProcessor> JoinProcessor::Make(
-    const v2::PsiConfig& psi_config, const std::filesystem::path& root) {
+    const v2::PsiConfig& psi_config, const std::filesystem::path& root,
+    const std::filesystem::path& cache_dir) {
   YACL_ENFORCE(std::filesystem::exists(psi_config.input_config().path()),
                "input file {} not exists.", psi_config.input_config().path());
   if (!std::filesystem::exists(root)) {
@@ -42,7 +44,8 @@ std::shared_ptr<JoinProcessor> JoinProcessor::Make(
     std::filesystem::create_directories(root);
   }
 
-  return std::shared_ptr<JoinProcessor>(new JoinProcessor(psi_config, root));
+  return std::shared_ptr<JoinProcessor>(
+      new JoinProcessor(psi_config, root, cache_dir));
 }
 
 std::shared_ptr<JoinProcessor> JoinProcessor::Make(
@@ -169,17 +172,20 @@ JoinProcessor::JoinProcessor(const v2::UbPsiConfig& ub_psi_config,
   if (!ub_psi_config.output_attr().csv_null_rep().empty()) {
     csv_null_rep_ = ub_psi_config.output_attr().csv_null_rep();
   }
+  output_shard_num_ = std::max(1U, ub_psi_config.output_attr().shard_num());
   align_output_ = !ub_psi_config.disable_alignment();
 }
 
 JoinProcessor::JoinProcessor(const v2::PsiConfig& psi_config,
-                             const std::filesystem::path& root) {
+                             const std::filesystem::path& root,
+                             const std::filesystem::path& cache_dir) {
   // TODO: support more format, CSV is only option for now
   YACL_ENFORCE(psi_config.input_config().type() == v2::IoType::IO_TYPE_FILE_CSV,
                "unsupport input format {}",
                v2::IoType_Name(psi_config.input_config().type()));
   input_path_ = psi_config.input_config().path();
   is_input_key_unique_ = psi_config.input_attr().keys_unique();
+  is_input_key_sorted_ = psi_config.input_attr().keys_sorted();
   YACL_ENFORCE(
       psi_config.output_config().type() == v2::IoType::IO_TYPE_FILE_CSV,
       "unsupport output format {}",
@@ -207,8 +213,13 @@ JoinProcessor::JoinProcessor(const v2::PsiConfig& psi_config,
   std::string prefix =
       fmt::format("{}_{}_", role_ == v2::ROLE_RECEIVER ? "receiver" : "sender",
                   GetRandomString(16));
-  sorted_input_path_ = root / (prefix + "join_sorted_input.csv");
-  key_info_path_ = root / (prefix + "join_sorted_input_key_info.csv");
+  if (cache_dir.empty()) {
+    sorted_input_path_ = root / (prefix + "join_sorted_input.csv");
+    key_info_path_ = root / (prefix + "join_sorted_input_key_info.csv");
+  } else {
+    sorted_input_path_ = cache_dir / "join_sorted_input.csv";
+    key_info_path_ = cache_dir / "join_sorted_input_key_info.csv";
+  }
   if (type_ != v2::PsiConfig::ADVANCED_JOIN_TYPE_DIFFERENCE) {
     sorted_intersect_path_ = root / (prefix + "join_sorted_input.inter.csv");
   }
@@ -225,6 +236,7 @@ JoinProcessor::JoinProcessor(const v2::PsiConfig& psi_config,
   if (!psi_config.output_attr().csv_null_rep().empty()) {
     csv_null_rep_ = psi_config.output_attr().csv_null_rep();
   }
+  output_shard_num_ = std::max(1U, psi_config.output_attr().shard_num());
 
   align_output_ = !psi_config.disable_alignment();
 }
@@ -240,7 +252,16 @@ std::shared_ptr<SortedTable> JoinProcessor::GetSortedInputTable() {
   if (sorted_table_ == nullptr) {
     if (std::filesystem::exists(sorted_input_path_)) {
       sorted_table_ = SortedTable::Make(sorted_input_path_, keys_);
+    } else if (is_input_key_sorted_ && IsSortedByKeys(input_path_, keys_)) {
+      SPDLOG_INFO("input {} is sorted by keys, skip sorting.", input_path_);
+      sorted_table_ = SortedTable::Make(input_path_, keys_);
     } else {
+      if (is_input_key_sorted_) {
+        SPDLOG_WARN(
+            "input {} is declared to be sorted by keys {}, but it is not, "
+            "fall back to sorting.",
+            input_path_, absl::StrJoin(keys_, ","));
+      }
       sorted_table_ =
           SortedTable::Make(GetInputTable(), sorted_input_path_, keys_);
     }
@@ -283,40 +304,20 @@ KeyInfo::StatInfo JoinProcessor::DealResultIndex(IndexReader& index) {
 void JoinProcessor::GenerateResult(uint32_t peer_except_cnt) {
   SPDLOG_INFO("start generate result file: {}, peer_except_cnt: {}",
               output_path_, peer_except_cnt);
-  auto ofs = io::GetStdOutFileStream(output_path_);
 
   auto columns = GetUniqueKeysInfo()->SourceFileColumns();
-  *ofs << MakeQuotedCsvLine(columns) << '\n';
+  ResultWriter writer(MakeQuotedCsvLine(columns));
 
-  auto write_output = [&](std::string input_path) {
+  auto write_output = [&](const std::string& input_path) {
     if (input_path.empty()) {
       return;
     }
-
-    std::string line;
-    std::ifstream ifs(input_path);
-    std::getline(ifs, line);
-
-    while (std::getline(ifs, line)) {
-      *ofs << line << '\n';
-    }
+    writer.AppendCsvBody(input_path);
   };
 
   auto write_na = [&](uint32_t na_line_cnt) {
-    if (na_line_cnt == 0) {
-      return;
-    }
-    auto size = columns.size();
-    std::ostringstream oss;
-    oss << csv_null_rep_;
-    while (--size) {
-      oss << ',' << csv_null_rep_;
-    }
-    oss << '\n';
-    auto line = oss.str();
-    while (na_line_cnt--) {
-      *ofs << line;
-    }
+    std::vector<std::string> na_columns(columns.size(), csv_null_rep_);
+    writer.AppendRepeatedLine(absl::StrJoin(na_columns, ","), na_line_cnt);
   };
 
   write_output(sorted_intersect_path_);
@@ -337,6 +338,12 @@ void JoinProcessor::GenerateResult(uint32_t peer_except_cnt) {
     write_na(peer_except_cnt);
   }
 
+  if (output_shard_num_ > 1) {
+    writer.WriteSharded(output_path_, output_shard_num_);
+  } else {
+    writer.Write(output_path_);
+  }
+
   SPDLOG_INFO("end generate result file: {}", output_path_);
 }
 
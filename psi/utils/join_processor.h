@@ -34,8 +34,11 @@ class JoinProcessor {
  public:
   inline static const std::string kNullRep = "NULL";
 
-  static std::shared_ptr<JoinProcessor> Make(const v2::PsiConfig& psi_config,
-                                             const std::filesystem::path& root);
+  // If `cache_dir` is set, the sorted input and key info are kept there with
+  // fixed names, and reused if they exist already.
+  static std::shared_ptr<JoinProcessor> Make(
+      const v2::PsiConfig& psi_config, const std::filesystem::path& root,
+      const std::filesystem::path& cache_dir = {});
 
   static std::shared_ptr<JoinProcessor> Make(const v2::UbPsiConfig& psi_config,
                                              const std::filesystem::path& root);
@@ -52,7 +55,8 @@ class JoinProcessor {
   std::shared_ptr<UniqueKeyTable> GetUniqueKeyTable();
 
   JoinProcessor(const v2::PsiConfig& psi_config,
-                const std::filesystem::path& root);
+                const std::filesystem::path& root,
+                const std::filesystem::path& cache_dir);
 
   JoinProcessor(const v2::UbPsiConfig& psi_config,
                 const std::filesystem::path& root);
@@ -67,11 +71,14 @@ class JoinProcessor {
 
   // TODO(huocun): ub psi support this condition
   bool is_input_key_unique_ = false;
+  // Input is declared to be sorted by keys, which is verified before use.
+  bool is_input_key_sorted_ = false;
   // Keys for PSI.
   std::vector<std::string> keys_;
 
   std::string output_path_;
   std::string csv_null_rep_ = "NULL";
+  uint32_t output_shard_num_ = 1;
   bool align_output_ = true;
 
   // Join type.
@@ -16,6 +16,7 @@
 
 #include <filesystem>
 
+#include "fmt/format.h"
 #include "gtest/gtest.h"
 #include "index_store.h"
 #include "random_str.h"
@@ -168,4 +169,86 @@ TEST_F(JoinProcessorTest, Working) {
   EXPECT_EQ(GetFileLine(output_path_), 3);
 }
 
+TEST_F(JoinProcessorTest, SortedInput) {
+  auto sorted_csv_path = (root_ / "sorted_test.csv").string();
+  {
+    std::ofstream sorted_csv_of(sorted_csv_path);
+    sorted_csv_of << R"csv("id","label1","label2","label3","label4"
+1,"b","y1",0.12,"one"
+1,"b","y1",-0.13,"two"
+3,"c","y3",0.9,"three"
+4,"b","y4",-12,"four"
+)csv";
+  }
+
+  for (const auto& path : {sorted_csv_path, csv_path_}) {
+    v2::PsiConfig config;
+    config.mutable_protocol_config()->set_protocol(
+        v2::Protocol::PROTOCOL_ECDH);
+    config.mutable_protocol_config()->set_role(v2::Role::ROLE_RECEIVER);
+    config.mutable_protocol_config()->set_broadcast_result(true);
+    config.mutable_input_config()->set_type(v2::IO_TYPE_FILE_CSV);
+    config.mutable_input_config()->set_path(path);
+    config.mutable_output_config()->set_type(v2::IO_TYPE_FILE_CSV);
+    config.mutable_output_config()->set_path(output_path_);
+    config.mutable_input_attr()->set_keys_sorted(true);
+    config.mutable_keys()->Add("id");
+
+    auto processor = JoinProcessor::Make(config, root_);
+
+    auto key_info = processor->GetUniqueKeysInfo();
+    EXPECT_EQ(key_info->DupKeyCnt(), 1);
+    EXPECT_EQ(key_info->KeyCnt(), 3);
+    EXPECT_EQ(key_info->OriginCnt(), 4);
+
+    MemoryIndexReader index_reader({0}, {0});
+    auto stat = processor->DealResultIndex(index_reader);
+    EXPECT_EQ(stat.join_intersection_count, 2);
+
+    processor->GenerateResult(0);
+    EXPECT_EQ(GetFileLine(output_path_), 3);
+  }
+
+  // Sorted input is used as it is, only unsorted input is copied and sorted.
+  size_t sorted_copy_cnt = 0;
+  for (const auto& entry : std::filesystem::directory_iterator(root_)) {
+    if (entry.path().string().find("join_sorted_input.csv") !=
+        std::string::npos) {
+      sorted_copy_cnt++;
+    }
+  }
+  EXPECT_EQ(sorted_copy_cnt, 1);
+}
+
+TEST_F(JoinProcessorTest, FullJoinSharded) {
+  v2::PsiConfig config;
+  config.mutable_protocol_config()->set_protocol(v2::Protocol::PROTOCOL_ECDH);
+  config.mutable_protocol_config()->set_role(v2::Role::ROLE_RECEIVER);
+  config.mutable_protocol_config()->set_broadcast_result(true);
+  config.mutable_input_config()->set_type(v2::IO_TYPE_FILE_CSV);
+  config.mutable_input_config()->set_path(csv_path_);
+  config.mutable_output_config()->set_type(v2::IO_TYPE_FILE_CSV);
+  config.mutable_output_config()->set_path(output_path_);
+  config.mutable_output_attr()->set_shard_num(3);
+  config.mutable_keys()->Add("id");
+  config.set_advanced_join_type(v2::PsiConfig::ADVANCED_JOIN_TYPE_FULL_JOIN);
+  config.set_left_side(v2::Role::ROLE_RECEIVER);
+
+  auto processor = JoinProcessor::Make(config, root_);
+
+  MemoryIndexReader index_reader({0}, {0});
+  processor->DealResultIndex(index_reader);
+  processor->GenerateResult(5);
+
+  // 2 intersected rows, 2 except rows and 5 NULL rows for peer.
+  size_t line_cnt = 0;
+  for (size_t i = 0; i < 3; ++i) {
+    auto path = std::filesystem::path(output_path_) /
+                fmt::format("part-{:05d}.csv", i);
+    ASSERT_TRUE(std::filesystem::exists(path));
+    line_cnt += GetFileLine(path.string()) - 1;
+  }
+  EXPECT_EQ(line_cnt, 9);
+}
+
 }  // namespace psi
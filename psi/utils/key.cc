@@ -14,172 +14,601 @@
 
 #include "psi/utils/key.h"
 
-#include <omp.h>
-
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
-#include <sstream>
+#include <future>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <string_view>
+#include <utility>
 
+#include "absl/strings/str_join.h"
 #include "fmt/ranges.h"
 #include "spdlog/spdlog.h"
 #include "yacl/base/exception.h"
+#include "yacl/utils/scope_guard.h"
 
 #include "psi/utils/arrow_helper.h"
-#include "psi/utils/io.h"
+#include "psi/utils/random_str.h"
+#include "psi/utils/resource.h"
 
 namespace psi {
 
 namespace {
 
-// parse cpuset.cpus format(eg. "0-3,5")
-int ParseCpuset(const std::string& cpuset) {
-  int count = 0;
-  std::stringstream ss(cpuset);
-  std::string item;
-  while (std::getline(ss, item, ',')) {
-    size_t dash = item.find('-');
-    if (dash != std::string::npos) {
-      int start = std::stoi(item.substr(0, dash));
-      int end = std::stoi(item.substr(dash + 1));
-      count += end - start + 1;
-    } else {
-      if (!item.empty()) {
-        count++;
+constexpr size_t kMinSortMemoryBudget = 1024 * 1024;
+constexpr size_t kSortIoBufferSize = 4 * 1024 * 1024;
+constexpr size_t kMinMergeIoBufferSize = 64 * 1024;
+constexpr size_t kMinSortSegmentSize = 64 * 1024;
+
+// Reads lines of a file with a large buffer. Line delimiter is excluded.
+class LineReader {
+ public:
+  LineReader(const std::string& path, size_t buffer_size)
+      : path_(path), buf_(std::max<size_t>(buffer_size, 1)) {
+    file_ = std::fopen(path_.c_str(), "rb");
+    YACL_ENFORCE(file_ != nullptr, "open file {} failed: {}", path_,
+                 std::strerror(errno));
+    std::setvbuf(file_, nullptr, _IONBF, 0);
+  }
+
+  ~LineReader() {
+    if (file_ != nullptr) {
+      std::fclose(file_);
+    }
+  }
+
+  LineReader(const LineReader&) = delete;
+  LineReader& operator=(const LineReader&) = delete;
+
+  // Returns false at the end of file. `line` is valid until next call.
+  bool Next(std::string_view* line) {
+    while (true) {
+      const char* begin = buf_.data() + begin_;
+      const auto* pos =
+          static_cast<const char*>(std::memchr(begin, '\n', end_ - begin_));
+      if (pos != nullptr) {
+        *line = std::string_view(begin, pos - begin);
+        begin_ += line->size() + 1;
+        return true;
+      }
+      if (eof_) {
+        if (begin_ < end_) {
+          *line = std::string_view(begin, end_ - begin_);
+          begin_ = end_;
+          return true;
+        }
+        return false;
+      }
+      Fill();
+    }
+  }
+
+ private:
+  void Fill() {
+    if (begin_ > 0) {
+      std::memmove(buf_.data(), buf_.data() + begin_, end_ - begin_);
+      end_ -= begin_;
+      begin_ = 0;
+    }
+    if (end_ == buf_.size()) {
+      // Line is longer than buffer.
+      buf_.resize(buf_.size() * 2);
+    }
+    end_ += std::fread(buf_.data() + end_, 1, buf_.size() - end_, file_);
+    YACL_ENFORCE(std::ferror(file_) == 0, "read file {} failed: {}", path_,
+                 std::strerror(errno));
+    eof_ = std::feof(file_) != 0;
+  }
+
+  std::string path_;
+  std::FILE* file_ = nullptr;
+  std::vector<char> buf_;
+  size_t begin_ = 0;
+  size_t end_ = 0;
+  bool eof_ = false;
+};
+
+// Writes lines to a file with a large buffer. A '\n' is appended to each line.
+class LineWriter {
+ public:
+  explicit LineWriter(const std::string& path)
+      : path_(path), buf_(kSortIoBufferSize) {
+    file_ = std::fopen(path_.c_str(), "wb");
+    YACL_ENFORCE(file_ != nullptr, "open file {} failed: {}", path_,
+                 std::strerror(errno));
+    std::setvbuf(file_, buf_.data(), _IOFBF, buf_.size());
+  }
+
+  ~LineWriter() {
+    if (file_ != nullptr) {
+      std::fclose(file_);
+    }
+  }
+
+  LineWriter(const LineWriter&) = delete;
+  LineWriter& operator=(const LineWriter&) = delete;
+
+  void WriteLine(std::string_view line) {
+    YACL_ENFORCE(
+        std::fwrite(line.data(), 1, line.size(), file_) == line.size() &&
+            std::fputc('\n', file_) != EOF,
+        "write file {} failed: {}", path_, std::strerror(errno));
+  }
+
+  void Close() {
+    auto ret = std::fclose(file_);
+    file_ = nullptr;
+    YACL_ENFORCE(ret == 0, "close file {} failed: {}", path_,
+                 std::strerror(errno));
+  }
+
+ private:
+  std::string path_;
+  std::FILE* file_ = nullptr;
+  std::vector<char> buf_;
+};
+
+// Position of a key field in a line.
+struct KeyField {
+  uint32_t offset;
+  uint32_t size;
+};
+
+// Locates key fields in a line split by raw ','. Missing fields are empty.
+class KeyExtractor {
+ public:
+  explicit KeyExtractor(std::vector<size_t> key_cols)
+      : key_cols_(std::move(key_cols)),
+        max_col_(*std::max_element(key_cols_.begin(), key_cols_.end())) {}
+
+  size_t key_num() const { return key_cols_.size(); }
+
+  void Extract(std::string_view line, KeyField* fields) {
+    YACL_ENFORCE(line.size() < std::numeric_limits<uint32_t>::max(),
+                 "line is too long: {}", line.size());
+    bounds_.clear();
+    size_t begin = 0;
+    while (bounds_.size() <= max_col_) {
+      size_t end = line.find(',', begin);
+      if (end == std::string_view::npos) {
+        end = line.size();
+      }
+      bounds_.emplace_back(begin, end);
+      if (end == line.size()) {
+        break;
+      }
+      begin = end + 1;
+    }
+    for (size_t i = 0; i < key_cols_.size(); ++i) {
+      if (key_cols_[i] < bounds_.size()) {
+        const auto& [field_begin, field_end] = bounds_[key_cols_[i]];
+        fields[i] = KeyField{static_cast<uint32_t>(field_begin),
+                             static_cast<uint32_t>(field_end - field_begin)};
+      } else {
+        fields[i] = KeyField{static_cast<uint32_t>(line.size()), 0};
+      }
+    }
+  }
+
+ private:
+  std::vector<size_t> key_cols_;
+  size_t max_col_;
+  std::vector<std::pair<size_t, size_t>> bounds_;
+};
+
+// Same as `sort -n` in POSIX locale: leading blanks, an optional '-', digits
+// and an optional fraction. Anything else is ignored, empty number is zero.
+struct NumericView {
+  bool negative = false;
+  std::string_view integer;
+  std::string_view fraction;
+
+  explicit NumericView(std::string_view s) {
+    auto is_digit = [&s](size_t i) {
+      return i < s.size() && s[i] >= '0' && s[i] <= '9';
+    };
+    size_t i = 0;
+    while (i < s.size() && (s[i] == ' ' || s[i] == '\t')) {
+      ++i;
+    }
+    if (i < s.size() && s[i] == '-') {
+      negative = true;
+      ++i;
+    }
+    while (i < s.size() && s[i] == '0') {
+      ++i;
+    }
+    size_t integer_begin = i;
+    while (is_digit(i)) {
+      ++i;
+    }
+    integer = s.substr(integer_begin, i - integer_begin);
+    if (i < s.size() && s[i] == '.') {
+      size_t fraction_begin = ++i;
+      while (is_digit(i)) {
+        ++i;
       }
+      while (i > fraction_begin && s[i - 1] == '0') {
+        --i;
+      }
+      fraction = s.substr(fraction_begin, i - fraction_begin);
+    }
+    if (integer.empty() && fraction.empty()) {
+      // -0 is 0.
+      negative = false;
     }
   }
-  return count;
+};
+
+int CompareNumeric(std::string_view a, std::string_view b) {
+  NumericView x(a);
+  NumericView y(b);
+  if (x.negative != y.negative) {
+    return x.negative ? -1 : 1;
+  }
+  int ret = 0;
+  if (x.integer.size() != y.integer.size()) {
+    ret = x.integer.size() < y.integer.size() ? -1 : 1;
+  } else {
+    ret = x.integer.compare(y.integer);
+    if (ret == 0) {
+      ret = x.fraction.compare(y.fraction);
+    }
+  }
+  return x.negative ? -ret : ret;
 }
 
-int GetCpuCount() {
-  // 1. check cpuset
-  std::ifstream cpuset_file("/sys/fs/cgroup/cpuset/cpuset.cpus");
-  if (cpuset_file) {
-    std::string cpuset;
-    if (std::getline(cpuset_file, cpuset)) {
-      if (!cpuset.empty() && cpuset != "0") {
-        return ParseCpuset(cpuset);
+class KeyComparator {
+ public:
+  explicit KeyComparator(bool numeric) : numeric_(numeric) {}
+
+  int Compare(std::string_view a, const KeyField* a_fields, std::string_view b,
+              const KeyField* b_fields, size_t key_num) const {
+    for (size_t i = 0; i < key_num; ++i) {
+      auto a_key = a.substr(a_fields[i].offset, a_fields[i].size);
+      auto b_key = b.substr(b_fields[i].offset, b_fields[i].size);
+      // std::string_view::compare is bytewise, which is the order of C locale.
+      int ret = numeric_ ? CompareNumeric(a_key, b_key) : a_key.compare(b_key);
+      if (ret != 0) {
+        return ret;
       }
     }
+    return 0;
   }
 
-  // 2. check CPU quota and period
-  // 2.1 cgroup v1
-  std::ifstream quota_file("/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_quota_us");
-  std::ifstream period_file("/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_period_us");
-  if (quota_file && period_file) {
-    int64_t quota;
-    int64_t period;
-    quota_file >> quota;
-    period_file >> period;
-    if (quota > 0 && period > 0) {
-      return static_cast<int>((quota + period - 1) / period);
-    }
-  }
-
-  // 2.2 cgroup v2
-  std::ifstream v2_quota_file("/sys/fs/cgroup/cpu.max");
-  if (v2_quota_file) {
-    std::string line;
-    if (std::getline(v2_quota_file, line)) {
-      std::istringstream iss(line);
-      std::string quota_str;
-      std::string period_str;
-      if (iss >> quota_str >> period_str) {
-        if (quota_str != "max") {
-          try {
-            int64_t quota = std::stoll(quota_str);
-            int64_t period = std::stoll(period_str);
-            if (period > 0) {
-              return static_cast<int>((quota + period - 1) / period);
-            }
-          } catch (...) {
-            SPDLOG_WARN(
-                "trans quota({}) or period({}) failed, use default method",
-                quota_str, period_str);
-          }
-        }
+ private:
+  bool numeric_;
+};
+
+// A run of lines to be sorted in memory.
+class SortRun {
+ public:
+  SortRun(KeyExtractor extractor, KeyComparator comparator,
+          size_t reserve_bytes)
+      : extractor_(std::move(extractor)),
+        comparator_(comparator),
+        key_num_(extractor_.key_num()) {
+    data_.reserve(reserve_bytes);
+    offsets_.push_back(0);
+  }
+
+  void Add(std::string_view line) {
+    fields_.resize(fields_.size() + key_num_);
+    extractor_.Extract(line, fields_.data() + fields_.size() - key_num_);
+    data_.append(line);
+    offsets_.push_back(data_.size());
+  }
+
+  size_t size() const { return offsets_.size() - 1; }
+
+  size_t MemoryUsage() const {
+    return data_.size() + size() * (sizeof(uint64_t) + sizeof(uint32_t) +
+                                    key_num_ * sizeof(KeyField));
+  }
+
+  // Sort segments of the run by multiple threads, then merge them pairwise.
+  // Ties are broken by input order, so the result is stable.
+  void Sort(size_t thread_num) {
+    YACL_ENFORCE(size() < std::numeric_limits<uint32_t>::max(),
+                 "too many lines in one run: {}", size());
+    order_.resize(size());
+    std::iota(order_.begin(), order_.end(), 0);
+    auto less = [this](uint32_t a, uint32_t b) {
+      int ret = comparator_.Compare(Line(a), fields_.data() + a * key_num_,
+                                    Line(b), fields_.data() + b * key_num_,
+                                    key_num_);
+      return ret != 0 ? ret < 0 : a < b;
+    };
+
+    size_t segment_num = std::clamp<size_t>(
+        order_.size() / kMinSortSegmentSize, 1, std::max<size_t>(thread_num, 1));
+    std::vector<size_t> bounds(segment_num + 1);
+    for (size_t i = 0; i <= segment_num; ++i) {
+      bounds[i] = order_.size() * i / segment_num;
+    }
+    auto begin = order_.begin();
+    std::vector<std::future<void>> futures;
+    for (size_t i = 0; i < segment_num; ++i) {
+      futures.push_back(std::async(std::launch::async, [&, i] {
+        std::sort(begin + bounds[i], begin + bounds[i + 1], less);
+      }));
+    }
+    for (auto& f : futures) {
+      f.get();
+    }
+    for (size_t width = 1; width < segment_num; width *= 2) {
+      futures.clear();
+      for (size_t i = 0; i + width < segment_num; i += 2 * width) {
+        futures.push_back(std::async(std::launch::async, [&, i, width] {
+          std::inplace_merge(begin + bounds[i], begin + bounds[i + width],
+                             begin + bounds[std::min(i + 2 * width,
+                                                     segment_num)],
+                             less);
+        }));
+      }
+      for (auto& f : futures) {
+        f.get();
+      }
+    }
+  }
+
+  // Write sorted lines. Adjacent identical lines are dropped if `unique`.
+  void Dump(LineWriter* writer, bool unique) const {
+    for (size_t i = 0; i < order_.size(); ++i) {
+      auto line = Line(order_[i]);
+      if (unique && i > 0 && line == Line(order_[i - 1])) {
+        continue;
+      }
+      writer->WriteLine(line);
+    }
+  }
+
+  void Clear() {
+    data_.clear();
+    offsets_.resize(1);
+    fields_.clear();
+    order_.clear();
+  }
+
+ private:
+  std::string_view Line(size_t i) const {
+    return std::string_view(data_).substr(offsets_[i],
+                                          offsets_[i + 1] - offsets_[i]);
+  }
+
+  KeyExtractor extractor_;
+  KeyComparator comparator_;
+  size_t key_num_;
+
+  // All lines are concatenated in `data_`, i-th line is
+  // [offsets_[i], offsets_[i+1]).
+  std::string data_;
+  std::vector<uint64_t> offsets_;
+  std::vector<KeyField> fields_;
+  std::vector<uint32_t> order_;
+};
+
+// K-way merge sorted runs into `writer`. Lines with equal keys are taken from
+// former runs first, so the result is stable.
+void MergeRuns(const std::vector<std::string>& run_paths,
+               const KeyExtractor& extractor, const KeyComparator& comparator,
+               size_t memory_budget, bool unique, LineWriter* writer) {
+  struct RunCursor {
+    RunCursor(const std::string& path, size_t buffer_size,
+              KeyExtractor key_extractor)
+        : reader(path, buffer_size),
+          extractor(std::move(key_extractor)),
+          fields(extractor.key_num()) {}
+
+    bool Next() {
+      if (!reader.Next(&line)) {
+        return false;
       }
+      extractor.Extract(line, fields.data());
+      return true;
+    }
+
+    LineReader reader;
+    KeyExtractor extractor;
+    std::string_view line;
+    std::vector<KeyField> fields;
+  };
+
+  size_t buffer_size =
+      std::clamp(memory_budget / run_paths.size(), kMinMergeIoBufferSize,
+                 kSortIoBufferSize);
+  std::vector<std::unique_ptr<RunCursor>> cursors;
+  for (const auto& path : run_paths) {
+    cursors.push_back(
+        std::make_unique<RunCursor>(path, buffer_size, extractor));
+  }
+
+  auto greater = [&](size_t a, size_t b) {
+    int ret = comparator.Compare(cursors[a]->line, cursors[a]->fields.data(),
+                                 cursors[b]->line, cursors[b]->fields.data(),
+                                 extractor.key_num());
+    return ret != 0 ? ret > 0 : a > b;
+  };
+  std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(
+      greater);
+  for (size_t i = 0; i < cursors.size(); ++i) {
+    if (cursors[i]->Next()) {
+      heap.push(i);
     }
   }
 
-  // 3. use hardware_concurrency
-  return std::thread::hardware_concurrency();
+  std::string last_line;
+  bool has_last_line = false;
+  while (!heap.empty()) {
+    size_t top = heap.top();
+    heap.pop();
+    auto line = cursors[top]->line;
+    if (!unique || !has_last_line || line != last_line) {
+      writer->WriteLine(line);
+      if (unique) {
+        last_line.assign(line);
+        has_last_line = true;
+      }
+    }
+    if (cursors[top]->Next()) {
+      heap.push(top);
+    }
+  }
+}
+
+// Construct sort key indices from the header of `csv`.
+std::vector<size_t> GetKeyCols(const std::string& csv,
+                               const std::vector<std::string>& keys) {
+  auto csv_reader = MakeCsvReader(csv);
+  auto schema = csv_reader->schema();
+
+  YACL_ENFORCE(!keys.empty(), "sort keys are empty");
+
+  std::vector<size_t> key_cols;
+  for (const auto& key : keys) {
+    auto index = schema->GetFieldIndex(key);
+    YACL_ENFORCE(index >= 0, "field {} is not found in {}", key, csv);
+    key_cols.push_back(index);
+  }
+  YACL_ENFORCE(key_cols.size() == keys.size(),
+               "mismatched header, field_names={}", fmt::join(keys, ","));
+  return key_cols;
 }
 
 }  // namespace
 
-// Multiple-Key out-of-core sort.
-// Out-of-core support reference:
-//   http://vkundeti.blogspot.com/2008/03/tech-algorithmic-details-of-unix-sort.html
-// Multiple-Key support reference:
-//   https://stackoverflow.com/questions/9471101/sort-csv-file-by-column-priority-using-the-sort-command
-// use POSIX locale for sort
-//   https://unix.stackexchange.com/questions/43465/whats-the-default-order-of-linux-sort/43466
-//
-// NOTE:
-// This implementation requires `sort` command, which is guaranteed by our
-// docker-way ship.
 void MultiKeySort(const std::string& in_csv, const std::string& out_csv,
                   const std::vector<std::string>& keys, bool numeric_sort,
-                  bool unique) {
-  auto csv_reader = MakeCsvReader(in_csv);
-  auto schema = csv_reader->schema();
+                  bool unique, const MultiKeySortOptions& options) {
+  auto key_cols = GetKeyCols(in_csv, keys);
+
+  size_t thread_num = options.thread_num;
+  if (thread_num == 0) {
+    thread_num = std::max(GetCpuCount(), 1);
+  }
+  size_t memory_budget = options.memory_budget;
+  if (memory_budget == 0) {
+    memory_budget = GetMemoryLimit() / 4;
+  }
+  memory_budget = std::max(memory_budget, kMinSortMemoryBudget);
+  std::filesystem::path tmp_dir = options.tmp_dir;
+  if (tmp_dir.empty()) {
+    tmp_dir = std::filesystem::absolute(out_csv).parent_path();
+  }
 
-  std::string line;
+  SPDLOG_INFO(
+      "Begin sort {} to {}, keys: {}, numeric: {}, unique: {}, threads: {}, "
+      "memory budget: {} bytes",
+      in_csv, out_csv, fmt::join(keys, ","), numeric_sort, unique, thread_num,
+      memory_budget);
+
+  std::vector<std::string> run_paths;
+  ON_SCOPE_EXIT([&] {
+    for (const auto& run_path : run_paths) {
+      std::error_code ec;
+      std::filesystem::remove(run_path, ec);
+      if (ec.value() != 0) {
+        SPDLOG_WARN("can not remove tmp file: {}, msg: {}", run_path,
+                    ec.message());
+      }
+    }
+  });
+
+  LineWriter writer(out_csv);
+  KeyComparator comparator(numeric_sort);
+  size_t line_cnt = 0;
   {
-    // Copy head line to out_csv
-    // Add scope to flush write here.
-    io::FileIoOptions in_opts(in_csv);
-    auto in = io::BuildInputStream(in_opts);
-    in->GetLine(&line);
-    in->Close();
-
-    io::FileIoOptions out_opts(out_csv);
-    auto out = io::BuildOutputStream(out_opts);
-    out->Write(line);
-    out->Write("\n");
-    out->Close();
-  }
-
-  // Construct sort key indices.
-  std::vector<std::string> sort_keys;
-  for (auto key : keys) {
-    auto index = schema->GetFieldIndex(key);
-    YACL_ENFORCE(index >= 0, "field {} is not found in {}", key, in_csv);
-    // NOTE: `sort` cmd starts from index 1.
-    auto sort_index = index + 1;
-    // About `sort --key=KEYDEF`
-    //
-    // KEYDEF is F[.C][OPTS][,F[.C][OPTS]] for start and stop position, where
-    // F is a field number and C a character position in the field; both are
-    // origin 1, and the stop position defaults to the line's end.  If neither
-    // -t nor -b is in effect, characters in a field are counted from the
-    // beginning of the preceding whitespace.  OPTS is one or more
-    // single-letter ordering options [bdfgiMhnRrV], which override global
-    // ordering options for that key.  If no key is given, use the entire line
-    // as the key.
-    //
-    // I have already verified `sort --key=3,3 --key=1,1` will firstly sort by
-    // 3rd field and then 1st field.
-    sort_keys.push_back(fmt::format("--key={},{}", sort_index, sort_index));
-  }
-  YACL_ENFORCE(sort_keys.size() == keys.size(),
-               "mismatched header, field_names={}, line={}",
-               fmt::join(keys, ","), line);
-
-  int mcpus = GetCpuCount();
-
-  // Sort the csv body and append to out csv.
-  std::string cmd = fmt::format(
-      "tail -n +2 {} | LC_ALL=C sort {} --parallel={} --buffer-size=1G "
-      "--stable "
-      "--field-separator=, {} {} >>{}",
-      in_csv, numeric_sort ? "-n" : "", mcpus, fmt::join(sort_keys, " "),
-      unique ? "| LC_ALL=C uniq" : "", out_csv);
-  SPDLOG_INFO("Executing sort scripts: {}", cmd);
-  int ret = system(cmd.c_str());
-  SPDLOG_INFO("Finished sort scripts: {}, ret={}", cmd, ret);
-  YACL_ENFORCE(ret == 0, "failed to execute cmd={}, ret={}", cmd, ret);
+    LineReader reader(in_csv, kSortIoBufferSize);
+    std::string_view line;
+    // Copy head line to out_csv.
+    if (reader.Next(&line)) {
+      writer.WriteLine(line);
+    }
+
+    SortRun run(KeyExtractor(key_cols), comparator,
+                std::min<size_t>(memory_budget,
+                                 std::filesystem::file_size(in_csv) + 1));
+    auto spill_run = [&]() {
+      run.Sort(thread_num);
+      run_paths.push_back(
+          (tmp_dir / fmt::format("psi_sort_run_{}_{}", GetRandomString(),
+                                 run_paths.size()))
+              .string());
+      LineWriter run_writer(run_paths.back());
+      run.Dump(&run_writer, unique);
+      run_writer.Close();
+      SPDLOG_INFO("Spill sorted run {} with {} lines", run_paths.back(),
+                  run.size());
+      run.Clear();
+    };
+
+    while (reader.Next(&line)) {
+      run.Add(line);
+      line_cnt++;
+      if (run.MemoryUsage() >= memory_budget) {
+        spill_run();
+      }
+    }
+
+    if (run_paths.empty()) {
+      // Everything fits in memory, write to out_csv directly.
+      run.Sort(thread_num);
+      run.Dump(&writer, unique);
+    } else if (run.size() > 0) {
+      spill_run();
+    }
+  }
+
+  if (!run_paths.empty()) {
+    MergeRuns(run_paths, KeyExtractor(key_cols), comparator, memory_budget,
+              unique, &writer);
+  }
+  writer.Close();
+
+  SPDLOG_INFO("Finished sort {} to {}, lines: {}, runs: {}", in_csv, out_csv,
+              line_cnt, run_paths.size());
+}
+
+bool IsSortedByKeys(const std::string& csv,
+                    const std::vector<std::string>& keys, bool numeric_sort) {
+  KeyExtractor extractor(GetKeyCols(csv, keys));
+  KeyComparator comparator(numeric_sort);
+  size_t key_num = extractor.key_num();
+
+  LineReader reader(csv, kSortIoBufferSize);
+  std::string_view line;
+  // Skip head line.
+  if (!reader.Next(&line)) {
+    return true;
+  }
+
+  // `line` is invalidated by next read, so keep a copy of the previous one.
+  std::string prev_line;
+  std::vector<KeyField> prev_fields(key_num);
+  std::vector<KeyField> fields(key_num);
+  size_t line_cnt = 0;
+  while (reader.Next(&line)) {
+    extractor.Extract(line, fields.data());
+    if (line_cnt > 0 &&
+        comparator.Compare(prev_line, prev_fields.data(), line, fields.data(),
+                           key_num) > 0) {
+      SPDLOG_INFO("{} is not sorted by keys {}: line {} is out of order", csv,
+                  fmt::join(keys, ","), line_cnt + 2);
+      return false;
+    }
+    prev_line.assign(line);
+    prev_fields.swap(fields);
+    line_cnt++;
+  }
+  SPDLOG_INFO("{} is sorted by keys {}, lines: {}", csv, fmt::join(keys, ","),
+              line_cnt);
+  return true;
 }
 
 std::string KeysJoin(const std::vector<absl::string_view>& keys, char sep) {
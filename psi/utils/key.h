@@ -21,20 +21,45 @@
 
 namespace psi {
 
+struct MultiKeySortOptions {
+  // Memory budget in bytes for in-memory runs. If 0, a quarter of the memory
+  // limit of current cgroup (or of the physical memory) is used.
+  size_t memory_budget = 0;
+
+  // Number of threads used to sort runs. If 0, cpu count of current cgroup is
+  // used.
+  size_t thread_num = 0;
+
+  // Directory to hold temporary sorted runs. If empty, the directory of output
+  // file is used.
+  std::string tmp_dir;
+};
+
 // Multiple-Key out-of-core sort.
-// Out-of-core support reference:
-//   http://vkundeti.blogspot.com/2008/03/tech-algorithmic-details-of-unix-sort.html
-// Multiple-Key support reference:
-//   https://stackoverflow.com/questions/9471101/sort-csv-file-by-column-priority-using-the-sort-command
-// use POSIX locale for sort
-//   https://unix.stackexchange.com/questions/43465/whats-the-default-order-of-linux-sort/43466
 //
-// NOTE:
-// This implementation requires `sort` command, which is guaranteed by our
-// docker-way ship.
+// The body of `in_csv` is split into runs which fit into memory budget, each
+// run is sorted by multiple threads and spilled to disk, then all runs are
+// k-way merged into `out_csv`. Header line of `in_csv` is copied as it is.
+//
+// The semantic is the same as
+//   tail -n +2 in_csv |
+//     LC_ALL=C sort --stable --field-separator=, [-n] --key=k1,k1 ... |
+//     [LC_ALL=C uniq]
+// i.e. fields are split by raw ',', keys are compared bytewise (or as numbers
+// if `numeric_sort`), lines with equal keys keep their input order, and
+// `unique` drops adjacent identical lines of the sorted output.
 void MultiKeySort(const std::string& in_csv, const std::string& out_csv,
                   const std::vector<std::string>& keys,
-                  bool numeric_sort = false, bool unique = false);
+                  bool numeric_sort = false, bool unique = false,
+                  const MultiKeySortOptions& options = {});
+
+// Returns whether the body of `csv` is already in the order MultiKeySort with
+// the same `keys` and `numeric_sort` would produce, i.e. keys of every line
+// are not less than keys of the line before. Lines are streamed and the check
+// stops at the first line out of order.
+bool IsSortedByKeys(const std::string& csv,
+                    const std::vector<std::string>& keys,
+                    bool numeric_sort = false);
 
 // join keys with ","
 std::string KeysJoin(const std::vector<absl::string_view>& keys,
@@ -0,0 +1,181 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "psi/utils/key_info_index.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <utility>
+
+#include "spdlog/spdlog.h"
+#include "yacl/base/exception.h"
+#include "yacl/crypto/hash/hash_utils.h"
+#include "yacl/utils/parallel.h"
+#include "yacl/utils/scope_guard.h"
+
+namespace psi {
+
+namespace {
+
+constexpr size_t kReadBufferSize = 1 << 20;
+
+}  // namespace
+
+std::shared_ptr<KeyInfoIndex> KeyInfoIndex::Open(const std::string& path,
+                                                 uint64_t source_file_size) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+  ON_SCOPE_EXIT([&] { close(fd); });
+
+  struct stat st;
+  YACL_ENFORCE(fstat(fd, &st) == 0, "stat file {} failed: {}", path,
+               std::strerror(errno));
+  size_t file_size = st.st_size;
+  if (file_size < sizeof(Header)) {
+    SPDLOG_WARN("key info index {} is truncated", path);
+    return nullptr;
+  }
+
+  void* addr = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  YACL_ENFORCE(addr != MAP_FAILED, "mmap file {} failed: {}", path,
+               std::strerror(errno));
+
+  std::shared_ptr<KeyInfoIndex> index(new KeyInfoIndex());
+  index->addr_ = addr;
+  index->mapped_size_ = file_size;
+  index->header_ = static_cast<const Header*>(addr);
+  index->entries_ = reinterpret_cast<const Entry*>(
+      static_cast<const char*>(addr) + sizeof(Header));
+
+  const auto& header = *index->header_;
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion ||
+      file_size != sizeof(Header) + header.item_cnt * sizeof(Entry)) {
+    SPDLOG_WARN("key info index {} is broken", path);
+    return nullptr;
+  }
+  if (header.source_file_size != source_file_size) {
+    SPDLOG_WARN("key info index {} is built from a source of {} bytes, not {}",
+                path, header.source_file_size, source_file_size);
+    return nullptr;
+  }
+  return index;
+}
+
+KeyInfoIndex::~KeyInfoIndex() {
+  if (addr_ != nullptr) {
+    munmap(addr_, mapped_size_);
+  }
+}
+
+KeyInfoIndexWriter::KeyInfoIndexWriter(std::string index_path,
+                                       std::string source_path)
+    : index_path_(std::move(index_path)),
+      tmp_path_(index_path_ + ".tmp"),
+      source_path_(std::move(source_path)),
+      buf_(kReadBufferSize) {
+  out_.open(tmp_path_, std::ios::binary | std::ios::trunc);
+  YACL_ENFORCE(out_.is_open(), "open file {} failed", tmp_path_);
+  KeyInfoIndex::Header header{};
+  out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  source_.open(source_path_, std::ios::binary);
+  YACL_ENFORCE(source_.is_open(), "open file {} failed", source_path_);
+  // Skip the header line.
+  YACL_ENFORCE(NextLine(), "source file {} is empty", source_path_);
+}
+
+bool KeyInfoIndexWriter::NextLine() {
+  while (true) {
+    if (buf_pos_ == buf_len_) {
+      source_.read(buf_.data(), buf_.size());
+      buf_len_ = source_.gcount();
+      buf_pos_ = 0;
+      if (buf_len_ == 0) {
+        return false;
+      }
+    }
+    const char* begin = buf_.data() + buf_pos_;
+    const auto* newline =
+        static_cast<const char*>(std::memchr(begin, '\n', buf_len_ - buf_pos_));
+    if (newline != nullptr) {
+      size_t n = newline - begin + 1;
+      buf_pos_ += n;
+      offset_ += n;
+      return true;
+    }
+    offset_ += buf_len_ - buf_pos_;
+    buf_pos_ = buf_len_;
+  }
+}
+
+uint64_t KeyInfoIndexWriter::RowOffset(uint32_t row) {
+  YACL_ENFORCE(row >= row_, "rows should be ascending, {} after {}", row,
+               row_);
+  while (row_ < row) {
+    YACL_ENFORCE(NextLine(), "source file {} has only {} rows", source_path_,
+                 row_ + 1);
+    row_++;
+  }
+  return offset_;
+}
+
+void KeyInfoIndexWriter::Append(const std::vector<std::string>& keys,
+                                const std::vector<uint32_t>& start_indexes,
+                                const std::vector<uint32_t>& dup_cnts) {
+  YACL_ENFORCE(keys.size() == start_indexes.size() &&
+                   keys.size() == dup_cnts.size(),
+               "size of keys {}, start_indexes {} and dup_cnts {} mismatch",
+               keys.size(), start_indexes.size(), dup_cnts.size());
+
+  std::vector<KeyInfoIndex::Entry> entries(keys.size());
+  yacl::parallel_for(0, keys.size(), [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) {
+      entries[i].digest = yacl::crypto::Blake3_128(keys[i]);
+    }
+  });
+  for (size_t i = 0; i < keys.size(); ++i) {
+    entries[i].offset = RowOffset(start_indexes[i]);
+    entries[i].start_index = start_indexes[i];
+    entries[i].dup_cnt = dup_cnts[i];
+  }
+  out_.write(reinterpret_cast<const char*>(entries.data()),
+             entries.size() * sizeof(KeyInfoIndex::Entry));
+  item_cnt_ += entries.size();
+}
+
+void KeyInfoIndexWriter::Finish() {
+  KeyInfoIndex::Header header{};
+  std::memcpy(header.magic, KeyInfoIndex::kMagic, sizeof(KeyInfoIndex::kMagic));
+  header.version = KeyInfoIndex::kVersion;
+  header.item_cnt = item_cnt_;
+  header.source_file_size = std::filesystem::file_size(source_path_);
+  out_.seekp(0);
+  out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out_.close();
+  YACL_ENFORCE(!out_.fail(), "write file {} failed", tmp_path_);
+
+  std::filesystem::rename(tmp_path_, index_path_);
+  SPDLOG_INFO("write key info index {}, item_cnt={}", index_path_, item_cnt_);
+}
+
+}  // namespace psi
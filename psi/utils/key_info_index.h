@@ -0,0 +1,124 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "yacl/base/int128.h"
+
+namespace psi {
+
+// Binary companion index of KeyInfo. Entry i describes the i-th unique key:
+// its digest, and where its rows are in the source csv file, so that rows of
+// a key can be reached with one seek.
+//
+// Layout:
+//   Header | Entry[item_cnt]
+class KeyInfoIndex {
+ public:
+  static constexpr char kMagic[8] = {'P', 'S', 'I', 'K', 'I', 'D', 'X', '\0'};
+  static constexpr uint32_t kVersion = 1;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t item_cnt;
+    // Size of the source csv file, to detect a stale index.
+    uint64_t source_file_size;
+  };
+
+  struct Entry {
+    // Blake3_128 of the joined key, which is the item of the key digest
+    // file, see KeyInfo::MakeDigestFile.
+    uint128_t digest;
+    // Byte offset of the first row of the key in the source file.
+    uint64_t offset;
+    // Row index of the first row of the key, excluding the header line.
+    uint32_t start_index;
+    uint32_t dup_cnt;
+  };
+
+  // Maps the index file into memory. Returns nullptr if the file doesn't
+  // exist, is broken, or is not built from a source of `source_file_size`.
+  static std::shared_ptr<KeyInfoIndex> Open(const std::string& path,
+                                            uint64_t source_file_size);
+
+  KeyInfoIndex(const KeyInfoIndex&) = delete;
+  KeyInfoIndex& operator=(const KeyInfoIndex&) = delete;
+
+  ~KeyInfoIndex();
+
+  uint64_t size() const { return header_->item_cnt; }
+
+  const Entry& operator[](uint64_t i) const { return entries_[i]; }
+
+  uint64_t source_file_size() const { return header_->source_file_size; }
+
+ private:
+  KeyInfoIndex() = default;
+
+  void* addr_ = nullptr;
+  size_t mapped_size_ = 0;
+  const Header* header_ = nullptr;
+  const Entry* entries_ = nullptr;
+};
+
+static_assert(sizeof(KeyInfoIndex::Header) == 32);
+static_assert(sizeof(KeyInfoIndex::Entry) == 32);
+
+class KeyInfoIndexWriter {
+ public:
+  // `source_path` is the csv file which rows are indexed, with a header line.
+  KeyInfoIndexWriter(std::string index_path, std::string source_path);
+
+  // Keys must be appended in the order of KeyInfo, with ascending
+  // start_indexes.
+  void Append(const std::vector<std::string>& keys,
+              const std::vector<uint32_t>& start_indexes,
+              const std::vector<uint32_t>& dup_cnts);
+
+  // Index file is only visible at `index_path` after Finish.
+  void Finish();
+
+ private:
+  // Byte offset of the start of row `row` in the source file.
+  uint64_t RowOffset(uint32_t row);
+
+  // Moves to the start of next line. Returns false at end of file.
+  bool NextLine();
+
+  std::string index_path_;
+  std::string tmp_path_;
+  std::string source_path_;
+
+  std::ofstream out_;
+  uint64_t item_cnt_ = 0;
+
+  std::ifstream source_;
+  std::vector<char> buf_;
+  size_t buf_pos_ = 0;
+  size_t buf_len_ = 0;
+  // Byte offset and row index at the scan position.
+  uint64_t offset_ = 0;
+  uint32_t row_ = 0;
+};
+
+}  // namespace psi
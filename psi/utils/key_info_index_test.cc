@@ -0,0 +1,93 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "psi/utils/key_info_index.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "yacl/crypto/hash/hash_utils.h"
+
+namespace psi {
+
+class KeyInfoIndexTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    tmp_dir_ = "./tmp_key_info_index_test";
+    std::filesystem::create_directory(tmp_dir_);
+    source_path_ = tmp_dir_ + "/source.csv";
+    index_path_ = tmp_dir_ + "/source.csv.idx";
+
+    // No line break at the end of file.
+    std::ofstream out(source_path_);
+    out << "id,name\n"
+        << "a,alice\n"
+        << "b,bob\n"
+        << "b,carol\n"
+        << "c,davy";
+  }
+  void TearDown() override {
+    std::error_code ec;
+    std::filesystem::remove_all(tmp_dir_, ec);
+  }
+
+  std::string tmp_dir_;
+  std::string source_path_;
+  std::string index_path_;
+};
+
+TEST_F(KeyInfoIndexTest, Works) {
+  KeyInfoIndexWriter writer(index_path_, source_path_);
+  writer.Append({"a", "b"}, {0, 1}, {0, 1});
+  writer.Append({"c"}, {3}, {0});
+  EXPECT_FALSE(std::filesystem::exists(index_path_));
+  writer.Finish();
+
+  auto source_size = std::filesystem::file_size(source_path_);
+  auto index = KeyInfoIndex::Open(index_path_, source_size);
+  ASSERT_TRUE(index);
+  ASSERT_EQ(index->size(), 3);
+  EXPECT_EQ(index->source_file_size(), source_size);
+
+  EXPECT_EQ((*index)[0].digest, yacl::crypto::Blake3_128("a"));
+  EXPECT_EQ((*index)[0].offset, 8);
+  EXPECT_EQ((*index)[1].digest, yacl::crypto::Blake3_128("b"));
+  EXPECT_EQ((*index)[1].offset, 16);
+  EXPECT_EQ((*index)[1].start_index, 1);
+  EXPECT_EQ((*index)[1].dup_cnt, 1);
+  EXPECT_EQ((*index)[2].offset, 30);
+  EXPECT_EQ((*index)[2].start_index, 3);
+
+  // Stale index.
+  EXPECT_FALSE(KeyInfoIndex::Open(index_path_, source_size + 1));
+}
+
+TEST_F(KeyInfoIndexTest, Broken) {
+  EXPECT_FALSE(KeyInfoIndex::Open(index_path_, 0));
+
+  {
+    KeyInfoIndexWriter writer(index_path_, source_path_);
+    writer.Append({"a", "b"}, {0, 1}, {0, 1});
+    writer.Finish();
+  }
+  std::filesystem::resize_file(index_path_,
+                               std::filesystem::file_size(index_path_) - 1);
+  EXPECT_FALSE(KeyInfoIndex::Open(index_path_,
+                                  std::filesystem::file_size(source_path_)));
+}
+
+}  // namespace psi
@@ -0,0 +1,158 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "psi/utils/key.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "fmt/format.h"
+#include "gtest/gtest.h"
+
+namespace psi {
+
+namespace {
+
+void WriteLines(const std::string& path,
+                const std::vector<std::string>& lines) {
+  std::ofstream out(path);
+  for (const auto& line : lines) {
+    out << line << '\n';
+  }
+}
+
+std::vector<std::string> ReadLines(const std::string& path) {
+  std::ifstream in(path);
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(in, line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+}  // namespace
+
+class MultiKeySortTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    tmp_dir_ = "./tmp_key_test";
+    std::filesystem::create_directory(tmp_dir_);
+    in_path_ = tmp_dir_ + "/in.csv";
+    out_path_ = tmp_dir_ + "/out.csv";
+  }
+  void TearDown() override {
+    std::error_code ec;
+    std::filesystem::remove_all(tmp_dir_, ec);
+  }
+
+  std::string tmp_dir_;
+  std::string in_path_;
+  std::string out_path_;
+};
+
+TEST_F(MultiKeySortTest, MultiKeyStable) {
+  WriteLines(in_path_, {"id,name,value", "b,2,x", "a,3,y", "b,1,z", "a,3,a",
+                        "c,1,b", "b,1,c"});
+
+  MultiKeySort(in_path_, out_path_, {"name", "id"});
+
+  EXPECT_EQ(ReadLines(out_path_),
+            std::vector<std::string>({"id,name,value", "b,1,z", "b,1,c",
+                                      "c,1,b", "b,2,x", "a,3,y", "a,3,a"}));
+}
+
+TEST_F(MultiKeySortTest, Numeric) {
+  WriteLines(in_path_, {"idx,cnt", "10,0", "9,1", "-1,2", "0.5,3", "100,4",
+                        "09,5", "-0,6"});
+
+  MultiKeySort(in_path_, out_path_, {"idx"}, true);
+
+  EXPECT_EQ(ReadLines(out_path_),
+            std::vector<std::string>({"idx,cnt", "-1,2", "-0,6", "0.5,3",
+                                      "9,1", "09,5", "10,0", "100,4"}));
+}
+
+TEST_F(MultiKeySortTest, Unique) {
+  WriteLines(in_path_,
+             {"id,v", "b,1", "a,1", "b,2", "b,1", "a,1", "a,1", "c,3"});
+
+  MultiKeySort(in_path_, out_path_, {"id"}, false, true);
+
+  // Like `uniq`, only adjacent identical lines are dropped.
+  EXPECT_EQ(ReadLines(out_path_),
+            std::vector<std::string>({"id,v", "a,1", "b,1", "b,2", "b,1",
+                                      "c,3"}));
+}
+
+TEST_F(MultiKeySortTest, OutOfCore) {
+  std::mt19937 rng(0);
+  std::vector<std::string> lines;
+  constexpr size_t kLineNum = 200000;
+  for (size_t i = 0; i < kLineNum; ++i) {
+    lines.push_back(fmt::format("{},{},{}", rng() % 1000, i, rng() % 10));
+  }
+  std::vector<std::string> input = lines;
+  input.insert(input.begin(), "k1,row,k2");
+  WriteLines(in_path_, input);
+
+  MultiKeySortOptions options;
+  // Force several runs on disk.
+  options.memory_budget = 1;
+  options.thread_num = 4;
+  options.tmp_dir = tmp_dir_;
+  MultiKeySort(in_path_, out_path_, {"k2", "k1"}, true, false, options);
+
+  auto key = [](const std::string& line) {
+    auto first = line.find(',');
+    auto last = line.rfind(',');
+    return std::make_pair(std::stoi(line.substr(last + 1)),
+                          std::stoi(line.substr(0, first)));
+  };
+  std::stable_sort(lines.begin(), lines.end(),
+                   [&](const std::string& a, const std::string& b) {
+                     return key(a) < key(b);
+                   });
+  lines.insert(lines.begin(), "k1,row,k2");
+  EXPECT_EQ(ReadLines(out_path_), lines);
+
+  // Temporary runs are removed.
+  EXPECT_EQ(std::distance(std::filesystem::directory_iterator(tmp_dir_),
+                          std::filesystem::directory_iterator{}),
+            2);
+}
+
+TEST_F(MultiKeySortTest, IsSortedByKeys) {
+  WriteLines(in_path_, {"id,name,value", "b,2,x", "a,3,y", "b,1,z", "a,3,a",
+                        "c,1,b", "b,1,c"});
+  EXPECT_FALSE(IsSortedByKeys(in_path_, {"name", "id"}));
+
+  MultiKeySort(in_path_, out_path_, {"name", "id"});
+  EXPECT_TRUE(IsSortedByKeys(out_path_, {"name", "id"}));
+  EXPECT_FALSE(IsSortedByKeys(out_path_, {"id", "name"}));
+
+  // Bytewise order is not numeric order.
+  WriteLines(in_path_, {"idx", "9", "10"});
+  EXPECT_FALSE(IsSortedByKeys(in_path_, {"idx"}));
+  EXPECT_TRUE(IsSortedByKeys(in_path_, {"idx"}, true));
+
+  WriteLines(in_path_, {"idx"});
+  EXPECT_TRUE(IsSortedByKeys(in_path_, {"idx"}));
+}
+
+}  // namespace psi
@@ -0,0 +1,297 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "psi/utils/preprocess_cache.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <string_view>
+#include <utility>
+
+#include "absl/strings/escaping.h"
+#include "absl/strings/string_view.h"
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+#include "yacl/base/byte_container_view.h"
+#include "yacl/base/exception.h"
+#include "yacl/crypto/hash/blake3.h"
+
+#include "psi/utils/random_str.h"
+
+namespace psi {
+
+namespace {
+
+// Bumped when layout of entries changes, so that old entries are not used.
+constexpr char kCacheVersion[] = "psi-preprocess-cache-v1";
+
+constexpr char kLockFile[] = ".lock";
+
+constexpr char kReadyFile[] = ".ready";
+
+constexpr char kTmpDirTag[] = ".tmp.";
+
+constexpr size_t kReadBufferSize = 4 << 20;
+
+constexpr size_t kFingerprintSize = 16;
+
+void Lock(int fd, int operation) {
+  while (flock(fd, operation) != 0) {
+    YACL_ENFORCE(errno == EINTR, "flock failed: {}", std::strerror(errno));
+  }
+}
+
+// Whether `fd` is still the file at `path`, which is false if the file is
+// removed by eviction after it is opened.
+bool IsSameFile(int fd, const std::filesystem::path& path) {
+  struct stat fd_st;
+  struct stat path_st;
+  if (fstat(fd, &fd_st) != 0 || stat(path.c_str(), &path_st) != 0) {
+    return false;
+  }
+  return fd_st.st_dev == path_st.st_dev && fd_st.st_ino == path_st.st_ino;
+}
+
+uint64_t DirSize(const std::filesystem::path& dir) {
+  uint64_t size = 0;
+  std::error_code ec;
+  for (const auto& entry :
+       std::filesystem::recursive_directory_iterator(dir, ec)) {
+    if (entry.is_regular_file(ec)) {
+      size += entry.file_size(ec);
+    }
+  }
+  return size;
+}
+
+// Removes everything in `dir` but the lock file. Temporary dirs only if
+// `tmp_only`.
+void ClearDir(const std::filesystem::path& dir, bool tmp_only) {
+  for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+    auto name = entry.path().filename().string();
+    if (name == kLockFile ||
+        (tmp_only && name.find(kTmpDirTag) == std::string::npos)) {
+      continue;
+    }
+    std::filesystem::remove_all(entry.path());
+  }
+}
+
+}  // namespace
+
+PreprocessCache::Entry::Entry(std::filesystem::path dir, int lock_fd,
+                              bool ready)
+    : dir_(std::move(dir)), lock_fd_(lock_fd), ready_(ready) {}
+
+PreprocessCache::Entry::~Entry() {
+  // mtime of lock file is the last used time of the entry.
+  if (futimens(lock_fd_, nullptr) != 0) {
+    SPDLOG_WARN("touch {} failed: {}", (dir_ / kLockFile).string(),
+                std::strerror(errno));
+  }
+  close(lock_fd_);
+}
+
+void PreprocessCache::Entry::MarkReady() {
+  if (ready_) {
+    return;
+  }
+  std::ofstream(dir_ / kReadyFile).close();
+  YACL_ENFORCE(std::filesystem::exists(dir_ / kReadyFile),
+               "create file {} failed", (dir_ / kReadyFile).string());
+  Lock(lock_fd_, LOCK_SH);
+  ready_ = true;
+  SPDLOG_INFO("preprocess cache entry {} is ready", dir_.string());
+}
+
+std::filesystem::path PreprocessCache::Entry::GetOrBuildDir(
+    const std::string& name,
+    const std::function<void(const std::filesystem::path&)>& build) {
+  auto target = dir_ / name;
+  if (std::filesystem::exists(target)) {
+    SPDLOG_INFO("reuse {} in preprocess cache", target.string());
+    return target;
+  }
+
+  auto tmp = dir_ / fmt::format("{}{}{}", name, kTmpDirTag, GetRandomString());
+  build(tmp);
+  std::error_code ec;
+  std::filesystem::rename(tmp, target, ec);
+  if (ec) {
+    // Built by another task at the same time.
+    YACL_ENFORCE(std::filesystem::exists(target), "rename {} to {} failed: {}",
+                 tmp.string(), target.string(), ec.message());
+    std::filesystem::remove_all(tmp);
+  }
+  return target;
+}
+
+PreprocessCache::PreprocessCache(std::filesystem::path folder,
+                                 uint64_t max_size_bytes,
+                                 uint64_t max_age_seconds)
+    : folder_(std::move(folder)),
+      max_size_bytes_(max_size_bytes),
+      max_age_seconds_(max_age_seconds) {
+  YACL_ENFORCE(!folder_.empty(), "preprocess cache folder is empty");
+  std::filesystem::create_directories(folder_);
+}
+
+std::string PreprocessCache::Fingerprint(const std::string& input_path,
+                                         const std::vector<std::string>& keys,
+                                         const std::string& tag) {
+  yacl::crypto::Blake3Hash hash;
+  auto update = [&](std::string_view field) {
+    uint64_t size = field.size();
+    hash.Update(yacl::ByteContainerView(&size, sizeof(size)));
+    hash.Update(yacl::ByteContainerView(field));
+  };
+  update(kCacheVersion);
+  update(tag);
+  for (const auto& key : keys) {
+    update(key);
+  }
+
+  std::ifstream in(input_path, std::ios::binary);
+  YACL_ENFORCE(in.is_open(), "open file {} failed", input_path);
+  std::vector<char> buf(kReadBufferSize);
+  while (in) {
+    in.read(buf.data(), buf.size());
+    hash.Update(yacl::ByteContainerView(buf.data(), in.gcount()));
+  }
+  YACL_ENFORCE(in.eof(), "read file {} failed", input_path);
+
+  auto digest = hash.CumulativeHash();
+  return absl::BytesToHexString(absl::string_view(
+      reinterpret_cast<const char*>(digest.data()), kFingerprintSize));
+}
+
+std::shared_ptr<PreprocessCache::Entry> PreprocessCache::Open(
+    const std::string& fingerprint) {
+  auto dir = folder_ / fingerprint;
+  auto lock_path = dir / kLockFile;
+  while (true) {
+    std::filesystem::create_directories(dir);
+    int fd = open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      // The entry is evicted after the dir is created.
+      YACL_ENFORCE(errno == ENOENT, "open file {} failed: {}",
+                   lock_path.string(), std::strerror(errno));
+      continue;
+    }
+
+    Lock(fd, LOCK_SH);
+    if (IsSameFile(fd, lock_path) &&
+        std::filesystem::exists(dir / kReadyFile)) {
+      SPDLOG_INFO("open ready preprocess cache entry {}", dir.string());
+      return std::shared_ptr<Entry>(new Entry(dir, fd, true));
+    }
+
+    // Not ready, fill it exclusively. The lock is released during conversion,
+    // so the entry may be filled or evicted by others in the meantime.
+    Lock(fd, LOCK_EX);
+    if (!IsSameFile(fd, lock_path)) {
+      close(fd);
+      continue;
+    }
+    if (std::filesystem::exists(dir / kReadyFile)) {
+      Lock(fd, LOCK_SH);
+      SPDLOG_INFO("open ready preprocess cache entry {}", dir.string());
+      return std::shared_ptr<Entry>(new Entry(dir, fd, true));
+    }
+    ClearDir(dir, false);
+    SPDLOG_INFO("open new preprocess cache entry {}", dir.string());
+    return std::shared_ptr<Entry>(new Entry(dir, fd, false));
+  }
+}
+
+void PreprocessCache::Evict() {
+  struct Candidate {
+    std::filesystem::path dir;
+    int lock_fd;
+    std::time_t last_used;
+    uint64_t size;
+  };
+
+  std::vector<Candidate> candidates;
+  uint64_t total_size = 0;
+  for (const auto& dir_entry : std::filesystem::directory_iterator(folder_)) {
+    if (!dir_entry.is_directory()) {
+      continue;
+    }
+    auto dir = dir_entry.path();
+    uint64_t size = DirSize(dir);
+    total_size += size;
+
+    int fd = open((dir / kLockFile).c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+      continue;
+    }
+    // Entries in use, including the ones opened by this process, are locked.
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0 ||
+        !IsSameFile(fd, dir / kLockFile)) {
+      close(fd);
+      continue;
+    }
+    struct stat st;
+    YACL_ENFORCE(fstat(fd, &st) == 0, "stat file {} failed: {}",
+                 (dir / kLockFile).string(), std::strerror(errno));
+    candidates.push_back({dir, fd, st.st_mtime, size});
+  }
+
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate& a, const Candidate& b) {
+              return a.last_used < b.last_used;
+            });
+  auto now = std::time(nullptr);
+  size_t evicted = 0;
+  for (const auto& candidate : candidates) {
+    bool expired =
+        max_age_seconds_ > 0 &&
+        static_cast<uint64_t>(std::max<std::time_t>(
+            now - candidate.last_used, 0)) > max_age_seconds_;
+    bool oversized = max_size_bytes_ > 0 && total_size > max_size_bytes_;
+    std::error_code ec;
+    if (expired || oversized) {
+      std::filesystem::remove_all(candidate.dir, ec);
+      if (ec) {
+        SPDLOG_WARN("remove preprocess cache entry {} failed: {}",
+                    candidate.dir.string(), ec.message());
+      } else {
+        total_size -= candidate.size;
+        evicted++;
+      }
+    } else {
+      // Leftovers of tasks crashed while building sub directories.
+      try {
+        ClearDir(candidate.dir, true);
+      } catch (const std::exception& e) {
+        SPDLOG_WARN("clear preprocess cache entry {} failed: {}",
+                    candidate.dir.string(), e.what());
+      }
+    }
+    close(candidate.lock_fd);
+  }
+  SPDLOG_INFO("evict {} preprocess cache entries in {}, total size: {} bytes",
+              evicted, folder_.string(), total_size);
+}
+
+}  // namespace psi
@@ -0,0 +1,95 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace psi {
+
+// A persistent cache of preprocessed input, shared by tasks.
+//
+// Each entry is a directory under the cache folder named by the fingerprint
+// of input content and keys. Tasks hold a file lock of the entry:
+//   - exclusive while the entry is being filled, so the same input is never
+//     preprocessed twice at the same time.
+//   - shared while the entry is being used, so it is never evicted in use.
+// An entry is marked ready once filled. Files left in an entry which is not
+// ready, e.g. by a crashed task, are cleared when the entry is opened.
+class PreprocessCache {
+ public:
+  class Entry {
+   public:
+    ~Entry();
+
+    Entry(const Entry&) = delete;
+    Entry& operator=(const Entry&) = delete;
+
+    const std::filesystem::path& Dir() const { return dir_; }
+
+    // Files in the entry are filled by a former task.
+    bool IsReady() const { return ready_; }
+
+    // Marks the entry as filled, and lets other tasks use it.
+    void MarkReady();
+
+    // Returns the sub directory `name` of the entry. If it doesn't exist,
+    // `build` fills a temporary directory, which is renamed to `name` at last,
+    // so a sub directory could be added to a ready entry by tasks using it.
+    std::filesystem::path GetOrBuildDir(
+        const std::string& name,
+        const std::function<void(const std::filesystem::path&)>& build);
+
+   private:
+    friend class PreprocessCache;
+
+    Entry(std::filesystem::path dir, int lock_fd, bool ready);
+
+    std::filesystem::path dir_;
+    int lock_fd_;
+    bool ready_;
+  };
+
+  PreprocessCache(std::filesystem::path folder, uint64_t max_size_bytes = 0,
+                  uint64_t max_age_seconds = 0);
+
+  // Digest of content of `input_path`, `keys` and `tag`, which describes
+  // options of preprocessing that change files in the entry. The whole file is
+  // read once.
+  static std::string Fingerprint(const std::string& input_path,
+                                 const std::vector<std::string>& keys,
+                                 const std::string& tag = "");
+
+  // Opens the entry of `fingerprint`, which is created if not found.
+  std::shared_ptr<Entry> Open(const std::string& fingerprint);
+
+  // Removes entries not used for longer than `max_age_seconds`, then least
+  // recently used entries until total size is not greater than
+  // `max_size_bytes`. Entries in use are kept.
+  void Evict();
+
+  const std::filesystem::path& Folder() const { return folder_; }
+
+ private:
+  std::filesystem::path folder_;
+  uint64_t max_size_bytes_;
+  uint64_t max_age_seconds_;
+};
+
+}  // namespace psi
@@ -0,0 +1,135 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "psi/utils/preprocess_cache.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace psi {
+
+namespace {
+
+void WriteFile(const std::filesystem::path& path, const std::string& content) {
+  std::ofstream out(path, std::ios::binary);
+  out << content;
+}
+
+}  // namespace
+
+class PreprocessCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    tmp_dir_ = "./tmp_preprocess_cache_test";
+    std::filesystem::create_directory(tmp_dir_);
+    input_path_ = (tmp_dir_ / "input.csv").string();
+    WriteFile(input_path_, "id,v\n1,a\n2,b\n");
+  }
+  void TearDown() override {
+    std::error_code ec;
+    std::filesystem::remove_all(tmp_dir_, ec);
+  }
+
+  std::filesystem::path tmp_dir_;
+  std::string input_path_;
+};
+
+TEST_F(PreprocessCacheTest, Fingerprint) {
+  auto fingerprint = PreprocessCache::Fingerprint(input_path_, {"id"});
+  EXPECT_EQ(fingerprint.size(), 32);
+  EXPECT_EQ(fingerprint, PreprocessCache::Fingerprint(input_path_, {"id"}));
+  EXPECT_NE(fingerprint, PreprocessCache::Fingerprint(input_path_, {"v"}));
+  EXPECT_NE(fingerprint,
+            PreprocessCache::Fingerprint(input_path_, {"id", "v"}));
+  EXPECT_NE(fingerprint,
+            PreprocessCache::Fingerprint(input_path_, {"id"}, "sorted"));
+
+  WriteFile(input_path_, "id,v\n1,a\n2,c\n");
+  EXPECT_NE(fingerprint, PreprocessCache::Fingerprint(input_path_, {"id"}));
+}
+
+TEST_F(PreprocessCacheTest, OpenAndReuse) {
+  PreprocessCache cache(tmp_dir_ / "cache");
+  auto fingerprint = PreprocessCache::Fingerprint(input_path_, {"id"});
+
+  {
+    // Not marked ready, e.g. crashed.
+    auto entry = cache.Open(fingerprint);
+    EXPECT_FALSE(entry->IsReady());
+    WriteFile(entry->Dir() / "partial.csv", "id");
+  }
+  {
+    auto entry = cache.Open(fingerprint);
+    EXPECT_FALSE(entry->IsReady());
+    EXPECT_FALSE(std::filesystem::exists(entry->Dir() / "partial.csv"));
+    WriteFile(entry->Dir() / "sorted.csv", "id");
+    entry->MarkReady();
+    EXPECT_TRUE(entry->IsReady());
+  }
+
+  auto entry = cache.Open(fingerprint);
+  EXPECT_TRUE(entry->IsReady());
+  EXPECT_TRUE(std::filesystem::exists(entry->Dir() / "sorted.csv"));
+  // Shared by tasks at the same time.
+  auto other = cache.Open(fingerprint);
+  EXPECT_TRUE(other->IsReady());
+
+  size_t build_cnt = 0;
+  auto build = [&](const std::filesystem::path& dir) {
+    build_cnt++;
+    std::filesystem::create_directories(dir);
+    WriteFile(dir / "0", "bucket");
+  };
+  auto dir = entry->GetOrBuildDir("bucket_store_1", build);
+  EXPECT_EQ(other->GetOrBuildDir("bucket_store_1", build), dir);
+  EXPECT_EQ(build_cnt, 1);
+  EXPECT_TRUE(std::filesystem::exists(dir / "0"));
+}
+
+TEST_F(PreprocessCacheTest, Evict) {
+  PreprocessCache cache(tmp_dir_ / "cache", 250);
+
+  auto in_use = cache.Open("in_use");
+  WriteFile(in_use->Dir() / "data", std::string(100, 'x'));
+  in_use->MarkReady();
+  for (const auto* name : {"old", "new"}) {
+    auto entry = cache.Open(name);
+    WriteFile(entry->Dir() / "data", std::string(100, 'x'));
+    entry->MarkReady();
+  }
+  std::filesystem::last_write_time(
+      tmp_dir_ / "cache" / "old" / ".lock",
+      std::filesystem::file_time_type::clock::now() - std::chrono::hours(1));
+
+  // The least recently used one is evicted, and the one in use is kept.
+  cache.Evict();
+  EXPECT_TRUE(std::filesystem::exists(tmp_dir_ / "cache" / "in_use"));
+  EXPECT_FALSE(std::filesystem::exists(tmp_dir_ / "cache" / "old"));
+  EXPECT_TRUE(std::filesystem::exists(tmp_dir_ / "cache" / "new"));
+
+  in_use = nullptr;
+  std::filesystem::last_write_time(
+      tmp_dir_ / "cache" / "new" / ".lock",
+      std::filesystem::file_time_type::clock::now() - std::chrono::hours(1));
+  PreprocessCache aged_cache(tmp_dir_ / "cache", 0, 60);
+  aged_cache.Evict();
+  EXPECT_TRUE(std::filesystem::exists(tmp_dir_ / "cache" / "in_use"));
+  EXPECT_FALSE(std::filesystem::exists(tmp_dir_ / "cache" / "new"));
+}
+
+}  // namespace psi
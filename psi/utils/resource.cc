@@ -14,12 +14,20 @@
 
 #include "psi/utils/resource.h"
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
 #include <fstream>
+#include <limits>
+#include <sstream>
 #include <string>
+#include <thread>
 
 #include "absl/strings/ascii.h"
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_split.h"
+#include "spdlog/spdlog.h"
 
 namespace psi {
 
@@ -53,4 +61,110 @@ size_t ReadVMxFromProcSelfStatus(const std::string& key) {
 
 size_t GetPeakKbMemUsage() { return ReadVMxFromProcSelfStatus("VmHWM"); }
 
+namespace {
+
+// parse cpuset.cpus format(eg. "0-3,5")
+int ParseCpuset(const std::string& cpuset) {
+  int count = 0;
+  std::stringstream ss(cpuset);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    size_t dash = item.find('-');
+    if (dash != std::string::npos) {
+      int start = std::stoi(item.substr(0, dash));
+      int end = std::stoi(item.substr(dash + 1));
+      count += end - start + 1;
+    } else {
+      if (!item.empty()) {
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+}  // namespace
+
+int GetCpuCount() {
+  // 1. check cpuset
+  std::ifstream cpuset_file("/sys/fs/cgroup/cpuset/cpuset.cpus");
+  if (cpuset_file) {
+    std::string cpuset;
+    if (std::getline(cpuset_file, cpuset)) {
+      if (!cpuset.empty() && cpuset != "0") {
+        return ParseCpuset(cpuset);
+      }
+    }
+  }
+
+  // 2. check CPU quota and period
+  // 2.1 cgroup v1
+  std::ifstream quota_file("/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_quota_us");
+  std::ifstream period_file("/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_period_us");
+  if (quota_file && period_file) {
+    int64_t quota;
+    int64_t period;
+    quota_file >> quota;
+    period_file >> period;
+    if (quota > 0 && period > 0) {
+      return static_cast<int>((quota + period - 1) / period);
+    }
+  }
+
+  // 2.2 cgroup v2
+  std::ifstream v2_quota_file("/sys/fs/cgroup/cpu.max");
+  if (v2_quota_file) {
+    std::string line;
+    if (std::getline(v2_quota_file, line)) {
+      std::istringstream iss(line);
+      std::string quota_str;
+      std::string period_str;
+      if (iss >> quota_str >> period_str) {
+        if (quota_str != "max") {
+          try {
+            int64_t quota = std::stoll(quota_str);
+            int64_t period = std::stoll(period_str);
+            if (period > 0) {
+              return static_cast<int>((quota + period - 1) / period);
+            }
+          } catch (...) {
+            SPDLOG_WARN(
+                "trans quota({}) or period({}) failed, use default method",
+                quota_str, period_str);
+          }
+        }
+      }
+    }
+  }
+
+  // 3. use hardware_concurrency
+  return std::thread::hardware_concurrency();
+}
+
+uint64_t GetMemoryLimit() {
+  uint64_t limit = std::numeric_limits<uint64_t>::max();
+  auto pages = sysconf(_SC_PHYS_PAGES);
+  auto page_size = sysconf(_SC_PAGE_SIZE);
+  if (pages > 0 && page_size > 0) {
+    limit = static_cast<uint64_t>(pages) * static_cast<uint64_t>(page_size);
+  }
+
+  // cgroup v2 uses "max" for no limit, cgroup v1 uses a huge number instead.
+  for (const char* path : {"/sys/fs/cgroup/memory.max",
+                           "/sys/fs/cgroup/memory/memory.limit_in_bytes"}) {
+    std::ifstream limit_file(path);
+    std::string value;
+    if (limit_file && std::getline(limit_file, value)) {
+      uint64_t cgroup_limit = 0;
+      if (absl::SimpleAtoi(value, &cgroup_limit) && cgroup_limit > 0) {
+        limit = std::min(limit, cgroup_limit);
+      }
+    }
+  }
+
+  YACL_ENFORCE(limit != std::numeric_limits<uint64_t>::max(),
+               "can not detect memory limit, please set memory budget.");
+  return limit;
+}
+
 }  // namespace psi
@@ -15,6 +15,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 
 #include "yacl/base/exception.h"
 
@@ -26,4 +27,12 @@ namespace psi {
  */
 size_t GetPeakKbMemUsage();
 
+// Cpu count available to current process, cgroup cpuset and cpu quota are
+// respected.
+int GetCpuCount();
+
+// Memory limit in bytes of current process, the smaller one of physical
+// memory and cgroup memory limit.
+uint64_t GetMemoryLimit();
+
 }  // namespace psi
@@ -0,0 +1,269 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "psi/utils/result_writer.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <utility>
+
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+#include "yacl/base/exception.h"
+#include "yacl/utils/parallel.h"
+#include "yacl/utils/scope_guard.h"
+
+namespace psi {
+
+namespace {
+
+constexpr size_t kBlockSize = 4 << 20;
+
+constexpr size_t kScanSize = 64 << 10;
+
+int OpenForRead(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  YACL_ENFORCE(fd >= 0, "open file {} failed: {}", path, std::strerror(errno));
+  return fd;
+}
+
+void WriteAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    auto ret = write(fd, data, size);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    YACL_ENFORCE(ret > 0, "write failed: {}", std::strerror(errno));
+    data += ret;
+    size -= ret;
+  }
+}
+
+// Offset of the first `c` in [begin, end) of the file, if any.
+std::optional<uint64_t> FindByte(int fd, uint64_t begin, uint64_t end,
+                                 char c) {
+  std::vector<char> buf(kScanSize);
+  while (begin < end) {
+    size_t n = std::min<uint64_t>(buf.size(), end - begin);
+    auto ret = pread(fd, buf.data(), n, begin);
+    YACL_ENFORCE(ret > 0, "read failed: {}",
+                 ret == 0 ? "unexpected eof" : std::strerror(errno));
+    const auto* found =
+        static_cast<const char*>(std::memchr(buf.data(), c, ret));
+    if (found != nullptr) {
+      return begin + (found - buf.data());
+    }
+    begin += ret;
+  }
+  return std::nullopt;
+}
+
+void CopyRange(int in_fd, int out_fd, uint64_t begin, uint64_t end) {
+#ifdef __linux__
+  // Let the kernel move the data, falls back to read and write below if the
+  // file systems don't support it.
+  while (begin < end) {
+    off_t offset = begin;
+    auto ret = copy_file_range(in_fd, &offset, out_fd, nullptr, end - begin, 0);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      break;
+    }
+    begin += ret;
+  }
+#endif
+  std::vector<char> buf;
+  while (begin < end) {
+    buf.resize(std::min<uint64_t>(kBlockSize, end - begin));
+    auto ret = pread(in_fd, buf.data(), buf.size(), begin);
+    YACL_ENFORCE(ret > 0, "read failed: {}",
+                 ret == 0 ? "unexpected eof" : std::strerror(errno));
+    WriteAll(out_fd, buf.data(), ret);
+    begin += ret;
+  }
+}
+
+void WriteRepeated(int out_fd, const std::string& line, uint64_t repeat) {
+  if (repeat == 0 || line.empty()) {
+    return;
+  }
+  uint64_t block_lines =
+      std::min<uint64_t>(repeat, std::max<size_t>(1, kBlockSize / line.size()));
+  std::string block;
+  block.reserve(block_lines * line.size());
+  for (uint64_t i = 0; i < block_lines; ++i) {
+    block.append(line);
+  }
+  while (repeat >= block_lines) {
+    WriteAll(out_fd, block.data(), block.size());
+    repeat -= block_lines;
+  }
+  WriteAll(out_fd, block.data(), repeat * line.size());
+}
+
+}  // namespace
+
+ResultWriter::ResultWriter(std::string header) : header_(std::move(header)) {
+  header_.push_back('\n');
+}
+
+void ResultWriter::AppendCsvBody(const std::string& path) {
+  int fd = OpenForRead(path);
+  ON_SCOPE_EXIT([&] { close(fd); });
+  uint64_t size = std::filesystem::file_size(path);
+
+  auto header_end = FindByte(fd, 0, size, '\n');
+  if (!header_end.has_value() || *header_end + 1 == size) {
+    return;
+  }
+
+  // The last line of a file may have no line break.
+  char last = 0;
+  YACL_ENFORCE(pread(fd, &last, 1, size - 1) == 1, "read file {} failed: {}",
+               path, std::strerror(errno));
+
+  Piece piece;
+  piece.path = path;
+  piece.begin = *header_end + 1;
+  piece.end = size;
+  piece.add_line_break = last != '\n';
+  pieces_.push_back(std::move(piece));
+}
+
+void ResultWriter::AppendRepeatedLine(const std::string& line, uint64_t cnt) {
+  if (cnt == 0) {
+    return;
+  }
+  Piece piece;
+  piece.line = line + '\n';
+  piece.repeat = cnt;
+  pieces_.push_back(std::move(piece));
+}
+
+void ResultWriter::WriteFile(const std::string& path,
+                             const std::vector<Piece>& pieces) const {
+  auto parent = std::filesystem::path(path).parent_path();
+  if (!parent.empty() && !std::filesystem::exists(parent)) {
+    std::filesystem::create_directories(parent);
+  }
+  int out_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  YACL_ENFORCE(out_fd >= 0, "open file {} failed: {}", path,
+               std::strerror(errno));
+  ON_SCOPE_EXIT([&] { close(out_fd); });
+
+  WriteAll(out_fd, header_.data(), header_.size());
+  for (const auto& piece : pieces) {
+    if (piece.path.empty()) {
+      WriteRepeated(out_fd, piece.line, piece.repeat);
+    } else {
+      int in_fd = OpenForRead(piece.path);
+      ON_SCOPE_EXIT([&] { close(in_fd); });
+      CopyRange(in_fd, out_fd, piece.begin, piece.end);
+      if (piece.add_line_break) {
+        WriteAll(out_fd, "\n", 1);
+      }
+    }
+  }
+}
+
+void ResultWriter::Write(const std::string& path) const {
+  WriteFile(path, pieces_);
+}
+
+std::vector<std::vector<ResultWriter::Piece>> ResultWriter::Split(
+    size_t shard_num) const {
+  uint64_t total = 0;
+  for (const auto& piece : pieces_) {
+    total += piece.size();
+  }
+  uint64_t target = std::max<uint64_t>(1, (total + shard_num - 1) / shard_num);
+
+  std::vector<std::vector<Piece>> shards(shard_num);
+  size_t shard = 0;
+  uint64_t shard_size = 0;
+  for (auto piece : pieces_) {
+    while (piece.size() > 0) {
+      uint64_t remain = target - std::min(target, shard_size);
+      if (shard + 1 == shard_num || piece.size() <= remain) {
+        shard_size += piece.size();
+        shards[shard].push_back(std::move(piece));
+        break;
+      }
+
+      // Cut the piece at a line boundary after `remain` bytes.
+      Piece head = piece;
+      if (piece.path.empty()) {
+        uint64_t lines = std::max<uint64_t>(
+            1, (remain + piece.line.size() - 1) / piece.line.size());
+        head.repeat = std::min(lines, piece.repeat);
+        piece.repeat -= head.repeat;
+      } else {
+        int fd = OpenForRead(piece.path);
+        ON_SCOPE_EXIT([&] { close(fd); });
+        auto newline =
+            FindByte(fd, piece.begin + std::max<uint64_t>(remain, 1) - 1,
+                     piece.end, '\n');
+        if (!newline.has_value() || *newline + 1 == piece.end) {
+          // No line boundary inside, keep the piece as a whole.
+          shard_size += piece.size();
+          shards[shard].push_back(std::move(piece));
+          break;
+        }
+        head.end = *newline + 1;
+        head.add_line_break = false;
+        piece.begin = head.end;
+      }
+      shards[shard].push_back(std::move(head));
+      shard++;
+      shard_size = 0;
+    }
+    if (shard + 1 < shard_num && shard_size >= target) {
+      shard++;
+      shard_size = 0;
+    }
+  }
+  return shards;
+}
+
+std::vector<std::string> ResultWriter::WriteSharded(const std::string& dir,
+                                                    size_t shard_num) const {
+  YACL_ENFORCE(shard_num > 0);
+  std::filesystem::create_directories(dir);
+
+  auto shards = Split(shard_num);
+  std::vector<std::string> paths(shard_num);
+  for (size_t i = 0; i < shard_num; ++i) {
+    paths[i] =
+        (std::filesystem::path(dir) / fmt::format("part-{:05d}.csv", i))
+            .string();
+  }
+  yacl::parallel_for(0, shard_num, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) {
+      WriteFile(paths[i], shards[i]);
+    }
+  });
+  SPDLOG_INFO("write {} shards to {}", shard_num, dir);
+  return paths;
+}
+
+}  // namespace psi
@@ -0,0 +1,74 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace psi {
+
+// Composes a csv file from a header line, bodies of other csv files and
+// repeated lines, e.g. NULL rows of joins. Data is moved in large blocks
+// instead of line by line.
+class ResultWriter {
+ public:
+  // A line break is added to `header`.
+  explicit ResultWriter(std::string header);
+
+  // Append all lines except the header line of csv file at `path`.
+  void AppendCsvBody(const std::string& path);
+
+  // Append `cnt` copies of `line`, a line break is added to each copy.
+  void AppendRepeatedLine(const std::string& line, uint64_t cnt);
+
+  void Write(const std::string& path) const;
+
+  // Split lines into `shard_num` files in `dir`, which are written in
+  // parallel. Each file has the header line, and the concatenation of their
+  // bodies is the same as the body written by Write.
+  // Returns paths of shards in order.
+  std::vector<std::string> WriteSharded(const std::string& dir,
+                                        size_t shard_num) const;
+
+ private:
+  // A byte range of a file, or `repeat` copies of `line`.
+  struct Piece {
+    std::string path;
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    // The range is the end of a file without a final line break.
+    bool add_line_break = false;
+
+    std::string line;
+    uint64_t repeat = 0;
+
+    uint64_t size() const {
+      return path.empty() ? line.size() * repeat
+                          : end - begin + (add_line_break ? 1 : 0);
+    }
+  };
+
+  std::vector<std::vector<Piece>> Split(size_t shard_num) const;
+
+  void WriteFile(const std::string& path,
+                 const std::vector<Piece>& pieces) const;
+
+  std::string header_;
+  std::vector<Piece> pieces_;
+};
+
+}  // namespace psi
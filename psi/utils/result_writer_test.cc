@@ -0,0 +1,118 @@
+// Copyright 2024 Ant Group Co., Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "psi/utils/result_writer.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "fmt/format.h"
+#include "gtest/gtest.h"
+
+namespace psi {
+
+namespace {
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), {});
+}
+
+void WriteFile(const std::string& path, const std::string& content) {
+  std::ofstream out(path, std::ios::binary);
+  out << content;
+}
+
+}  // namespace
+
+class ResultWriterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    tmp_dir_ = "./tmp_result_writer_test";
+    std::filesystem::create_directory(tmp_dir_);
+  }
+  void TearDown() override {
+    std::error_code ec;
+    std::filesystem::remove_all(tmp_dir_, ec);
+  }
+
+  std::string tmp_dir_;
+};
+
+TEST_F(ResultWriterTest, Write) {
+  WriteFile(tmp_dir_ + "/a.csv", "id,v\n1,a\n2,b\n");
+  // Header only, and no line break at the end of file.
+  WriteFile(tmp_dir_ + "/b.csv", "id,v\n");
+  WriteFile(tmp_dir_ + "/c.csv", "id,v\n3,c");
+
+  ResultWriter writer("\"id\",\"v\"");
+  writer.AppendCsvBody(tmp_dir_ + "/a.csv");
+  writer.AppendRepeatedLine("NULL,NULL", 2);
+  writer.AppendCsvBody(tmp_dir_ + "/b.csv");
+  writer.AppendCsvBody(tmp_dir_ + "/c.csv");
+  writer.AppendRepeatedLine("NULL,NULL", 0);
+  writer.Write(tmp_dir_ + "/out.csv");
+
+  EXPECT_EQ(ReadFile(tmp_dir_ + "/out.csv"),
+            "\"id\",\"v\"\n1,a\n2,b\nNULL,NULL\nNULL,NULL\n3,c\n");
+}
+
+TEST_F(ResultWriterTest, WriteToMissingDirectory) {
+  WriteFile(tmp_dir_ + "/a.csv", "id\n1\n");
+
+  ResultWriter writer("id");
+  writer.AppendCsvBody(tmp_dir_ + "/a.csv");
+  writer.Write(tmp_dir_ + "/sub/dir/out.csv");
+
+  EXPECT_EQ(ReadFile(tmp_dir_ + "/sub/dir/out.csv"), "id\n1\n");
+}
+
+TEST_F(ResultWriterTest, WriteSharded) {
+  std::string body;
+  for (size_t i = 0; i < 1000; ++i) {
+    body += fmt::format("{},{}\n", i, std::string(i % 17, 'x'));
+  }
+  WriteFile(tmp_dir_ + "/a.csv", "id,v\n" + body);
+
+  ResultWriter writer("id,v");
+  writer.AppendCsvBody(tmp_dir_ + "/a.csv");
+  writer.AppendRepeatedLine("NULL,NULL", 500);
+  writer.AppendCsvBody(tmp_dir_ + "/a.csv");
+  std::string expected = body;
+  for (size_t i = 0; i < 500; ++i) {
+    expected += "NULL,NULL\n";
+  }
+  expected += body;
+
+  for (size_t shard_num : {1, 3, 7, 5000}) {
+    auto dir = tmp_dir_ + fmt::format("/out_{}", shard_num);
+    auto paths = writer.WriteSharded(dir, shard_num);
+    ASSERT_EQ(paths.size(), shard_num);
+
+    std::string merged;
+    for (const auto& path : paths) {
+      auto content = ReadFile(path);
+      ASSERT_EQ(content.substr(0, 5), "id,v\n");
+      // Shards are split at line boundaries.
+      ASSERT_TRUE(content.size() == 5 || content.back() == '\n');
+      merged += content.substr(5);
+    }
+    EXPECT_EQ(merged, expected);
+  }
+}
+
+}  // namespace psi
@@ -17,15 +17,18 @@
 #include <spdlog/spdlog.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <future>
 #include <ios>
 #include <memory>
 #include <numeric>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <tuple>
@@ -44,6 +47,7 @@
 #include "psi/utils/io.h"
 #include "psi/utils/key.h"
 #include "psi/utils/pb_helper.h"
+#include "psi/utils/random_str.h"
 
 #include "psi/utils/table_utils.pb.h"
 
@@ -297,6 +301,7 @@ std::shared_ptr<KeyInfo> KeyInfo::Make(
   }
 
   std::ofstream out(path);
+  KeyInfoIndexWriter index_writer(IndexPath(path), sorted_table->Path());
   yacl::crypto::Sha256Hash hash;
   uint32_t duplicate_key_cnt = 0;
   uint32_t unique_key_cnt = 0;
@@ -306,6 +311,7 @@ std::shared_ptr<KeyInfo> KeyInfo::Make(
   auto write_to_csv = [&](std::vector<std::string> keys,
                           std::vector<uint32_t> start_index,
                           std::vector<uint32_t> dup_cnts) {
+    index_writer.Append(keys, start_index, dup_cnts);
     for (size_t i = 0; i < keys.size(); ++i) {
       hash.Update(keys[i]);
       out << '"' << keys[i] << '"' << ',' << start_index[i] << ','
@@ -360,6 +366,7 @@ std::shared_ptr<KeyInfo> KeyInfo::Make(
 
   write_to_csv({cur_key}, {cur_key_start_index}, {cur_key_dup_cnt});
   out.close();
+  index_writer.Finish();
 
   proto::KeyInfoMeta meta;
   auto keys_hash = hash.CumulativeHash();
@@ -397,15 +404,22 @@ std::shared_ptr<KeyInfo> KeyInfo::Make(
   yacl::crypto::Sha256Hash hash;
   uint32_t lines = 0;
   auto provider = unique_key_table->GetProvider(unique_key_table->Keys());
+  KeyInfoIndexWriter index_writer(IndexPath(unique_key_table->Path()),
+                                  unique_key_table->Path());
 
   auto batch = provider->ReadNextBatch();
   while (!batch.empty()) {
+    std::vector<uint32_t> start_indexes(batch.size());
+    std::iota(start_indexes.begin(), start_indexes.end(), lines);
+    index_writer.Append(batch, start_indexes,
+                        std::vector<uint32_t>(batch.size(), 0));
     lines += batch.size();
     for (auto& item : batch) {
       hash.Update(item);
     }
     batch = provider->ReadNextBatch();
   }
+  index_writer.Finish();
 
   proto::KeyInfoMeta meta;
   auto keys_hash = hash.CumulativeHash();
@@ -428,6 +442,35 @@ KeyInfo::KeyInfo(std::string path, std::string format,
       table_(std::move(sorted_table)),
       meta_(std::move(meta)) {}
 
+const KeyInfoIndex& KeyInfo::Index() const {
+  std::call_once(index_once_, [this] { LoadOrBuildIndex(); });
+  return *index_;
+}
+
+void KeyInfo::LoadOrBuildIndex() const {
+  auto source_file_size = std::filesystem::file_size(table_->Path());
+  index_ = KeyInfoIndex::Open(IndexPath(), source_file_size);
+  if (index_) {
+    SPDLOG_INFO("key info index {} exists already.", IndexPath());
+    return;
+  }
+
+  KeyInfoIndexWriter writer(IndexPath(), table_->Path());
+  auto provider = GetBatchProvider();
+  while (true) {
+    auto batch = provider->ReadBatchWithInfo();
+    if (batch.keys.empty()) {
+      break;
+    }
+    writer.Append(batch.keys, batch.start_indexes, batch.dup_cnts);
+  }
+  writer.Finish();
+
+  index_ = KeyInfoIndex::Open(IndexPath(), source_file_size);
+  YACL_ENFORCE(index_, "open key info index {} failed", IndexPath());
+  YACL_ENFORCE_EQ(index_->size(), static_cast<uint64_t>(KeyCnt()));
+}
+
 std::shared_ptr<IBasicBatchProvider> KeyInfo::GetKeysProviderWithDupCnt(
     size_t batch_size) const {
   return GetBatchProvider(batch_size);
@@ -445,6 +488,158 @@ std::shared_ptr<KeysInfoProvider> KeyInfo::GetBatchProvider(
   }
 }
 
+namespace {
+
+uint64_t DigestFileSize(const KeyDigestProvider::DigestFileHeader& header) {
+  return sizeof(header) + header.item_cnt * sizeof(uint128_t) +
+         header.dup_entry_cnt * sizeof(KeyDigestProvider::DupEntry);
+}
+
+std::optional<KeyDigestProvider::DigestFileHeader> ReadDigestFileHeader(
+    const std::string& path) {
+  KeyDigestProvider::DigestFileHeader header{};
+  std::ifstream in(path, std::ios::binary);
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (in.gcount() != sizeof(header) ||
+      std::memcmp(header.magic, KeyDigestProvider::kMagic,
+                  sizeof(KeyDigestProvider::kMagic)) != 0 ||
+      header.version != KeyDigestProvider::kVersion ||
+      std::filesystem::file_size(path) != DigestFileSize(header)) {
+    return std::nullopt;
+  }
+  return header;
+}
+
+void FillDigestFileSource(const proto::KeyInfoMeta& meta,
+                          KeyDigestProvider::DigestFileHeader* header) {
+  YACL_ENFORCE(meta.keys_hash().size() == sizeof(header->keys_hash),
+               "unexpected keys hash size={}", meta.keys_hash().size());
+  header->source_file_size = meta.source_file_size();
+  std::memcpy(header->keys_hash, meta.keys_hash().data(),
+              sizeof(header->keys_hash));
+}
+
+}  // namespace
+
+void KeyInfo::MakeDigestFile(const std::string& digest_path) const {
+  KeyDigestProvider::DigestFileHeader header{};
+  std::memcpy(header.magic, KeyDigestProvider::kMagic,
+              sizeof(KeyDigestProvider::kMagic));
+  header.version = KeyDigestProvider::kVersion;
+  FillDigestFileSource(meta_, &header);
+
+  if (std::filesystem::exists(digest_path)) {
+    auto exist_header = ReadDigestFileHeader(digest_path);
+    if (exist_header.has_value() && exist_header->item_cnt == KeyCnt() &&
+        exist_header->source_file_size == header.source_file_size &&
+        std::memcmp(exist_header->keys_hash, header.keys_hash,
+                    sizeof(header.keys_hash)) == 0) {
+      SPDLOG_INFO("key digest file {} exists already.", digest_path);
+      return;
+    }
+    SPDLOG_WARN("key digest file {} is broken or stale, rebuild.",
+                digest_path);
+  }
+
+  const auto& index = Index();
+
+  // Write to a temporary file first, so that an interrupted run never leaves
+  // a file which looks complete. The name is unique since tasks may share the
+  // digest file in preprocessing cache.
+  std::string tmp_path = digest_path + ".tmp." + GetRandomString();
+  std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+  YACL_ENFORCE(out.is_open(), "open file {} failed", tmp_path);
+
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  std::vector<KeyDigestProvider::DupEntry> dup_entries;
+  std::vector<uint128_t> digests;
+  for (uint64_t begin = 0; begin < index.size(); begin += kBatchSize) {
+    uint64_t end = std::min<uint64_t>(begin + kBatchSize, index.size());
+    digests.resize(end - begin);
+    for (uint64_t i = begin; i < end; ++i) {
+      const auto& entry = index[i];
+      digests[i - begin] = entry.digest;
+      if (entry.dup_cnt != 0) {
+        dup_entries.push_back(KeyDigestProvider::DupEntry{
+            static_cast<uint32_t>(i), entry.dup_cnt});
+      }
+    }
+    out.write(reinterpret_cast<const char*>(digests.data()),
+              digests.size() * sizeof(uint128_t));
+  }
+  header.item_cnt = index.size();
+  out.write(reinterpret_cast<const char*>(dup_entries.data()),
+            dup_entries.size() * sizeof(KeyDigestProvider::DupEntry));
+
+  header.dup_entry_cnt = dup_entries.size();
+  out.seekp(0);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.close();
+  YACL_ENFORCE(!out.fail(), "write file {} failed", tmp_path);
+
+  std::filesystem::rename(tmp_path, digest_path);
+  SPDLOG_INFO("write {} key digests to {}, dup_entry_cnt={}", header.item_cnt,
+              digest_path, header.dup_entry_cnt);
+}
+
+std::shared_ptr<KeyDigestProvider> KeyInfo::GetDigestProvider(
+    const std::string& digest_path, size_t batch_size) const {
+  MakeDigestFile(digest_path);
+  return std::make_shared<KeyDigestProvider>(digest_path, batch_size);
+}
+
+KeyDigestProvider::KeyDigestProvider(std::string path, size_t batch_size)
+    : path_(std::move(path)), batch_size_(batch_size) {
+  YACL_ENFORCE(batch_size_ > 0);
+  auto header = ReadDigestFileHeader(path_);
+  YACL_ENFORCE(header.has_value(), "bad key digest file {}", path_);
+  header_ = *header;
+
+  digest_in_.open(path_, std::ios::binary);
+  digest_in_.seekg(sizeof(DigestFileHeader));
+  dup_in_.open(path_, std::ios::binary);
+  dup_in_.seekg(sizeof(DigestFileHeader) +
+                header_.item_cnt * sizeof(uint128_t));
+  YACL_ENFORCE(digest_in_.good() && dup_in_.good(), "open file {} failed",
+               path_);
+}
+
+absl::Span<const uint128_t> KeyDigestProvider::ReadNextDigestBatch(
+    std::unordered_map<uint32_t, uint32_t>* dup_cnts) {
+  dup_cnts->clear();
+  size_t cnt = std::min<uint64_t>(batch_size_, header_.item_cnt - read_cnt_);
+  if (cnt == 0) {
+    return {};
+  }
+
+  buffer_.resize(cnt);
+  digest_in_.read(reinterpret_cast<char*>(buffer_.data()),
+                  cnt * sizeof(uint128_t));
+  YACL_ENFORCE(digest_in_.good(), "read file {} failed", path_);
+
+  while (true) {
+    if (!next_dup_.has_value()) {
+      if (dup_read_cnt_ == header_.dup_entry_cnt) {
+        break;
+      }
+      DupEntry entry;
+      dup_in_.read(reinterpret_cast<char*>(&entry), sizeof(entry));
+      YACL_ENFORCE(dup_in_.good(), "read file {} failed", path_);
+      dup_read_cnt_++;
+      next_dup_ = entry;
+    }
+    if (next_dup_->index >= read_cnt_ + cnt) {
+      break;
+    }
+    (*dup_cnts)[next_dup_->index - read_cnt_] = next_dup_->dup_cnt;
+    next_dup_.reset();
+  }
+
+  read_cnt_ += cnt;
+  return absl::MakeConstSpan(buffer_);
+}
+
 std::shared_ptr<arrow::csv::StreamingReader> KeyInfo::GetStreamReader() const {
   return MakeCsvReader(path_, GetSchema());
 }
@@ -481,6 +676,30 @@ void ResultDumper::Dump(const std::string& line, int64_t duplicate_cnt,
   }
 }
 
+void ResultDumper::CopyToExcept(std::istream& in, uint64_t size,
+                                int64_t line_cnt) {
+  except_cnt_ += line_cnt;
+  if (!except_file_ || size == 0) {
+    return;
+  }
+
+  std::vector<char> buf(std::min<uint64_t>(size, 1 << 20));
+  char last = '\n';
+  while (size > 0) {
+    size_t n = std::min<uint64_t>(size, buf.size());
+    in.read(buf.data(), n);
+    YACL_ENFORCE(static_cast<size_t>(in.gcount()) == n,
+                 "unexpected end of input");
+    except_file_->write(buf.data(), n);
+    last = buf[n - 1];
+    size -= n;
+  }
+  // The last line of a file may have no line break.
+  if (last != '\n') {
+    *except_file_ << '\n';
+  }
+}
+
 void ResultDumper::Flush() {
   if (intersect_file_) {
     intersect_file_->flush();
@@ -500,101 +719,59 @@ KeyInfo::StatInfo KeyInfo::ApplyPeerDupCnt(IndexReader& reader,
   uint32_t peer_intersection_count = 0;
   uint32_t inter_unique_cnt = 0;
   std::string line;
-  std::ifstream sorted_file(table_->Path());
+  std::ifstream sorted_file(table_->Path(), std::ios::binary);
   std::getline(sorted_file, line);
   // dump schema line
   dumper.ToIntersect(line);
   dumper.ToExcept(line);
 
-  InterIndexProcessor processor(reader, GetBatchProvider());
-
-  uint32_t sorted_file_index = 0;
-  auto inter_index_info = processor.GetBatchInfo();
-  SPDLOG_INFO("inter_info: {}", inter_index_info.size());
-  while (!inter_index_info.empty()) {
-    inter_unique_cnt += inter_index_info.size();
-    for (auto& info : inter_index_info) {
-      while (sorted_file_index < info.start_index) {
-        std::getline(sorted_file, line);
-        dumper.ToExcept(line);
-        sorted_file_index++;
-      }
-      for (uint32_t i = 0; i <= info.self_dup_cnt; ++i) {
-        std::getline(sorted_file, line);
-        dumper.ToIntersect(line, info.peer_dup_cnt);
-      }
-      sorted_file_index += info.self_dup_cnt + 1;
-      self_intersection_count += info.self_dup_cnt + 1;
-      peer_intersection_count += info.peer_dup_cnt + 1;
+  // Rows of intersected keys are reached by seeking with the key info index,
+  // rows in between are copied as a whole if except part is required.
+  uint64_t file_size = std::filesystem::file_size(table_->Path());
+  uint64_t offset = sorted_file.tellg();
+  uint32_t row = 0;
+  auto skip_to = [&](uint64_t target_offset, uint32_t target_row) {
+    dumper.CopyToExcept(sorted_file, target_offset - offset,
+                        target_row - row);
+    if (!dumper.HasExcept() && target_offset != offset) {
+      sorted_file.seekg(target_offset);
     }
+    offset = target_offset;
+    row = target_row;
+  };
 
-    inter_index_info = processor.GetBatchInfo();
-  }
-
-  while (std::getline(sorted_file, line)) {
-    dumper.ToExcept(line);
-    sorted_file_index++;
-  }
-
-  return StatInfo{
-      self_intersection_count, peer_intersection_count, sorted_file_index,
-      static_cast<uint32_t>(dumper.intersect_cnt() - 1), inter_unique_cnt};
-}
-
-InterIndexProcessor::InterIndexProcessor(
-    IndexReader& reader, std::shared_ptr<KeysInfoProvider> self_info_provider)
-    : reader_(reader), self_info_provider_(self_info_provider) {
-  index_with_peer_cnt_ = reader_.GetNextWithPeerCnt();
-}
-
-std::vector<InterIndexProcessor::InterInfo>
-InterIndexProcessor::GetBatchInfo() {
-  if (finish_) {
-    return {};
-  }
+  const auto& index = Index();
+  std::optional<uint64_t> last_key_index;
+  for (auto next = reader.GetNextWithPeerCnt(); next.has_value();
+       next = reader.GetNextWithPeerCnt()) {
+    auto [key_index, peer_dup_cnt] = *next;
+    YACL_ENFORCE(key_index < index.size(),
+                 "key index {} out of range, key count: {}", key_index,
+                 index.size());
+    YACL_ENFORCE(!last_key_index.has_value() || key_index > *last_key_index,
+                 "duplicated or unsorted key index in result: {}", key_index);
+    last_key_index = key_index;
+
+    const auto& entry = index[key_index];
+    skip_to(entry.offset, entry.start_index);
+    for (uint32_t i = 0; i <= entry.dup_cnt; ++i) {
+      std::getline(sorted_file, line);
+      dumper.ToIntersect(line, peer_dup_cnt);
+    }
+    offset =
+        key_index + 1 < index.size() ? index[key_index + 1].offset : file_size;
+    row = entry.start_index + entry.dup_cnt + 1;
 
-  if (!index_with_peer_cnt_.has_value()) {
-    finish_ = true;
-    return {};
+    inter_unique_cnt++;
+    self_intersection_count += entry.dup_cnt + 1;
+    peer_intersection_count += peer_dup_cnt + 1;
   }
+  skip_to(file_size, OriginCnt());
 
-  std::vector<InterIndexProcessor::InterInfo> inter;
-  while (inter.empty()) {
-    auto [_, start_index, self_dup_cnt] =
-        self_info_provider_->ReadBatchWithInfo();
-    if (start_index.empty()) {
-      YACL_ENFORCE(!index_with_peer_cnt_.has_value(),
-                   "reach end of key_info, but index_with_peer_cnt_ is not "
-                   "empty: {}, {}",
-                   index_with_peer_cnt_->first, index_with_peer_cnt_->second);
-      SPDLOG_INFO("reach end of key_info provider");
-      break;
-    }
-    YACL_ENFORCE(start_index.size() == self_dup_cnt.size(),
-                 "start_index size:{} should be equal to self_dup_cnt size:{}",
-                 start_index.size(), self_dup_cnt.size());
-    for (size_t i = 0; i != start_index.size(); ++i, ++self_info_index_) {
-      if (!index_with_peer_cnt_.has_value()) {
-        SPDLOG_DEBUG("break: i {} self_info_index_ {}", i, self_info_index_);
-        finish_ = true;
-        break;
-      }
-      SPDLOG_DEBUG("i {} self_info_index_ {} key_index {} ", i,
-                   self_info_index_, index_with_peer_cnt_->first);
-      if (self_info_index_ == index_with_peer_cnt_->first) {
-        inter.emplace_back(start_index[i], self_dup_cnt[i],
-                           index_with_peer_cnt_->second);
-        SPDLOG_DEBUG("start_index {} self_dup_cnt {} peer_dup_cnt {} ",
-                     start_index[i], self_dup_cnt[i],
-                     index_with_peer_cnt_->second);
-        index_with_peer_cnt_ = reader_.GetNextWithPeerCnt();
-      } else if (self_info_index_ > index_with_peer_cnt_->first) {
-        YACL_THROW_WITH_STACK("duplicated read_cnt in result: {}",
-                              index_with_peer_cnt_->first);
-      }
-    }
-  }
-  return inter;
+  return StatInfo{self_intersection_count, peer_intersection_count,
+                  OriginCnt(),
+                  static_cast<uint32_t>(dumper.intersect_cnt() - 1),
+                  inter_unique_cnt};
 }
 
 }  // namespace psi
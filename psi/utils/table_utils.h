@@ -17,8 +17,10 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <fstream>
 #include <future>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -31,6 +33,7 @@
 
 #include "psi/utils/batch_provider.h"
 #include "psi/utils/index_store.h"
+#include "psi/utils/key_info_index.h"
 
 #include "psi/utils/table_utils.pb.h"
 
@@ -126,6 +129,13 @@ struct ResultDumper {
   void ToIntersect(const std::string& line, int64_t duplicate_cnt = 0);
   void ToExcept(const std::string& line, int64_t duplicate_cnt = 0);
 
+  // Copy `size` bytes holding `line_cnt` lines from the current position of
+  // `in` to except part. `in` is left untouched if except part is not
+  // required.
+  void CopyToExcept(std::istream& in, uint64_t size, int64_t line_cnt);
+
+  bool HasExcept() const { return except_file_ != nullptr; }
+
   int64_t except_cnt() const { return except_cnt_; }
   int64_t intersect_cnt() const { return intersect_cnt_; }
 
@@ -221,6 +231,56 @@ class SortedTableKeysInfoProvider : public KeysInfoProvider {
   std::shared_ptr<arrow::Int64Array> dup_cnt_col_;
 };
 
+// Reads the key digest file written by KeyInfo::MakeDigestFile.
+//
+// Layout:
+//   DigestFileHeader | uint128_t digest[item_cnt] | DupEntry[dup_entry_cnt]
+// Digests are in the same order as the keys of KeyInfo, DupEntry are the
+// items with non-zero dup_cnt, ascending by index. `source_file_size` and
+// `keys_hash` are copied from the KeyInfo meta, so that a file of other
+// inputs is never reused.
+class KeyDigestProvider : public IDigestBatchProvider {
+ public:
+  static constexpr char kMagic[8] = {'P', 'S', 'I', 'K', 'D', 'G', 'S', 'T'};
+  static constexpr uint32_t kVersion = 2;
+
+  struct DigestFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t item_cnt;
+    uint64_t dup_entry_cnt;
+    uint64_t source_file_size;
+    uint8_t keys_hash[32];
+  };
+
+  struct DupEntry {
+    uint32_t index;
+    uint32_t dup_cnt;
+  };
+
+  KeyDigestProvider(std::string path, size_t batch_size);
+
+  size_t batch_size() const override { return batch_size_; }
+
+  absl::Span<const uint128_t> ReadNextDigestBatch(
+      std::unordered_map<uint32_t, uint32_t>* dup_cnts) override;
+
+  uint64_t ItemCnt() const { return header_.item_cnt; }
+
+ private:
+  std::string path_;
+  size_t batch_size_;
+  DigestFileHeader header_{};
+
+  std::ifstream digest_in_;
+  std::ifstream dup_in_;
+  uint64_t read_cnt_ = 0;
+  uint64_t dup_read_cnt_ = 0;
+  std::optional<DupEntry> next_dup_;
+  std::vector<uint128_t> buffer_;
+};
+
 class KeyInfo : public Table {
  public:
   struct StatInfo {
@@ -271,6 +331,14 @@ class KeyInfo : public Table {
   std::shared_ptr<KeysInfoProvider> GetBatchProvider(
       size_t batch_size = kBatchSize) const;
 
+  // Writes the 128-bit digests of the joined keys, taken from the key info
+  // index, to `digest_path`. The file is reused if it is already complete.
+  void MakeDigestFile(const std::string& digest_path) const;
+
+  // Same items and dup_cnts as GetKeysProviderWithDupCnt, but as digests.
+  std::shared_ptr<KeyDigestProvider> GetDigestProvider(
+      const std::string& digest_path, size_t batch_size = kBatchSize) const;
+
   std::vector<uint8_t> KeysHash() const {
     return std::vector<uint8_t>(meta_.keys_hash().begin(),
                                 meta_.keys_hash().end());
@@ -290,39 +358,30 @@ class KeyInfo : public Table {
 
   std::vector<std::string> SourceFileColumns() const;
 
+  // Binary companion index, see KeyInfoIndex. Written along with the key
+  // info by Make.
+  std::string IndexPath() const { return IndexPath(path_); }
+
+  static std::string IndexPath(const std::string& key_info_path) {
+    return key_info_path + ".idx";
+  }
+
  protected:
   explicit KeyInfo(std::string path, std::string format,
                    std::shared_ptr<TableWithKeys> table_with_keys,
                    proto::KeyInfoMeta opts);
-  std::shared_ptr<TableWithKeys> table_;
-  proto::KeyInfoMeta meta_;
-};
-
-class InterIndexProcessor {
- public:
-  struct InterInfo {
-    InterInfo() = default;
-    InterInfo(uint32_t index, uint32_t self_cnt, uint32_t cnt)
-        : start_index(index), self_dup_cnt(self_cnt), peer_dup_cnt(cnt) {}
-
-    uint32_t start_index;
-    uint32_t self_dup_cnt;
-    uint32_t peer_dup_cnt;
-  };
 
-  InterIndexProcessor(IndexReader& reader,
-                      std::shared_ptr<KeysInfoProvider> self_info_provider);
+  // The index is mapped on first use, since only result generation and key
+  // digests need it. It is built then if the key info was made by a former
+  // version, which wrote no index.
+  const KeyInfoIndex& Index() const;
 
-  std::vector<InterInfo> GetBatchInfo();
+  void LoadOrBuildIndex() const;
 
-  bool IsFinish() const { return finish_; }
-
- private:
-  IndexReader& reader_;
-  std::shared_ptr<KeysInfoProvider> self_info_provider_;
-  std::optional<std::pair<uint64_t, uint64_t>> index_with_peer_cnt_;
-  uint32_t self_info_index_ = 0;
-  bool finish_ = false;
+  std::shared_ptr<TableWithKeys> table_;
+  proto::KeyInfoMeta meta_;
+  mutable std::once_flag index_once_;
+  mutable std::shared_ptr<KeyInfoIndex> index_;
 };
 
 }  // namespace psi
@@ -19,11 +19,26 @@
 #include <fstream>
 
 #include "gtest/gtest.h"
+#include "yacl/crypto/hash/hash_utils.h"
 
 #include "psi/utils/index_store.h"
 
 namespace psi {
 
+namespace {
+
+size_t CountLines(const std::filesystem::path& path) {
+  std::ifstream in(path);
+  size_t cnt = 0;
+  std::string line;
+  while (std::getline(in, line)) {
+    cnt++;
+  }
+  return cnt;
+}
+
+}  // namespace
+
 class TableUtilTest : public ::testing::Test {
  protected:
   void SetUp() override {
@@ -82,6 +97,8 @@ TEST_F(TableUtilTest, TableToCsv) {
 
   auto key_info = KeyInfo::Make(sort_table, key_info_path_.string());
   EXPECT_EQ(key_info->DupKeyCnt(), 2);
+  // The index is written along with the key info.
+  EXPECT_TRUE(std::filesystem::exists(key_info->IndexPath()));
 
   auto provider = key_info->GetKeysProviderWithDupCnt();
   auto batch = provider->ReadNextBatchWithDupCnt();
@@ -100,6 +117,10 @@ TEST_F(TableUtilTest, TableToCsv) {
   EXPECT_EQ(stat.peer_intersection_count, 6);
   EXPECT_EQ(stat.original_count, 6);
   EXPECT_EQ(stat.join_intersection_count, 9);
+
+  EXPECT_TRUE(std::filesystem::exists(key_info->IndexPath()));
+  EXPECT_EQ(CountLines(intersect_path_), 10);
+  EXPECT_EQ(CountLines(except_path_), 4);
 }
 
 TEST_F(TableUtilTest, UniqueTableToCsv) {
@@ -109,6 +130,7 @@ TEST_F(TableUtilTest, UniqueTableToCsv) {
   auto key_info = KeyInfo::Make(unique_table);
 
   EXPECT_EQ(key_info->DupKeyCnt(), 0);
+  EXPECT_TRUE(std::filesystem::exists(key_info->IndexPath()));
 
   auto provider = key_info->GetKeysProviderWithDupCnt();
   auto batch = provider->ReadNextBatchWithDupCnt();
@@ -127,4 +149,55 @@ TEST_F(TableUtilTest, UniqueTableToCsv) {
   EXPECT_EQ(stat.join_intersection_count, 6);
 }
 
+TEST_F(TableUtilTest, DigestProvider) {
+  auto table = Table::MakeFromCsv(csv_path_.string());
+  auto sort_table =
+      SortedTable::Make(table, sorted_csv_path_.string(), {"id", "id2"});
+  auto key_info = KeyInfo::Make(sort_table, key_info_path_.string());
+
+  auto digest_path = (root_dir_ / "key_digest.bin").string();
+  // Batches smaller than the key count.
+  auto provider = key_info->GetDigestProvider(digest_path, 3);
+  EXPECT_EQ(provider->ItemCnt(), 4);
+
+  std::unordered_map<uint32_t, uint32_t> dup_cnts;
+  auto digests = provider->ReadNextDigestBatch(&dup_cnts);
+  ASSERT_EQ(digests.size(), 3);
+  EXPECT_EQ(digests[0], yacl::crypto::Blake3_128("1,1"));
+  EXPECT_EQ(digests[1], yacl::crypto::Blake3_128("2,2"));
+  EXPECT_EQ(digests[2], yacl::crypto::Blake3_128("3,3"));
+  EXPECT_EQ(dup_cnts, (std::unordered_map<uint32_t, uint32_t>{{1, 1}}));
+
+  digests = provider->ReadNextDigestBatch(&dup_cnts);
+  ASSERT_EQ(digests.size(), 1);
+  EXPECT_EQ(digests[0], yacl::crypto::Blake3_128("4,4"));
+  EXPECT_EQ(dup_cnts, (std::unordered_map<uint32_t, uint32_t>{{0, 1}}));
+
+  EXPECT_TRUE(provider->ReadNextDigestBatch(&dup_cnts).empty());
+
+  // Reused, and a truncated file is rebuilt.
+  key_info->MakeDigestFile(digest_path);
+  std::filesystem::resize_file(digest_path, 10);
+  provider = key_info->GetDigestProvider(digest_path);
+  EXPECT_EQ(provider->ReadNextDigestBatch(&dup_cnts).size(), 4);
+
+  // A file of other keys is rebuilt, even with the same key count.
+  auto other_csv_path = root_dir_ / "other.csv";
+  {
+    std::ofstream out(other_csv_path);
+    out << "id,id2\n5,5\n6,6\n7,7\n8,8\n";
+  }
+  auto other_sort_table =
+      SortedTable::Make(Table::MakeFromCsv(other_csv_path.string()),
+                        (root_dir_ / "other.csv.sorted").string(),
+                        {"id", "id2"});
+  auto other_key_info = KeyInfo::Make(
+      other_sort_table, (root_dir_ / "other.csv.sorted.keyinfo").string());
+  provider = other_key_info->GetDigestProvider(digest_path);
+  digests = provider->ReadNextDigestBatch(&dup_cnts);
+  ASSERT_EQ(digests.size(), 4);
+  EXPECT_EQ(digests[0], yacl::crypto::Blake3_128("5,5"));
+  EXPECT_TRUE(dup_cnts.empty());
+}
+
 }  // namespace psi